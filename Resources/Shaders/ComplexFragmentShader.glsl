@@ -16,8 +16,8 @@ struct Material {
 	sampler2D albedoTex;
 	sampler2D roughnessTex;
     sampler2D metallicTex;
-	sampler2D ambientTex;
 	sampler2D toonTex;
+	sampler2D normalTex; // Tangent space
 };
 
 uniform Material material;
@@ -32,6 +32,8 @@ uniform bool schlick;			//Approximation of Schlick for GGX micro facet BRDF
 in vec3 fPosition; // Shader input, linearly interpolated by default from the previous stage (here the vertex shader)
 in vec3 fNormal;
 in vec2 fTexCoord;
+in vec4 fTangent; // Handedness of the bitangent in w
+in float fAmbientOcclusion; // Per vertex, 1 when disabled
 
 out vec4 colorResponse; // Shader output: the color response attached to this fragment
 
@@ -39,6 +41,7 @@ out vec4 colorResponse; // Shader output: the color response attached to this fr
 uniform LightSource lightSourcesArray[NB_LIGHTSOURCES];
 
 uniform float renderingMode;
+uniform bool normalMapping = false;
 float alpha =  texture(material.roughnessTex, fTexCoord).r;  // roughness
 float F0 = (texture(material.metallicTex, fTexCoord).r+texture(material.metallicTex, fTexCoord).g+texture(material.metallicTex, fTexCoord).b )/3; //Fresnel refraction index, dependent on material
 float ks = F0;							//coefficient specular
@@ -108,8 +111,21 @@ vec3 computeLightSourceRadiance(LightSource lightSource, vec3 n, vec3 wo)
 		return vec3(0,0,0);
 }
 
+// Perturbs the interpolated normal by the normal map, in the tangent frame orthonormalized per fragment as MikkTSpace expects
+vec3 mapNormal (vec3 n) {
+	vec3 t = fTangent.xyz - n * dot (n, fTangent.xyz);
+	if (dot (t, t) == 0.0)
+		return n;
+	t = normalize (t);
+	vec3 b = (fTangent.w < 0.0 ? -1.0 : 1.0) * cross (n, t);
+	vec3 m = texture (material.normalTex, fTexCoord).xyz * 2.0 - 1.0;
+	return normalize (mat3 (t, b, n) * m);
+}
+
 void main() {
 	vec3 n = normalize (fNormal); // Linear barycentric interpolation does not preserve unit vectors
+	if (normalMapping && renderingMode == 0.f)
+		n = mapNormal (n);
 	vec3 wo = normalize (-fPosition);
 	vec3 radiance = vec3 (0.0, 0.0, 0.0);
 
@@ -119,7 +135,7 @@ void main() {
 		}
 
 		//ambient occlusion
-		radiance = texture(material.ambientTex, fTexCoord).r * radiance;
+		radiance = fAmbientOcclusion * radiance;
 	}
 	else if (renderingMode == 1.f) { //TOON SHADING
 		if (dot(n, wo) < 0.4) { //contour
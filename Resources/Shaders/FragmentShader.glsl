@@ -16,8 +16,8 @@ struct Material {
 	sampler2D albedoTex;
 	sampler2D roughnessTex;
   sampler2D metallicTex;
-	sampler2D ambientTex;
 	sampler2D toonTex;
+	sampler2D normalTex; // Tangent space
 };
 
 uniform Material material;
@@ -28,6 +28,8 @@ uniform float zMax;
 in vec3 fPosition; // Shader input, linearly interpolated by default from the previous stage (here the vertex shader)
 in vec3 fNormal;
 in vec2 fTexCoord;
+in vec4 fTangent; // Handedness of the bitangent in w
+in float fAmbientOcclusion; // Per vertex, 1 when disabled
 
 out vec4 colorResponse; // Shader output: the color response attached to this fragment
 
@@ -35,6 +37,7 @@ out vec4 colorResponse; // Shader output: the color response attached to this fr
 uniform LightSource lightSourcesArray[NB_LIGHTSOURCES];
 
 uniform float renderingMode;
+uniform bool normalMapping = false;
 
 vec3 computeLightSourceRadiance(LightSource lightSource, vec3 n, vec3 wo)
 {
@@ -75,8 +78,21 @@ vec3 computeLightSourceRadiance(LightSource lightSource, vec3 n, vec3 wo)
 	}
 }
 
+// Perturbs the interpolated normal by the normal map, in the tangent frame orthonormalized per fragment as MikkTSpace expects
+vec3 mapNormal (vec3 n) {
+	vec3 t = fTangent.xyz - n * dot (n, fTangent.xyz);
+	if (dot (t, t) == 0.0)
+		return n;
+	t = normalize (t);
+	vec3 b = (fTangent.w < 0.0 ? -1.0 : 1.0) * cross (n, t);
+	vec3 m = texture (material.normalTex, fTexCoord).xyz * 2.0 - 1.0;
+	return normalize (mat3 (t, b, n) * m);
+}
+
 void main() {
 	vec3 n = normalize (fNormal); // Linear barycentric interpolation does not preserve unit vectors
+	if (normalMapping && renderingMode == 0.f)
+		n = mapNormal (n);
 	vec3 wo = normalize (-fPosition);
 	vec3 radiance = vec3 (0.0, 0.0, 0.0);
 
@@ -86,7 +102,7 @@ void main() {
 		}
 
 		//ambient occlusion
-		radiance = texture(material.ambientTex, fTexCoord).r * radiance;
+		radiance = fAmbientOcclusion * radiance;
 	}
 	else if (renderingMode == 1.f) { //TOON SHADING
 		if (dot(n, wo) < 0.4) { //contour
@@ -1,20 +1,59 @@
 #version 450 core // Minimal GL version support expected from the GPU
 
 layout(location=0) in vec3 vPosition; // The 1st input attribute is the position (CPU side: glVertexAttrib 0)
-layout(location=1) in vec3 vNormal;
+layout(location=1) in vec3 vNormal; // Octahedral projection in xy for packed vertices
 layout(location=2) in vec2 vTexCoord;
+layout(location=3) in vec4 vQTangent; // Tangent frame as a unit quaternion, the sign of w being the handedness (see VertexPacking::QTangent)
+layout(location=4) in float vAmbientOcclusion; // Baked on the CPU, 1 being unoccluded (see AmbientOcclusion::bake)
 
-uniform mat4 projectionMat, modelViewMat, normalMat; 
+uniform mat4 projectionMat, modelViewMat, normalMat; // modelViewMat includes the dequantization of packed positions
+uniform bool octahedralNormals = false;
+uniform int texCoordMode = 0; // 0: vTexCoord attribute, generated otherwise: 1: planar, 2: triplanar, 3: spherical (see Mesh::TexCoordMode)
+uniform mat4 texCoordMat; // Maps vPosition to the unit cube of the bounding box, or to the unit bounding sphere in spherical mode
+uniform bool tangentFrames = false;
+uniform bool ambientOcclusion = false;
 
 out vec3 fPosition;
 out vec3 fNormal;
 out vec2 fTexCoord;
+out vec4 fTangent; // View space, with the handedness of the bitangent in w. Zero without tangent frames
+out float fAmbientOcclusion;
+
+vec3 decodeOctahedral (vec2 e) {
+	vec3 n = vec3 (e, 1.0 - abs (e.x) - abs (e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs (n.yx)) * vec2 (n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize (n);
+}
+
+// Tangent, first column of the rotation matrix, and handedness
+vec4 decodeQTangent (vec4 q) {
+	q = normalize (q);
+	vec3 t = vec3 (1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+	return vec4 (t, q.w < 0.0 ? -1.0 : 1.0);
+}
+
+vec2 generateTexCoord (vec3 position, vec3 normal) {
+	vec3 p = (texCoordMat * vec4 (position, 1.0)).xyz;
+	if (texCoordMode == 1)
+		return p.xy;
+	if (texCoordMode == 2) {
+		vec3 a = abs (normal);
+		return a.x >= a.y && a.x >= a.z ? p.yz : (a.y >= a.z ? p.xz : p.xy);
+	}
+	vec3 d = normalize (p);
+	return vec2 (0.5 + atan (d.z, d.x) / (2.0 * 3.14159265), 0.5 + asin (clamp (d.y, -1.0, 1.0)) / 3.14159265);
+}
 
 void main() {
 	vec4 p = modelViewMat * vec4 (vPosition, 1.0);
     gl_Position =  projectionMat * p; // mandatory to fire rasterization properly
-    vec4 n = normalMat * vec4 (vNormal, 1.0);
+    vec3 normal = octahedralNormals ? decodeOctahedral (vNormal.xy) : vNormal;
+    vec4 n = normalMat * vec4 (normal, 1.0);
     fPosition = p.xyz;
     fNormal = normalize (n.xyz);
-    fTexCoord = vTexCoord;
+    fTexCoord = texCoordMode == 0 ? vTexCoord : generateTexCoord (vPosition, normal);
+    vec4 tangent = tangentFrames ? decodeQTangent (vQTangent) : vec4 (0.0);
+    fTangent = vec4 (mat3 (normalMat) * tangent.xyz, tangent.w); // Rigid model-view: tangents turn like normals, and modelViewMat would dequantize them
+    fAmbientOcclusion = ambientOcclusion ? vAmbientOcclusion : 1.0;
 }
\ No newline at end of file
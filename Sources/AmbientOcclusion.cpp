@@ -0,0 +1,161 @@
+#define _USE_MATH_DEFINES
+
+#include "AmbientOcclusion.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "VertexPacking.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include <ios>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = { 'B', 'G', 'L', 'A', 'O', 'C', 'C', '\0' };
+
+/// Increment whenever the layout below or the baking changes
+const uint32_t VERSION = 2;
+
+/// Fixed-size header, followed by the ambient occlusion of every vertex as normalized unsigned shorts, in the native
+/// byte order of the machine that wrote the cache
+struct FileHeader {
+	MeshCache::VersionedHeader versioned;
+	uint64_t geometryHash; // Of the positions, normals and triangles the ambient occlusion was baked from
+	uint64_t numVertices;
+	uint32_t numRays;
+	float maxDistance;
+};
+
+/// Van der Corput sequence, the second coordinate of the Hammersley points
+inline float radicalInverse (uint32_t i) {
+	i = (i << 16) | (i >> 16);
+	i = ((i & 0x55555555u) << 1) | ((i & 0xAAAAAAAAu) >> 1);
+	i = ((i & 0x33333333u) << 2) | ((i & 0xCCCCCCCCu) >> 2);
+	i = ((i & 0x0F0F0F0Fu) << 4) | ((i & 0xF0F0F0F0u) >> 4);
+	i = ((i & 0x00FF00FFu) << 8) | ((i & 0xFF00FF00u) >> 8);
+	return static_cast<float> (i) * 2.3283064365386963e-10f;
+}
+
+/// Integer hash, rotating the sample points of each vertex differently
+inline uint32_t hashVertex (uint32_t v) {
+	v ^= v >> 16;
+	v *= 0x7feb352du;
+	v ^= v >> 15;
+	v *= 0x846ca68bu;
+	v ^= v >> 16;
+	return v;
+}
+
+/// Tangent and bitangent of a unit normal (Duff et al., "Building an Orthonormal Basis, Revisited", 2017)
+inline void orthonormalBasis (const glm::vec3 & n, glm::vec3 & t, glm::vec3 & b) {
+	float sign = std::copysign (1.f, n.z);
+	float a = -1.f / (sign + n.z);
+	float c = n.x * n.y * a;
+	t = glm::vec3 (1.f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+	b = glm::vec3 (c, sign + n.y * n.y * a, -n.y);
+}
+
+uint64_t geometryHash (const Mesh & mesh) {
+	// Hashed from the upload source when it still holds the geometry, which spares filling the vectors
+	const Mesh::ExternalGeometry & source = mesh.uploadSource ();
+	size_t numVertices = mesh.numVertices ();
+	size_t numTriangles = mesh.numTriangles ();
+	bool fromSource = source.positions && source.normals && source.triangles && source.numVertices == numVertices && source.numTriangles == numTriangles;
+	const glm::vec3 * P = fromSource ? source.positions : mesh.vertexPositions ().data ();
+	const glm::vec3 * N = fromSource ? source.normals : mesh.vertexNormals ().data ();
+	const glm::uvec3 * T = fromSource ? source.triangles : mesh.triangleIndices ().data ();
+	uint64_t hashes[3] = { MeshCache::hashBytes (P, sizeof (glm::vec3) * numVertices),
+						   MeshCache::hashBytes (N, sizeof (glm::vec3) * numVertices),
+						   MeshCache::hashBytes (T, sizeof (glm::uvec3) * numTriangles) };
+	return MeshCache::hashBytes (hashes, sizeof (hashes));
+}
+
+}
+
+void AmbientOcclusion::bake (const MeshBVH & bvh, const glm::vec3 * P, const glm::vec3 * N, size_t numVertices, float radius,
+							 float * ambientOcclusion, const BakeOptions & options) {
+	unsigned int numRays = std::max (options.numRays, 1u);
+	float maxDistance = options.maxDistance * radius;
+	float bias = 1e-4f * radius; // Keeps the rays off the triangles of the vertex
+	std::vector<glm::vec2> points (numRays);
+	for (unsigned int i = 0; i < numRays; i++)
+		points[i] = glm::vec2 ((i + 0.5f) / numRays, radicalInverse (i));
+	Parallel::forRangeStealing (numVertices, [&] (size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			float length = glm::length (N[v]);
+			if (!(length > 0.f)) {
+				ambientOcclusion[v] = 1.f;
+				continue;
+			}
+			glm::vec3 n = N[v] / length, t, b;
+			orthonormalBasis (n, t, b);
+			uint32_t h = hashVertex (static_cast<uint32_t> (v));
+			glm::vec2 rotation ((h & 0xFFFF) / 65536.f, (h >> 16) / 65536.f);
+			glm::vec3 origin = P[v] + bias * n;
+			unsigned int numEscaped = 0;
+			for (unsigned int i = 0; i < numRays; i++) {
+				// Cosine-weighted: uniform on the unit disk, projected up to the hemisphere
+				glm::vec2 u = glm::fract (points[i] + rotation);
+				float r = std::sqrt (u.x);
+				float phi = static_cast<float> (2.0 * M_PI) * u.y;
+				glm::vec3 d = r * std::cos (phi) * t + r * std::sin (phi) * b + std::sqrt (std::max (1.f - u.x, 0.f)) * n;
+				if (!bvh.occluded (origin, d, maxDistance))
+					numEscaped++;
+			}
+			ambientOcclusion[v] = static_cast<float> (numEscaped) / numRays;
+		}
+	}, 64);
+}
+
+std::string AmbientOcclusion::cacheFilename (const std::string & sourceFilename) {
+	return sourceFilename + ".ao";
+}
+
+bool AmbientOcclusion::loadCache (const std::string & sourceFilename, const Mesh & mesh, const BakeOptions & options, std::vector<float> & ambientOcclusion) {
+	std::string filename = cacheFilename (sourceFilename);
+	std::shared_ptr<MappedFile> file = MeshCache::mapFile (filename, MAGIC, VERSION, sizeof (FileHeader));
+	if (!file)
+		return false;
+	FileHeader header;
+	std::memcpy (&header, file->data (), sizeof (FileHeader));
+	size_t numVertices = mesh.numVertices ();
+	if (header.versioned.fileSize != sizeof (FileHeader) + sizeof (uint16_t) * header.numVertices) {
+		std::cout << " > [AO] Ignoring incompatible cache <" << filename << ">" << std::endl;
+		return false;
+	}
+	if (header.numVertices != numVertices || header.numRays != options.numRays || header.maxDistance != options.maxDistance
+		|| header.geometryHash != geometryHash (mesh)) {
+		std::cout << " > [AO] Cache <" << filename << "> out of date" << std::endl;
+		return false;
+	}
+	const char * packed = file->data () + sizeof (FileHeader);
+	ambientOcclusion.resize (numVertices);
+	for (size_t v = 0; v < numVertices; v++) {
+		uint16_t value;
+		std::memcpy (&value, packed + sizeof (uint16_t) * v, sizeof (uint16_t));
+		ambientOcclusion[v] = value / 65535.f;
+	}
+	std::cout << " > [AO] " << numVertices << " vertices read from <" << filename << ">" << std::endl;
+	return true;
+}
+
+void AmbientOcclusion::saveCache (const std::string & sourceFilename, const Mesh & mesh, const BakeOptions & options, const std::vector<float> & ambientOcclusion) {
+	if (ambientOcclusion.size () != mesh.numVertices ())
+		throw std::ios_base::failure ("[Ambient Occlusion][saveCache] Incomplete ambient occlusion for " + sourceFilename);
+	FileHeader header;
+	std::memset (static_cast<void *> (&header), 0, sizeof (FileHeader)); // Padding included, for reproducible files
+	header.geometryHash = geometryHash (mesh);
+	header.numVertices = ambientOcclusion.size ();
+	header.numRays = options.numRays;
+	header.maxDistance = options.maxDistance;
+	std::vector<uint16_t> packed (ambientOcclusion.size ());
+	VertexPacking::packAmbientOcclusion (ambientOcclusion.data (), ambientOcclusion.size (), packed.data ());
+	MeshCache::writeFile (cacheFilename (sourceFilename), MAGIC, VERSION, header.versioned, sizeof (FileHeader),
+						  { { sizeof (FileHeader), packed.data (), sizeof (uint16_t) * packed.size () } });
+}
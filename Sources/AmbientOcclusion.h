@@ -0,0 +1,43 @@
+#ifndef AMBIENT_OCCLUSION_H
+#define AMBIENT_OCCLUSION_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "MeshBVH.h"
+
+/// Per-vertex ambient occlusion, baked on the CPU by casting rays over the hemisphere of the normal of each vertex
+/// against a BVH of the mesh, and its sidecar cache next to the source model.
+namespace AmbientOcclusion {
+
+struct BakeOptions {
+	unsigned int numRays = 64; ///< Per vertex
+	float maxDistance = 0.5f; ///< Beyond which occluders are ignored, relative to the bounding sphere radius
+};
+
+/// Fraction of cosine-weighted rays (Hammersley points rotated per vertex) escaping within the maximum distance,
+/// i.e., the cosine-weighted visibility of the hemisphere, for each vertex. Rays start slightly above the vertex along
+/// its normal, vertices without normal are unoccluded. Vertices are spread over the threads with work stealing, each
+/// thread walking a contiguous range first: the rays of neighbouring vertices traverse the same nodes. The result does
+/// not depend on the number of threads.
+void bake (const MeshBVH & bvh, const glm::vec3 * P, const glm::vec3 * N, size_t numVertices, float radius,
+		   float * ambientOcclusion, const BakeOptions & options = BakeOptions ());
+
+/// Location of the cache associated to a source model
+std::string cacheFilename (const std::string & sourceFilename);
+
+/// Reads the ambient occlusion of the mesh from the cache of sourceFilename, as normalized unsigned shorts. Returns
+/// false, leaving ambientOcclusion unchanged, if there is no cache or if it was baked from other positions, normals,
+/// triangles or options.
+bool loadCache (const std::string & sourceFilename, const Mesh & mesh, const BakeOptions & options, std::vector<float> & ambientOcclusion);
+
+/// Writes the cache of sourceFilename. Throws std::ios_base::failure on I/O errors.
+void saveCache (const std::string & sourceFilename, const Mesh & mesh, const BakeOptions & options, const std::vector<float> & ambientOcclusion);
+
+}
+
+#endif // AMBIENT_OCCLUSION_H
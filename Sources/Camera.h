@@ -14,6 +14,16 @@ public:
 	inline void setNear (float n) { m_near = n; }
 	inline float getFar () const { return m_far; }
 	inline void setFar (float n) { m_far = n; }
+
+	/// Point the rotations of the camera orbit around, the origin by default
+	inline const glm::vec3 & getPivot () const { return m_pivot; }
+
+	/// Moves the pivot, the translation compensating so that the view stays the same
+	inline void setPivot (const glm::vec3 & p) {
+		glm::mat3 frame (glm::mat4_cast (curQuat) * computeTransformMatrix ());
+		setTranslation (getTranslation () + glm::inverse (frame) * (m_pivot - p));
+		m_pivot = p;
+	}
 	
 	/**
 	 *  The view matrix is the inverse of the camera model matrix, 
@@ -22,7 +32,7 @@ public:
 	 */
 	inline glm::mat4 computeViewMatrix () const {
 		glm::mat4 rotationMatrix = glm::mat4_cast (curQuat);
-		return inverse (rotationMatrix * computeTransformMatrix ());
+		return inverse (glm::translate (glm::mat4 (1.f), m_pivot) * rotationMatrix * computeTransformMatrix ());
 	}
 	
 	/// Returns the projection matrix stemming from the camera intrinsic parameter. 
@@ -35,6 +45,7 @@ private:
 	float m_aspectRatio = 1.f; // Ratio between the width and the height of the image
 	float m_near = 0.1f; // Distance before which geometry is excluded fromt he rasterization process
 	float m_far = 10.f; // Distance after which the geometry is excluded fromt he rasterization process
+	glm::vec3 m_pivot = glm::vec3 (0.f);
 	glm::quat curQuat;
 	glm::quat lastQuat;
 };
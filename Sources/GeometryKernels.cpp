@@ -0,0 +1,661 @@
+#define _USE_MATH_DEFINES
+
+#include "GeometryKernels.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_SSE2
+#endif
+
+using namespace std;
+
+namespace {
+
+#ifdef MESH_SSE2
+/// acos on [-1, 1], absolute error below 1e-6 rad (Abramowitz and Stegun 4.4.46, reflected for negative inputs)
+inline __m128 acos4 (__m128 x) {
+	const __m128 signMask = _mm_set1_ps (-0.f);
+	__m128 negative = _mm_cmplt_ps (x, _mm_setzero_ps ());
+	__m128 a = _mm_min_ps (_mm_andnot_ps (signMask, x), _mm_set1_ps (1.f));
+	__m128 poly = _mm_set1_ps (-0.0012624911f);
+	poly = _mm_add_ps (_mm_mul_ps (poly, a), _mm_set1_ps (0.0066700901f));
+	poly = _mm_add_ps (_mm_mul_ps (poly, a), _mm_set1_ps (-0.0170881256f));
+	poly = _mm_add_ps (_mm_mul_ps (poly, a), _mm_set1_ps (0.0308918810f));
+	poly = _mm_add_ps (_mm_mul_ps (poly, a), _mm_set1_ps (-0.0501743046f));
+	poly = _mm_add_ps (_mm_mul_ps (poly, a), _mm_set1_ps (0.0889789874f));
+	poly = _mm_add_ps (_mm_mul_ps (poly, a), _mm_set1_ps (-0.2145988016f));
+	poly = _mm_add_ps (_mm_mul_ps (poly, a), _mm_set1_ps (1.5707963050f));
+	__m128 result = _mm_mul_ps (_mm_sqrt_ps (_mm_sub_ps (_mm_set1_ps (1.f), a)), poly);
+	__m128 reflected = _mm_sub_ps (_mm_set1_ps (static_cast<float> (M_PI)), result);
+	return _mm_or_ps (_mm_and_ps (negative, reflected), _mm_andnot_ps (negative, result));
+}
+
+/// Normalizes 4 vectors in SoA form. Zero vectors stay zero.
+inline void normalize4 (__m128 & x, __m128 & y, __m128 & z) {
+	__m128 squaredLength = _mm_add_ps (_mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y)), _mm_mul_ps (z, z));
+	__m128 nonZero = _mm_cmpgt_ps (squaredLength, _mm_setzero_ps ());
+	__m128 inverseLength = _mm_and_ps (nonZero, _mm_div_ps (_mm_set1_ps (1.f), _mm_sqrt_ps (squaredLength)));
+	x = _mm_mul_ps (x, inverseLength);
+	y = _mm_mul_ps (y, inverseLength);
+	z = _mm_mul_ps (z, inverseLength);
+}
+
+inline float horizontalMax (__m128 v) {
+	v = _mm_max_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (1, 0, 3, 2)));
+	v = _mm_max_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 3, 0, 1)));
+	return _mm_cvtss_f32 (v);
+}
+
+inline float horizontalMin (__m128 v) {
+	v = _mm_min_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (1, 0, 3, 2)));
+	v = _mm_min_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 3, 0, 1)));
+	return _mm_cvtss_f32 (v);
+}
+
+inline float horizontalSum (__m128 v) {
+	alignas (16) float lanes[4];
+	_mm_store_ps (lanes, v);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+#endif
+
+/// Scalar counterpart of normalize4
+inline glm::vec3 safeNormalize (const glm::vec3 & v) {
+	float squaredLength = glm::dot (v, v);
+	return squaredLength > 0.f ? v * (1.f / std::sqrt (squaredLength)) : glm::vec3 (0.f);
+}
+
+/// Vertex fetches of the normal kernels from interleaved positions
+struct AoSPositions {
+	const glm::vec3 * P;
+
+	inline glm::vec3 operator[] (unsigned int i) const { return P[i]; }
+
+#ifdef MESH_SSE2
+	/// Vertices i[0..3], one per lane
+	inline void load4 (const unsigned int i[4], __m128 & x, __m128 & y, __m128 & z) const {
+		__m128 v[4];
+		for (int k = 0; k < 4; k++) {
+			// x, y, z, 0 without reading past the vertex, then transposed
+			const float * q = &P[i[k]][0];
+			v[k] = _mm_movelh_ps (_mm_loadl_pi (_mm_setzero_ps (), reinterpret_cast<const __m64 *> (q)), _mm_load_ss (q + 2));
+		}
+		_MM_TRANSPOSE4_PS (v[0], v[1], v[2], v[3]);
+		x = v[0];
+		y = v[1];
+		z = v[2];
+	}
+#endif
+};
+
+/// Vertex fetches of the normal kernels from separate coordinate arrays
+struct SoAPositions {
+	const float * x;
+	const float * y;
+	const float * z;
+
+	inline glm::vec3 operator[] (unsigned int i) const { return glm::vec3 (x[i], y[i], z[i]); }
+
+#ifdef MESH_SSE2
+	inline void load4 (const unsigned int i[4], __m128 & px, __m128 & py, __m128 & pz) const {
+		px = _mm_setr_ps (x[i[0]], x[i[1]], x[i[2]], x[i[3]]);
+		py = _mm_setr_ps (y[i[0]], y[i[1]], y[i[2]], y[i[3]]);
+		pz = _mm_setr_ps (z[i[0]], z[i[1]], z[i[2]], z[i[3]]);
+	}
+#endif
+};
+
+/// Sphere in double precision, for the fitting steps
+struct Sphere {
+	glm::dvec3 center = glm::dvec3 (0.0);
+	double radius = -1.0; // Empty
+
+	inline bool contains (const glm::dvec3 & p, double tolerance = 0.0) const {
+		return radius >= 0.0 && glm::length (p - center) <= radius * (1.0 + tolerance) + tolerance;
+	}
+};
+
+/// Smallest sphere through the support points (at most 4), falling back to the sphere of the farthest pair when they
+/// are (nearly) degenerate
+Sphere circumscribedSphere (const glm::dvec3 * support, int numSupport) {
+	Sphere s;
+	if (numSupport == 0)
+		return s;
+	glm::dvec3 p0 = support[0];
+	if (numSupport == 1) {
+		s.center = p0;
+		s.radius = 0.0;
+		return s;
+	}
+	glm::dvec3 a = support[1] - p0;
+	bool solved = false;
+	if (numSupport == 2) {
+		s.center = p0 + 0.5 * a;
+		solved = true;
+	} else if (numSupport == 3) {
+		glm::dvec3 b = support[2] - p0;
+		glm::dvec3 axb = glm::cross (a, b);
+		double denominator = 2.0 * glm::dot (axb, axb);
+		if (denominator > 1e-12 * glm::dot (a, a) * glm::dot (b, b)) {
+			s.center = p0 + (glm::dot (b, b) * glm::cross (axb, a) + glm::dot (a, a) * glm::cross (b, axb)) / denominator;
+			solved = true;
+		}
+	} else {
+		glm::dvec3 b = support[2] - p0;
+		glm::dvec3 c = support[3] - p0;
+		// 2 [a b c]^T x = (|a|^2, |b|^2, |c|^2)
+		glm::dmat3 m = glm::transpose (glm::dmat3 (a, b, c));
+		double determinant = glm::determinant (m);
+		double scale = glm::length (a) * glm::length (b) * glm::length (c);
+		if (std::abs (determinant) > 1e-12 * scale) {
+			s.center = p0 + glm::inverse (m) * (0.5 * glm::dvec3 (glm::dot (a, a), glm::dot (b, b), glm::dot (c, c)));
+			solved = true;
+		}
+	}
+	if (!solved) {
+		s.radius = -1.0;
+		for (int i = 0; i < numSupport; i++)
+			for (int j = i + 1; j < numSupport; j++)
+				if (glm::length (support[i] - support[j]) > 2.0 * s.radius) {
+					s.center = 0.5 * (support[i] + support[j]);
+					s.radius = 0.5 * glm::length (support[i] - support[j]);
+				}
+		return s;
+	}
+	for (int i = 0; i < numSupport; i++)
+		s.radius = std::max (s.radius, glm::length (support[i] - s.center));
+	return s;
+}
+
+/// Minimal enclosing sphere of a few points (Welzl, "Smallest enclosing disks (balls and ellipsoids)", 1991)
+Sphere minimalSphere (const glm::dvec3 * points, int numPoints, glm::dvec3 * support, int numSupport) {
+	if (numPoints == 0 || numSupport == 4)
+		return circumscribedSphere (support, numSupport);
+	Sphere s = minimalSphere (points, numPoints - 1, support, numSupport);
+	if (s.contains (points[numPoints - 1], 1e-9))
+		return s;
+	support[numSupport] = points[numPoints - 1];
+	return minimalSphere (points, numPoints - 1, support, numSupport + 1);
+}
+
+/// Grows a sphere just enough to enclose p, moving its center toward p (Ritter, "An efficient bounding sphere", 1990)
+inline void growSphere (Sphere & s, const glm::dvec3 & p) {
+	glm::dvec3 offset = p - s.center;
+	double squaredDistance = glm::dot (offset, offset);
+	if (squaredDistance <= s.radius * s.radius)
+		return;
+	double d = std::sqrt (squaredDistance);
+	double radius = 0.5 * (s.radius + d);
+	s.center += (radius - s.radius) / d * offset;
+	s.radius = radius;
+}
+
+/// Smallest sphere enclosing two spheres
+Sphere mergeSpheres (const Sphere & a, const Sphere & b) {
+	if (b.radius < 0.0)
+		return a;
+	if (a.radius < 0.0)
+		return b;
+	glm::dvec3 ab = b.center - a.center;
+	double d = glm::length (ab);
+	if (d + b.radius <= a.radius)
+		return a;
+	if (d + a.radius <= b.radius)
+		return b;
+	Sphere s;
+	s.radius = 0.5 * (d + a.radius + b.radius);
+	s.center = a.center + (s.radius - a.radius) / d * ab;
+	return s;
+}
+
+/// Eigen decomposition of a symmetric matrix by cyclic Jacobi rotations. Eigenvectors are the columns of vectors.
+void symmetricEigen (glm::dmat3 m, glm::dvec3 & values, glm::dmat3 & vectors) {
+	vectors = glm::dmat3 (1.0);
+	for (int sweep = 0; sweep < 32; sweep++) {
+		double offDiagonal = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+		if (offDiagonal < 1e-30 * (m[0][0] * m[0][0] + m[1][1] * m[1][1] + m[2][2] * m[2][2]) || offDiagonal == 0.0)
+			break;
+		for (int p = 0; p < 2; p++)
+			for (int q = p + 1; q < 3; q++) {
+				if (m[p][q] == 0.0)
+					continue;
+				double theta = (m[q][q] - m[p][p]) / (2.0 * m[p][q]);
+				double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs (theta) + std::sqrt (theta * theta + 1.0));
+				double c = 1.0 / std::sqrt (t * t + 1.0);
+				double sn = t * c;
+				glm::dmat3 rotation (1.0);
+				rotation[p][p] = c;
+				rotation[q][q] = c;
+				rotation[q][p] = sn; // Column q, row p
+				rotation[p][q] = -sn;
+				m = glm::transpose (rotation) * m * rotation;
+				vectors = vectors * rotation;
+			}
+	}
+	values = glm::dvec3 (m[0][0], m[1][1], m[2][2]);
+}
+
+template<typename Positions>
+GeometryKernels::Bounds computeBounds (const Positions & P, size_t numVertices) {
+	GeometryKernels::Bounds bounds;
+	if (numVertices == 0)
+		return bounds;
+	const size_t blockSize = 16384;
+	size_t numBlocks = (numVertices + blockSize - 1) / blockSize;
+	auto blockEnd = [&] (size_t b) { return std::min (numVertices, (b + 1) * blockSize); };
+
+	// First pass: box, moments relative to the first vertex (avoids the cancellation far from the origin), and extreme
+	// vertices along the axes and the diagonals of the unit cube
+	struct Reduction {
+		glm::vec3 boxMin = glm::vec3 (std::numeric_limits<float>::max ());
+		glm::vec3 boxMax = glm::vec3 (-std::numeric_limits<float>::max ());
+		glm::dvec3 sum = glm::dvec3 (0.0);
+		double sumProducts[6] = {}; // xx, xy, xz, yy, yz, zz
+		float extremeMin[7];
+		float extremeMax[7];
+		glm::vec3 extremeMinVertex[7];
+		glm::vec3 extremeMaxVertex[7];
+	};
+	glm::dvec3 origin = P[0];
+	std::vector<Reduction> reductions (numBlocks);
+	Parallel::forEachTask (numBlocks, [&] (size_t b) {
+		// Accumulated in locals, which the compiler keeps in registers, and extremes tracked by index
+		Reduction r;
+		std::fill (r.extremeMin, r.extremeMin + 7, std::numeric_limits<float>::max ());
+		std::fill (r.extremeMax, r.extremeMax + 7, -std::numeric_limits<float>::max ());
+		unsigned int extremeMinIndex[7] = {};
+		unsigned int extremeMaxIndex[7] = {};
+		glm::dvec3 sum (0.0);
+		double xx = 0.0, xy = 0.0, xz = 0.0, yy = 0.0, yz = 0.0, zz = 0.0;
+		for (unsigned int i = static_cast<unsigned int> (b * blockSize); i < blockEnd (b); i++) {
+			glm::vec3 p = P[i];
+			r.boxMin = glm::min (r.boxMin, p);
+			r.boxMax = glm::max (r.boxMax, p);
+			glm::dvec3 d = glm::dvec3 (p) - origin;
+			sum += d;
+			xx += d.x * d.x;
+			xy += d.x * d.y;
+			xz += d.x * d.z;
+			yy += d.y * d.y;
+			yz += d.y * d.z;
+			zz += d.z * d.z;
+			float projections[7] = { p.x, p.y, p.z, p.x + p.y + p.z, p.x + p.y - p.z, p.x - p.y + p.z, -p.x + p.y + p.z };
+			for (int k = 0; k < 7; k++) {
+				if (projections[k] < r.extremeMin[k]) {
+					r.extremeMin[k] = projections[k];
+					extremeMinIndex[k] = i;
+				}
+				if (projections[k] > r.extremeMax[k]) {
+					r.extremeMax[k] = projections[k];
+					extremeMaxIndex[k] = i;
+				}
+			}
+		}
+		r.sum = sum;
+		double products[6] = { xx, xy, xz, yy, yz, zz };
+		std::copy (products, products + 6, r.sumProducts);
+		for (int k = 0; k < 7; k++) {
+			r.extremeMinVertex[k] = P[extremeMinIndex[k]];
+			r.extremeMaxVertex[k] = P[extremeMaxIndex[k]];
+		}
+		reductions[b] = r;
+	});
+	Reduction total = reductions[0];
+	for (size_t b = 1; b < numBlocks; b++) {
+		const Reduction & r = reductions[b];
+		total.boxMin = glm::min (total.boxMin, r.boxMin);
+		total.boxMax = glm::max (total.boxMax, r.boxMax);
+		total.sum += r.sum;
+		for (int k = 0; k < 6; k++)
+			total.sumProducts[k] += r.sumProducts[k];
+		for (int k = 0; k < 7; k++) {
+			if (r.extremeMin[k] < total.extremeMin[k]) {
+				total.extremeMin[k] = r.extremeMin[k];
+				total.extremeMinVertex[k] = r.extremeMinVertex[k];
+			}
+			if (r.extremeMax[k] > total.extremeMax[k]) {
+				total.extremeMax[k] = r.extremeMax[k];
+				total.extremeMaxVertex[k] = r.extremeMaxVertex[k];
+			}
+		}
+	}
+	bounds.boxMin = total.boxMin;
+	bounds.boxMax = total.boxMax;
+
+	// Principal axes
+	double n = static_cast<double> (numVertices);
+	glm::dvec3 mean = total.sum / n;
+	const double * s = total.sumProducts;
+	glm::dmat3 covariance (s[0] / n - mean.x * mean.x, s[1] / n - mean.x * mean.y, s[2] / n - mean.x * mean.z,
+						   s[1] / n - mean.x * mean.y, s[3] / n - mean.y * mean.y, s[4] / n - mean.y * mean.z,
+						   s[2] / n - mean.x * mean.z, s[4] / n - mean.y * mean.z, s[5] / n - mean.z * mean.z);
+	glm::dvec3 variances;
+	glm::dmat3 eigenvectors;
+	symmetricEigen (covariance, variances, eigenvectors);
+	int order[3] = { 0, 1, 2 };
+	std::sort (order, order + 3, [&] (int a, int b) { return variances[a] > variances[b]; });
+	glm::dmat3 axes (eigenvectors[order[0]], eigenvectors[order[1]], glm::dvec3 (0.0));
+	axes[0] = glm::normalize (axes[0]);
+	axes[1] = glm::normalize (axes[1] - glm::dot (axes[1], axes[0]) * axes[0]);
+	axes[2] = glm::cross (axes[0], axes[1]);
+
+	// Seed sphere: the minimal one of the extreme vertices, relative to the first vertex as well
+	glm::dvec3 extremes[14];
+	for (int k = 0; k < 7; k++) {
+		extremes[2 * k] = glm::dvec3 (total.extremeMinVertex[k]) - origin;
+		extremes[2 * k + 1] = glm::dvec3 (total.extremeMaxVertex[k]) - origin;
+	}
+	glm::dvec3 support[4];
+	Sphere seed = minimalSphere (extremes, 14, support, 0);
+
+	// Second pass: growth of the seed over the vertices, and extents along the principal axes
+	struct Extents {
+		Sphere sphere;
+		glm::vec3 min = glm::vec3 (std::numeric_limits<float>::max ());
+		glm::vec3 max = glm::vec3 (-std::numeric_limits<float>::max ());
+	};
+	std::vector<Extents> extents (numBlocks);
+	glm::mat3 toAxes = glm::transpose (glm::mat3 (axes));
+	glm::vec3 floatOrigin = glm::vec3 (origin);
+	Parallel::forEachTask (numBlocks, [&] (size_t b) {
+		Extents & e = extents[b];
+		e.sphere = seed;
+		for (size_t i = b * blockSize; i < blockEnd (b); i++) {
+			glm::vec3 p = P[static_cast<unsigned int> (i)];
+			growSphere (e.sphere, glm::dvec3 (p) - origin);
+			glm::vec3 projection = toAxes * (p - floatOrigin);
+			e.min = glm::min (e.min, projection);
+			e.max = glm::max (e.max, projection);
+		}
+	});
+	Sphere sphere = extents[0].sphere;
+	glm::dvec3 axesMin = extents[0].min;
+	glm::dvec3 axesMax = extents[0].max;
+	for (size_t b = 1; b < numBlocks; b++) {
+		sphere = mergeSpheres (sphere, extents[b].sphere);
+		axesMin = glm::min (axesMin, glm::dvec3 (extents[b].min));
+		axesMax = glm::max (axesMax, glm::dvec3 (extents[b].max));
+	}
+	// Rounded outward, so that the float sphere still encloses every vertex
+	bounds.sphereCenter = glm::vec3 (origin + sphere.center);
+	bounds.sphereRadius = static_cast<float> (sphere.radius + glm::length (glm::dvec3 (bounds.sphereCenter) - (origin + sphere.center))) * (1.f + 1e-6f);
+	bounds.orientedBoxCenter = glm::vec3 (origin + axes * (0.5 * (axesMin + axesMax)));
+	bounds.orientedBoxAxes = glm::mat3 (axes);
+	bounds.orientedBoxHalfExtents = glm::vec3 (0.5 * (axesMax - axesMin));
+	return bounds;
+}
+
+
+/// Unit normal of triangles [begin, end), and the angle at each of their corners when angles is not null, written
+/// from the start of the output arrays.
+/// Degenerate triangles get a null normal, and thus do not contribute to the vertex normals.
+template<typename Positions>
+void computeFaceNormals (const Positions & P, const glm::uvec3 * T, size_t begin, size_t end, glm::vec3 * faceNormals, float * angles) {
+	size_t t = begin;
+#ifdef MESH_SSE2
+	// 4 triangles at a time, one per lane. Gathering the vertices of 4 triangles (transposing them in the AoS case) costs
+	// about what the vectorized cross products save, only the angles (acos) make this path pay off.
+	for (; angles && t + 4 <= end; t += 4) {
+		__m128 p[3][3]; // [corner][axis]
+		for (int j = 0; j < 3; j++) {
+			unsigned int indices[4] = { T[t][j], T[t + 1][j], T[t + 2][j], T[t + 3][j] };
+			P.load4 (indices, p[j][0], p[j][1], p[j][2]);
+		}
+		__m128 e[3][3]; // e[j]: edge from corner j to corner j + 1
+		for (int j = 0; j < 3; j++)
+			for (int axis = 0; axis < 3; axis++)
+				e[j][axis] = _mm_sub_ps (p[(j + 1) % 3][axis], p[j][axis]);
+		// cross (p1 - p0, p2 - p0)
+		__m128 u[3] = { e[0][0], e[0][1], e[0][2] };
+		__m128 v[3] = { _mm_sub_ps (p[2][0], p[0][0]), _mm_sub_ps (p[2][1], p[0][1]), _mm_sub_ps (p[2][2], p[0][2]) };
+		__m128 nx = _mm_sub_ps (_mm_mul_ps (u[1], v[2]), _mm_mul_ps (v[1], u[2]));
+		__m128 ny = _mm_sub_ps (_mm_mul_ps (u[2], v[0]), _mm_mul_ps (v[2], u[0]));
+		__m128 nz = _mm_sub_ps (_mm_mul_ps (u[0], v[1]), _mm_mul_ps (v[0], u[1]));
+		normalize4 (nx, ny, nz);
+		alignas (16) float n[3][4];
+		_mm_store_ps (n[0], nx);
+		_mm_store_ps (n[1], ny);
+		_mm_store_ps (n[2], nz);
+		for (int k = 0; k < 4; k++)
+			faceNormals[t + k - begin] = glm::vec3 (n[0][k], n[1][k], n[2][k]);
+		for (int j = 0; j < 3; j++)
+			normalize4 (e[j][0], e[j][1], e[j][2]);
+		alignas (16) float a[3][4];
+		for (int j = 0; j < 3; j++) {
+			// Angle at corner j, between the outgoing edge j and the reversed incoming edge j + 2
+			const __m128 * out = e[j];
+			const __m128 * in = e[(j + 2) % 3];
+			__m128 cosine = _mm_sub_ps (_mm_setzero_ps (), _mm_add_ps (_mm_add_ps (_mm_mul_ps (out[0], in[0]), _mm_mul_ps (out[1], in[1])), _mm_mul_ps (out[2], in[2])));
+			_mm_store_ps (a[j], acos4 (cosine));
+		}
+		for (int k = 0; k < 4; k++)
+			for (int j = 0; j < 3; j++)
+				angles[3 * (t + k - begin) + j] = a[j][k];
+	}
+#endif
+	for (; t < end; t++) {
+		glm::vec3 p0 = P[T[t][0]];
+		glm::vec3 p1 = P[T[t][1]];
+		glm::vec3 p2 = P[T[t][2]];
+		faceNormals[t - begin] = safeNormalize (glm::cross (p1 - p0, p2 - p0));
+		if (angles) {
+			glm::vec3 e[3] = { safeNormalize (p1 - p0), safeNormalize (p2 - p1), safeNormalize (p0 - p2) };
+			for (int j = 0; j < 3; j++)
+				angles[3 * (t - begin) + j] = std::acos (glm::clamp (-glm::dot (e[j], e[(j + 2) % 3]), -1.f, 1.f));
+		}
+	}
+}
+
+/// Face normals (and corner angles) are computed per triangle, then summed per vertex in increasing corner order.
+/// With several workers, the sums use a gather formulation over the vertex to corners table: each thread owns a range
+/// of triangles, then a range of vertices, so nothing is written concurrently. The table is built on the fly when no
+/// adjacency is given. A single worker scatters the face normals of small batches instead, which is race-free there and
+/// needs neither the table nor per-triangle arrays.
+/// Both paths sum in the same order, the normals do not depend on the number of threads.
+template<typename Positions>
+void computePerVertexNormals (const Positions & P, size_t numVertices, const glm::uvec3 * T, size_t numTriangles, glm::vec3 * N, bool angleBased,
+							  const MeshAdjacency * adjacency) {
+	if (Parallel::numThreads () == 1) {
+		const size_t batchSize = 256; // Multiple of the SIMD width, so that both paths vectorize the same triangles
+		glm::vec3 faceNormals[batchSize];
+		float angles[3 * batchSize];
+		std::fill (N, N + numVertices, glm::vec3 (0.f));
+		for (size_t begin = 0; !angleBased && begin < numTriangles; begin++) {
+			// Same arithmetic as computeFaceNormals, without the round trip through memory
+			const glm::uvec3 & t = T[begin];
+			glm::vec3 p0 = P[t[0]];
+			glm::vec3 normal = safeNormalize (glm::cross (P[t[1]] - p0, P[t[2]] - p0));
+			for (int j = 0; j < 3; j++)
+				N[t[j]] += normal;
+		}
+		for (size_t begin = 0; angleBased && begin < numTriangles; begin += batchSize) {
+			size_t end = std::min (begin + batchSize, numTriangles);
+			computeFaceNormals (P, T, begin, end, faceNormals, angles);
+			for (size_t t = begin; t < end; t++)
+				for (int j = 0; j < 3; j++)
+					N[T[t][j]] += angles[3 * (t - begin) + j] * faceNormals[t - begin];
+		}
+		for (size_t v = 0; v < numVertices; v++)
+			N[v] = safeNormalize (N[v]);
+		return;
+	}
+	std::vector<glm::vec3> faceNormals (numTriangles);
+	std::vector<float> angles (angleBased ? 3 * numTriangles : 0);
+	// Blocks of whole SIMD groups, so that the scalar tail handles the same triangles whatever the number of threads
+	size_t numGroups = (numTriangles + 3) / 4;
+	Parallel::forRange (numGroups, [&] (size_t begin, size_t end) {
+		computeFaceNormals (P, T, 4 * begin, std::min (4 * end, numTriangles), faceNormals.data () + 4 * begin,
+							angleBased ? angles.data () + 12 * begin : nullptr);
+	}, 1024);
+	std::unique_ptr<MeshAdjacency> localAdjacency;
+	if (!adjacency) {
+		localAdjacency = std::make_unique<MeshAdjacency> (T, numTriangles, numVertices);
+		adjacency = localAdjacency.get ();
+	}
+	Parallel::forRange (numVertices, [&] (size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			glm::vec3 sum (0.f);
+			for (unsigned int corner : adjacency->corners (static_cast<unsigned int> (v)))
+				sum += (angleBased ? angles[corner] : 1.f) * faceNormals[MeshAdjacency::triangle (corner)];
+			N[v] = safeNormalize (sum);
+		}
+	});
+}
+
+}
+
+GeometryKernels::Bounds GeometryKernels::computeBounds (const glm::vec3 * P, size_t numVertices) {
+	return ::computeBounds (AoSPositions { P }, numVertices);
+}
+
+GeometryKernels::Bounds GeometryKernels::computeBounds (const VertexSoA & P) {
+	return ::computeBounds (SoAPositions { P.x.data (), P.y.data (), P.z.data () }, P.numVertices);
+}
+
+void GeometryKernels::computePerVertexNormals (const glm::vec3 * P, size_t numVertices, const glm::uvec3 * T, size_t numTriangles, glm::vec3 * N,
+											   bool angleBased, const MeshAdjacency * adjacency) {
+	::computePerVertexNormals (AoSPositions { P }, numVertices, T, numTriangles, N, angleBased, adjacency);
+}
+
+void GeometryKernels::computePerVertexNormals (const VertexSoA & P, const glm::uvec3 * T, size_t numTriangles, glm::vec3 * N, bool angleBased,
+											   const MeshAdjacency * adjacency) {
+	::computePerVertexNormals (SoAPositions { P.x.data (), P.y.data (), P.z.data () }, P.numVertices, T, numTriangles, N, angleBased, adjacency);
+}
+
+void GeometryKernels::computePerVertexTangents (const glm::vec3 * P, const glm::vec3 * N, const glm::vec2 * UV, size_t numVertices,
+												const glm::uvec3 * T, size_t numTriangles, glm::vec4 * tangents, const MeshAdjacency * adjacency) {
+	// Per triangle: unit dP/du and dP/dv, oriented by the winding of the triangle in texture space, and corner angles
+	std::vector<glm::vec3> faceTangents (2 * numTriangles);
+	std::vector<float> angles (3 * numTriangles);
+	Parallel::forRange (numTriangles, [&] (size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++) {
+			const glm::uvec3 & triangle = T[t];
+			glm::vec3 e1 = P[triangle[1]] - P[triangle[0]];
+			glm::vec3 e2 = P[triangle[2]] - P[triangle[0]];
+			glm::vec2 d1 = UV[triangle[1]] - UV[triangle[0]];
+			glm::vec2 d2 = UV[triangle[2]] - UV[triangle[0]];
+			float det = d1.x * d2.y - d2.x * d1.y;
+			float orientation = det < 0.f ? -1.f : 1.f;
+			// Degenerate in texture space: no contribution
+			faceTangents[2 * t] = det == 0.f ? glm::vec3 (0.f) : safeNormalize (orientation * (d2.y * e1 - d1.y * e2));
+			faceTangents[2 * t + 1] = det == 0.f ? glm::vec3 (0.f) : safeNormalize (orientation * (d1.x * e2 - d2.x * e1));
+			glm::vec3 e[3] = { safeNormalize (e1), safeNormalize (e2 - e1), safeNormalize (-e2) };
+			for (int j = 0; j < 3; j++)
+				angles[3 * t + j] = std::acos (glm::clamp (-glm::dot (e[j], e[(j + 2) % 3]), -1.f, 1.f));
+		}
+	}, 1024);
+	std::unique_ptr<MeshAdjacency> localAdjacency;
+	if (!adjacency) {
+		localAdjacency = std::make_unique<MeshAdjacency> (T, numTriangles, numVertices);
+		adjacency = localAdjacency.get ();
+	}
+	Parallel::forRange (numVertices, [&] (size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			glm::vec3 n = N[v];
+			glm::vec3 tangent (0.f), bitangent (0.f);
+			for (unsigned int corner : adjacency->corners (static_cast<unsigned int> (v))) {
+				unsigned int t = MeshAdjacency::triangle (corner);
+				const glm::vec3 & s = faceTangents[2 * t];
+				const glm::vec3 & b = faceTangents[2 * t + 1];
+				tangent += angles[corner] * safeNormalize (s - glm::dot (n, s) * n);
+				bitangent += angles[corner] * safeNormalize (b - glm::dot (n, b) * n);
+			}
+			tangent = safeNormalize (tangent - glm::dot (n, tangent) * n);
+			if (tangent == glm::vec3 (0.f)) // No texture space around the vertex: any direction of the tangent plane
+				tangent = safeNormalize (glm::cross (n, std::abs (n.x) < 0.5f ? glm::vec3 (1.f, 0.f, 0.f) : glm::vec3 (0.f, 1.f, 0.f)));
+			tangents[v] = glm::vec4 (tangent, glm::dot (glm::cross (n, tangent), bitangent) < 0.f ? -1.f : 1.f);
+		}
+	});
+}
+
+void GeometryKernels::computePlanarParameterization (const glm::vec3 * P, size_t numVertices, glm::vec2 * UV, size_t numTexCoords) {
+	float xMin = numeric_limits<float>::max();
+	float xMax = -numeric_limits<float>::max();
+	float yMin = numeric_limits<float>::max();
+	float yMax = -numeric_limits<float>::max();
+
+	//determining the positions min and max for x and y among the vertices of the mesh
+	for (size_t i = 0; i < numVertices; i++) {
+		if (P[i][0] < xMin) {
+			xMin = P[i][0];
+		}
+
+		if (P[i][0] > xMax) {
+			xMax = P[i][0];
+		}
+
+		if (P[i][1] < yMin) {
+			yMin = P[i][1];
+		}
+
+		if (P[i][1] > yMax) {
+			yMax = P[i][1];
+		}
+	}
+
+	//to compute U and V (texture coordinates), we do a linear parametrization of X and Y (vertex coordinates)
+	for (size_t i = 0; i < numTexCoords; i++) {
+		UV[i][0] = (P[i][0] - xMin)/(xMax - xMin);
+		UV[i][1] = (P[i][1] - yMin)/(yMax - yMin);
+	}
+}
+
+void GeometryKernels::computePlanarParameterization (const VertexSoA & P, glm::vec2 * UV, size_t numTexCoords) {
+	if (P.numVertices == 0)
+		return;
+	size_t paddedSize = P.paddedSize ();
+	size_t count = std::min (numTexCoords, P.numVertices);
+	if (count == 0)
+		return; // UV may be null
+	const float * X = P.x.data ();
+	const float * Y = P.y.data ();
+	size_t i = 0;
+#ifdef MESH_SSE2
+	__m128 xMin4 = _mm_load_ps (X);
+	__m128 xMax4 = xMin4;
+	__m128 yMin4 = _mm_load_ps (Y);
+	__m128 yMax4 = yMin4;
+	for (size_t k = 4; k < paddedSize; k += 4) {
+		__m128 x = _mm_load_ps (X + k);
+		__m128 y = _mm_load_ps (Y + k);
+		xMin4 = _mm_min_ps (xMin4, x);
+		xMax4 = _mm_max_ps (xMax4, x);
+		yMin4 = _mm_min_ps (yMin4, y);
+		yMax4 = _mm_max_ps (yMax4, y);
+	}
+	float xMin = horizontalMin (xMin4);
+	float xMax = horizontalMax (xMax4);
+	float yMin = horizontalMin (yMin4);
+	float yMax = horizontalMax (yMax4);
+	// Same divisions as the AoS kernel, written back interleaved
+	xMin4 = _mm_set1_ps (xMin);
+	yMin4 = _mm_set1_ps (yMin);
+	__m128 xExtent = _mm_set1_ps (xMax - xMin);
+	__m128 yExtent = _mm_set1_ps (yMax - yMin);
+	float * uv = &UV[0][0];
+	for (; i + 4 <= count; i += 4) {
+		__m128 u = _mm_div_ps (_mm_sub_ps (_mm_load_ps (X + i), xMin4), xExtent);
+		__m128 v = _mm_div_ps (_mm_sub_ps (_mm_load_ps (Y + i), yMin4), yExtent);
+		_mm_storeu_ps (uv + 2 * i, _mm_unpacklo_ps (u, v));
+		_mm_storeu_ps (uv + 2 * i + 4, _mm_unpackhi_ps (u, v));
+	}
+#else
+	float xMin = X[0], xMax = X[0], yMin = Y[0], yMax = Y[0];
+	for (size_t k = 1; k < paddedSize; k++) {
+		xMin = std::min (xMin, X[k]);
+		xMax = std::max (xMax, X[k]);
+		yMin = std::min (yMin, Y[k]);
+		yMax = std::max (yMax, Y[k]);
+	}
+#endif
+	for (; i < count; i++) {
+		UV[i][0] = (X[i] - xMin)/(xMax - xMin);
+		UV[i][1] = (Y[i] - yMin)/(yMax - yMin);
+	}
+}
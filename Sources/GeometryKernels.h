@@ -0,0 +1,57 @@
+#ifndef GEOMETRY_KERNELS_H
+#define GEOMETRY_KERNELS_H
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "MeshAdjacency.h"
+#include "VertexSoA.h"
+
+/// CPU geometry kernels behind Mesh. Each comes in two flavors:
+/// - on raw AoS arrays, so that they apply both to the CPU-side vectors and to mapped GPU memory (see Mesh::beginStreaming),
+/// - on the aligned SoA copy of the positions (see Mesh::positionsSoA), which the SIMD code reads without any shuffle.
+namespace GeometryKernels {
+
+/// Bounding volumes of a set of vertices
+struct Bounds {
+	glm::vec3 boxMin = glm::vec3 (0.f); ///< Axis-aligned box
+	glm::vec3 boxMax = glm::vec3 (0.f);
+	glm::vec3 sphereCenter = glm::vec3 (0.f);
+	float sphereRadius = 0.f;
+	glm::vec3 orientedBoxCenter = glm::vec3 (0.f);
+	glm::mat3 orientedBoxAxes = glm::mat3 (1.f); ///< Right-handed orthonormal columns, by decreasing variance of the vertices
+	glm::vec3 orientedBoxHalfExtents = glm::vec3 (0.f); ///< Along each of the axes
+};
+
+/// Axis-aligned box, near-optimal sphere and principal component (PCA) oriented box of the vertices, in two parallel
+/// passes. The first one reduces the axis-aligned box, the covariance and the extreme vertices along 7 directions, whose
+/// minimal sphere (Welzl) seeds the bounding sphere as in Larsson's EPOS. The second one grows that sphere over every
+/// vertex (Ritter) and measures the extents along the principal axes. Vertices are processed in fixed blocks reduced in
+/// order, so that the result does not depend on the number of threads.
+Bounds computeBounds (const glm::vec3 * P, size_t numVertices);
+Bounds computeBounds (const VertexSoA & P);
+
+/// Area (or corner angle) weighted average of the face normals around each vertex. adjacency, when given, saves
+/// building the vertex to corners table in the multi-threaded path.
+void computePerVertexNormals (const glm::vec3 * P, size_t numVertices, const glm::uvec3 * T, size_t numTriangles, glm::vec3 * N, bool angleBased,
+							  const MeshAdjacency * adjacency = nullptr);
+void computePerVertexNormals (const VertexSoA & P, const glm::uvec3 * T, size_t numTriangles, glm::vec3 * N, bool angleBased,
+							  const MeshAdjacency * adjacency = nullptr);
+
+/// Unit tangent of each vertex for normal mapping, as MikkTSpace (Mikkelsen, "Simulation of Wrinkled Surfaces
+/// Revisited", 2008) derives it, without splitting any vertex: the texture space derivatives dP/du and dP/dv of each
+/// triangle are projected on the tangent plane of the normal at each of its corners, weighted by the corner angle and
+/// summed per vertex, and the tangent is orthonormalized against the normal. w is the handedness, the bitangent being
+/// w * cross (N, tangent), from the summed dP/dv. Gathered in parallel over the vertex to corners table, built on the
+/// fly when adjacency is null. Normals and texture coordinates only exist as AoS arrays, hence this single flavor.
+void computePerVertexTangents (const glm::vec3 * P, const glm::vec3 * N, const glm::vec2 * UV, size_t numVertices, const glm::uvec3 * T,
+							   size_t numTriangles, glm::vec4 * tangents, const MeshAdjacency * adjacency = nullptr);
+
+/// Texture coordinates mapping the bounding rectangle of the vertices in the xy plane to [0, 1]^2
+void computePlanarParameterization (const glm::vec3 * P, size_t numVertices, glm::vec2 * UV, size_t numTexCoords);
+void computePlanarParameterization (const VertexSoA & P, glm::vec2 * UV, size_t numTexCoords);
+
+}
+
+#endif // GEOMETRY_KERNELS_H
@@ -20,6 +20,9 @@
 #include <memory>
 #include <algorithm>
 #include <exception>
+#include <future>
+#include <chrono>
+#include <iomanip>
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -32,6 +35,7 @@
 #include "MeshLoader.h"
 #include "Material.h"
 #include "LightSource.h"
+#include "Parallel.h"
 
 static const std::string SHADER_PATH ("../Resources/Shaders/");
 
@@ -48,6 +52,15 @@ static std::shared_ptr<Camera> cameraPtr;
 // Pointer to the displayed mesh
 static std::shared_ptr<Mesh> meshPtr;
 
+// Mesh being loaded in the background. A proxy is displayed in its place until it is ready.
+static std::future<std::shared_ptr<Mesh>> pendingMeshFuture;
+static std::shared_ptr<Mesh> loadedMeshPtr; // Loaded, waiting for its GPU data to be complete
+static std::shared_ptr<Mesh> streamingMeshPtr; // Mesh whose GPU buffers are filled while loading (streaming upload only)
+static bool streamUpload = false;
+
+// Mesh loading settings (parser backend, binary cache)
+static MeshLoader::LoadOptions loadOptions;
+
 // Pointer to GPU shader pipeline i.e., set of shaders structured in a GPU program
 static std::shared_ptr<ShaderProgram> shaderProgramPtr; // A GPU program contains at least a vertex shader and a fragment shader
 
@@ -65,17 +78,64 @@ static float renderingMode = 0.f;
 static bool microFacet = true;	//Blinn-Phong BRDF / micro facet BRDF
 static bool ggx = true;			//Cook-Torrance micro facet BRDF / GGX micro facet BRDF
 static bool schlick = true;
+static bool clusterCulling = true; // Frustum and back-face culling of the meshlets
+static bool levelOfDetail = true; // Coarser triangles when the mesh is small on screen
+static Mesh::VertexFormat vertexFormat = Mesh::VertexFormat::Packed;
+static Mesh::Residency residency = Mesh::Residency::Keep; // Of the CPU-side copy of the loaded mesh, once uploaded
+static Mesh::TexCoordMode texCoordMode = Mesh::TexCoordMode::Attribute;
+static const char * TEX_COORD_MODE_NAMES[] = { "attribute", "planar", "triplanar", "spherical" };
+static bool normalMapping = true; // Needs the tangent frames of the mesh
+static bool ambientOcclusion = true; // Needs the baked ambient occlusion of the mesh, see MeshLoader::LoadOptions::ambientOcclusionRays
 void clear ();
 
+/// Reports where the memory of the current mesh goes
+void printMemoryUsage () {
+	Mesh::MemoryUsage usage = meshPtr->memoryUsage ();
+	const double MB = 1024.0 * 1024.0;
+	std::cout << " > [Memory] " << std::fixed << std::setprecision (2) << usage.cpuBytes () / MB << " MB on the CPU ("
+			  << usage.cpuGeometryBytes / MB << " MB of geometry, " << usage.cpuDerivedBytes / MB << " MB of derived data), "
+			  << usage.gpuBytes () / MB << " MB on the GPU (" << usage.gpuVertexBytes / MB << " MB of vertices, "
+			  << usage.gpuIndexBytes / MB << " MB of indices, " << usage.gpuOtherBytes / MB << " MB of draw commands)"
+			  << (meshPtr->hasCPUCopy () ? "" : ", CPU copy released") << std::defaultfloat << std::endl;
+}
+
+/// Reports the size of the vertex buffers and the encoding error of the current mesh
+void printVertexFormat () {
+	const Mesh & mesh = *meshPtr;
+	bool packed = mesh.gpuVertexFormat () == Mesh::VertexFormat::Packed;
+	const char * format = packed ? "packed" : (mesh.gpuVertexFormat () == Mesh::VertexFormat::Interleaved ? "interleaved floats" : "separate floats");
+	std::cout << " > [Vertices] " << format << ", " << TEX_COORD_MODE_NAMES[static_cast<int> (mesh.gpuTexCoordMode ())] << " texture coordinates, "
+			  << (mesh.hasTangentFrames () ? "tangent frames, " : "") << (mesh.hasAmbientOcclusion () ? "ambient occlusion, " : "")
+			  << mesh.gpuVertexSize () << " bytes per vertex, " << 8 * mesh.gpuIndexSize ()
+			  << "-bit indices, " << std::fixed << std::setprecision (2) << mesh.gpuVertexSize () * mesh.gpuNumVertices () / (1024.0 * 1024.0)
+			  << " MB of vertex buffers, " << mesh.gpuIndexSize () * mesh.gpuNumIndices () / (1024.0 * 1024.0) << " MB of index buffer";
+	if (packed) {
+		GeometryKernels::Bounds bounds = mesh.bounds ();
+		const VertexPacking::PackingError & error = mesh.packingError ();
+		std::cout << ", max error " << std::setprecision (4) << 100.f * error.position / std::max (glm::length (bounds.boxMax - bounds.boxMin), 1e-30f)
+				  << "% of the diagonal for positions, " << error.normalDegrees << " degrees for normals, " << error.texCoord << " for texture coordinates";
+	}
+	if (mesh.hasTangentFrames ())
+		std::cout << (packed ? ", " : ", max error ") << std::setprecision (4) << mesh.packingError ().tangentDegrees << " degrees for tangents";
+	std::cout << std::defaultfloat << std::endl;
+}
+
 void printHelp () {
 	std::cout << "> Help:" << std::endl
 			  << "    Mouse commands:" << std::endl
-			  << "    * Left button: rotate camera" << std::endl
+			  << "    * Left button: rotate camera, around the point of the mesh clicked" << std::endl
 			  << "    * Middle button: zoom" << std::endl
 			  << "    * Right button: pan camera" << std::endl
 			  << "    Keyboard commands:" << std::endl
    			  << "    * H: print this help" << std::endl
    			  << "    * F1: toggle wireframe rendering" << std::endl
+   			  << "    * C: toggle cluster culling" << std::endl
+   			  << "    * L: toggle level of detail selection" << std::endl
+   			  << "    * P: toggle packed vertices" << std::endl
+   			  << "    * N: toggle normal mapping" << std::endl
+   			  << "    * O: toggle the baked ambient occlusion" << std::endl
+   			  << "    * U: cycle through the texture coordinate attribute and the planar, triplanar and spherical generated ones" << std::endl
+   			  << "    * M: print the memory usage of the mesh" << std::endl
    			  << "    * ESC: quit the program" << std::endl;
 }
 
@@ -110,6 +170,38 @@ void keyCallback (GLFWwindow * windowPtr, int key, int scancode, int action, int
 	else if (action == GLFW_PRESS && key == GLFW_KEY_S) {
 		schlick = !schlick;
 	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_C) {
+		clusterCulling = !clusterCulling;
+		std::cout << " > Cluster culling " << (clusterCulling ? "on" : "off") << std::endl;
+	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_L) {
+		levelOfDetail = !levelOfDetail;
+		std::cout << " > Level of detail " << (levelOfDetail ? "on" : "off") << std::endl;
+	}
+	else if (action == GLFW_PRESS && (key == GLFW_KEY_P || key == GLFW_KEY_U)) {
+		if (key == GLFW_KEY_P)
+			vertexFormat = vertexFormat == Mesh::VertexFormat::Packed ? Mesh::VertexFormat::Interleaved : Mesh::VertexFormat::Packed;
+		else
+			texCoordMode = static_cast<Mesh::TexCoordMode> ((static_cast<int> (texCoordMode) + 1) % 4);
+		if (!meshPtr->ensureCPUCopy () || meshPtr->numVertices () == 0) {
+			std::cout << " > Streamed meshes, and meshes released after upload, keep their vertex buffers" << std::endl;
+			return;
+		}
+		meshPtr->setVertexFormat (vertexFormat);
+		meshPtr->setTexCoordMode (texCoordMode);
+		meshPtr->init ();
+		printVertexFormat ();
+	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_M)
+		printMemoryUsage ();
+	else if (action == GLFW_PRESS && key == GLFW_KEY_N) {
+		normalMapping = !normalMapping;
+		std::cout << " > Normal mapping " << (normalMapping ? "on" : "off") << (meshPtr->hasTangentFrames () ? "" : ", the mesh has no tangent frames") << std::endl;
+	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_O) {
+		ambientOcclusion = !ambientOcclusion;
+		std::cout << " > Ambient occlusion " << (ambientOcclusion ? "on" : "off") << (meshPtr->hasAmbientOcclusion () ? "" : ", the mesh has none baked") << std::endl;
+	}
 }
 
 /// Called each time the mouse cursor moves
@@ -130,12 +222,39 @@ void cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
 	}
 }
 
+/// Moves the pivot of the camera rotations to the point of the mesh under the cursor, if any
+void pickPivot (double xpos, double ypos) {
+	std::shared_ptr<const MeshBVH> bvhPtr = meshPtr->bvh ();
+	if (!bvhPtr)
+		return; // Streamed meshes, and meshes released for good, have no CPU-side copy to build it from
+	auto start = std::chrono::high_resolution_clock::now ();
+	int width, height;
+	glfwGetWindowSize (windowPtr, &width, &height);
+	// Ray through the cursor from the near plane to the far one, in model space
+	glm::mat4 modelMatrix = meshPtr->computeTransformMatrix ();
+	glm::mat4 inverseMatrix = glm::inverse (cameraPtr->computeProjectionMatrix () * cameraPtr->computeViewMatrix () * modelMatrix);
+	glm::vec2 ndc (2.0 * xpos / width - 1.0, 1.0 - 2.0 * ypos / height);
+	glm::vec4 nearPoint = inverseMatrix * glm::vec4 (ndc, -1.f, 1.f);
+	glm::vec4 farPoint = inverseMatrix * glm::vec4 (ndc, 1.f, 1.f);
+	glm::vec3 origin = glm::vec3 (nearPoint) / nearPoint.w;
+	glm::vec3 direction = glm::vec3 (farPoint) / farPoint.w - origin;
+	MeshBVH::Hit hit = bvhPtr->intersect (origin, direction, 1.f);
+	double ms = std::chrono::duration<double, std::milli> (std::chrono::high_resolution_clock::now () - start).count ();
+	if (!hit.isHit ())
+		return; // Keeps the current pivot
+	glm::vec3 pivot (modelMatrix * glm::vec4 (origin + hit.distance * direction, 1.f));
+	cameraPtr->setPivot (pivot);
+	std::cout << " > [Pick] Triangle " << hit.triangle << " hit at (" << pivot.x << ", " << pivot.y << ", " << pivot.z
+			  << "), now the pivot, in " << std::fixed << std::setprecision (3) << ms << " ms" << std::defaultfloat << std::endl;
+}
+
 /// Called each time a mouse button is pressed
 void mouseButtonCallback (GLFWwindow * window, int button, int action, int mods) {
 	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
     	if (!isRotating) {
     		isRotating = true;
     		glfwGetCursorPos (window, &baseX, &baseY);
+    		pickPivot (baseX, baseY);
     		baseRot = cameraPtr->getRotation ();
         }
     } else if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
@@ -223,6 +342,44 @@ void initOpenGL () {
 #define NB_LIGHTSOURCES 4
 LightSource lightSourcesArray[NB_LIGHTSOURCES];
 
+/// Low resolution sphere, displayed while the actual mesh is loading.
+std::shared_ptr<Mesh> genProxyMesh (const glm::vec3 & center, float radius) {
+	const unsigned int numRings = 12;
+	const unsigned int numSectors = 24;
+	auto proxyMeshPtr = std::make_shared<Mesh> ();
+	auto & P = proxyMeshPtr->vertexPositions ();
+	auto & N = proxyMeshPtr->vertexNormals ();
+	auto & T = proxyMeshPtr->triangleIndices ();
+	for (unsigned int i = 0; i <= numRings; i++) {
+		float theta = static_cast<float> (M_PI * i / numRings);
+		for (unsigned int j = 0; j <= numSectors; j++) {
+			float phi = static_cast<float> (2.0 * M_PI * j / numSectors);
+			glm::vec3 n (std::sin (theta) * std::cos (phi), std::sin (theta) * std::sin (phi), std::cos (theta));
+			P.push_back (center + radius * n);
+			N.push_back (n);
+		}
+	}
+	for (unsigned int i = 0; i < numRings; i++)
+		for (unsigned int j = 0; j < numSectors; j++) {
+			unsigned int v = i * (numSectors + 1) + j;
+			T.push_back (glm::uvec3 (v, v + numSectors + 1, v + 1)); // Counter-clockwise seen from outside
+			T.push_back (glm::uvec3 (v + 1, v + numSectors + 1, v + numSectors + 2));
+		}
+	proxyMeshPtr->vertexTexCoords ().resize (P.size ());
+	proxyMeshPtr->computePlanarParameterization ();
+	return proxyMeshPtr;
+}
+
+/// Adjusts the camera to the displayed mesh
+void frameCamera () {
+	glm::vec3 center;
+	meshPtr->computeBoundingSphere (center, meshScale);
+	cameraPtr->setPivot (glm::vec3 (0.f));
+	cameraPtr->setTranslation (center + glm::vec3 (0.0, 0.0, 3.0 * meshScale));
+	cameraPtr->setNear (meshScale / 100.f);
+	cameraPtr->setFar (6.f * meshScale);
+}
+
 void initScene (const std::string & meshFilename) {
 	// Camera
 	int width, height;
@@ -230,14 +387,45 @@ void initScene (const std::string & meshFilename) {
 	cameraPtr = std::make_shared<Camera> ();
 	cameraPtr->setAspectRatio (static_cast<float>(width) / static_cast<float>(height));
 
-	// Mesh
-	meshPtr = std::make_shared<Mesh> ();
-	try {
-		MeshLoader::loadOFF (meshFilename, meshPtr);
-	} catch (std::exception & e) {
-		exitOnCriticalError (std::string ("[Error loading mesh]") + e.what ());
-	}
+	// Mesh: loaded on a background thread, so that the window keeps responding meanwhile.
+	// OpenGL calls stay on this thread, the loaded mesh is uploaded when swapped in (see updateMesh).
+	// The proxy matches the bounds of the mesh when they can be known upfront, so that the camera framed on it suits the mesh
+	GeometryKernels::Bounds bounds;
+	if (MeshLoader::estimateBounds (meshFilename, bounds) && bounds.sphereRadius > 0.f)
+		meshPtr = genProxyMesh (bounds.sphereCenter, bounds.sphereRadius);
+	else
+		meshPtr = genProxyMesh (glm::vec3 (0.f), 1.f);
+	meshPtr->setVertexFormat (vertexFormat);
 	meshPtr->init ();
+	MeshLoader::LoadOptions options = loadOptions;
+	bool isOFF = MeshLoader::fileExtension (meshFilename) == "off";
+	if (streamUpload && !isOFF)
+		std::cerr << " > Streaming upload is only available for OFF files" << std::endl;
+	if (streamUpload && isOFF && options.weldEpsilon >= 0.f)
+		std::cerr << " > Vertex welding is not available with streaming upload" << std::endl;
+	if (streamUpload && isOFF) {
+		// The GPU buffers are allocated upfront, the loader thread parses straight into their mapping
+		size_t numVertices, numTriangles;
+		try {
+			MeshLoader::readOFFHeader (meshFilename, numVertices, numTriangles);
+		} catch (std::exception & e) {
+			exitOnCriticalError (std::string ("[Error loading mesh]") + e.what ());
+		}
+		streamingMeshPtr = std::make_shared<Mesh> ();
+		streamingMeshPtr->setTexCoordMode (texCoordMode);
+		streamingMeshPtr->beginStreaming (numVertices, numTriangles);
+		std::shared_ptr<Mesh> targetMeshPtr = streamingMeshPtr;
+		pendingMeshFuture = std::async (std::launch::async, [meshFilename, options, targetMeshPtr] () {
+			MeshLoader::streamOFF (meshFilename, targetMeshPtr, options);
+			return targetMeshPtr;
+		});
+	} else {
+		pendingMeshFuture = std::async (std::launch::async, [meshFilename, options] () {
+			auto newMeshPtr = std::make_shared<Mesh> ();
+			MeshLoader::load (meshFilename, newMeshPtr, options);
+			return newMeshPtr;
+		});
+	}
 
 	// Lighting
 	lightSourcesArray[0] = LightSource(glm::vec3 (5.0, 5.0, 5.0), glm::vec3 (1.0, 1.0, 1.0), 10.f, 1.f, 0.1f, 0.01f, M_PI/8, glm::vec3 (-1.0, -1.0, -1.0)); //position, color, intensity, a_c, a_l, a_q, coneAngle, direction
@@ -265,15 +453,15 @@ void initScene (const std::string & meshFilename) {
 
 	GLuint metallicTex = material.loadTextureFromFileToGPU(dirName + "Metallic.png");
 
-	GLuint ambientTex = material.loadTextureFromFileToGPU(dirName + "Ambient_Occlusion.png");
-
 	GLuint toonTex = material.loadTextureFromFileToGPU(dirName + "X_toon.png");
 
+	GLuint normalTex = material.loadTextureFromFileToGPU(dirName + "Normal.png");
+
 	shaderProgramPtr->set ("material.albedoTex", 0u);
 	shaderProgramPtr->set ("material.roughnessTex", 1u);
 	shaderProgramPtr->set ("material.metallicTex", 2u);
-	shaderProgramPtr->set ("material.ambientTex", 3u);
 	shaderProgramPtr->set ("material.toonTex", 4u);
+	shaderProgramPtr->set ("material.normalTex", 5u);
 
 	glActiveTexture (GL_TEXTURE0);
 	glBindTexture (GL_TEXTURE_2D, albedoTex);
@@ -284,22 +472,47 @@ void initScene (const std::string & meshFilename) {
 	glActiveTexture (GL_TEXTURE2);
 	glBindTexture (GL_TEXTURE_2D, metallicTex);
 
-	glActiveTexture (GL_TEXTURE3);
-	glBindTexture (GL_TEXTURE_2D, ambientTex);
-
 	glActiveTexture (GL_TEXTURE4);
 	glBindTexture (GL_TEXTURE_2D, toonTex);
 
+	glActiveTexture (GL_TEXTURE5);
+	glBindTexture (GL_TEXTURE_2D, normalTex);
+
 	//zMin and zMax for the computation of the detail value
 	shaderProgramPtr->set ("zMin", meshScale);
 	shaderProgramPtr->set ("zMax", meshScale*5);
 
-	// Adjust the camera to the actual mesh
-	glm::vec3 center;
-	meshPtr->computeBoundingSphere (center, meshScale);
-	cameraPtr->setTranslation (center + glm::vec3 (0.0, 0.0, 3.0 * meshScale));
-	cameraPtr->setNear (meshScale / 100.f);
-	cameraPtr->setFar (6.f * meshScale);
+	frameCamera ();
+}
+
+/// Swaps the loaded mesh in place of the proxy once the background loading is over.
+/// The swap happens between two frames, on the thread owning the OpenGL context.
+void updateMesh () {
+	// In streaming mode, the chunks decoded so far are transferred while the loader keeps going
+	bool uploaded = !streamingMeshPtr || streamingMeshPtr->updateStreaming ();
+	if (pendingMeshFuture.valid () && pendingMeshFuture.wait_for (std::chrono::seconds (0)) == std::future_status::ready) {
+		try {
+			loadedMeshPtr = pendingMeshFuture.get ();
+		} catch (std::exception & e) {
+			exitOnCriticalError (std::string ("[Error loading mesh]") + e.what ());
+		}
+		if (!streamingMeshPtr) {
+			loadedMeshPtr->setVertexFormat (vertexFormat);
+			loadedMeshPtr->setResidency (residency);
+			loadedMeshPtr->setTexCoordMode (texCoordMode);
+			loadedMeshPtr->init ();
+			uploaded = true;
+		}
+	}
+	if (!loadedMeshPtr || !uploaded)
+		return;
+	meshPtr = loadedMeshPtr;
+	loadedMeshPtr.reset ();
+	streamingMeshPtr.reset ();
+	frameCamera ();
+	printVertexFormat ();
+	printMemoryUsage ();
+	std::cout << " > Mesh displayed after " << glfwGetTime () << " s" << std::endl;
 }
 
 void init (const std::string & meshFilename) {
@@ -309,6 +522,11 @@ void init (const std::string & meshFilename) {
 }
 
 void clear () {
+	if (pendingMeshFuture.valid ())
+		pendingMeshFuture.wait (); // The loader thread may still write in the mesh buffers
+	pendingMeshFuture = std::future<std::shared_ptr<Mesh>> ();
+	loadedMeshPtr.reset ();
+	streamingMeshPtr.reset ();
 	cameraPtr.reset ();
 	meshPtr.reset ();
 	shaderProgramPtr.reset ();
@@ -333,12 +551,41 @@ void render () {
 	glm::mat4 viewMatrix = cameraPtr->computeViewMatrix ();
 	glm::mat4 modelViewMatrix = viewMatrix * modelMatrix;
 	glm::mat4 normalMatrix = glm::transpose (glm::inverse (modelViewMatrix));
-	shaderProgramPtr->set ("modelViewMat", modelViewMatrix);
+	shaderProgramPtr->set ("modelViewMat", modelViewMatrix * meshPtr->dequantizationMatrix ());
 	shaderProgramPtr->set ("normalMat", normalMatrix);
-	meshPtr->render ();
+	shaderProgramPtr->set ("octahedralNormals", meshPtr->gpuVertexFormat () == Mesh::VertexFormat::Packed);
+	shaderProgramPtr->set ("texCoordMode", static_cast<GLuint> (meshPtr->gpuTexCoordMode ()));
+	shaderProgramPtr->set ("texCoordMat", meshPtr->texCoordMatrix ());
+	shaderProgramPtr->set ("tangentFrames", meshPtr->hasTangentFrames ());
+	shaderProgramPtr->set ("normalMapping", normalMapping && meshPtr->hasTangentFrames ());
+	shaderProgramPtr->set ("ambientOcclusion", ambientOcclusion && meshPtr->hasAmbientOcclusion ());
+	int width, height;
+	glfwGetFramebufferSize (windowPtr, &width, &height);
+	meshPtr->render (modelViewMatrix, projectionMatrix, static_cast<float> (height), levelOfDetail, clusterCulling);
 	shaderProgramPtr->stop ();
 }
 
+/// Shows the level of detail and culling outcome of the last frame in the window title
+void updateWindowTitle () {
+	static std::string lastTitle;
+	const MeshRenderer::RenderStats & stats = meshPtr->renderStats ();
+	std::string title ("Computer Graphics - Practical Assignment");
+	bool clusterHierarchy = levelOfDetail && !meshPtr->clusterHierarchy ().empty ();
+	if (clusterHierarchy)
+		title += " - cut of " + std::to_string (stats.numMeshlets) + " clusters up to level " + std::to_string (stats.levelOfDetail)
+			   + " (" + std::to_string (static_cast<int> (stats.projectedRadius)) + " px radius)";
+	else if (levelOfDetail && !meshPtr->levelsOfDetail ().empty ())
+		title += " - LOD " + std::to_string (stats.levelOfDetail) + " (" + std::to_string (static_cast<int> (stats.projectedRadius)) + " px radius)";
+	if ((clusterCulling || clusterHierarchy) && stats.numMeshlets > 0)
+		title += " - " + std::to_string (stats.numFrustumCulled + stats.numBackFaceCulled) + " of " + std::to_string (stats.numMeshlets)
+			   + " clusters culled (" + std::to_string (stats.numFrustumCulled) + " frustum, " + std::to_string (stats.numBackFaceCulled)
+			   + " back-face), " + std::to_string (stats.numDrawnTriangles) + " triangles in " + std::to_string (stats.numDrawCommands) + " draws";
+	if (title != lastTitle) {
+		glfwSetWindowTitle (windowPtr, title.c_str ());
+		lastTitle = title;
+	}
+}
+
 // Update any accessible variable based on the current time
 void update (float currentTime) {
 	// Animate any entity of the program here
@@ -374,17 +621,70 @@ void update (float currentTime) {
 }
 
 void usage (const char * command) {
-	std::cerr << "Usage : " << command << " [<file.off>]" << std::endl;
+	std::cerr << "Usage : " << command << " [--parser stream|mapped|parallel] [--threads <n>] [--no-cache] [--weld <epsilon>] [--stream-upload] [--float-vertices] [--residency keep|release|reload] [--gpu-texcoords planar|triplanar|spherical] [--ao-rays <n>] [<file.off|file.ply|file.glb|file.qmesh>]" << std::endl;
 	std::exit (EXIT_FAILURE);
 }
 
 int main (int argc, char ** argv) {
-	if (argc > 2)
-		usage (argv[0]);
-	init (argc == 1 ? DEFAULT_MESH_FILENAME : argv[1]); // Your initialization code (user interface, OpenGL states, scene with geometry, material, lights, etc)
+	std::string meshFilename = DEFAULT_MESH_FILENAME;
+	bool hasFilename = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg (argv[i]);
+		if (arg == "--parser" && i + 1 < argc) {
+			std::string name (argv[++i]);
+			if (name == "stream")
+				loadOptions.parser = MeshLoader::OFFParser::Stream;
+			else if (name == "mapped")
+				loadOptions.parser = MeshLoader::OFFParser::Mapped;
+			else if (name == "parallel")
+				loadOptions.parser = MeshLoader::OFFParser::Parallel;
+			else
+				usage (argv[0]);
+		} else if (arg == "--stream-upload") {
+			streamUpload = true;
+		} else if (arg == "--float-vertices") {
+			vertexFormat = Mesh::VertexFormat::Interleaved;
+		} else if (arg == "--residency" && i + 1 < argc) {
+			std::string name (argv[++i]);
+			if (name == "keep")
+				residency = Mesh::Residency::Keep;
+			else if (name == "release")
+				residency = Mesh::Residency::Release;
+			else if (name == "reload")
+				residency = Mesh::Residency::Reload;
+			else
+				usage (argv[0]);
+		} else if (arg == "--gpu-texcoords" && i + 1 < argc) {
+			std::string name (argv[++i]);
+			if (name == "planar")
+				texCoordMode = Mesh::TexCoordMode::Planar;
+			else if (name == "triplanar")
+				texCoordMode = Mesh::TexCoordMode::Triplanar;
+			else if (name == "spherical")
+				texCoordMode = Mesh::TexCoordMode::Spherical;
+			else
+				usage (argv[0]);
+			loadOptions.generateTexCoords = true; // No planar parameterization on the CPU for the files without texture coordinates
+		} else if (arg == "--ao-rays" && i + 1 < argc) {
+			loadOptions.ambientOcclusionRays = static_cast<unsigned int> (std::atoi (argv[++i]));
+		} else if (arg == "--no-cache") {
+			loadOptions.useCache = false;
+		} else if (arg == "--weld" && i + 1 < argc) {
+			loadOptions.weldEpsilon = static_cast<float> (std::atof (argv[++i]));
+		} else if (arg == "--threads" && i + 1 < argc) {
+			Parallel::setNumThreads (static_cast<unsigned int> (std::atoi (argv[++i])));
+		} else if (!hasFilename && arg.compare (0, 2, "--") != 0) {
+			meshFilename = arg;
+			hasFilename = true;
+		} else
+			usage (argv[0]);
+	}
+	init (meshFilename); // Your initialization code (user interface, OpenGL states, scene with geometry, material, lights, etc)
 	while (!glfwWindowShouldClose (windowPtr)) {
+		updateMesh ();
 		update (static_cast<float> (glfwGetTime ()));
 		render ();
+		updateWindowTitle ();
 		glfwSwapBuffers (windowPtr);
 		glfwPollEvents ();
 	}
@@ -0,0 +1,86 @@
+#include "MappedFile.h"
+
+#include <exception>
+#include <ios>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile (const std::string & filename) {
+	HANDLE file = CreateFileA (filename.c_str (), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::ios_base::failure ("[Mapped File] Cannot open " + filename);
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx (file, &fileSize)) {
+		CloseHandle (file);
+		throw std::ios_base::failure ("[Mapped File] Cannot stat " + filename);
+	}
+	m_fileHandle = file;
+	m_size = static_cast<size_t> (fileSize.QuadPart);
+	if (m_size == 0)
+		return; // Empty files cannot be mapped, but are valid
+	HANDLE mapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle (file);
+		throw std::ios_base::failure ("[Mapped File] Cannot map " + filename);
+	}
+	m_mappingHandle = mapping;
+	m_data = static_cast<const char *> (MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr) {
+		CloseHandle (mapping);
+		CloseHandle (file);
+		throw std::ios_base::failure ("[Mapped File] Cannot map " + filename);
+	}
+}
+
+MappedFile::~MappedFile () {
+	if (m_data)
+		UnmapViewOfFile (m_data);
+	if (m_mappingHandle)
+		CloseHandle (m_mappingHandle);
+	if (m_fileHandle)
+		CloseHandle (m_fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile (const std::string & filename) {
+	int fd = open (filename.c_str (), O_RDONLY);
+	if (fd < 0)
+		throw std::ios_base::failure ("[Mapped File] Cannot open " + filename);
+	struct stat st;
+	if (fstat (fd, &st) != 0) {
+		close (fd);
+		throw std::ios_base::failure ("[Mapped File] Cannot stat " + filename);
+	}
+	m_size = static_cast<size_t> (st.st_size);
+	if (m_size > 0) {
+		void * ptr = mmap (nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr == MAP_FAILED) {
+			close (fd);
+			throw std::ios_base::failure ("[Mapped File] Cannot map " + filename);
+		}
+		madvise (ptr, m_size, MADV_SEQUENTIAL); // Loaders scan the file front to back
+		m_data = static_cast<const char *> (ptr);
+	}
+	close (fd); // The mapping keeps its own reference on the file
+}
+
+MappedFile::~MappedFile () {
+	if (m_data)
+		munmap (const_cast<char *> (m_data), m_size);
+}
+
+#endif
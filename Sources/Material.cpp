@@ -11,6 +11,7 @@ GLuint Material::loadTextureFromFileToGPU(const std::string & filename) {
   &height,
   &numComponents, // 1 for a 8 bit greyscale image, 3 for 24bits RGB image
   0);
+  GLenum format = numComponents == 1 ? GL_RED : (numComponents == 4 ? GL_RGBA : GL_RGB); // Greyscale, RGB or RGBA (e.g., normal maps)
   // Create a texture in GPU memory
   GLuint texID;
   glGenTextures (1, &texID);
@@ -22,11 +23,11 @@ GLuint Material::loadTextureFromFileToGPU(const std::string & filename) {
   // Uploading the image data to GPU memory
   glTexImage2D (GL_TEXTURE_2D,
     0,
-    (numComponents == 1 ? GL_RED : GL_RGB), // We assume only greyscale or RGB pixels
+    format,
     width,
     height,
     0,
-    (numComponents == 1 ? GL_RED : GL_RGB), // We assume only greyscale or RGB pixels
+    format,
     GL_UNSIGNED_BYTE,
     data);
     // Generating mipmaps for filtered texture fetch
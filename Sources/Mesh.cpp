@@ -1,127 +1,515 @@
 #define _USE_MATH_DEFINES
 
 #include "Mesh.h"
+#include "Parallel.h"
+#include "GeometryKernels.h"
 
 #include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <algorithm>
 #include <iostream>
 #include <limits>
 
 using namespace std;
 
+namespace {
+
+/// Uploads interleaved vertices in a new buffer, without their texture coordinates, which come last, when the vertex
+/// shader generates them. Returns the size of the uploaded vertices.
+template<typename Vertex>
+size_t uploadInterleavedVertices (const std::vector<Vertex> & vertices, bool texCoords, GLuint & buffer) {
+	size_t vertexSize = texCoords ? sizeof (Vertex) : offsetof (Vertex, texCoord);
+	const void * data = vertices.data ();
+	std::vector<unsigned char> truncated;
+	if (!texCoords) {
+		truncated.resize (vertexSize * vertices.size ());
+		Parallel::forRange (vertices.size (), [&] (size_t begin, size_t end) {
+			for (size_t v = begin; v < end; v++)
+				std::memcpy (&truncated[vertexSize * v], &vertices[v], vertexSize);
+		}, 4096);
+		data = truncated.data ();
+	}
+	glCreateBuffers (1, &buffer);
+	glNamedBufferStorage (buffer, vertexSize * vertices.size (), data, GL_DYNAMIC_STORAGE_BIT);
+	return vertexSize;
+}
+
+/// Maps model space to the space the vertex shader generates texture coordinates from, see Mesh::texCoordMatrix
+glm::mat4 modelToTexCoordMatrix (Mesh::TexCoordMode mode, const GeometryKernels::Bounds & bounds) {
+	if (mode == Mesh::TexCoordMode::Spherical)
+		return glm::scale (glm::mat4 (1.f), glm::vec3 (1.f / std::max (bounds.sphereRadius, 1e-30f))) * glm::translate (glm::mat4 (1.f), -bounds.sphereCenter);
+	glm::vec3 extent = glm::max (bounds.boxMax - bounds.boxMin, glm::vec3 (1e-30f));
+	return glm::scale (glm::mat4 (1.f), 1.f / extent) * glm::translate (glm::mat4 (1.f), -bounds.boxMin);
+}
+
+/// Narrows the indices of the triangles to 16 bits, in parallel, every index being known to fit
+void narrowIndices (const glm::uvec3 * T, size_t numTriangles, GLushort * indices) {
+	Parallel::forRange (numTriangles, [&] (size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++)
+			for (int j = 0; j < 3; j++)
+				indices[3 * t + j] = static_cast<GLushort> (T[t][j]);
+	}, 4096);
+}
+
+}
+
 Mesh::~Mesh () {
 	clear ();
 }
 
+GeometryKernels::Bounds Mesh::bounds () const {
+	if (numVertices () == 0 && m_gpuNumVertices > 0) // Streamed or released mesh, without any CPU-side copy
+		return m_uploadedBounds;
+	{
+		std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+		if (m_bounds) // E.g., read along with the upload source, which leaves the vectors unfilled
+			return *m_bounds;
+	}
+	std::shared_ptr<const VertexSoA> positions = positionsSoA ();
+	std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+	if (!m_bounds)
+		m_bounds = std::make_shared<const GeometryKernels::Bounds> (GeometryKernels::computeBounds (*positions));
+	return *m_bounds;
+}
+
 void Mesh::computeBoundingSphere (glm::vec3 & center, float & radius) const {
-	center = glm::vec3 (0.0);
-	radius = 0.f;
-	for (const auto & p : m_vertexPositions)
-		center += p;
-	center /= m_vertexPositions.size ();
-	for (const auto & p : m_vertexPositions)
-		radius = std::max (radius, distance (center, p));
+	GeometryKernels::Bounds b = bounds ();
+	center = b.sphereCenter;
+	radius = b.sphereRadius;
+}
+
+std::shared_ptr<const VertexSoA> Mesh::positionsSoA () const {
+	fill ();
+	std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+	if (!m_positionsSoA || m_positionsSoA->numVertices != m_vertexPositions.size ())
+		m_positionsSoA = std::make_shared<const VertexSoA> (m_vertexPositions.data (), m_vertexPositions.size ());
+	return m_positionsSoA;
+}
+
+std::shared_ptr<const MeshAdjacency> Mesh::adjacency () const {
+	fill ();
+	std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+	if (!m_adjacency || m_adjacency->numVertices () != m_vertexPositions.size () || m_adjacency->numTriangles () != m_triangleIndices.size ())
+		m_adjacency = std::make_shared<const MeshAdjacency> (m_triangleIndices.data (), m_triangleIndices.size (), m_vertexPositions.size ());
+	return m_adjacency;
+}
+
+std::shared_ptr<const MeshBVH> Mesh::bvh () const {
+	if (m_cpuCopyReleased) {
+		{
+			std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+			if (m_bvh)
+				return m_bvh;
+		}
+		// Built once from a reloaded copy, which is dropped right after: the hierarchy holds its own triangles
+		std::shared_ptr<Mesh> reloadedPtr = m_residency == Residency::Reload && m_reloadSource ? m_reloadSource () : nullptr;
+		if (!reloadedPtr || reloadedPtr->numTriangles () == 0)
+			return nullptr;
+		const Mesh & reloaded = *reloadedPtr;
+		auto bvhPtr = std::make_shared<const MeshBVH> (reloaded.vertexPositions ().data (), reloaded.vertexPositions ().size (),
+													   reloaded.triangleIndices ().data (), reloaded.triangleIndices ().size ());
+		std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+		if (!m_bvh)
+			m_bvh = bvhPtr;
+		return m_bvh;
+	}
+	fill ();
+	std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+	if (!m_bvh && !m_triangleIndices.empty ())
+		m_bvh = std::make_shared<const MeshBVH> (m_vertexPositions.data (), m_vertexPositions.size (), m_triangleIndices.data (), m_triangleIndices.size ());
+	return m_bvh;
 }
 
 void Mesh::recomputePerVertexNormals (bool angleBased) {
-	m_vertexNormals.clear ();
-	// Change the following code to compute a proper per-vertex normal
+	vertexNormals ().clear ();
 	m_vertexNormals.resize (m_vertexPositions.size (), glm::vec3 (0.0, 0.0, 0.0));
+	// The single-thread path needs no connectivity, do not build it for nothing
+	GeometryKernels::computePerVertexNormals (*positionsSoA (), m_triangleIndices.data (), m_triangleIndices.size (),
+											  m_vertexNormals.data (), angleBased, Parallel::numThreads () > 1 ? adjacency ().get () : nullptr);
+}
 
-	glm::vec3 p0;
-	glm::vec3 p1;
-	glm::vec3 p2;
-	float angle0;
-	float angle1;
-	float angle2;
-	glm::vec3 normal;
+void Mesh::computePlanarParameterization() {
+	std::vector<glm::vec2> & UV = vertexTexCoords ();
+	GeometryKernels::computePlanarParameterization (*positionsSoA (), UV.data (), UV.size ());
+}
 
-	std::vector<glm::vec3> vertexIncidentNormalsSum;
-	vertexIncidentNormalsSum.resize(m_vertexPositions.size (), glm::vec3 (0.0, 0.0, 0.0));
+void Mesh::setUploadSource (const ExternalGeometry & source) {
+	std::lock_guard<std::mutex> fillLock (m_fillMutex);
+	m_vertexPositions.clear ();
+	m_vertexNormals.clear ();
+	m_vertexTexCoords.clear ();
+	m_triangleIndices.clear ();
+	clearDerivedTriangles ();
+	{
+		std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+		m_positionsSoA.reset ();
+		m_adjacency.reset ();
+		m_bvh.reset ();
+		m_bounds = std::make_shared<const GeometryKernels::Bounds> (source.bounds);
+	}
+	m_uploadSource = source;
+	m_lazyFill = true;
+}
 
-	std::vector<float> vertexIncidentAnglesSum;
-	vertexIncidentAnglesSum.resize(m_vertexPositions.size (), 0.0);
+void Mesh::fillFromUploadSource () const {
+	std::lock_guard<std::mutex> lock (m_fillMutex);
+	if (!m_lazyFill.load (std::memory_order_relaxed))
+		return; // Filled by another thread meanwhile
+	const ExternalGeometry & source = m_uploadSource;
+	m_vertexPositions.assign (source.positions, source.positions + source.numVertices);
+	if (source.normals)
+		m_vertexNormals.assign (source.normals, source.normals + source.numVertices);
+	if (source.texCoords)
+		m_vertexTexCoords.assign (source.texCoords, source.texCoords + source.numVertices);
+	m_triangleIndices.assign (source.triangles, source.triangles + source.numTriangles);
+	m_lodTriangleIndices.assign (source.lodTriangles, source.lodTriangles + source.numLodTriangles);
+	m_clusterTriangleIndices.assign (source.clusterTriangles, source.clusterTriangles + source.numClusterTriangles);
+	m_lazyFill.store (false, std::memory_order_release);
+}
 
-	for (int i = 0; i < m_triangleIndices.size (); i++) {
+size_t Mesh::packVertices (bool texCoords, const float * AO, std::vector<unsigned char> & vertices, VertexPacking::PackingError & error) const {
+	// Packed from the arrays of the upload source while they match, as init uploads them, without filling the vectors
+	const ExternalGeometry & source = m_uploadSource;
+	size_t numVertices = this->numVertices ();
+	bool sourceVertices = source.positions && source.numVertices == numVertices;
+	const glm::vec3 * P = sourceVertices ? source.positions : vertexPositions ().data ();
+	const glm::vec3 * N = sourceVertices && source.normals ? source.normals : vertexNormals ().size () == numVertices ? vertexNormals ().data () : nullptr;
+	const glm::vec2 * UV = sourceVertices && source.texCoords ? source.texCoords : vertexTexCoords ().size () == numVertices ? vertexTexCoords ().data () : nullptr;
+	GeometryKernels::Bounds bounds = this->bounds ();
+	std::vector<VertexPacking::PackedVertex> packed (numVertices);
+	error = VertexPacking::packVertices (P, N, texCoords ? UV : nullptr, AO, numVertices, bounds.boxMin, bounds.boxMax, packed.data ());
+	// Texture coordinates come last, generated ones are left out
+	size_t vertexSize = texCoords ? sizeof (VertexPacking::PackedVertex) : offsetof (VertexPacking::PackedVertex, texCoord);
+	vertices.resize (vertexSize * numVertices);
+	Parallel::forRange (numVertices, [&] (size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++)
+			std::memcpy (&vertices[vertexSize * v], &packed[v], vertexSize);
+	}, 4096);
+	return vertexSize;
+}
 
-		p0 = m_vertexPositions[m_triangleIndices[i][0]];
-		p1 = m_vertexPositions[m_triangleIndices[i][1]];
-		p2 = m_vertexPositions[m_triangleIndices[i][2]];
+float Mesh::packTangentFrames (bool texCoords, std::vector<VertexPacking::QTangent> & tangentFrames) const {
+	const auto & P = vertexPositions ();
+	const auto & N = vertexNormals ();
+	const auto & UV = vertexTexCoords ();
+	const auto & T = triangleIndices ();
+	size_t numVertices = P.size ();
+	std::vector<glm::vec2> planarTexCoords;
+	const glm::vec2 * tangentUV = texCoords && UV.size () == numVertices ? UV.data () : nullptr;
+	if (!tangentUV) {
+		planarTexCoords.resize (numVertices);
+		GeometryKernels::computePlanarParameterization (*positionsSoA (), planarTexCoords.data (), numVertices);
+		tangentUV = planarTexCoords.data ();
+	}
+	std::vector<glm::vec4> tangents (numVertices);
+	GeometryKernels::computePerVertexTangents (P.data (), N.data (), tangentUV, numVertices, T.data (), T.size (), tangents.data (), adjacency ().get ());
+	tangentFrames.resize (numVertices);
+	return VertexPacking::packTangentFrames (N.data (), tangents.data (), numVertices, tangentFrames.data ());
+}
 
-		if (angleBased) {
-			angle0 = acos(dot(normalize(p1-p0), normalize(p2-p0)));
-			angle1 = acos(dot(normalize(p2-p1), normalize(p0-p1)));
-			angle2 = acos(dot(normalize(p0-p2), normalize(p1-p2)));
-		}
-		else {
-			angle0 = 1;
-			angle1 = 1;
-			angle2 = 1;
+void Mesh::packShortIndices (std::vector<uint16_t> & indices) const {
+	const auto & T = triangleIndices ();
+	const auto & lodT = lodTriangleIndices ();
+	const auto & clusterT = clusterTriangleIndices ();
+	indices.resize (3 * (T.size () + lodT.size () + clusterT.size ()));
+	narrowIndices (T.data (), T.size (), indices.data ());
+	narrowIndices (lodT.data (), lodT.size (), indices.data () + 3 * T.size ());
+	narrowIndices (clusterT.data (), clusterT.size (), indices.data () + 3 * (T.size () + lodT.size ()));
+}
+
+void Mesh::init () {
+	if (!ensureCPUCopy ())
+		return;
+	releaseGPUBuffers (); // Uploads again, e.g., in another vertex format
+	// Upload straight from the external source while its arrays still match (e.g., a mapped file), which leaves the
+	// vectors unfilled, from the CPU-side vectors otherwise
+	const ExternalGeometry & source = m_uploadSource;
+	size_t numVertices = this->numVertices ();
+	size_t numTriangles = this->numTriangles ();
+	size_t numLodTriangles = this->numLodTriangles ();
+	size_t numClusterTriangles = this->numClusterTriangles ();
+	bool sourceVertices = source.numVertices == numVertices;
+	const glm::vec3 * P = source.positions && sourceVertices ? source.positions : m_vertexPositions.data ();
+	const glm::vec3 * N = source.normals && sourceVertices ? source.normals : m_vertexNormals.size () == numVertices ? m_vertexNormals.data () : nullptr;
+	const glm::vec2 * UV = source.texCoords && sourceVertices ? source.texCoords : m_vertexTexCoords.size () == numVertices ? m_vertexTexCoords.data () : nullptr;
+
+	m_gpuVertexFormat = m_vertexFormat;
+	m_dequantizationMatrix = glm::mat4 (1.f);
+	m_packingError = VertexPacking::PackingError ();
+	const float * AO = m_vertexAmbientOcclusion.size () == numVertices ? m_vertexAmbientOcclusion.data () : nullptr;
+	m_gpuAmbientOcclusion = AO && numVertices > 0;
+	m_gpuTexCoordMode = m_texCoordMode == TexCoordMode::Attribute && !UV ? TexCoordMode::Planar : m_texCoordMode;
+	bool uploadTexCoords = m_gpuTexCoordMode == TexCoordMode::Attribute;
+	// The packed buffers of the source hold its texture coordinates, and tangent frames following them
+	bool sourcePacked = sourceVertices && (source.texCoords != nullptr) == uploadTexCoords;
+	bool separateAmbientOcclusion = m_gpuVertexFormat != VertexFormat::Packed;
+	if (m_gpuVertexFormat == VertexFormat::Packed) {
+		// Single interleaved buffer, the positions quantized over the bounding box
+		GeometryKernels::Bounds bounds = this->bounds ();
+		m_dequantizationMatrix = VertexPacking::dequantizationMatrix (bounds.boxMin, bounds.boxMax);
+		std::vector<unsigned char> packed;
+		const void * vertices = source.packedVertices;
+		if (vertices && sourcePacked) {
+			// Packed without ambient occlusion, which then gets a buffer of its own
+			m_gpuVertexSize = uploadTexCoords ? sizeof (VertexPacking::PackedVertex) : offsetof (VertexPacking::PackedVertex, texCoord);
+			m_packingError = source.packingError;
+			separateAmbientOcclusion = true;
+		} else {
+			m_gpuVertexSize = packVertices (uploadTexCoords, AO, packed, m_packingError);
+			vertices = packed.data ();
 		}
+		glCreateBuffers (1, &m_vbo);
+		glNamedBufferStorage (m_vbo, std::max<size_t> (m_gpuVertexSize * numVertices, 1), vertices, GL_DYNAMIC_STORAGE_BIT);
+	} else if (m_gpuVertexFormat == VertexFormat::Interleaved) {
+		std::vector<VertexPacking::InterleavedVertex> interleaved (numVertices);
+		VertexPacking::interleaveVertices (P, N, uploadTexCoords ? UV : nullptr, numVertices, interleaved.data ());
+		m_gpuVertexSize = uploadInterleavedVertices (interleaved, uploadTexCoords, m_vbo);
+	} else {
+		glCreateBuffers (1, &m_posVbo); // Generate a GPU buffer to store the positions of the vertices
+		size_t vertexBufferSize = sizeof (glm::vec3) * numVertices; // Gather the size of the buffer from the number of vertices
+		glNamedBufferStorage (m_posVbo, vertexBufferSize, P, GL_DYNAMIC_STORAGE_BIT); // Create a data store on the GPU, filled from a CPU array
 
-		normal = normalize(cross(p1-p0, p2-p0));
+		glCreateBuffers (1, &m_normalVbo); // Same for normal
+		glNamedBufferStorage (m_normalVbo, vertexBufferSize, N, GL_DYNAMIC_STORAGE_BIT);
 
-		vertexIncidentNormalsSum[m_triangleIndices[i][0]] += angle0*normal;
-		vertexIncidentNormalsSum[m_triangleIndices[i][1]] += angle1*normal;
-		vertexIncidentNormalsSum[m_triangleIndices[i][2]] += angle2*normal;
+		m_gpuVertexSize = 2 * sizeof (glm::vec3);
+		if (uploadTexCoords) {
+			glCreateBuffers (1, &m_texCoordVbo); // Same for texture coordinates
+			glNamedBufferStorage (m_texCoordVbo, sizeof (glm::vec2) * numVertices, UV, GL_DYNAMIC_STORAGE_BIT);
+			m_gpuVertexSize += sizeof (glm::vec2);
+		}
+	}
+	if (m_gpuAmbientOcclusion && separateAmbientOcclusion) {
+		std::vector<uint16_t> ambientOcclusion (numVertices);
+		VertexPacking::packAmbientOcclusion (AO, numVertices, ambientOcclusion.data ());
+		glCreateBuffers (1, &m_ambientOcclusionVbo);
+		glNamedBufferStorage (m_ambientOcclusionVbo, sizeof (uint16_t) * numVertices, ambientOcclusion.data (), GL_DYNAMIC_STORAGE_BIT);
+	}
+	m_texCoordMatrix = uploadTexCoords ? glm::mat4 (1.f) : modelToTexCoordMatrix (m_gpuTexCoordMode, bounds ()) * m_dequantizationMatrix;
+	// Tangent frames follow the texture coordinates the shaders read, only planar ones are known here when generated
+	m_gpuTangentFrames = m_tangentFrames && N && numVertices > 0 && (uploadTexCoords || m_gpuTexCoordMode == TexCoordMode::Planar);
+	if (m_gpuTangentFrames) {
+		std::vector<VertexPacking::QTangent> packed;
+		const VertexPacking::QTangent * tangentFrames = source.tangentFrames;
+		if (tangentFrames && sourcePacked)
+			m_packingError.tangentDegrees = source.packingError.tangentDegrees;
+		else {
+			m_packingError.tangentDegrees = packTangentFrames (uploadTexCoords, packed);
+			tangentFrames = packed.data ();
+		}
+		glCreateBuffers (1, &m_tangentVbo);
+		glNamedBufferStorage (m_tangentVbo, sizeof (VertexPacking::QTangent) * numVertices, tangentFrames, GL_DYNAMIC_STORAGE_BIT);
+	}
 
-		vertexIncidentAnglesSum[m_triangleIndices[i][0]] += angle0;
-		vertexIncidentAnglesSum[m_triangleIndices[i][1]] += angle1;
-		vertexIncidentAnglesSum[m_triangleIndices[i][2]] += angle2;
+	glCreateBuffers (1, &m_ibo); // Same for the index buffer, that stores the list of indices of the triangles forming the mesh
+	size_t indexBufferSize = sizeof (glm::uvec3) * numTriangles;
+	size_t lodBufferSize = sizeof (glm::uvec3) * numLodTriangles;
+	size_t clusterBufferSize = sizeof (glm::uvec3) * numClusterTriangles;
+	const glm::uvec3 * T = source.triangles && source.numTriangles == numTriangles ? source.triangles : m_triangleIndices.data ();
+	m_gpuIndexType = m_shortIndices && numVertices <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	if (m_gpuIndexType == GL_UNSIGNED_SHORT) {
+		// Same layout, on half the bytes
+		std::vector<uint16_t> packed;
+		const uint16_t * indices = source.shortIndices;
+		if (!indices) {
+			packShortIndices (packed);
+			indices = packed.data ();
+		}
+		size_t shortBufferSize = sizeof (GLushort) * 3 * (numTriangles + numLodTriangles + numClusterTriangles);
+		glNamedBufferStorage (m_ibo, std::max<size_t> (shortBufferSize, 1), indices, GL_DYNAMIC_STORAGE_BIT);
+	} else if (lodBufferSize + clusterBufferSize == 0)
+		glNamedBufferStorage (m_ibo, indexBufferSize, T, GL_DYNAMIC_STORAGE_BIT);
+	else { // The coarser levels of detail, then the cluster hierarchy, follow the full detail triangles in the same buffer
+		const glm::uvec3 * lodT = source.lodTriangles ? source.lodTriangles : m_lodTriangleIndices.data ();
+		const glm::uvec3 * clusterT = source.clusterTriangles ? source.clusterTriangles : m_clusterTriangleIndices.data ();
+		glNamedBufferStorage (m_ibo, indexBufferSize + lodBufferSize + clusterBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
+		glNamedBufferSubData (m_ibo, 0, indexBufferSize, T);
+		glNamedBufferSubData (m_ibo, indexBufferSize, lodBufferSize, lodT);
+		glNamedBufferSubData (m_ibo, indexBufferSize + lodBufferSize, clusterBufferSize, clusterT);
 	}
+	if (!m_lazyFill)
+		m_uploadSource = ExternalGeometry (); // The GPU owns its copy, and the vectors theirs: release the mapping
 
-	for (int i = 0; i < m_vertexNormals.size (); i++) {
-		//m_vertexNormals[i] = (1/vertexIncidentAnglesSum[i])*vertexIncidentNormalsSum[i];
-		m_vertexNormals[i] = normalize(vertexIncidentNormalsSum[i]);
+	m_gpuNumVertices = numVertices;
+	m_gpuNumTriangles = numTriangles;
+	m_gpuNumLodTriangles = numLodTriangles;
+	m_gpuNumClusterTriangles = numClusterTriangles;
+	initVertexArray ();
+	m_renderer.init (m_vao, m_gpuIndexType, numTriangles, numLodTriangles, m_meshlets.size (), m_levelsOfDetail.size (), m_clusterHierarchy.size ());
+	if (m_residency == Residency::Release || (m_residency == Residency::Reload && m_reloadSource))
+		releaseCPUCopy ();
+}
 
-	}
+void Mesh::releaseCPUCopy () {
+	m_uploadedBounds = bounds (); // Still needed to select the levels of detail
+	// Swapped with empty vectors, clear would keep the memory
+	std::vector<glm::vec3> ().swap (m_vertexPositions);
+	std::vector<glm::vec3> ().swap (m_vertexNormals);
+	std::vector<glm::vec2> ().swap (m_vertexTexCoords);
+	std::vector<glm::uvec3> ().swap (m_triangleIndices);
+	std::vector<glm::uvec3> ().swap (m_lodTriangleIndices);
+	std::vector<glm::uvec3> ().swap (m_clusterTriangleIndices);
+	m_uploadSource = ExternalGeometry ();
+	m_lazyFill = false;
+	std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+	m_positionsSoA.reset ();
+	m_adjacency.reset ();
+	m_cpuCopyReleased = true; // The hierarchy, if any, is kept for picking: it holds its own copy of the triangles
 }
 
-void Mesh::init () {
-	glCreateBuffers (1, &m_posVbo); // Generate a GPU buffer to store the positions of the vertices
-	size_t vertexBufferSize = sizeof (glm::vec3) * m_vertexPositions.size (); // Gather the size of the buffer from the CPU-side vector
-	glNamedBufferStorage (m_posVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT); // Create a data store on the GPU
-	glNamedBufferSubData (m_posVbo, 0, vertexBufferSize, m_vertexPositions.data ()); // Fill the data store from a CPU array
+bool Mesh::ensureCPUCopy () {
+	if (!m_cpuCopyReleased)
+		return true;
+	std::shared_ptr<Mesh> reloadedPtr = m_residency == Residency::Reload && m_reloadSource ? m_reloadSource () : nullptr;
+	// The source must still hold the uploaded mesh
+	if (!reloadedPtr || reloadedPtr->numVertices () != m_gpuNumVertices || reloadedPtr->numTriangles () != m_gpuNumTriangles
+		|| reloadedPtr->numLodTriangles () != m_gpuNumLodTriangles || reloadedPtr->numClusterTriangles () != m_gpuNumClusterTriangles)
+		return false;
+	// Filled on demand when read back from a cache, as after a first load
+	m_uploadSource = reloadedPtr->m_uploadSource;
+	m_lazyFill = reloadedPtr->m_lazyFill.load ();
+	m_vertexPositions.swap (reloadedPtr->m_vertexPositions);
+	m_vertexNormals.swap (reloadedPtr->m_vertexNormals);
+	m_vertexTexCoords.swap (reloadedPtr->m_vertexTexCoords);
+	m_triangleIndices.swap (reloadedPtr->m_triangleIndices);
+	m_lodTriangleIndices.swap (reloadedPtr->m_lodTriangleIndices);
+	m_clusterTriangleIndices.swap (reloadedPtr->m_clusterTriangleIndices);
+	m_cpuCopyReleased = false;
+	return true;
+}
 
-	glCreateBuffers (1, &m_normalVbo); // Same for normal
-	glNamedBufferStorage (m_normalVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferSubData (m_normalVbo, 0, vertexBufferSize, m_vertexNormals.data ());
+Mesh::MemoryUsage Mesh::memoryUsage () const {
+	MemoryUsage usage;
+	usage.cpuGeometryBytes = sizeof (glm::vec3) * (m_vertexPositions.capacity () + m_vertexNormals.capacity ()) + sizeof (glm::vec2) * m_vertexTexCoords.capacity ()
+						   + sizeof (float) * m_vertexAmbientOcclusion.capacity ()
+						   + sizeof (glm::uvec3) * (m_triangleIndices.capacity () + m_lodTriangleIndices.capacity () + m_clusterTriangleIndices.capacity ());
+	usage.cpuDerivedBytes = sizeof (Meshlet) * m_meshlets.capacity () + sizeof (LevelOfDetail) * m_levelsOfDetail.capacity ()
+						  + sizeof (ClusterNode) * m_clusterHierarchy.capacity () + m_renderer.cpuBytes ();
+	{
+		std::lock_guard<std::mutex> lock (m_derivedDataMutex);
+		if (m_positionsSoA)
+			usage.cpuDerivedBytes += 3 * sizeof (float) * m_positionsSoA->paddedSize ();
+		if (m_adjacency)
+			usage.cpuDerivedBytes += m_adjacency->sizeInBytes ();
+		if (m_bvh)
+			usage.cpuDerivedBytes += m_bvh->sizeInBytes ();
+	}
+	if (m_ibo) {
+		usage.gpuVertexBytes = gpuVertexSize () * m_gpuNumVertices;
+		usage.gpuIndexBytes = gpuIndexSize () * gpuNumIndices ();
+	}
+	usage.gpuOtherBytes = m_renderer.gpuBytes ();
+	return usage;
+}
 
-	glCreateBuffers (1, &m_texCoordVbo); // Same for texture coordinates
-	size_t texCoordBufferSize = sizeof (glm::vec2) * m_vertexTexCoords.size ();
-	glNamedBufferStorage (m_texCoordVbo, texCoordBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferSubData (m_texCoordVbo, 0, texCoordBufferSize, m_vertexTexCoords.data ());
+void Mesh::initVertexArray () {
+	glCreateVertexArrays (1, &m_vao); // Create a single handle that joins together attributes (vertex positions, normals) and connectivity (triangles indices)
+	// Each attribute reads its format from the vertex buffer bound to its binding point: a single interleaved buffer,
+	// or one per attribute. Packed attributes are decoded by the vertex fetch, normalized integers and half floats being read as floats.
+	// Generated texture coordinates leave their attribute disabled
+	GLuint numAttributes = m_gpuTexCoordMode == TexCoordMode::Attribute ? 3 : 2;
+	GLuint numBindings = 1;
+	if (m_gpuVertexFormat == VertexFormat::Packed) {
+		glVertexArrayVertexBuffer (m_vao, 0, m_vbo, 0, static_cast<GLsizei> (m_gpuVertexSize));
+		glVertexArrayAttribFormat (m_vao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof (VertexPacking::PackedVertex, position));
+		glVertexArrayAttribFormat (m_vao, 1, 2, GL_SHORT, GL_TRUE, offsetof (VertexPacking::PackedVertex, normal));
+		glVertexArrayAttribFormat (m_vao, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof (VertexPacking::PackedVertex, texCoord));
+	} else if (m_gpuVertexFormat == VertexFormat::Interleaved) {
+		glVertexArrayVertexBuffer (m_vao, 0, m_vbo, 0, static_cast<GLsizei> (m_gpuVertexSize));
+		glVertexArrayAttribFormat (m_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof (VertexPacking::InterleavedVertex, position));
+		glVertexArrayAttribFormat (m_vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof (VertexPacking::InterleavedVertex, normal));
+		glVertexArrayAttribFormat (m_vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof (VertexPacking::InterleavedVertex, texCoord));
+	} else {
+		numBindings = 3;
+		glVertexArrayVertexBuffer (m_vao, 0, m_posVbo, 0, sizeof (glm::vec3));
+		glVertexArrayVertexBuffer (m_vao, 1, m_normalVbo, 0, sizeof (glm::vec3));
+		glVertexArrayVertexBuffer (m_vao, 2, m_texCoordVbo, 0, sizeof (glm::vec2));
+		glVertexArrayAttribFormat (m_vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribFormat (m_vao, 1, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribFormat (m_vao, 2, 2, GL_FLOAT, GL_FALSE, 0);
+	}
+	for (GLuint attribute = 0; attribute < numAttributes; attribute++) {
+		glVertexArrayAttribBinding (m_vao, attribute, numBindings == 1 ? 0 : attribute);
+		glEnableVertexArrayAttrib (m_vao, attribute);
+	}
+	if (m_gpuTangentFrames) { // Binding 3, after the ones of the separate buffers, whatever the vertex format
+		glVertexArrayVertexBuffer (m_vao, 3, m_tangentVbo, 0, sizeof (VertexPacking::QTangent));
+		glVertexArrayAttribFormat (m_vao, 3, 4, GL_BYTE, GL_TRUE, 0);
+		glVertexArrayAttribBinding (m_vao, 3, 3);
+		glEnableVertexArrayAttrib (m_vao, 3);
+	}
+	if (m_gpuAmbientOcclusion) { // Binding 4 when in a buffer of its own
+		if (!m_ambientOcclusionVbo) {
+			glVertexArrayAttribFormat (m_vao, 4, 1, GL_UNSIGNED_SHORT, GL_TRUE, offsetof (VertexPacking::PackedVertex, ambientOcclusion));
+			glVertexArrayAttribBinding (m_vao, 4, 0);
+		} else {
+			glVertexArrayVertexBuffer (m_vao, 4, m_ambientOcclusionVbo, 0, sizeof (uint16_t));
+			glVertexArrayAttribFormat (m_vao, 4, 1, GL_UNSIGNED_SHORT, GL_TRUE, 0);
+			glVertexArrayAttribBinding (m_vao, 4, 4);
+		}
+		glEnableVertexArrayAttrib (m_vao, 4);
+	}
+	glVertexArrayElementBuffer (m_vao, m_ibo);
+}
 
-	glCreateBuffers (1, &m_ibo); // Same for the index buffer, that stores the list of indices of the triangles forming the mesh
-	size_t indexBufferSize = sizeof (glm::uvec3) * m_triangleIndices.size ();
-	glNamedBufferStorage (m_ibo, indexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferSubData (m_ibo, 0, indexBufferSize, m_triangleIndices.data ());
+void Mesh::beginStreaming (size_t numVertices, size_t numTriangles) {
+	clear ();
+	bool streamTexCoords = m_texCoordMode == TexCoordMode::Attribute; // Computed by endStreaming, or left to the vertex shader
+	GLuint * buffers[MeshStreaming::NumStreams] = { &m_posVbo, &m_normalVbo, &m_texCoordVbo, &m_ibo };
+	for (GLuint * buffer : buffers)
+		glCreateBuffers (1, buffer);
+	GLuint streamedBuffers[MeshStreaming::NumStreams] = { m_posVbo, m_normalVbo, m_texCoordVbo, m_ibo };
+	m_streaming.begin (streamedBuffers, numVertices, numTriangles, streamTexCoords);
+	m_gpuNumVertices = numVertices;
+	m_gpuNumTriangles = numTriangles;
+	m_gpuVertexFormat = VertexFormat::Separate; // Written in place by the loader
+	m_gpuVertexSize = 2 * sizeof (glm::vec3) + (streamTexCoords ? sizeof (glm::vec2) : 0);
+	m_gpuTexCoordMode = m_texCoordMode;
+	m_gpuIndexType = GL_UNSIGNED_INT;
+	m_dequantizationMatrix = glm::mat4 (1.f);
+	m_gpuNumLodTriangles = 0;
+	m_gpuNumClusterTriangles = 0;
+	initVertexArray ();
+	m_renderer.init (m_vao, m_gpuIndexType, numTriangles, 0, 0, 0, 0);
+}
 
-	glCreateVertexArrays (1, &m_vao); // Create a single handle that joins together attributes (vertex positions, normals) and connectivity (triangles indices)
-	glBindVertexArray (m_vao);
-	glEnableVertexAttribArray (0);
-	glBindBuffer (GL_ARRAY_BUFFER, m_posVbo);
-	glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
-	glEnableVertexAttribArray (1);
-	glBindBuffer (GL_ARRAY_BUFFER, m_normalVbo);
-	glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
-	glEnableVertexAttribArray (2);
-	glBindBuffer (GL_ARRAY_BUFFER, m_texCoordVbo);
-	glVertexAttribPointer (2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof (GLfloat), 0);
-	glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-	glBindVertexArray (0); // Desactive the VAO just created. Will be activated at rendering time.
+void Mesh::endStreaming (bool angleBasedNormals) {
+	m_uploadedBounds = m_streaming.end (m_gpuTexCoordMode == TexCoordMode::Attribute, angleBasedNormals);
+	if (m_gpuTexCoordMode != TexCoordMode::Attribute)
+		m_texCoordMatrix = modelToTexCoordMatrix (m_gpuTexCoordMode, m_uploadedBounds);
 }
 
-void Mesh::render () {
-	glBindVertexArray (m_vao); // Activate the VAO storing geometry data
-	glDrawElements (GL_TRIANGLES, static_cast<GLsizei> (m_triangleIndices.size () * 3), GL_UNSIGNED_INT, 0); // Call for rendering: stream the current GPU geometry through the current GPU program
+void Mesh::render (const glm::mat4 & modelViewMatrix, const glm::mat4 & projectionMatrix, float viewportHeight,
+				   bool selectLevelOfDetail, bool cullClusters) {
+	m_renderer.render (m_meshlets, m_levelsOfDetail, m_clusterHierarchy, bounds (), modelViewMatrix, projectionMatrix,
+					   viewportHeight, selectLevelOfDetail, cullClusters);
 }
 
 void Mesh::clear () {
+	m_streaming.close ();
+	m_gpuNumVertices = 0;
+	m_gpuNumTriangles = 0;
+	m_gpuNumLodTriangles = 0;
+	m_gpuNumClusterTriangles = 0;
+	m_uploadSource = ExternalGeometry ();
+	m_lazyFill = false;
 	m_vertexPositions.clear ();
 	m_vertexNormals.clear ();
 	m_vertexTexCoords.clear ();
 	m_triangleIndices.clear ();
+	m_vertexAmbientOcclusion.clear ();
+	clearDerivedTriangles ();
+	m_positionsSoA.reset ();
+	m_bounds.reset ();
+	m_adjacency.reset ();
+	m_bvh.reset ();
+	m_reloadSource = nullptr;
+	m_cpuCopyReleased = false;
+	releaseGPUBuffers ();
+}
+
+void Mesh::releaseGPUBuffers () {
 	if (m_vao) {
 		glDeleteVertexArrays (1, &m_vao);
 		m_vao = 0;
@@ -138,40 +526,23 @@ void Mesh::clear () {
 		glDeleteBuffers (1, &m_texCoordVbo);
 		m_texCoordVbo = 0;
 	}
+	if (m_vbo) {
+		glDeleteBuffers (1, &m_vbo);
+		m_vbo = 0;
+	}
+	if (m_tangentVbo) {
+		glDeleteBuffers (1, &m_tangentVbo);
+		m_tangentVbo = 0;
+	}
+	m_gpuTangentFrames = false;
+	if (m_ambientOcclusionVbo) {
+		glDeleteBuffers (1, &m_ambientOcclusionVbo);
+		m_ambientOcclusionVbo = 0;
+	}
+	m_gpuAmbientOcclusion = false;
 	if (m_ibo) {
 		glDeleteBuffers (1, &m_ibo);
 		m_ibo = 0;
 	}
-}
-
-void Mesh::computePlanarParameterization() {
-	float xMin = numeric_limits<float>::max();
-	float xMax = -numeric_limits<float>::max();
-	float yMin = numeric_limits<float>::max();
-	float yMax = -numeric_limits<float>::max();
-
-	//determining the positions min and max for x and y among the vertices of the mesh
-	for (int i = 0; i < m_vertexPositions.size (); i++) {
-		if (m_vertexPositions[i][0] < xMin) {
-			xMin = m_vertexPositions[i][0];
-		}
-
-		if (m_vertexPositions[i][0] > xMax) {
-			xMax = m_vertexPositions[i][0];
-		}
-
-		if (m_vertexPositions[i][1] < yMin) {
-			yMin = m_vertexPositions[i][1];
-		}
-
-		if (m_vertexPositions[i][1] > yMax) {
-			yMax = m_vertexPositions[i][1];
-		}
-	}
-
-	//to compute U and V (texture coordinates), we do a linear parametrization of X and Y (vertex coordinates)
-	for (int i = 0; i < m_vertexTexCoords.size (); i++) {
-		m_vertexTexCoords[i][0] = (m_vertexPositions[i][0] - xMin)/(xMax - xMin);
-		m_vertexTexCoords[i][1] = (m_vertexPositions[i][1] - yMin)/(yMax - yMin);
-	}
+	m_renderer.release ();
 }
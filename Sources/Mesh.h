@@ -4,46 +4,313 @@
 #include <glad/glad.h>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
 #include "Transform.h"
+#include "MeshAdjacency.h"
+#include "VertexSoA.h"
+#include "GeometryKernels.h"
+#include "Meshlet.h"
+#include "VertexPacking.h"
+#include "MeshBVH.h"
+#include "MeshRenderer.h"
+#include "MeshStreaming.h"
 
 class Mesh : public Transform {
 public:
 	virtual ~Mesh ();
 
-	inline const std::vector<glm::vec3> & vertexPositions () const { return m_vertexPositions; }
-	inline std::vector<glm::vec3> & vertexPositions () { return m_vertexPositions; }
-	inline const std::vector<glm::vec3> & vertexNormals () const { return m_vertexNormals; }
-	inline std::vector<glm::vec3> & vertexNormals () { return m_vertexNormals; }
-	inline const std::vector<glm::vec2> & vertexTexCoords () const { return m_vertexTexCoords; }
-	inline std::vector<glm::vec2> & vertexTexCoords () { return m_vertexTexCoords; }
-	inline const std::vector<glm::uvec3> & triangleIndices () const { return m_triangleIndices; }
-	inline std::vector<glm::uvec3> & triangleIndices () { return m_triangleIndices; }
+	/// Read-only geometry kept alive by its owner, e.g., a mapped cache file, uploaded as is and copied into the vectors on first access
+	struct ExternalGeometry {
+		std::shared_ptr<const void> owner;
+		size_t numVertices = 0;
+		size_t numTriangles = 0;
+		size_t numLodTriangles = 0;
+		size_t numClusterTriangles = 0;
+		const glm::vec3 * positions = nullptr;
+		const glm::vec3 * normals = nullptr;
+		const glm::vec2 * texCoords = nullptr; ///< Null when left to the vertex shader
+		const glm::uvec3 * triangles = nullptr;
+		const glm::uvec3 * lodTriangles = nullptr;
+		const glm::uvec3 * clusterTriangles = nullptr;
+		GeometryKernels::Bounds bounds;
+		/// Optional buffers of the packed format, as computed by packVertices, packTangentFrames and packShortIndices
+		const void * packedVertices = nullptr;
+		VertexPacking::PackingError packingError;
+		const VertexPacking::QTangent * tangentFrames = nullptr;
+		const uint16_t * shortIndices = nullptr;
+	};
+
+	// Mutable accesses drop the upload source and the derived data
+	inline const std::vector<glm::vec3> & vertexPositions () const { fill (); return m_vertexPositions; }
+	inline std::vector<glm::vec3> & vertexPositions () { fillForWriting (); m_uploadSource.positions = nullptr; m_positionsSoA.reset (); m_bounds.reset (); m_bvh.reset (); clearDerivedTriangles (); return m_vertexPositions; }
+	inline const std::vector<glm::vec3> & vertexNormals () const { fill (); return m_vertexNormals; }
+	inline std::vector<glm::vec3> & vertexNormals () { fillForWriting (); m_uploadSource.normals = nullptr; return m_vertexNormals; }
+	inline const std::vector<glm::vec2> & vertexTexCoords () const { fill (); return m_vertexTexCoords; }
+	inline std::vector<glm::vec2> & vertexTexCoords () { fillForWriting (); m_uploadSource.texCoords = nullptr; return m_vertexTexCoords; }
+	inline const std::vector<glm::uvec3> & triangleIndices () const { fill (); return m_triangleIndices; }
+	inline std::vector<glm::uvec3> & triangleIndices () { fillForWriting (); m_uploadSource.triangles = nullptr; m_adjacency.reset (); m_bvh.reset (); clearDerivedTriangles (); return m_triangleIndices; }
+
+	/// Without filling the vectors from the upload source
+	inline size_t numVertices () const { return m_lazyFill ? m_uploadSource.numVertices : m_vertexPositions.size (); }
+	inline size_t numTriangles () const { return m_lazyFill ? m_uploadSource.numTriangles : m_triangleIndices.size (); }
+
+	/// Per-vertex ambient occlusion in [0, 1] (see AmbientOcclusion::bake), optional, kept by the residency policy
+	inline const std::vector<float> & vertexAmbientOcclusion () const { return m_vertexAmbientOcclusion; }
+	inline std::vector<float> & vertexAmbientOcclusion () { return m_vertexAmbientOcclusion; }
+
+	/// Contiguous clusters of triangles culled by render (see MeshOptimizer::buildMeshlets), cleared by mutable geometry access
+	inline const std::vector<Meshlet> & meshlets () const { return m_meshlets; }
+	inline std::vector<Meshlet> & meshlets () { return m_meshlets; }
+
+	/// Coarser levels by increasing error, their triangles in lodTriangleIndices (see MeshOptimizer::buildLevelsOfDetail)
+	inline const std::vector<LevelOfDetail> & levelsOfDetail () const { return m_levelsOfDetail; }
+	inline std::vector<LevelOfDetail> & levelsOfDetail () { return m_levelsOfDetail; }
+	inline const std::vector<glm::uvec3> & lodTriangleIndices () const { fill (); return m_lodTriangleIndices; }
+	inline std::vector<glm::uvec3> & lodTriangleIndices () { fillForWriting (); m_uploadSource.lodTriangles = nullptr; return m_lodTriangleIndices; }
+
+	/// Clusters from the meshlets up, those above in clusterTriangleIndices (see MeshOptimizer::buildClusterHierarchy)
+	inline const std::vector<ClusterNode> & clusterHierarchy () const { return m_clusterHierarchy; }
+	inline std::vector<ClusterNode> & clusterHierarchy () { return m_clusterHierarchy; }
+	inline const std::vector<glm::uvec3> & clusterTriangleIndices () const { fill (); return m_clusterTriangleIndices; }
+	inline std::vector<glm::uvec3> & clusterTriangleIndices () { fillForWriting (); m_uploadSource.clusterTriangles = nullptr; return m_clusterTriangleIndices; }
+
+	/// Replaces the vertices and every triangle by the source; set the meshlets, levels and hierarchy after it
+	void setUploadSource (const ExternalGeometry & source);
+	/// Current source, empty once the vectors were filled from it and uploaded
+	inline const ExternalGeometry & uploadSource () const { return m_uploadSource; }
+
+	/// Packed vertices as init uploads them, texture coordinates only if texCoords, AO optional. Returns the vertex size.
+	size_t packVertices (bool texCoords, const float * AO, std::vector<unsigned char> & vertices, VertexPacking::PackingError & error) const;
+	/// Tangent frames of the texture coordinates, planar ones unless texCoords. Returns the largest error, in degrees.
+	float packTangentFrames (bool texCoords, std::vector<VertexPacking::QTangent> & tangentFrames) const;
+	/// Triangles, then those of the levels of detail and cluster hierarchy, on 16 bits. Every vertex must fit.
+	void packShortIndices (std::vector<uint16_t> & indices) const;
+
+	/// Starts a streaming upload that keeps no CPU-side copy (see MeshStreaming). OpenGL thread only.
+	void beginStreaming (size_t numVertices, size_t numTriangles);
+
+	/// Where to write the streamed geometry. Any thread.
+	inline const MeshStreaming::Target & streamingTarget () const { return m_streaming.target (); }
+
+	/// Copies a written range of positions or triangles into its mapped buffer. Any thread.
+	inline void commitStreamedRange (MeshStreaming::Stream stream, size_t firstElement, size_t numElements) { m_streaming.commit (stream, firstElement, numElements); }
+
+	/// Commits the normals, texture coordinates and bounds computed from the staged geometry, and closes the stream. Any thread.
+	void endStreaming (bool angleBasedNormals = false);
+
+	/// Flushes the committed ranges, true once the stream is complete and unmapped. OpenGL thread only.
+	inline bool updateStreaming () { return m_streaming.update (); }
+
+	/// Aligned SoA copy of the positions for the CPU kernels, kept until they are accessed mutably. Thread-safe.
+	std::shared_ptr<const VertexSoA> positionsSoA () const;
+
+	/// Connectivity of the triangles, kept until they are accessed mutably. Thread-safe.
+	std::shared_ptr<const MeshAdjacency> adjacency () const;
+
+	/// Ray query hierarchy, kept until the geometry is accessed mutably, across releases too. Null when streamed. Thread-safe.
+	std::shared_ptr<const MeshBVH> bvh () const;
+
+	/// See GeometryKernels::computeBounds, kept until the positions are accessed mutably. Thread-safe.
+	GeometryKernels::Bounds bounds () const;
 
 	/// Compute the parameters of a sphere which bounds the mesh
 	void computeBoundingSphere (glm::vec3 & center, float & radius) const;
 
 	void recomputePerVertexNormals (bool angleBased = false);
 
+	/// Layout of the vertex buffers
+	enum class VertexFormat {
+		Separate, ///< One float buffer per attribute, 32 bytes per vertex in 3 streams
+		Interleaved, ///< Float attributes in a single buffer, 32 bytes per vertex, see VertexPacking::InterleavedVertex
+		Packed ///< Quantized attributes in a single buffer, 16 bytes per vertex, see VertexPacking::PackedVertex
+	};
+
+	/// Format of the next init. Streamed meshes are always uploaded in separate float buffers.
+	inline void setVertexFormat (VertexFormat format) { m_vertexFormat = format; }
+	inline VertexFormat gpuVertexFormat () const { return m_gpuVertexFormat; }
+
+	/// Lets the next init upload 16-bit indices when every vertex fits. On by default.
+	inline void setShortIndices (bool shortIndices) { m_shortIndices = shortIndices; }
+	/// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	inline GLenum gpuIndexType () const { return m_gpuIndexType; }
+	inline size_t gpuIndexSize () const { return m_gpuIndexType == GL_UNSIGNED_SHORT ? sizeof (GLushort) : sizeof (GLuint); }
+	/// Of every triangle uploaded, levels of detail and cluster hierarchy included
+	inline size_t gpuNumIndices () const { return 3 * (m_gpuNumTriangles + m_gpuNumLodTriangles + m_gpuNumClusterTriangles); }
+
+	/// Maps the uploaded positions to model space, identity unless quantized
+	inline const glm::mat4 & dequantizationMatrix () const { return m_dequantizationMatrix; }
+
+	/// Source of the texture coordinates of the shaders
+	enum class TexCoordMode {
+		Attribute = 0, ///< Per-vertex attribute, uploaded with the others
+		Planar, ///< Generated by the vertex shader from x and y over the bounding box, as computePlanarParameterization
+		Triplanar, ///< Generated over the bounding box, on the axis-aligned plane the normal faces the most
+		Spherical ///< Generated from the direction of the vertex from the center of the bounding sphere, as longitude and latitude
+	};
+
+	/// Mode of the next init. Meshes without texture coordinates fall back to Planar.
+	inline void setTexCoordMode (TexCoordMode mode) { m_texCoordMode = mode; }
+	inline TexCoordMode gpuTexCoordMode () const { return m_gpuTexCoordMode; }
+
+	/// Maps the uploaded positions to the space the vertex shader generates the texture coordinates from
+	inline const glm::mat4 & texCoordMatrix () const { return m_texCoordMatrix; }
+
+	/// Makes the next init upload a QTangent per vertex for normal mapping, when possible. On by default.
+	inline void setTangentFrames (bool tangentFrames) { m_tangentFrames = tangentFrames; }
+	inline bool hasTangentFrames () const { return m_gpuTangentFrames; }
+
+	/// True once init uploaded the ambient occlusion
+	inline bool hasAmbientOcclusion () const { return m_gpuAmbientOcclusion; }
+
+	/// Of the uploaded vertices, zero unless packed, but for the tangent frames
+	inline const VertexPacking::PackingError & packingError () const { return m_packingError; }
+	/// Over every vertex buffer, tangent frames and ambient occlusion included
+	inline size_t gpuVertexSize () const {
+		return m_gpuVertexSize + (m_gpuTangentFrames ? sizeof (VertexPacking::QTangent) : 0) + (m_ambientOcclusionVbo ? sizeof (uint16_t) : 0);
+	}
+	inline size_t gpuNumVertices () const { return m_gpuNumVertices; }
+
+	/// What becomes of the CPU-side copy of the geometry once init uploaded it
+	enum class Residency {
+		Keep, ///< The vectors stay, the default
+		Release, ///< The vertex and triangle vectors are freed for good, only the GPU copy remains
+		Reload ///< Freed as well, and read back from the reload source by ensureCPUCopy. Kept when there is no reload source.
+	};
+
+	/// Reads the geometry of the mesh back from storage, e.g., its binary cache. Returns null if it cannot.
+	typedef std::function<std::shared_ptr<Mesh> ()> ReloadSource;
+
+	/// Policy of the next init. Meshlets, levels of detail and the cluster hierarchy stay in any case, render needs them.
+	inline void setResidency (Residency residency) { m_residency = residency; }
+	inline Residency residency () const { return m_residency; }
+
+	/// Set by MeshLoader when the mesh has an up to date binary cache. Dropped by clear.
+	inline void setReloadSource (const ReloadSource & source) { m_reloadSource = source; }
+
+	/// False once the residency policy released the vertex and triangle vectors, which are then empty. The bounds remain.
+	inline bool hasCPUCopy () const { return !m_cpuCopyReleased; }
+
+	/// Brings a released copy back from the reload source, on demand. Returns false if there is none. Not thread-safe.
+	bool ensureCPUCopy ();
+
+	/// Bytes held by the mesh on each side
+	struct MemoryUsage {
+		size_t cpuGeometryBytes = 0; ///< Vertex and triangle vectors, the triangles of the levels of detail and cluster hierarchy included
+		size_t cpuDerivedBytes = 0; ///< Meshlets, levels of detail, cluster hierarchy, SoA copy, adjacency, BVH and draw commands
+		size_t gpuVertexBytes = 0;
+		size_t gpuIndexBytes = 0;
+		size_t gpuOtherBytes = 0; ///< Indirect draw commands
+
+		inline size_t cpuBytes () const { return cpuGeometryBytes + cpuDerivedBytes; }
+		inline size_t gpuBytes () const { return gpuVertexBytes + gpuIndexBytes + gpuOtherBytes; }
+	};
+
+	/// Current allocations, counting the capacity of the vectors. Not thread-safe.
+	MemoryUsage memoryUsage () const;
+
+	/// Uploads the geometry in the selected vertex format, then applies the residency policy
 	void init ();
-	void render ();
+
+	/// Draws every triangle
+	inline void render () { m_renderer.render (); }
+
+	/// Draws the coarsest level of detail, or cut of the cluster hierarchy, within a pixel of error (see MeshRenderer)
+	void render (const glm::mat4 & modelViewMatrix, const glm::mat4 & projectionMatrix, float viewportHeight,
+				 bool selectLevelOfDetail = true, bool cullClusters = true);
+
+	inline const MeshRenderer::RenderStats & renderStats () const { return m_renderer.renderStats (); }
+
 	void clear ();
 
 	void computePlanarParameterization();
 
 private:
-	std::vector<glm::vec3> m_vertexPositions;
-	std::vector<glm::vec3> m_vertexNormals;
-	std::vector<glm::vec2> m_vertexTexCoords;
-	std::vector<glm::uvec3> m_triangleIndices;
+	void initVertexArray ();
+
+	/// Copies the upload source in the vectors on their first access. Thread-safe.
+	inline void fill () const {
+		if (m_lazyFill.load (std::memory_order_acquire))
+			fillFromUploadSource ();
+	}
+	void fillFromUploadSource () const;
+	/// The buffers of the packed format no longer match once any array changes
+	inline void fillForWriting () {
+		fill ();
+		m_uploadSource.packedVertices = nullptr;
+		m_uploadSource.tangentFrames = nullptr;
+		m_uploadSource.shortIndices = nullptr;
+	}
+	inline size_t numLodTriangles () const { return m_lazyFill ? m_uploadSource.numLodTriangles : m_lodTriangleIndices.size (); }
+	inline size_t numClusterTriangles () const { return m_lazyFill ? m_uploadSource.numClusterTriangles : m_clusterTriangleIndices.size (); }
+
+	inline void clearDerivedTriangles () {
+		m_uploadSource.lodTriangles = nullptr;
+		m_uploadSource.clusterTriangles = nullptr;
+		m_meshlets.clear ();
+		m_levelsOfDetail.clear ();
+		m_lodTriangleIndices.clear ();
+		m_clusterHierarchy.clear ();
+		m_clusterTriangleIndices.clear ();
+	}
+	void releaseGPUBuffers ();
+	void releaseCPUCopy ();
+
+	// Filled from the upload source on first access
+	mutable std::vector<glm::vec3> m_vertexPositions;
+	mutable std::vector<glm::vec3> m_vertexNormals;
+	mutable std::vector<glm::vec2> m_vertexTexCoords;
+	mutable std::vector<glm::uvec3> m_triangleIndices;
+	std::vector<float> m_vertexAmbientOcclusion;
+	std::vector<Meshlet> m_meshlets;
+	std::vector<LevelOfDetail> m_levelsOfDetail;
+	mutable std::vector<glm::uvec3> m_lodTriangleIndices;
+	std::vector<ClusterNode> m_clusterHierarchy;
+	mutable std::vector<glm::uvec3> m_clusterTriangleIndices;
+	ExternalGeometry m_uploadSource;
+	mutable std::atomic<bool> m_lazyFill { false }; // The vectors above are still to be filled from the upload source
+	mutable std::mutex m_fillMutex;
+	Residency m_residency = Residency::Keep;
+	ReloadSource m_reloadSource;
+	bool m_cpuCopyReleased = false;
+	GeometryKernels::Bounds m_uploadedBounds; // Of meshes without CPU-side copy: streamed, or released after upload
+	mutable std::shared_ptr<const VertexSoA> m_positionsSoA;
+	mutable std::shared_ptr<const GeometryKernels::Bounds> m_bounds;
+	mutable std::shared_ptr<const MeshAdjacency> m_adjacency;
+	mutable std::shared_ptr<const MeshBVH> m_bvh;
+	mutable std::mutex m_derivedDataMutex; // Guards the lazily derived data above
 	GLuint m_vao = 0;
 	GLuint m_posVbo = 0;
 	GLuint m_normalVbo = 0;
 	GLuint m_texCoordVbo = 0;
+	GLuint m_vbo = 0; // Interleaved vertices, replacing the three buffers above in the interleaved and packed formats
+	GLuint m_tangentVbo = 0;
+	GLuint m_ambientOcclusionVbo = 0; // Of float vertices, packed ones hold it
+	VertexFormat m_vertexFormat = VertexFormat::Packed;
+	VertexFormat m_gpuVertexFormat = VertexFormat::Separate;
+	bool m_shortIndices = true;
+	GLenum m_gpuIndexType = GL_UNSIGNED_INT;
+	size_t m_gpuVertexSize = 0; // Stride of the interleaved vertices, tangent frames aside
+	bool m_tangentFrames = true;
+	bool m_gpuTangentFrames = false;
+	bool m_gpuAmbientOcclusion = false;
+	glm::mat4 m_dequantizationMatrix = glm::mat4 (1.f);
+	TexCoordMode m_texCoordMode = TexCoordMode::Attribute;
+	TexCoordMode m_gpuTexCoordMode = TexCoordMode::Attribute;
+	glm::mat4 m_texCoordMatrix = glm::mat4 (1.f);
+	VertexPacking::PackingError m_packingError;
 	GLuint m_ibo = 0;
+	size_t m_gpuNumVertices = 0;
+	size_t m_gpuNumTriangles = 0;
+	size_t m_gpuNumLodTriangles = 0;
+	size_t m_gpuNumClusterTriangles = 0;
+	MeshRenderer m_renderer;
+	MeshStreaming m_streaming;
 };
 
 #endif // MESH_H
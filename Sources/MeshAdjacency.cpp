@@ -0,0 +1,79 @@
+#include "MeshAdjacency.h"
+#include "Parallel.h"
+
+#include <algorithm>
+
+using namespace std;
+
+MeshAdjacency::MeshAdjacency (const glm::uvec3 * T, size_t numTriangles, size_t numVertices)
+	: m_cornerOffsets (numVertices + 1, 0), m_corners (3 * numTriangles), m_neighbourOffsets (numVertices + 1, 0), m_twins (3 * numTriangles) {
+	const unsigned int * indices = numTriangles > 0 ? &T[0][0] : nullptr;
+
+	// Vertex to corners. Two streaming passes: cheaper serial than any synchronized parallel scatter at these sizes,
+	// and the rows come out sorted.
+	for (size_t c = 0; c < 3 * numTriangles; c++)
+		m_cornerOffsets[indices[c] + 1]++;
+	for (size_t v = 0; v < numVertices; v++)
+		m_cornerOffsets[v + 1] += m_cornerOffsets[v];
+	std::vector<unsigned int> cursors (m_cornerOffsets.begin (), m_cornerOffsets.end () - 1);
+	for (size_t c = 0; c < 3 * numTriangles; c++)
+		m_corners[cursors[indices[c]]++] = static_cast<unsigned int> (c);
+
+	// Half-edge twins, gathered from the corners of both end vertices
+	auto target = [&] (unsigned int halfEdge) { return indices[next (halfEdge)]; };
+	Parallel::forRange (3 * numTriangles, [&] (size_t begin, size_t end) {
+		for (size_t h = begin; h < end; h++) {
+			unsigned int from = indices[h];
+			unsigned int to = target (static_cast<unsigned int> (h));
+			unsigned int twin = NoTwin;
+			unsigned int numSame = 0;
+			unsigned int numOpposite = 0;
+			for (unsigned int k : corners (from))
+				numSame += target (k) == to;
+			for (unsigned int k : corners (to))
+				if (target (k) == from) {
+					twin = k;
+					numOpposite++;
+				}
+			m_twins[h] = from != to && numSame == 1 && numOpposite == 1 ? twin : NoTwin;
+		}
+	});
+
+	// 1-rings, built per block of vertices, then concatenated
+	const size_t blockSize = 4096;
+	size_t numBlocks = (numVertices + blockSize - 1) / blockSize;
+	std::vector<std::vector<unsigned int>> blockNeighbours (numBlocks);
+	Parallel::forEachTask (numBlocks, [&] (size_t b) {
+		std::vector<unsigned int> ring;
+		std::vector<unsigned int> & neighbours = blockNeighbours[b];
+		for (size_t v = b * blockSize; v < std::min (numVertices, (b + 1) * blockSize); v++) {
+			ring.clear ();
+			for (unsigned int k : corners (static_cast<unsigned int> (v))) {
+				ring.push_back (indices[next (k)]);
+				ring.push_back (indices[previous (k)]);
+			}
+			std::sort (ring.begin (), ring.end ());
+			ring.erase (std::unique (ring.begin (), ring.end ()), ring.end ());
+			ring.erase (std::remove (ring.begin (), ring.end (), static_cast<unsigned int> (v)), ring.end ()); // Degenerate triangles
+			m_neighbourOffsets[v + 1] = static_cast<unsigned int> (ring.size ());
+			neighbours.insert (neighbours.end (), ring.begin (), ring.end ());
+		}
+	});
+	for (size_t v = 0; v < numVertices; v++)
+		m_neighbourOffsets[v + 1] += m_neighbourOffsets[v];
+	m_neighbours.resize (m_neighbourOffsets.back ());
+	Parallel::forEachTask (numBlocks, [&] (size_t b) {
+		std::copy (blockNeighbours[b].begin (), blockNeighbours[b].end (), m_neighbours.begin () + m_neighbourOffsets[b * blockSize]);
+	});
+}
+
+bool MeshAdjacency::isBoundary (unsigned int v) const {
+	for (unsigned int k : corners (v))
+		if (m_twins[k] == NoTwin || m_twins[previous (k)] == NoTwin)
+			return true;
+	return false;
+}
+
+size_t MeshAdjacency::sizeInBytes () const {
+	return sizeof (unsigned int) * (m_cornerOffsets.size () + m_corners.size () + m_neighbourOffsets.size () + m_neighbours.size () + m_twins.size ());
+}
@@ -0,0 +1,70 @@
+#ifndef MESH_ADJACENCY_H
+#define MESH_ADJACENCY_H
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+/// Connectivity of an indexed triangle mesh, stored as compressed rows of 32-bit indices:
+/// - vertex to corners: corner 3 * t + j is vertex j of triangle t, so that corner / 3 is the incident triangle,
+/// - vertex to vertices: the 1-ring of each vertex, sorted and without duplicates,
+/// - half-edge twins: half-edge 3 * t + j goes from vertex j to vertex j + 1 of triangle t, and its twin is the
+///   opposite half-edge of the neighbouring triangle.
+/// Every row lists its entries in increasing order, so that the kernels gathering over them give the same result
+/// whatever the number of threads.
+/// Immutable once built. See Mesh::adjacency for a copy kept up to date with the mesh.
+class MeshAdjacency {
+public:
+	/// Twin of the half-edges on the boundary, or shared by more than two triangles
+	static const unsigned int NoTwin = ~0u;
+
+	/// Contiguous row of indices, to be used in range-based for loops
+	struct Row {
+		const unsigned int * first;
+		const unsigned int * last;
+		inline const unsigned int * begin () const { return first; }
+		inline const unsigned int * end () const { return last; }
+		inline size_t size () const { return static_cast<size_t> (last - first); }
+	};
+
+	/// Builds the tables of triangles T, referencing vertices [0, numVertices). Runs in parallel.
+	MeshAdjacency (const glm::uvec3 * T, size_t numTriangles, size_t numVertices);
+
+	inline size_t numVertices () const { return m_cornerOffsets.size () - 1; }
+	inline size_t numTriangles () const { return m_twins.size () / 3; }
+
+	/// Corners of the triangles incident to vertex v
+	inline Row corners (unsigned int v) const { return row (m_cornerOffsets, m_corners, v); }
+
+	/// Vertices sharing an edge with vertex v
+	inline Row neighbours (unsigned int v) const { return row (m_neighbourOffsets, m_neighbours, v); }
+
+	/// Number of triangles incident to vertex v
+	inline unsigned int valence (unsigned int v) const { return m_cornerOffsets[v + 1] - m_cornerOffsets[v]; }
+
+	inline unsigned int twin (unsigned int halfEdge) const { return m_twins[halfEdge]; }
+
+	inline static unsigned int triangle (unsigned int corner) { return corner / 3; }
+	inline static unsigned int next (unsigned int halfEdge) { return halfEdge % 3 == 2 ? halfEdge - 2 : halfEdge + 1; }
+	inline static unsigned int previous (unsigned int halfEdge) { return halfEdge % 3 == 0 ? halfEdge + 2 : halfEdge - 1; }
+
+	/// True if one of the edges of vertex v has no twin, i.e., v lies on a boundary or on a non-manifold edge
+	bool isBoundary (unsigned int v) const;
+
+	/// Memory footprint of the tables, in bytes
+	size_t sizeInBytes () const;
+
+private:
+	inline static Row row (const std::vector<unsigned int> & offsets, const std::vector<unsigned int> & entries, unsigned int v) {
+		return Row { entries.data () + offsets[v], entries.data () + offsets[v + 1] };
+	}
+
+	std::vector<unsigned int> m_cornerOffsets; // numVertices + 1 entries
+	std::vector<unsigned int> m_corners;
+	std::vector<unsigned int> m_neighbourOffsets; // numVertices + 1 entries
+	std::vector<unsigned int> m_neighbours;
+	std::vector<unsigned int> m_twins;
+};
+
+#endif // MESH_ADJACENCY_H
@@ -0,0 +1,519 @@
+#include "MeshBVH.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_SSE2
+#endif
+
+using namespace std;
+
+namespace {
+
+/// Costs of the surface area heuristic, relative to the test of a block of 4 triangles
+const float BOX_TEST_COST = 0.5f;
+const float BLOCK_TEST_COST = 1.f;
+
+const int NUM_BINS = 16;
+const uint32_t MAX_LEAF_SIZE = 16; // Triangles, the heuristic may prefer smaller leaves
+const unsigned int MAX_DEPTH = 64; // Bounds the traversal stack
+const uint32_t PARALLEL_RANGE_SIZE = 16384; // Triangles of the ranges binned in parallel, and below which subtrees become tasks
+
+inline uint32_t numBlocks (uint32_t numTriangles) { return (numTriangles + 3) / 4; }
+
+inline float halfArea (const glm::vec3 & boxMin, const glm::vec3 & boxMax) {
+	glm::vec3 e = glm::max (boxMax - boxMin, glm::vec3 (0.f));
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+struct Box {
+	glm::vec3 boxMin = glm::vec3 (std::numeric_limits<float>::max ());
+	glm::vec3 boxMax = glm::vec3 (-std::numeric_limits<float>::max ());
+
+	inline void grow (const glm::vec3 & p) { boxMin = glm::min (boxMin, p); boxMax = glm::max (boxMax, p); }
+	inline void grow (const Box & b) { boxMin = glm::min (boxMin, b.boxMin); boxMax = glm::max (boxMax, b.boxMax); }
+	inline float halfArea () const { return ::halfArea (boxMin, boxMax); }
+};
+
+struct Bin {
+	Box box;
+	uint32_t count = 0;
+};
+
+/// Node under construction: an inner node has its left child right after it, a leaf a range of the ordered triangles.
+/// The upper levels stand for the subtrees built by tasks with placeholders.
+struct BuildNode {
+	Box box;
+	uint32_t rightChild = 0;
+	uint32_t begin = 0;
+	uint32_t end = 0;
+	int task = -1;
+	bool leaf = false;
+};
+
+/// Subtree left to a task: range of the ordered triangles and depth of its root
+struct BuildTask {
+	uint32_t begin;
+	uint32_t end;
+	unsigned int depth;
+};
+
+/// Top-down binned SAH construction over the ordered triangle indices, which it partitions in place
+class Builder {
+public:
+	Builder (const glm::vec3 * P, size_t numVertices, const glm::uvec3 * T, size_t numTriangles)
+		: m_boxes (numTriangles), m_centroids (numTriangles), m_order (numTriangles) {
+		Parallel::forRange (numTriangles, [&] (size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++) {
+				Box box;
+				for (int j = 0; j < 3; j++) {
+					if (T[t][j] >= numVertices)
+						throw std::out_of_range ("[Mesh BVH][MeshBVH] Triangle " + std::to_string (t) + " refers to a missing vertex");
+					box.grow (P[T[t][j]]);
+				}
+				m_boxes[t] = box;
+				m_centroids[t] = 0.5f * (box.boxMin + box.boxMax);
+				m_order[t] = static_cast<uint32_t> (t);
+			}
+		});
+	}
+
+	inline const std::vector<uint32_t> & order () const { return m_order; }
+
+	/// Builds the subtree of triangles [begin, end) in nodes, depth-first. When tasks are given, ranges of at most
+	/// taskSize triangles are not built but recorded there, behind a placeholder.
+	uint32_t build (std::vector<BuildNode> & nodes, uint32_t begin, uint32_t end, unsigned int depth,
+					uint32_t taskSize = 0, std::vector<BuildTask> * tasks = nullptr) {
+		uint32_t index = static_cast<uint32_t> (nodes.size ());
+		nodes.emplace_back ();
+		// Only the upper levels run in parallel, the tasks below them already do
+		bool parallel = tasks != nullptr;
+		Box box, centroidBox;
+		bounds (begin, end, parallel, box, centroidBox);
+		nodes[index].box = box;
+		if (tasks && end - begin <= taskSize) {
+			nodes[index].task = static_cast<int> (tasks->size ());
+			tasks->push_back ({ begin, end, depth });
+			return index;
+		}
+		uint32_t count = end - begin;
+		uint32_t middle = count > 1 && depth < MAX_DEPTH ? split (begin, end, parallel, box, centroidBox) : begin;
+		if (middle == begin || middle == end) {
+			nodes[index].leaf = true;
+			nodes[index].begin = begin;
+			nodes[index].end = end;
+			return index;
+		}
+		build (nodes, begin, middle, depth + 1, taskSize, tasks);
+		uint32_t right = build (nodes, middle, end, depth + 1, taskSize, tasks);
+		nodes[index].rightChild = right;
+		return index;
+	}
+
+private:
+	template<typename Func>
+	void overRange (uint32_t begin, uint32_t end, bool parallel, Func func) {
+		// Large ranges in parallel blocks: the merged minima, maxima and counts do not depend on how they are split
+		if (!parallel || end - begin < PARALLEL_RANGE_SIZE)
+			func (begin, end);
+		else
+			Parallel::forRange (end - begin, [&] (size_t b, size_t e) { func (begin + static_cast<uint32_t> (b), begin + static_cast<uint32_t> (e)); }, 4096);
+	}
+
+	void bounds (uint32_t begin, uint32_t end, bool parallel, Box & box, Box & centroidBox) {
+		std::mutex mutex;
+		overRange (begin, end, parallel, [&] (uint32_t b, uint32_t e) {
+			Box localBox, localCentroids;
+			for (uint32_t i = b; i < e; i++) {
+				localBox.grow (m_boxes[m_order[i]]);
+				localCentroids.grow (m_centroids[m_order[i]]);
+			}
+			std::lock_guard<std::mutex> lock (mutex);
+			box.grow (localBox);
+			centroidBox.grow (localCentroids);
+		});
+	}
+
+	/// Partitions the range by the cheapest binned split, returns where the right child starts, or begin for a leaf
+	uint32_t split (uint32_t begin, uint32_t end, bool parallel, const Box & box, const Box & centroidBox) {
+		uint32_t count = end - begin;
+		glm::vec3 extent = centroidBox.boxMax - centroidBox.boxMin;
+		glm::vec3 scale;
+		for (int axis = 0; axis < 3; axis++)
+			scale[axis] = extent[axis] > 1e-30f ? NUM_BINS / extent[axis] : 0.f;
+		auto binOf = [&] (uint32_t t, int axis) {
+			return std::min (static_cast<int> ((m_centroids[t][axis] - centroidBox.boxMin[axis]) * scale[axis]), NUM_BINS - 1);
+		};
+		Bin bins[3][NUM_BINS];
+		std::mutex mutex;
+		overRange (begin, end, parallel, [&] (uint32_t b, uint32_t e) {
+			Bin local[3][NUM_BINS];
+			for (uint32_t i = b; i < e; i++) {
+				uint32_t t = m_order[i];
+				for (int axis = 0; axis < 3; axis++) {
+					Bin & bin = local[axis][binOf (t, axis)];
+					bin.box.grow (m_boxes[t]);
+					bin.count++;
+				}
+			}
+			std::lock_guard<std::mutex> lock (mutex);
+			for (int axis = 0; axis < 3; axis++)
+				for (int k = 0; k < NUM_BINS; k++) {
+					bins[axis][k].box.grow (local[axis][k].box);
+					bins[axis][k].count += local[axis][k].count;
+				}
+		});
+
+		// Sweep the planes between the bins of each axis
+		float area = std::max (box.halfArea (), 1e-30f);
+		float bestCost = BLOCK_TEST_COST * numBlocks (count);
+		int bestAxis = -1, bestPlane = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			if (scale[axis] == 0.f)
+				continue;
+			float rightCosts[NUM_BINS];
+			Box right;
+			uint32_t rightCount = 0;
+			for (int k = NUM_BINS - 1; k > 0; k--) {
+				right.grow (bins[axis][k].box);
+				rightCount += bins[axis][k].count;
+				rightCosts[k] = right.halfArea () * numBlocks (rightCount);
+			}
+			Box left;
+			uint32_t leftCount = 0;
+			for (int k = 0; k < NUM_BINS - 1; k++) {
+				left.grow (bins[axis][k].box);
+				leftCount += bins[axis][k].count;
+				if (leftCount == 0 || leftCount == count)
+					continue;
+				float cost = 2.f * BOX_TEST_COST + BLOCK_TEST_COST * (left.halfArea () * numBlocks (leftCount) + rightCosts[k + 1]) / area;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestPlane = k + 1;
+				}
+			}
+		}
+		if (bestAxis < 0) {
+			if (count <= MAX_LEAF_SIZE)
+				return begin; // Cheaper as a leaf
+			// Too large for a leaf: halves by their centroids along the widest axis, or any halves if they all coincide
+			int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+			uint32_t * first = m_order.data () + begin;
+			std::nth_element (first, first + count / 2, first + count, [&] (uint32_t a, uint32_t b) {
+				return m_centroids[a][axis] < m_centroids[b][axis];
+			});
+			return begin + count / 2;
+		}
+		uint32_t * first = m_order.data () + begin;
+		uint32_t * middle = std::partition (first, m_order.data () + end, [&] (uint32_t t) { return binOf (t, bestAxis) < bestPlane; });
+		return static_cast<uint32_t> (middle - m_order.data ());
+	}
+
+	std::vector<Box> m_boxes;
+	std::vector<glm::vec3> m_centroids;
+	std::vector<uint32_t> m_order;
+};
+
+#ifdef MESH_SSE2
+inline float horizontalMax3 (__m128 v) {
+	v = _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 2, 1, 0)); // Drops the 4th lane
+	v = _mm_max_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (1, 0, 3, 2)));
+	v = _mm_max_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 3, 0, 1)));
+	return _mm_cvtss_f32 (v);
+}
+
+inline float horizontalMin3 (__m128 v) {
+	v = _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 2, 1, 0));
+	v = _mm_min_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (1, 0, 3, 2)));
+	v = _mm_min_ps (v, _mm_shuffle_ps (v, v, _MM_SHUFFLE (2, 3, 0, 1)));
+	return _mm_cvtss_f32 (v);
+}
+#endif
+
+/// Ray in the layout of the box and triangle tests
+struct RayData {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 invDirection;
+#ifdef MESH_SSE2
+	__m128 origin4;
+	__m128 invDirection4;
+	__m128 o[3]; // Broadcast coordinates
+	__m128 d[3];
+#endif
+
+	RayData (const glm::vec3 & o, const glm::vec3 & dir) : origin (o), direction (dir) {
+		for (int k = 0; k < 3; k++) {
+			// Finite slopes, so that the slab tests never compute 0 * inf
+			float dk = std::abs (dir[k]) < 1e-30f ? std::copysign (1e-30f, dir[k]) : dir[k];
+			invDirection[k] = 1.f / dk;
+		}
+#ifdef MESH_SSE2
+		origin4 = _mm_setr_ps (origin.x, origin.y, origin.z, 0.f);
+		invDirection4 = _mm_setr_ps (invDirection.x, invDirection.y, invDirection.z, 0.f);
+		for (int k = 0; k < 3; k++) {
+			this->o[k] = _mm_set1_ps (origin[k]);
+			this->d[k] = _mm_set1_ps (direction[k]);
+		}
+#endif
+	}
+};
+
+}
+
+MeshBVH::MeshBVH (const glm::vec3 * P, size_t numVertices, const glm::uvec3 * T, size_t numTriangles) : m_numTriangles (numTriangles) {
+	if (numTriangles == 0) {
+		// Empty box, never hit
+		m_nodes.push_back ({ glm::vec3 (std::numeric_limits<float>::max ()), 0, glm::vec3 (-std::numeric_limits<float>::max ()), 0 });
+		return;
+	}
+	Builder builder (P, numVertices, T, numTriangles);
+	uint32_t count = static_cast<uint32_t> (numTriangles);
+
+	// Upper levels, down to ranges small enough for a few tasks per thread, then the subtrees below them in parallel
+	std::vector<BuildNode> skeleton;
+	std::vector<BuildTask> tasks;
+	uint32_t taskSize = std::max (PARALLEL_RANGE_SIZE, count / (4 * Parallel::numThreads ()));
+	builder.build (skeleton, 0, count, 0, taskSize, &tasks);
+	std::vector<std::vector<BuildNode>> subtrees (tasks.size ());
+	Parallel::forEachTask (tasks.size (), [&] (size_t task) {
+		builder.build (subtrees[task], tasks[task].begin, tasks[task].end, tasks[task].depth);
+	});
+
+	// Flatten depth-first: the placeholders are replaced by their subtrees, the leaves numbered in order
+	size_t numNodes = skeleton.size ();
+	for (const auto & subtree : subtrees)
+		numNodes += subtree.size ();
+	std::vector<BuildNode> nodes;
+	nodes.reserve (numNodes);
+	std::function<uint32_t (const std::vector<BuildNode> &, uint32_t)> flatten = [&] (const std::vector<BuildNode> & tree, uint32_t n) {
+		if (tree[n].task >= 0)
+			return flatten (subtrees[tree[n].task], 0);
+		uint32_t index = static_cast<uint32_t> (nodes.size ());
+		nodes.push_back (tree[n]);
+		if (!tree[n].leaf) {
+			flatten (tree, n + 1);
+			nodes[index].rightChild = flatten (tree, tree[n].rightChild);
+		}
+		return index;
+	};
+	flatten (skeleton, 0);
+
+	m_nodes.resize (nodes.size ());
+	std::vector<uint32_t> leaves;
+	uint32_t numBlocksSoFar = 0;
+	for (size_t n = 0; n < nodes.size (); n++) {
+		const BuildNode & node = nodes[n];
+		Node & flat = m_nodes[n];
+		flat.boxMin = node.box.boxMin;
+		flat.boxMax = node.box.boxMax;
+		if (node.leaf) {
+			flat.offset = numBlocksSoFar;
+			flat.numBlocks = numBlocks (node.end - node.begin);
+			numBlocksSoFar += flat.numBlocks;
+			leaves.push_back (static_cast<uint32_t> (n));
+		} else {
+			flat.offset = node.rightChild;
+			flat.numBlocks = 0;
+		}
+	}
+
+	// Triangles of each leaf, by blocks of 4
+	m_blocks.resize (numBlocksSoFar);
+	const std::vector<uint32_t> & order = builder.order ();
+	Parallel::forRange (leaves.size (), [&] (size_t begin, size_t end) {
+		for (size_t l = begin; l < end; l++) {
+			const BuildNode & leaf = nodes[leaves[l]];
+			TriangleBlock * block = &m_blocks[m_nodes[leaves[l]].offset];
+			for (uint32_t i = leaf.begin; i < leaf.begin + 4 * numBlocks (leaf.end - leaf.begin); i++) {
+				TriangleBlock & b = block[(i - leaf.begin) / 4];
+				int lane = (i - leaf.begin) % 4;
+				glm::vec3 v0 (0.f), e1 (0.f), e2 (0.f);
+				b.triangles[lane] = NoHit;
+				if (i < leaf.end) {
+					const glm::uvec3 & t = T[order[i]];
+					v0 = P[t[0]];
+					e1 = P[t[1]] - v0;
+					e2 = P[t[2]] - v0;
+					b.triangles[lane] = order[i];
+				}
+				for (int k = 0; k < 3; k++) {
+					b.v0[k][lane] = v0[k];
+					b.e1[k][lane] = e1[k];
+					b.e2[k][lane] = e2[k];
+				}
+			}
+		}
+	}, 256);
+}
+
+template<bool anyHit>
+MeshBVH::Hit MeshBVH::traverse (const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance) const {
+	Hit hit;
+	hit.distance = maxDistance;
+	if (m_numTriangles == 0)
+		return hit;
+	RayData ray (origin, direction);
+
+	// Slab test, returns the entry distance
+	auto intersectBox = [&] (const Node & node, float & tNear) {
+#ifdef MESH_SSE2
+		__m128 t1 = _mm_mul_ps (_mm_sub_ps (_mm_setr_ps (node.boxMin.x, node.boxMin.y, node.boxMin.z, 0.f), ray.origin4), ray.invDirection4);
+		__m128 t2 = _mm_mul_ps (_mm_sub_ps (_mm_setr_ps (node.boxMax.x, node.boxMax.y, node.boxMax.z, 0.f), ray.origin4), ray.invDirection4);
+		tNear = std::max (horizontalMax3 (_mm_min_ps (t1, t2)), 0.f);
+		float tFar = horizontalMin3 (_mm_max_ps (t1, t2));
+#else
+		glm::vec3 t1 = (node.boxMin - ray.origin) * ray.invDirection;
+		glm::vec3 t2 = (node.boxMax - ray.origin) * ray.invDirection;
+		glm::vec3 tMin = glm::min (t1, t2);
+		glm::vec3 tMax = glm::max (t1, t2);
+		tNear = std::max (std::max (tMin.x, tMin.y), std::max (tMin.z, 0.f));
+		float tFar = std::min (std::min (tMax.x, tMax.y), tMax.z);
+#endif
+		return tNear <= tFar && tNear < hit.distance;
+	};
+
+	// Möller and Trumbore, on the 4 triangles of a block at once. Returns true on a closer hit.
+	auto intersectBlock = [&] (const TriangleBlock & block) {
+		alignas (16) float t[4], u[4], v[4];
+		int mask = 0;
+#ifdef MESH_SSE2
+		__m128 e1[3], e2[3], s[3];
+		for (int k = 0; k < 3; k++) {
+			e1[k] = _mm_load_ps (block.e1[k]);
+			e2[k] = _mm_load_ps (block.e2[k]);
+			s[k] = _mm_sub_ps (ray.o[k], _mm_load_ps (block.v0[k]));
+		}
+		const __m128 * d = ray.d;
+		__m128 px = _mm_sub_ps (_mm_mul_ps (d[1], e2[2]), _mm_mul_ps (d[2], e2[1]));
+		__m128 py = _mm_sub_ps (_mm_mul_ps (d[2], e2[0]), _mm_mul_ps (d[0], e2[2]));
+		__m128 pz = _mm_sub_ps (_mm_mul_ps (d[0], e2[1]), _mm_mul_ps (d[1], e2[0]));
+		__m128 det = _mm_add_ps (_mm_add_ps (_mm_mul_ps (e1[0], px), _mm_mul_ps (e1[1], py)), _mm_mul_ps (e1[2], pz));
+		__m128 invDet = _mm_div_ps (_mm_set1_ps (1.f), det); // Infinite for degenerate triangles, which then fail the tests below
+		__m128 u4 = _mm_mul_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (s[0], px), _mm_mul_ps (s[1], py)), _mm_mul_ps (s[2], pz)), invDet);
+		__m128 qx = _mm_sub_ps (_mm_mul_ps (s[1], e1[2]), _mm_mul_ps (s[2], e1[1]));
+		__m128 qy = _mm_sub_ps (_mm_mul_ps (s[2], e1[0]), _mm_mul_ps (s[0], e1[2]));
+		__m128 qz = _mm_sub_ps (_mm_mul_ps (s[0], e1[1]), _mm_mul_ps (s[1], e1[0]));
+		__m128 v4 = _mm_mul_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (d[0], qx), _mm_mul_ps (d[1], qy)), _mm_mul_ps (d[2], qz)), invDet);
+		__m128 t4 = _mm_mul_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (e2[0], qx), _mm_mul_ps (e2[1], qy)), _mm_mul_ps (e2[2], qz)), invDet);
+		__m128 zero = _mm_setzero_ps ();
+		__m128 inside = _mm_and_ps (_mm_and_ps (_mm_cmpge_ps (u4, zero), _mm_cmpge_ps (v4, zero)), _mm_cmple_ps (_mm_add_ps (u4, v4), _mm_set1_ps (1.f)));
+		__m128 inRange = _mm_and_ps (_mm_cmpge_ps (t4, zero), _mm_cmplt_ps (t4, _mm_set1_ps (hit.distance)));
+		mask = _mm_movemask_ps (_mm_and_ps (inside, inRange));
+		if (mask == 0)
+			return false;
+		_mm_store_ps (t, t4);
+		_mm_store_ps (u, u4);
+		_mm_store_ps (v, v4);
+#else
+		for (int lane = 0; lane < 4; lane++) {
+			glm::vec3 e1 (block.e1[0][lane], block.e1[1][lane], block.e1[2][lane]);
+			glm::vec3 e2 (block.e2[0][lane], block.e2[1][lane], block.e2[2][lane]);
+			glm::vec3 s = ray.origin - glm::vec3 (block.v0[0][lane], block.v0[1][lane], block.v0[2][lane]);
+			glm::vec3 p = glm::cross (ray.direction, e2);
+			glm::vec3 q = glm::cross (s, e1);
+			float invDet = 1.f / glm::dot (e1, p);
+			u[lane] = glm::dot (s, p) * invDet;
+			v[lane] = glm::dot (ray.direction, q) * invDet;
+			t[lane] = glm::dot (e2, q) * invDet;
+			if (u[lane] >= 0.f && v[lane] >= 0.f && u[lane] + v[lane] <= 1.f && t[lane] >= 0.f && t[lane] < hit.distance)
+				mask |= 1 << lane;
+		}
+		if (mask == 0)
+			return false;
+#endif
+		for (int lane = 0; lane < 4; lane++)
+			if ((mask & (1 << lane)) && t[lane] < hit.distance) {
+				hit.triangle = block.triangles[lane];
+				hit.distance = t[lane];
+				hit.barycentrics = glm::vec2 (u[lane], v[lane]);
+			}
+		return true;
+	};
+
+	struct Entry {
+		uint32_t node;
+		float tNear;
+	};
+	Entry stack[MAX_DEPTH + 1];
+	size_t stackSize = 0;
+	float tNear;
+	if (!intersectBox (m_nodes[0], tNear))
+		return hit;
+	uint32_t node = 0;
+	while (true) {
+		const Node & n = m_nodes[node];
+		if (n.isLeaf ()) {
+			for (uint32_t b = n.offset; b < n.offset + n.numBlocks; b++)
+				if (intersectBlock (m_blocks[b]) && anyHit)
+					return hit;
+		} else {
+			// Nearest child first, the other one later if still closer than the closest hit by then
+			float tLeft, tRight;
+			bool left = intersectBox (m_nodes[node + 1], tLeft);
+			bool right = intersectBox (m_nodes[n.offset], tRight);
+			if (left && right) {
+				bool leftFirst = tLeft <= tRight;
+				stack[stackSize++] = leftFirst ? Entry { n.offset, tRight } : Entry { node + 1, tLeft };
+				node = leftFirst ? node + 1 : n.offset;
+				continue;
+			}
+			if (left || right) {
+				node = left ? node + 1 : n.offset;
+				continue;
+			}
+		}
+		// Next pending subtree still in reach
+		while (stackSize > 0 && stack[stackSize - 1].tNear >= hit.distance)
+			stackSize--;
+		if (stackSize == 0)
+			break;
+		node = stack[--stackSize].node;
+	}
+	return hit;
+}
+
+MeshBVH::Hit MeshBVH::intersect (const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance) const {
+	return traverse<false> (origin, direction, maxDistance);
+}
+
+bool MeshBVH::occluded (const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance) const {
+	return traverse<true> (origin, direction, maxDistance).isHit ();
+}
+
+MeshBVH::Statistics MeshBVH::statistics () const {
+	Statistics stats;
+	stats.numNodes = m_nodes.size ();
+	stats.numTriangleBlocks = m_blocks.size ();
+	float rootArea = std::max (halfArea (m_nodes[0].boxMin, m_nodes[0].boxMax), 1e-30f);
+	std::vector<std::pair<uint32_t, unsigned int>> stack (1, { 0u, 0u });
+	while (!stack.empty ()) {
+		uint32_t n = stack.back ().first;
+		unsigned int depth = stack.back ().second;
+		stack.pop_back ();
+		const Node & node = m_nodes[n];
+		stats.depth = std::max (stats.depth, depth);
+		float probability = halfArea (node.boxMin, node.boxMax) / rootArea;
+		if (node.isLeaf () || m_numTriangles == 0) {
+			stats.numLeaves++;
+			stats.sahCost += probability * BLOCK_TEST_COST * node.numBlocks;
+		} else {
+			stats.sahCost += probability * 2.f * BOX_TEST_COST;
+			stack.push_back ({ n + 1, depth + 1 });
+			stack.push_back ({ node.offset, depth + 1 });
+		}
+	}
+	return stats;
+}
+
+size_t MeshBVH::sizeInBytes () const {
+	return sizeof (Node) * m_nodes.capacity () + sizeof (TriangleBlock) * m_blocks.capacity ();
+}
@@ -0,0 +1,88 @@
+#ifndef MESH_BVH_H
+#define MESH_BVH_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+/// Bounding volume hierarchy over the triangles of a mesh, for ray queries (picking, visibility).
+/// Built top-down with binned surface area heuristic splits (Wald, "On fast Construction of SAH-based Bounding Volume
+/// Hierarchies", 2007): the upper levels bin the triangles in parallel, then the subtrees below them are built as
+/// independent tasks. Nodes are flattened depth-first in 32 bytes, the left child of an inner node following it.
+/// Leaves hold their triangles by blocks of 4, in SoA, tested against a ray at once with SSE.
+/// Keeps its own copy of the triangles, independent of the mesh, and immutable once built. The tree does not depend on
+/// the number of threads. See Mesh::bvh for a copy kept up to date with the mesh.
+class MeshBVH {
+public:
+	/// Triangle of the hits missing every triangle
+	static const uint32_t NoHit = ~0u;
+
+	/// Closest intersection along a ray
+	struct Hit {
+		uint32_t triangle = NoHit; ///< Index in the triangles the hierarchy was built from
+		float distance = std::numeric_limits<float>::max (); ///< Along the ray, in units of its direction
+		glm::vec2 barycentrics = glm::vec2 (0.f); ///< Of the second and third vertices of the triangle
+		inline bool isHit () const { return triangle != NoHit; }
+	};
+
+	/// Size and shape of the hierarchy
+	struct Statistics {
+		size_t numNodes = 0;
+		size_t numLeaves = 0;
+		size_t numTriangleBlocks = 0;
+		unsigned int depth = 0;
+		float sahCost = 0.f; ///< Expected box and block tests of a random ray hitting the root box
+	};
+
+	/// Builds the hierarchy of triangles T over positions P. Runs in parallel. Throws std::out_of_range if a triangle
+	/// refers to a vertex beyond numVertices.
+	MeshBVH (const glm::vec3 * P, size_t numVertices, const glm::uvec3 * T, size_t numTriangles);
+
+	/// Closest triangle hit by the ray, both faces of the triangles counting, within [0, maxDistance)
+	Hit intersect (const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance = std::numeric_limits<float>::max ()) const;
+
+	/// True if any triangle is hit within [0, maxDistance), which stops at the first one found
+	bool occluded (const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance = std::numeric_limits<float>::max ()) const;
+
+	inline size_t numTriangles () const { return m_numTriangles; }
+	inline const glm::vec3 & boxMin () const { return m_nodes[0].boxMin; }
+	inline const glm::vec3 & boxMax () const { return m_nodes[0].boxMax; }
+
+	Statistics statistics () const;
+
+	/// Memory footprint of the nodes and triangle blocks, in bytes
+	size_t sizeInBytes () const;
+
+private:
+	/// Flattened node: an inner node has its left child right after it and its right child at offset, a leaf has its
+	/// triangles in the numBlocks blocks starting at offset
+	struct Node {
+		glm::vec3 boxMin;
+		uint32_t offset;
+		glm::vec3 boxMax;
+		uint32_t numBlocks; ///< 0 for inner nodes
+		inline bool isLeaf () const { return numBlocks > 0; }
+	};
+
+	static_assert (sizeof (Node) == 32, "Nodes are 32 bytes");
+
+	/// 4 triangles as a vertex and two edges, one per lane. Unused lanes are degenerate, and never hit.
+	struct alignas (16) TriangleBlock {
+		float v0[3][4];
+		float e1[3][4];
+		float e2[3][4];
+		uint32_t triangles[4];
+	};
+
+	template<bool anyHit>
+	Hit traverse (const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<TriangleBlock> m_blocks;
+	size_t m_numTriangles = 0;
+};
+
+#endif // MESH_BVH_H
@@ -0,0 +1,925 @@
+// ----------------------------------------------
+// Mesh I/O benchmark: runs every loader path on a set of models and reports
+// per-phase timings (file read, parse, normals, parameterization, GPU upload),
+// throughput, peak resident memory and run-to-run variance, as text and JSON.
+// Then compares the CPU kernels, index optimizations and vertex formats, times
+// ray queries against the BVH, and a full draw of each model in every GPU
+// buffer layout.
+// ----------------------------------------------
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <cstdlib>
+#include <random>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "MeshCache.h"
+#include "MeshCodec.h"
+#include "Parallel.h"
+#include "GeometryKernels.h"
+#include "MeshOptimizer.h"
+#include "VertexPacking.h"
+#include "MeshBVH.h"
+#include "AmbientOcclusion.h"
+#include "ShaderProgram.h"
+
+using namespace std;
+
+static const std::string DEFAULT_MODEL_PATH ("../Resources/Models/");
+
+static const std::string SHADER_PATH ("../Resources/Shaders/");
+
+enum Phase { Read = 0, Parse, Normals, Parameterization, Upload, NumPhases };
+
+static const char * PHASE_NAMES[NumPhases] = { "read", "parse", "normals", "parameterization", "upload" };
+
+/// Timings of a phase over all the runs, in seconds
+struct PhaseStats {
+	std::vector<double> seconds;
+
+	double mean () const {
+		double sum = 0.0;
+		for (double s : seconds)
+			sum += s;
+		return seconds.empty () ? 0.0 : sum / seconds.size ();
+	}
+	/// Sample standard deviation
+	double stddev () const {
+		if (seconds.size () < 2)
+			return 0.0;
+		double m = mean ();
+		double sum = 0.0;
+		for (double s : seconds)
+			sum += (s - m) * (s - m);
+		return std::sqrt (sum / (seconds.size () - 1));
+	}
+	double min () const { return seconds.empty () ? 0.0 : *std::min_element (seconds.begin (), seconds.end ()); }
+	double max () const { return seconds.empty () ? 0.0 : *std::max_element (seconds.begin (), seconds.end ()); }
+};
+
+/// A way of getting a model into a mesh
+struct LoaderPath {
+	std::string name;
+	MeshLoader::LoadOptions options;
+	bool compressed = false; ///< Loads the model converted to .qmesh
+};
+
+struct Result {
+	std::string model;
+	std::string path;
+	std::string inputFilename;
+	size_t inputBytes = 0;
+	size_t numVertices = 0;
+	size_t numTriangles = 0;
+	PhaseStats phases[NumPhases];
+	size_t peakRSS = 0; ///< Process-wide peak, in bytes, once the path ran
+};
+
+/// Per-vertex normals timings of a model at a given number of worker threads, min over the runs, in seconds
+struct NormalsScaling {
+	std::string model;
+	unsigned int numThreads = 1;
+	double areaSeconds = 0.0;
+	double angleSeconds = 0.0;
+};
+
+enum Kernel { Bounds = 0, PlanarParameterization, AreaNormals, AngleNormals, NumKernels };
+
+static const char * KERNEL_NAMES[NumKernels] = { "bounds", "planarParameterization", "areaNormals", "angleNormals" };
+
+/// Timings of the geometry kernels of a model on the AoS vectors and on the SoA copy, min over the runs, in seconds
+struct KernelLayouts {
+	std::string model;
+	double soaBuildSeconds = 0.0; ///< Copy of the positions to the SoA layout, paid once per change of the positions
+	double aosSeconds[NumKernels] = {};
+	double soaSeconds[NumKernels] = {};
+};
+
+enum IndexStage { FileOrder = 0, VertexCache, Overdraw, Meshlets, VertexFetch, NumIndexStages };
+
+static const char * INDEX_STAGE_NAMES[NumIndexStages] = { "fileOrder", "vertexCache", "overdraw", "meshlets", "vertexFetch" };
+
+/// Vertex cache efficiency of a model after each index optimization stage, applied in order, and their timings, min
+/// over the runs, in seconds
+struct IndexOptimization {
+	std::string model;
+	MeshOptimizer::VertexCacheStatistics statistics[NumIndexStages];
+	double seconds[NumIndexStages] = {};
+};
+
+/// Size of the vertex buffers of a model as floats and packed, with the packing time, min over the runs, in seconds,
+/// and the packing error. Same for the tangent frames, generated then encoded as QTangents.
+struct VertexFormats {
+	std::string model;
+	size_t numVertices = 0;
+	size_t floatBytes = 0;
+	size_t packedBytes = 0;
+	double packSeconds = 0.0;
+	size_t tangentFrameBytes = 0;
+	double tangentSeconds = 0.0;
+	VertexPacking::PackingError error;
+};
+
+/// Build time of the BVH of a model and its shape, min over the runs, in seconds, then the mean time of random rays
+/// through its bounding box, closest hit and any hit, in seconds per ray, and the ambient occlusion bake time, min over
+/// the runs, in seconds
+struct RayQueries {
+	std::string model;
+	size_t numTriangles = 0;
+	double buildSeconds = 0.0;
+	MeshBVH::Statistics statistics;
+	size_t bytes = 0;
+	size_t numRays = 0;
+	double hitRatio = 0.0;
+	double intersectSecondsPerRay = 0.0;
+	double occludedSecondsPerRay = 0.0;
+	unsigned int ambientOcclusionRays = 0; ///< Per vertex
+	double ambientOcclusionSeconds = 0.0;
+	double meanAmbientOcclusion = 0.0;
+};
+
+/// Vertex and index buffer layout of a draw
+struct DrawLayout {
+	const char * name;
+	Mesh::VertexFormat vertexFormat;
+	bool shortIndices;
+};
+
+static const DrawLayout DRAW_LAYOUTS[] = { { "separate", Mesh::VertexFormat::Separate, false },
+										   { "interleaved", Mesh::VertexFormat::Interleaved, false },
+										   { "interleaved16", Mesh::VertexFormat::Interleaved, true },
+										   { "packed16", Mesh::VertexFormat::Packed, true } };
+
+static const size_t NUM_DRAW_LAYOUTS = sizeof (DRAW_LAYOUTS) / sizeof (DRAW_LAYOUTS[0]);
+
+/// GPU time of a full detail draw of a model in each layout, min over the runs, in seconds, with the size of the buffers
+/// it reads. Models with too many vertices for 16-bit indices keep 32-bit ones.
+struct DrawTimings {
+	std::string model;
+	size_t vertexBytes[NUM_DRAW_LAYOUTS] = {};
+	size_t indexBytes[NUM_DRAW_LAYOUTS] = {};
+	double gpuSeconds[NUM_DRAW_LAYOUTS] = {};
+};
+
+/// Mutes std::cout while alive, the loaders report every step
+class QuietOutput {
+public:
+	QuietOutput (bool enabled) : m_buffer (enabled ? std::cout.rdbuf (nullptr) : nullptr) {}
+	~QuietOutput () {
+		if (m_buffer) {
+			std::cout.rdbuf (m_buffer);
+			std::cout.clear ();
+		}
+	}
+private:
+	std::streambuf * m_buffer;
+};
+
+size_t peakResidentSetSize () {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo (GetCurrentProcess (), &counters, sizeof (counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return static_cast<size_t> (usage.ru_maxrss); // Bytes
+#else
+	return static_cast<size_t> (usage.ru_maxrss) * 1024; // Kilobytes
+#endif
+#endif
+}
+
+template<typename Func>
+double timeSeconds (Func func) {
+	auto start = std::chrono::steady_clock::now ();
+	func ();
+	return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+/// Hidden window providing the OpenGL context of the upload phase. Returns false if none can be created.
+bool initOpenGL () {
+	if (!glfwInit ())
+		return false;
+	glfwWindowHint (GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint (GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow * windowPtr = glfwCreateWindow (64, 64, "Mesh Benchmark", nullptr, nullptr);
+	if (!windowPtr) {
+		glfwTerminate ();
+		return false;
+	}
+	glfwMakeContextCurrent (windowPtr);
+	return gladLoadGLLoader ((GLADloadproc)glfwGetProcAddress) != 0;
+}
+
+Result runPath (const std::string & model, const LoaderPath & path, int numRuns, bool gpu, bool verbose) {
+	Result result;
+	result.model = model;
+	result.path = path.name;
+	result.inputFilename = model;
+	if (path.compressed) {
+		// Converted once, outside of the timings
+		result.inputFilename = (std::filesystem::temp_directory_path () / std::filesystem::path (model).filename ()).replace_extension (".qmesh").string ();
+		QuietOutput quiet (!verbose);
+		MeshLoader::LoadOptions options;
+		options.useCache = false;
+		auto sourcePtr = std::make_shared<Mesh> ();
+		MeshLoader::load (model, sourcePtr, options);
+		MeshCodec::encode (result.inputFilename, *sourcePtr);
+	} else if (path.options.useCache) {
+		// Makes sure the cache is up to date, so that every run reads it
+		QuietOutput quiet (!verbose);
+		auto meshPtr = std::make_shared<Mesh> ();
+		MeshLoader::load (model, meshPtr, path.options);
+	}
+	// Bytes actually read by the path
+	std::string readFilename = path.options.useCache && !path.compressed ? MeshCache::cacheFilename (model) : result.inputFilename;
+	result.inputBytes = std::filesystem::file_size (readFilename);
+
+	MeshLoader::LoadOptions options = path.options;
+	options.computeMissingAttributes = false; // Timed as separate phases
+	for (int run = 0; run < numRuns; run++) {
+		result.phases[Read].seconds.push_back (timeSeconds ([&] () {
+			std::ifstream in (readFilename.c_str (), std::ios::binary);
+			std::vector<char> buffer (result.inputBytes);
+			in.read (buffer.data (), static_cast<std::streamsize> (buffer.size ()));
+		}));
+
+		auto meshPtr = std::make_shared<Mesh> ();
+		result.phases[Parse].seconds.push_back (timeSeconds ([&] () {
+			QuietOutput quiet (!verbose);
+			MeshLoader::load (result.inputFilename, meshPtr, options);
+		}));
+		const Mesh & mesh = *meshPtr;
+		result.numVertices = mesh.vertexPositions ().size ();
+		result.numTriangles = mesh.triangleIndices ().size ();
+
+		// The kernels run on a copy, so that a mesh coming from the cache keeps uploading straight from its mapping
+		Mesh kernelMesh;
+		kernelMesh.vertexPositions () = mesh.vertexPositions ();
+		kernelMesh.triangleIndices () = mesh.triangleIndices ();
+		kernelMesh.vertexNormals ().resize (result.numVertices);
+		kernelMesh.vertexTexCoords ().resize (result.numVertices);
+		result.phases[Normals].seconds.push_back (timeSeconds ([&] () { kernelMesh.recomputePerVertexNormals (); }));
+		result.phases[Parameterization].seconds.push_back (timeSeconds ([&] () { kernelMesh.computePlanarParameterization (); }));
+		if (mesh.vertexNormals ().size () != result.numVertices)
+			meshPtr->vertexNormals ().swap (kernelMesh.vertexNormals ());
+		if (mesh.vertexTexCoords ().size () != result.numVertices)
+			meshPtr->vertexTexCoords ().swap (kernelMesh.vertexTexCoords ());
+
+		if (gpu) {
+			glFinish ();
+			result.phases[Upload].seconds.push_back (timeSeconds ([&] () {
+				meshPtr->init ();
+				glFinish (); // Includes the transfer itself, not only its submission
+			}));
+			meshPtr->clear ();
+		}
+	}
+	if (path.compressed) {
+		std::error_code error;
+		std::filesystem::remove (result.inputFilename, error);
+	}
+	result.peakRSS = peakResidentSetSize ();
+	return result;
+}
+
+/// Times the area and angle weighted normals at 1, 2, 4... threads, up to maxNumThreads
+std::vector<NormalsScaling> runNormalsScaling (const std::string & model, unsigned int maxNumThreads, int numRuns, bool verbose) {
+	auto meshPtr = std::make_shared<Mesh> ();
+	{
+		QuietOutput quiet (!verbose);
+		MeshLoader::LoadOptions options;
+		options.useCache = false;
+		options.computeMissingAttributes = false;
+		MeshLoader::load (model, meshPtr, options);
+	}
+	meshPtr->vertexNormals ().resize (meshPtr->vertexPositions ().size ());
+	std::vector<NormalsScaling> scaling;
+	for (unsigned int n = 1; ; n = std::min (2 * n, maxNumThreads)) {
+		Parallel::setNumThreads (n);
+		NormalsScaling entry;
+		entry.model = model;
+		entry.numThreads = n;
+		PhaseStats area, angle;
+		for (int run = 0; run < numRuns; run++) {
+			area.seconds.push_back (timeSeconds ([&] () { meshPtr->recomputePerVertexNormals (false); }));
+			angle.seconds.push_back (timeSeconds ([&] () { meshPtr->recomputePerVertexNormals (true); }));
+		}
+		entry.areaSeconds = area.min ();
+		entry.angleSeconds = angle.min ();
+		scaling.push_back (entry);
+		if (n >= maxNumThreads)
+			break;
+	}
+	return scaling;
+}
+
+KernelLayouts runKernelLayouts (const std::string & model, int numRuns, bool verbose) {
+	auto meshPtr = std::make_shared<Mesh> ();
+	{
+		QuietOutput quiet (!verbose);
+		MeshLoader::LoadOptions options;
+		options.useCache = false;
+		options.computeMissingAttributes = false;
+		MeshLoader::load (model, meshPtr, options);
+	}
+	const Mesh & mesh = *meshPtr;
+	const std::vector<glm::vec3> & P = mesh.vertexPositions ();
+	const std::vector<glm::uvec3> & T = mesh.triangleIndices ();
+	std::vector<glm::vec3> N (P.size ());
+	std::vector<glm::vec2> UV (P.size ());
+	KernelLayouts layouts;
+	layouts.model = model;
+	auto minSeconds = [&] (auto func) {
+		PhaseStats stats;
+		for (int run = 0; run < numRuns; run++)
+			stats.seconds.push_back (timeSeconds (func));
+		return stats.min ();
+	};
+	layouts.soaBuildSeconds = minSeconds ([&] () { VertexSoA soa (P.data (), P.size ()); });
+	VertexSoA soa (P.data (), P.size ());
+	layouts.aosSeconds[Bounds] = minSeconds ([&] () { GeometryKernels::computeBounds (P.data (), P.size ()); });
+	layouts.soaSeconds[Bounds] = minSeconds ([&] () { GeometryKernels::computeBounds (soa); });
+	layouts.aosSeconds[PlanarParameterization] = minSeconds ([&] () { GeometryKernels::computePlanarParameterization (P.data (), P.size (), UV.data (), UV.size ()); });
+	layouts.soaSeconds[PlanarParameterization] = minSeconds ([&] () { GeometryKernels::computePlanarParameterization (soa, UV.data (), UV.size ()); });
+	for (bool angleBased : { false, true }) {
+		Kernel kernel = angleBased ? AngleNormals : AreaNormals;
+		layouts.aosSeconds[kernel] = minSeconds ([&] () { GeometryKernels::computePerVertexNormals (P.data (), P.size (), T.data (), T.size (), N.data (), angleBased); });
+		layouts.soaSeconds[kernel] = minSeconds ([&] () { GeometryKernels::computePerVertexNormals (soa, T.data (), T.size (), N.data (), angleBased); });
+	}
+	return layouts;
+}
+
+IndexOptimization runIndexOptimization (const std::string & model, int numRuns, bool verbose) {
+	auto sourcePtr = std::make_shared<Mesh> ();
+	{
+		QuietOutput quiet (!verbose);
+		MeshLoader::LoadOptions options;
+		options.useCache = false;
+		options.optimizeIndices = false;
+		options.buildMeshlets = false;
+		options.buildLevelsOfDetail = false;
+		options.buildClusterHierarchy = false;
+		options.computeMissingAttributes = false;
+		MeshLoader::load (model, sourcePtr, options);
+	}
+	const Mesh & source = *sourcePtr;
+	IndexOptimization optimization;
+	optimization.model = model;
+	PhaseStats stats[NumIndexStages];
+	for (int run = 0; run < numRuns; run++) {
+		Mesh mesh;
+		mesh.vertexPositions () = source.vertexPositions ();
+		mesh.triangleIndices () = source.triangleIndices ();
+		stats[FileOrder].seconds.push_back (0.0);
+		stats[VertexCache].seconds.push_back (timeSeconds ([&] () { MeshOptimizer::optimizeVertexCache (mesh); }));
+		optimization.statistics[VertexCache] = MeshOptimizer::analyzeVertexCache (mesh);
+		stats[Overdraw].seconds.push_back (timeSeconds ([&] () { MeshOptimizer::optimizeOverdraw (mesh); }));
+		optimization.statistics[Overdraw] = MeshOptimizer::analyzeVertexCache (mesh);
+		stats[Meshlets].seconds.push_back (timeSeconds ([&] () { MeshOptimizer::buildMeshlets (mesh); }));
+		optimization.statistics[Meshlets] = MeshOptimizer::analyzeVertexCache (mesh);
+		stats[VertexFetch].seconds.push_back (timeSeconds ([&] () { MeshOptimizer::optimizeVertexFetch (mesh); }));
+		optimization.statistics[VertexFetch] = MeshOptimizer::analyzeVertexCache (mesh);
+	}
+	optimization.statistics[FileOrder] = MeshOptimizer::analyzeVertexCache (source);
+	for (int stage = 0; stage < NumIndexStages; stage++)
+		optimization.seconds[stage] = stats[stage].min ();
+	return optimization;
+}
+
+VertexFormats runVertexFormats (const std::string & model, int numRuns, bool verbose) {
+	auto meshPtr = std::make_shared<Mesh> ();
+	{
+		QuietOutput quiet (!verbose);
+		MeshLoader::LoadOptions options;
+		options.useCache = false;
+		options.optimizeIndices = false;
+		options.buildMeshlets = false;
+		options.buildLevelsOfDetail = false;
+		MeshLoader::load (model, meshPtr, options);
+	}
+	const Mesh & mesh = *meshPtr;
+	const std::vector<glm::vec3> & P = mesh.vertexPositions ();
+	GeometryKernels::Bounds bounds = mesh.bounds ();
+	std::vector<VertexPacking::PackedVertex> packed (P.size ());
+	VertexFormats formats;
+	formats.model = model;
+	formats.numVertices = P.size ();
+	formats.floatBytes = P.size () * (2 * sizeof (glm::vec3) + sizeof (glm::vec2));
+	formats.packedBytes = P.size () * sizeof (VertexPacking::PackedVertex);
+	PhaseStats stats;
+	for (int run = 0; run < numRuns; run++)
+		stats.seconds.push_back (timeSeconds ([&] () {
+			formats.error = VertexPacking::packVertices (P.data (), mesh.vertexNormals ().data (), mesh.vertexTexCoords ().data (), nullptr, P.size (),
+														 bounds.boxMin, bounds.boxMax, packed.data ());
+		}));
+	formats.packSeconds = stats.min ();
+	std::vector<glm::vec4> tangents (P.size ());
+	std::vector<VertexPacking::QTangent> tangentFrames (P.size ());
+	formats.tangentFrameBytes = P.size () * sizeof (VertexPacking::QTangent);
+	PhaseStats tangentStats;
+	for (int run = 0; run < numRuns; run++)
+		tangentStats.seconds.push_back (timeSeconds ([&] () {
+			GeometryKernels::computePerVertexTangents (P.data (), mesh.vertexNormals ().data (), mesh.vertexTexCoords ().data (), P.size (),
+													   mesh.triangleIndices ().data (), mesh.triangleIndices ().size (), tangents.data (), mesh.adjacency ().get ());
+			formats.error.tangentDegrees = VertexPacking::packTangentFrames (mesh.vertexNormals ().data (), tangents.data (), P.size (), tangentFrames.data ());
+		}));
+	formats.tangentSeconds = tangentStats.min ();
+	formats.error.position /= std::max (glm::length (bounds.boxMax - bounds.boxMin), 1e-30f); // Relative to the diagonal
+	return formats;
+}
+
+RayQueries runRayQueries (const std::string & model, int numRuns, bool verbose) {
+	auto meshPtr = std::make_shared<Mesh> ();
+	{
+		QuietOutput quiet (!verbose);
+		MeshLoader::LoadOptions options;
+		options.useCache = false;
+		options.buildMeshlets = false;
+		options.buildLevelsOfDetail = false;
+		MeshLoader::load (model, meshPtr, options);
+	}
+	const Mesh & mesh = *meshPtr;
+	const std::vector<glm::vec3> & P = mesh.vertexPositions ();
+	const std::vector<glm::uvec3> & T = mesh.triangleIndices ();
+	RayQueries queries;
+	queries.model = model;
+	queries.numTriangles = T.size ();
+	std::unique_ptr<MeshBVH> bvhPtr;
+	PhaseStats buildStats;
+	for (int run = 0; run < numRuns; run++)
+		buildStats.seconds.push_back (timeSeconds ([&] () { bvhPtr.reset (new MeshBVH (P.data (), P.size (), T.data (), T.size ())); }));
+	queries.buildSeconds = buildStats.min ();
+	queries.statistics = bvhPtr->statistics ();
+	queries.bytes = bvhPtr->sizeInBytes ();
+
+	// From the bounding sphere of the box towards points inside it, the same rays every time
+	const size_t numRays = 100000;
+	glm::vec3 center = 0.5f * (bvhPtr->boxMin () + bvhPtr->boxMax ());
+	glm::vec3 halfExtent = 0.5f * (bvhPtr->boxMax () - bvhPtr->boxMin ());
+	std::mt19937 generator (1);
+	std::uniform_real_distribution<float> uniform (-1.f, 1.f);
+	std::vector<glm::vec3> origins (numRays), directions (numRays);
+	for (size_t r = 0; r < numRays; r++) {
+		glm::vec3 d (uniform (generator), uniform (generator), uniform (generator));
+		origins[r] = center + glm::length (halfExtent) * glm::normalize (d + glm::vec3 (1e-6f));
+		directions[r] = center + halfExtent * glm::vec3 (uniform (generator), uniform (generator), uniform (generator)) - origins[r];
+	}
+	size_t numHits = 0;
+	queries.numRays = numRays;
+	queries.intersectSecondsPerRay = timeSeconds ([&] () {
+		for (size_t r = 0; r < numRays; r++)
+			numHits += bvhPtr->intersect (origins[r], directions[r]).isHit ();
+	}) / numRays;
+	queries.hitRatio = static_cast<double> (numHits) / numRays;
+	size_t numOccluded = 0;
+	queries.occludedSecondsPerRay = timeSeconds ([&] () {
+		for (size_t r = 0; r < numRays; r++)
+			numOccluded += bvhPtr->occluded (origins[r], directions[r]);
+	}) / numRays;
+	if (numOccluded != numHits)
+		throw std::runtime_error ("[Mesh Benchmark] Closest and any hit queries disagree");
+
+	const std::vector<glm::vec3> & N = mesh.vertexNormals ();
+	AmbientOcclusion::BakeOptions bakeOptions;
+	bakeOptions.numRays = 64;
+	std::vector<float> ambientOcclusion (P.size ());
+	PhaseStats bakeStats;
+	for (int run = 0; run < numRuns; run++)
+		bakeStats.seconds.push_back (timeSeconds ([&] () {
+			AmbientOcclusion::bake (*bvhPtr, P.data (), N.data (), P.size (), mesh.bounds ().sphereRadius, ambientOcclusion.data (), bakeOptions);
+		}));
+	queries.ambientOcclusionRays = bakeOptions.numRays;
+	queries.ambientOcclusionSeconds = bakeStats.min ();
+	for (float value : ambientOcclusion)
+		queries.meanAmbientOcclusion += value;
+	queries.meanAmbientOcclusion /= std::max<size_t> (ambientOcclusion.size (), 1);
+	return queries;
+}
+
+DrawTimings runDrawTimings (const std::string & model, ShaderProgram & program, int numRuns, bool verbose) {
+	const int numDrawsPerRun = 16; // Per query, to stay well above the timer resolution on small models
+	auto meshPtr = std::make_shared<Mesh> ();
+	{
+		QuietOutput quiet (!verbose);
+		MeshLoader::load (model, meshPtr, MeshLoader::LoadOptions ());
+	}
+	Mesh & mesh = *meshPtr;
+	mesh.setTangentFrames (false); // Same buffers as the shader reads without normal mapping
+	// Whole mesh in view, on the small framebuffer of the hidden window so that vertex processing dominates
+	GeometryKernels::Bounds bounds = mesh.bounds ();
+	float radius = std::max (bounds.sphereRadius, 1e-6f);
+	glm::mat4 viewMatrix = glm::translate (glm::mat4 (1.f), glm::vec3 (0.f, 0.f, -3.f * radius));
+	glm::mat4 projectionMatrix = glm::perspective (glm::radians (45.f), 1.f, 0.1f * radius, 10.f * radius);
+	glm::mat4 modelMatrix = glm::translate (glm::mat4 (1.f), -bounds.sphereCenter);
+	glEnable (GL_DEPTH_TEST);
+	program.use ();
+	program.set ("projectionMat", projectionMatrix);
+	program.set ("normalMat", glm::transpose (glm::inverse (viewMatrix * modelMatrix)));
+	GLuint query;
+	glCreateQueries (GL_TIME_ELAPSED, 1, &query);
+	DrawTimings timings;
+	timings.model = model;
+	for (size_t layout = 0; layout < NUM_DRAW_LAYOUTS; layout++) {
+		mesh.setVertexFormat (DRAW_LAYOUTS[layout].vertexFormat);
+		mesh.setShortIndices (DRAW_LAYOUTS[layout].shortIndices);
+		mesh.init ();
+		timings.vertexBytes[layout] = mesh.gpuVertexSize () * mesh.gpuNumVertices ();
+		timings.indexBytes[layout] = mesh.gpuIndexSize () * 3 * mesh.triangleIndices ().size ();
+		program.set ("modelViewMat", viewMatrix * modelMatrix * mesh.dequantizationMatrix ());
+		program.set ("octahedralNormals", mesh.gpuVertexFormat () == Mesh::VertexFormat::Packed);
+		mesh.render (); // Warm up
+		PhaseStats stats;
+		for (int run = 0; run < numRuns; run++) {
+			glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glBeginQuery (GL_TIME_ELAPSED, query);
+			for (int draw = 0; draw < numDrawsPerRun; draw++)
+				mesh.render ();
+			glEndQuery (GL_TIME_ELAPSED);
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v (query, GL_QUERY_RESULT, &nanoseconds); // Waits for the draws
+			stats.seconds.push_back (nanoseconds * 1e-9 / numDrawsPerRun);
+		}
+		timings.gpuSeconds[layout] = stats.min ();
+	}
+	glDeleteQueries (1, &query);
+	ShaderProgram::stop ();
+	mesh.clear ();
+	return timings;
+}
+
+void printResult (const Result & result, bool gpu) {
+	double megaBytes = result.inputBytes / (1024.0 * 1024.0);
+	double parseSeconds = result.phases[Parse].mean ();
+	std::cout << std::fixed << std::setprecision (3)
+			  << " > [" << result.path << "] <" << result.model << "> " << result.numVertices << " vertices, " << result.numTriangles << " triangles, "
+			  << megaBytes << " MB read, " << (parseSeconds > 0.0 ? megaBytes / parseSeconds : 0.0) << " MB/s parsed, peak RSS "
+			  << result.peakRSS / (1024.0 * 1024.0) << " MB" << std::endl;
+	for (int phase = 0; phase < NumPhases; phase++) {
+		if (phase == Upload && !gpu)
+			continue;
+		const PhaseStats & stats = result.phases[phase];
+		std::cout << "     " << std::left << std::setw (17) << PHASE_NAMES[phase] << std::right
+				  << " mean " << std::setw (9) << stats.mean () * 1000.0 << " ms"
+				  << "  stddev " << std::setw (8) << stats.stddev () * 1000.0 << " ms"
+				  << "  min " << std::setw (9) << stats.min () * 1000.0 << " ms"
+				  << "  max " << std::setw (9) << stats.max () * 1000.0 << " ms" << std::endl;
+	}
+	std::cout << std::defaultfloat;
+}
+
+std::string jsonString (const std::string & s) {
+	std::string escaped = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped + "\"";
+}
+
+void printNormalsScaling (const std::vector<NormalsScaling> & scaling) {
+	if (scaling.empty ())
+		return;
+	std::cout << std::fixed << std::setprecision (3) << " > [normals] <" << scaling.front ().model << "> speedup over 1 thread (area / angle weighted)" << std::endl;
+	for (const auto & entry : scaling)
+		std::cout << "     " << std::setw (3) << entry.numThreads << " threads  area " << std::setw (9) << entry.areaSeconds * 1000.0 << " ms ("
+				  << scaling.front ().areaSeconds / entry.areaSeconds << "x)  angle " << std::setw (9) << entry.angleSeconds * 1000.0 << " ms ("
+				  << scaling.front ().angleSeconds / entry.angleSeconds << "x)" << std::endl;
+	std::cout << std::defaultfloat;
+}
+
+void printKernelLayouts (const KernelLayouts & layouts) {
+	std::cout << std::fixed << std::setprecision (3) << " > [kernels] <" << layouts.model << "> AoS vs SoA positions, SoA copy "
+			  << layouts.soaBuildSeconds * 1000.0 << " ms" << std::endl;
+	for (int kernel = 0; kernel < NumKernels; kernel++)
+		std::cout << "     " << std::left << std::setw (23) << KERNEL_NAMES[kernel] << std::right
+				  << " AoS " << std::setw (9) << layouts.aosSeconds[kernel] * 1000.0 << " ms"
+				  << "  SoA " << std::setw (9) << layouts.soaSeconds[kernel] * 1000.0 << " ms"
+				  << "  (" << layouts.aosSeconds[kernel] / layouts.soaSeconds[kernel] << "x)" << std::endl;
+	std::cout << std::defaultfloat;
+}
+
+void printIndexOptimization (const IndexOptimization & optimization) {
+	std::cout << std::fixed << std::setprecision (3) << " > [indices] <" << optimization.model << "> FIFO vertex cache of 16 entries" << std::endl;
+	for (int stage = 0; stage < NumIndexStages; stage++)
+		std::cout << "     " << std::left << std::setw (17) << INDEX_STAGE_NAMES[stage] << std::right
+				  << " ACMR " << std::setw (6) << optimization.statistics[stage].acmr
+				  << "  ATVR " << std::setw (6) << optimization.statistics[stage].atvr
+				  << "  " << std::setw (9) << optimization.seconds[stage] * 1000.0 << " ms" << std::endl;
+	std::cout << std::defaultfloat;
+}
+
+void printVertexFormats (const VertexFormats & formats) {
+	std::cout << std::fixed << std::setprecision (3) << " > [vertices] <" << formats.model << "> " << formats.floatBytes / (1024.0 * 1024.0)
+			  << " MB as floats, " << formats.packedBytes / (1024.0 * 1024.0) << " MB packed in " << formats.packSeconds * 1000.0
+			  << " ms, max error " << std::setprecision (5) << formats.error.position * 100.f << "% of the diagonal for positions, "
+			  << formats.error.normalDegrees << " degrees for normals, " << formats.error.texCoord << " for texture coordinates; "
+			  << std::setprecision (3) << formats.tangentFrameBytes / (1024.0 * 1024.0) << " MB of tangent frames in " << formats.tangentSeconds * 1000.0
+			  << " ms, max error " << std::setprecision (5) << formats.error.tangentDegrees << " degrees" << std::defaultfloat << std::endl;
+}
+
+void printRayQueries (const RayQueries & queries) {
+	const MeshBVH::Statistics & stats = queries.statistics;
+	std::cout << std::fixed << std::setprecision (3) << " > [rays] <" << queries.model << "> BVH of " << queries.numTriangles
+			  << " triangles built in " << queries.buildSeconds * 1000.0 << " ms, " << stats.numNodes << " nodes, " << stats.numLeaves
+			  << " leaves of " << stats.numTriangleBlocks << " blocks, depth " << stats.depth << ", SAH cost " << stats.sahCost << ", "
+			  << queries.bytes / (1024.0 * 1024.0) << " MB; " << queries.numRays << " rays, " << std::setprecision (1) << queries.hitRatio * 100.0
+			  << "% hits, " << std::setprecision (3) << queries.intersectSecondsPerRay * 1e6 << " us per closest hit, "
+			  << queries.occludedSecondsPerRay * 1e6 << " us per any hit; ambient occlusion with " << queries.ambientOcclusionRays
+			  << " rays per vertex baked in " << queries.ambientOcclusionSeconds * 1000.0 << " ms on " << Parallel::numThreads ()
+			  << " threads, mean " << queries.meanAmbientOcclusion << std::defaultfloat << std::endl;
+}
+
+void printDrawTimings (const DrawTimings & timings) {
+	std::cout << " > [draw] <" << timings.model << ">" << std::fixed;
+	for (size_t layout = 0; layout < NUM_DRAW_LAYOUTS; layout++)
+		std::cout << (layout ? ", " : " ") << DRAW_LAYOUTS[layout].name << " " << std::setprecision (3) << timings.gpuSeconds[layout] * 1000.0
+				  << " ms (" << std::setprecision (2) << (timings.vertexBytes[layout] + timings.indexBytes[layout]) / (1024.0 * 1024.0) << " MB)";
+	std::cout << std::defaultfloat << std::endl;
+}
+
+void writeJSON (const std::string & filename, const std::vector<Result> & results, const std::vector<NormalsScaling> & scaling,
+				const std::vector<KernelLayouts> & kernels, const std::vector<IndexOptimization> & indices,
+				const std::vector<VertexFormats> & vertices, const std::vector<RayQueries> & rays, const std::vector<DrawTimings> & draws,
+				int numRuns, bool gpu) {
+	std::ofstream out (filename.c_str ());
+	if (!out)
+		throw std::ios_base::failure ("[Mesh Benchmark] Cannot write " + filename);
+	out << std::setprecision (9);
+	out << "{\n  \"runs\": " << numRuns << ",\n  \"threads\": " << Parallel::numThreads ()
+		<< ",\n  \"gpu\": " << (gpu ? "true" : "false") << ",\n  \"results\": [";
+	for (size_t i = 0; i < results.size (); i++) {
+		const Result & result = results[i];
+		double parseSeconds = result.phases[Parse].mean ();
+		out << (i ? "," : "") << "\n    {\n"
+			<< "      \"model\": " << jsonString (result.model) << ",\n"
+			<< "      \"path\": " << jsonString (result.path) << ",\n"
+			<< "      \"inputBytes\": " << result.inputBytes << ",\n"
+			<< "      \"numVertices\": " << result.numVertices << ",\n"
+			<< "      \"numTriangles\": " << result.numTriangles << ",\n"
+			<< "      \"parseThroughputMBps\": " << (parseSeconds > 0.0 ? result.inputBytes / (1024.0 * 1024.0) / parseSeconds : 0.0) << ",\n"
+			<< "      \"peakRSSBytes\": " << result.peakRSS << ",\n"
+			<< "      \"phases\": {";
+		bool first = true;
+		for (int phase = 0; phase < NumPhases; phase++) {
+			const PhaseStats & stats = result.phases[phase];
+			if (stats.seconds.empty ())
+				continue;
+			out << (first ? "" : ",") << "\n        " << jsonString (PHASE_NAMES[phase]) << ": { \"meanSeconds\": " << stats.mean ()
+				<< ", \"stddevSeconds\": " << stats.stddev () << ", \"minSeconds\": " << stats.min () << ", \"maxSeconds\": " << stats.max ()
+				<< ", \"samples\": [";
+			for (size_t s = 0; s < stats.seconds.size (); s++)
+				out << (s ? ", " : "") << stats.seconds[s];
+			out << "] }";
+			first = false;
+		}
+		out << "\n      }\n    }";
+	}
+	out << "\n  ],\n  \"normalsScaling\": [";
+	for (size_t i = 0; i < scaling.size (); i++)
+		out << (i ? "," : "") << "\n    { \"model\": " << jsonString (scaling[i].model) << ", \"threads\": " << scaling[i].numThreads
+			<< ", \"areaSeconds\": " << scaling[i].areaSeconds << ", \"angleSeconds\": " << scaling[i].angleSeconds << " }";
+	out << "\n  ],\n  \"kernels\": [";
+	for (size_t i = 0; i < kernels.size (); i++) {
+		out << (i ? "," : "") << "\n    { \"model\": " << jsonString (kernels[i].model) << ", \"soaBuildSeconds\": " << kernels[i].soaBuildSeconds;
+		for (int kernel = 0; kernel < NumKernels; kernel++)
+			out << ", " << jsonString (KERNEL_NAMES[kernel]) << ": { \"aosSeconds\": " << kernels[i].aosSeconds[kernel]
+				<< ", \"soaSeconds\": " << kernels[i].soaSeconds[kernel] << " }";
+		out << " }";
+	}
+	out << "\n  ],\n  \"indices\": [";
+	for (size_t i = 0; i < indices.size (); i++) {
+		out << (i ? "," : "") << "\n    { \"model\": " << jsonString (indices[i].model);
+		for (int stage = 0; stage < NumIndexStages; stage++)
+			out << ", " << jsonString (INDEX_STAGE_NAMES[stage]) << ": { \"acmr\": " << indices[i].statistics[stage].acmr
+				<< ", \"atvr\": " << indices[i].statistics[stage].atvr << ", \"seconds\": " << indices[i].seconds[stage] << " }";
+		out << " }";
+	}
+	out << "\n  ],\n  \"vertices\": [";
+	for (size_t i = 0; i < vertices.size (); i++)
+		out << (i ? "," : "") << "\n    { \"model\": " << jsonString (vertices[i].model) << ", \"numVertices\": " << vertices[i].numVertices
+			<< ", \"floatBytes\": " << vertices[i].floatBytes << ", \"packedBytes\": " << vertices[i].packedBytes
+			<< ", \"packSeconds\": " << vertices[i].packSeconds << ", \"maxPositionError\": " << vertices[i].error.position
+			<< ", \"maxNormalErrorDegrees\": " << vertices[i].error.normalDegrees << ", \"maxTexCoordError\": " << vertices[i].error.texCoord
+			<< ", \"tangentFrameBytes\": " << vertices[i].tangentFrameBytes << ", \"tangentSeconds\": " << vertices[i].tangentSeconds
+			<< ", \"maxTangentErrorDegrees\": " << vertices[i].error.tangentDegrees << " }";
+	out << "\n  ],\n  \"rays\": [";
+	for (size_t i = 0; i < rays.size (); i++)
+		out << (i ? "," : "") << "\n    { \"model\": " << jsonString (rays[i].model) << ", \"numTriangles\": " << rays[i].numTriangles
+			<< ", \"buildSeconds\": " << rays[i].buildSeconds << ", \"numNodes\": " << rays[i].statistics.numNodes
+			<< ", \"numLeaves\": " << rays[i].statistics.numLeaves << ", \"numTriangleBlocks\": " << rays[i].statistics.numTriangleBlocks
+			<< ", \"depth\": " << rays[i].statistics.depth << ", \"sahCost\": " << rays[i].statistics.sahCost << ", \"bytes\": " << rays[i].bytes
+			<< ", \"numRays\": " << rays[i].numRays << ", \"hitRatio\": " << rays[i].hitRatio
+			<< ", \"intersectSecondsPerRay\": " << rays[i].intersectSecondsPerRay << ", \"occludedSecondsPerRay\": " << rays[i].occludedSecondsPerRay
+			<< ", \"ambientOcclusionRays\": " << rays[i].ambientOcclusionRays << ", \"ambientOcclusionSeconds\": " << rays[i].ambientOcclusionSeconds
+			<< ", \"meanAmbientOcclusion\": " << rays[i].meanAmbientOcclusion << " }";
+	out << "\n  ],\n  \"draws\": [";
+	for (size_t i = 0; i < draws.size (); i++) {
+		out << (i ? "," : "") << "\n    { \"model\": " << jsonString (draws[i].model);
+		for (size_t layout = 0; layout < NUM_DRAW_LAYOUTS; layout++)
+			out << ", " << jsonString (DRAW_LAYOUTS[layout].name) << ": { \"gpuSeconds\": " << draws[i].gpuSeconds[layout]
+				<< ", \"vertexBytes\": " << draws[i].vertexBytes[layout] << ", \"indexBytes\": " << draws[i].indexBytes[layout] << " }";
+		out << " }";
+	}
+	out << "\n  ]\n}\n";
+	if (!out)
+		throw std::ios_base::failure ("[Mesh Benchmark] Cannot write " + filename);
+}
+
+void usage (const char * command) {
+	std::cerr << "Usage : " << command << " [--runs <n>] [--threads <n>] [--json <file>] [--no-gpu] [--verbose] [<file.off>...]" << std::endl
+			  << "        Benchmarks every .off file of " << DEFAULT_MODEL_PATH << " when no model is given" << std::endl;
+	std::exit (EXIT_FAILURE);
+}
+
+int main (int argc, char ** argv) {
+	int numRuns = 5;
+	bool gpu = true;
+	bool verbose = false;
+	unsigned int requestedNumThreads = 0;
+	std::string jsonFilename ("MeshBenchmark.json");
+	std::vector<std::string> models;
+	for (int i = 1; i < argc; i++) {
+		std::string arg (argv[i]);
+		if (arg == "--runs" && i + 1 < argc) {
+			numRuns = std::max (1, std::atoi (argv[++i]));
+		} else if (arg == "--threads" && i + 1 < argc) {
+			requestedNumThreads = static_cast<unsigned int> (std::max (0, std::atoi (argv[++i])));
+			Parallel::setNumThreads (requestedNumThreads);
+		} else if (arg == "--json" && i + 1 < argc) {
+			jsonFilename = argv[++i];
+		} else if (arg == "--no-gpu") {
+			gpu = false;
+		} else if (arg == "--verbose") {
+			verbose = true;
+		} else if (arg.compare (0, 2, "--") != 0) {
+			models.push_back (arg);
+		} else
+			usage (argv[0]);
+	}
+	if (models.empty ()) {
+		std::error_code error;
+		for (const auto & entry : std::filesystem::directory_iterator (DEFAULT_MODEL_PATH, error))
+			if (MeshLoader::fileExtension (entry.path ().string ()) == "off")
+				models.push_back (entry.path ().string ());
+		std::sort (models.begin (), models.end ());
+	}
+	if (models.empty ())
+		usage (argv[0]);
+	if (gpu && !initOpenGL ()) {
+		std::cerr << " > [Mesh Benchmark] No OpenGL 4.5 context available, skipping the upload and draw phases" << std::endl;
+		gpu = false;
+	}
+
+	std::vector<LoaderPath> paths;
+	const std::pair<const char *, MeshLoader::OFFParser> parsers[] = { { "stream", MeshLoader::OFFParser::Stream },
+																	   { "mapped", MeshLoader::OFFParser::Mapped },
+																	   { "parallel", MeshLoader::OFFParser::Parallel } };
+	for (const auto & parser : parsers) {
+		LoaderPath path;
+		path.name = parser.first;
+		path.options.parser = parser.second;
+		path.options.useCache = false;
+		path.options.optimizeIndices = false; // Timed separately, see runIndexOptimization
+		path.options.buildMeshlets = false;
+		path.options.buildLevelsOfDetail = false;
+		path.options.buildClusterHierarchy = false;
+		paths.push_back (path);
+	}
+	LoaderPath cachePath;
+	cachePath.name = "cache";
+	paths.push_back (cachePath);
+	LoaderPath compressedPath;
+	compressedPath.name = "qmesh";
+	compressedPath.options.useCache = false;
+	compressedPath.compressed = true;
+	paths.push_back (compressedPath);
+
+	std::vector<Result> results;
+	int status = EXIT_SUCCESS;
+	for (const auto & model : models)
+		for (const auto & path : paths) {
+			try {
+				results.push_back (runPath (model, path, numRuns, gpu, verbose));
+				printResult (results.back (), gpu);
+			} catch (std::exception & e) {
+				std::cerr << " > [" << path.name << "] <" << model << "> failed: " << e.what () << std::endl;
+				status = EXIT_FAILURE;
+			}
+		}
+	// Normals kernel scaling, up to the requested number of threads, or the hardware ones
+	std::vector<NormalsScaling> scaling;
+	for (const auto & model : models) {
+		try {
+			std::vector<NormalsScaling> modelScaling = runNormalsScaling (model, Parallel::numThreads (), numRuns, verbose);
+			printNormalsScaling (modelScaling);
+			scaling.insert (scaling.end (), modelScaling.begin (), modelScaling.end ());
+		} catch (std::exception & e) {
+			std::cerr << " > [normals] <" << model << "> failed: " << e.what () << std::endl;
+			status = EXIT_FAILURE;
+		}
+		Parallel::setNumThreads (requestedNumThreads);
+	}
+	// Data layout of the geometry kernels
+	std::vector<KernelLayouts> kernels;
+	for (const auto & model : models) {
+		try {
+			kernels.push_back (runKernelLayouts (model, numRuns, verbose));
+			printKernelLayouts (kernels.back ());
+		} catch (std::exception & e) {
+			std::cerr << " > [kernels] <" << model << "> failed: " << e.what () << std::endl;
+			status = EXIT_FAILURE;
+		}
+	}
+	// Index buffer optimization stages
+	std::vector<IndexOptimization> indices;
+	for (const auto & model : models) {
+		try {
+			indices.push_back (runIndexOptimization (model, numRuns, verbose));
+			printIndexOptimization (indices.back ());
+		} catch (std::exception & e) {
+			std::cerr << " > [indices] <" << model << "> failed: " << e.what () << std::endl;
+			status = EXIT_FAILURE;
+		}
+	}
+	// Packed vertex format
+	std::vector<VertexFormats> vertices;
+	for (const auto & model : models) {
+		try {
+			vertices.push_back (runVertexFormats (model, numRuns, verbose));
+			printVertexFormats (vertices.back ());
+		} catch (std::exception & e) {
+			std::cerr << " > [vertices] <" << model << "> failed: " << e.what () << std::endl;
+			status = EXIT_FAILURE;
+		}
+	}
+	// Ray queries against the BVH
+	std::vector<RayQueries> rays;
+	for (const auto & model : models) {
+		try {
+			rays.push_back (runRayQueries (model, numRuns, verbose));
+			printRayQueries (rays.back ());
+		} catch (std::exception & e) {
+			std::cerr << " > [rays] <" << model << "> failed: " << e.what () << std::endl;
+			status = EXIT_FAILURE;
+		}
+	}
+	// Draw time of each buffer layout
+	std::vector<DrawTimings> draws;
+	if (gpu) {
+		try {
+			std::shared_ptr<ShaderProgram> programPtr = ShaderProgram::genBasicShaderProgram (SHADER_PATH + "VertexShader.glsl",
+																							  SHADER_PATH + "FragmentShader.glsl");
+			for (const auto & model : models) {
+				try {
+					draws.push_back (runDrawTimings (model, *programPtr, numRuns, verbose));
+					printDrawTimings (draws.back ());
+				} catch (std::exception & e) {
+					std::cerr << " > [draw] <" << model << "> failed: " << e.what () << std::endl;
+					status = EXIT_FAILURE;
+				}
+			}
+		} catch (std::exception & e) {
+			std::cerr << " > [draw] Cannot load the shaders: " << e.what () << std::endl;
+			status = EXIT_FAILURE;
+		}
+	}
+	try {
+		writeJSON (jsonFilename, results, scaling, kernels, indices, vertices, rays, draws, numRuns, gpu);
+		std::cout << " > Results written to <" << jsonFilename << ">" << std::endl;
+	} catch (std::exception & e) {
+		std::cerr << e.what () << std::endl;
+		status = EXIT_FAILURE;
+	}
+	if (gpu)
+		glfwTerminate ();
+	return status;
+}
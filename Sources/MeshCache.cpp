@@ -0,0 +1,369 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <iterator>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <exception>
+#include <ios>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = { 'B', 'G', 'L', 'M', 'E', 'S', 'H', '\0' };
+
+/// Increment whenever the layout below or the processing applied to the cached mesh changes
+const uint32_t VERSION = 8;
+
+/// Every array starts on this boundary, which suits both SIMD loads and GPU copies
+const uint64_t ALIGNMENT = 64;
+
+/// Fixed-size header, followed by the positions, normals, texture coordinates, triangle indices, meshlets, level of
+/// detail triangle indices, levels of detail, cluster triangle indices and cluster hierarchy arrays, then the buffers of
+/// the packed format as Mesh::init uploads them: vertices, tangent frames and 16-bit indices when every vertex fits.
+/// The float arrays only serve the CPU kernels, which copy them on first use.
+/// All values are stored in the native byte order of the machine that wrote the cache.
+struct FileHeader {
+	MeshCache::VersionedHeader versioned;
+	uint64_t sourceSize;
+	int64_t sourceModificationTime;
+	uint64_t sourceContentHash;
+	uint64_t processingKey;
+	uint64_t numVertices;
+	uint64_t numTriangles;
+	uint64_t positionsOffset;
+	uint64_t normalsOffset;
+	uint64_t numTexCoords; // numVertices, or 0 when left to the vertex shader
+	uint64_t texCoordsOffset;
+	uint64_t trianglesOffset;
+	uint64_t numMeshlets;
+	uint64_t meshletsOffset;
+	uint64_t numLodTriangles;
+	uint64_t lodTrianglesOffset;
+	uint64_t numLevelsOfDetail;
+	uint64_t levelsOfDetailOffset;
+	uint64_t numClusterTriangles;
+	uint64_t clusterTrianglesOffset;
+	uint64_t numClusters;
+	uint64_t clustersOffset;
+	GeometryKernels::Bounds bounds; // Of the positions, which the packed vertices are quantized over
+	VertexPacking::PackingError packingError;
+	uint64_t packedVertexSize; // With texture coordinates when there are some
+	uint64_t packedVerticesOffset;
+	uint64_t numTangentFrames; // numVertices, or 0
+	uint64_t tangentFramesOffset;
+	uint64_t numShortIndices; // Of every triangle, or 0 when some vertex does not fit
+	uint64_t shortIndicesOffset;
+};
+
+static_assert (sizeof (Meshlet) == 40, "Meshlets are stored as is");
+static_assert (sizeof (LevelOfDetail) == 12, "Levels of detail are stored as is");
+static_assert (sizeof (ClusterNode) == 84, "Cluster nodes are stored as is");
+
+inline uint64_t alignUp (uint64_t offset) {
+	return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+int64_t modificationTime (const std::string & filename) {
+	std::error_code error;
+	auto time = std::filesystem::last_write_time (filename, error);
+	if (error)
+		throw std::ios_base::failure ("[Mesh Cache] Cannot stat " + filename);
+	return static_cast<int64_t> (time.time_since_epoch ().count ());
+}
+
+bool isValidArray (const FileHeader & header, uint64_t offset, uint64_t elementSize, uint64_t numElements) {
+	return offset % ALIGNMENT == 0 && offset >= sizeof (FileHeader) && offset + elementSize * numElements <= header.versioned.fileSize;
+}
+
+/// True if every index refers to one of the numVertices vertices
+template <typename Index>
+bool isValidIndexArray (const char * data, uint64_t offset, uint64_t numIndices, uint64_t numVertices) {
+	const Index * indices = reinterpret_cast<const Index *> (data + offset);
+	Index maxIndex = 0;
+	for (uint64_t i = 0; i < numIndices; i++)
+		maxIndex = std::max (maxIndex, indices[i]);
+	return numIndices == 0 || maxIndex < numVertices;
+}
+
+inline bool isValidRange (uint32_t first, uint32_t count, uint64_t size) {
+	return static_cast<uint64_t> (first) + count <= size;
+}
+
+/// Checks the indices and the triangle ranges of the meshlets, levels of detail and clusters, so that the CPU kernels
+/// never read out of bounds
+bool isValidContent (const FileHeader & header, const char * data) {
+	if (!isValidIndexArray<uint32_t> (data, header.trianglesOffset, 3 * header.numTriangles, header.numVertices)
+		|| !isValidIndexArray<uint32_t> (data, header.lodTrianglesOffset, 3 * header.numLodTriangles, header.numVertices)
+		|| !isValidIndexArray<uint32_t> (data, header.clusterTrianglesOffset, 3 * header.numClusterTriangles, header.numVertices)
+		|| !isValidIndexArray<uint16_t> (data, header.shortIndicesOffset, header.numShortIndices, header.numVertices))
+		return false;
+	const Meshlet * meshlets = reinterpret_cast<const Meshlet *> (data + header.meshletsOffset);
+	for (uint64_t i = 0; i < header.numMeshlets; i++)
+		if (!isValidRange (meshlets[i].firstTriangle, meshlets[i].numTriangles, header.numTriangles))
+			return false;
+	const LevelOfDetail * levels = reinterpret_cast<const LevelOfDetail *> (data + header.levelsOfDetailOffset);
+	for (uint64_t i = 0; i < header.numLevelsOfDetail; i++)
+		if (!isValidRange (levels[i].firstTriangle, levels[i].numTriangles, header.numLodTriangles))
+			return false;
+	const ClusterNode * clusters = reinterpret_cast<const ClusterNode *> (data + header.clustersOffset);
+	for (uint64_t i = 0; i < header.numClusters; i++)
+		if (!isValidRange (clusters[i].cluster.firstTriangle, clusters[i].cluster.numTriangles,
+						   clusters[i].level == 0 ? header.numTriangles : header.numClusterTriangles))
+			return false;
+	return true;
+}
+
+}
+
+/// FNV-1a variant consuming 8 bytes per step
+uint64_t MeshCache::hashBytes (const void * bytes, size_t size) {
+	const char * data = static_cast<const char *> (bytes);
+	const uint64_t prime = 0x100000001b3ull;
+	uint64_t h = 0xcbf29ce484222325ull ^ size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy (&word, data + i, 8);
+		h = (h ^ word) * prime;
+		h ^= h >> 29;
+	}
+	for (; i < size; i++)
+		h = (h ^ static_cast<unsigned char> (data[i])) * prime;
+	return h;
+}
+
+std::string MeshCache::cacheFilename (const std::string & sourceFilename) {
+	return sourceFilename + ".cache";
+}
+
+std::shared_ptr<MappedFile> MeshCache::mapFile (const std::string & filename, const char magic[8], uint32_t version, size_t headerSize) {
+	std::error_code error;
+	if (!std::filesystem::exists (filename, error))
+		return nullptr;
+	std::shared_ptr<MappedFile> file;
+	try {
+		file = std::make_shared<MappedFile> (filename);
+	} catch (std::exception &) {
+		return nullptr;
+	}
+	VersionedHeader header;
+	if (file->size () >= std::max (sizeof (VersionedHeader), headerSize))
+		std::memcpy (&header, file->data (), sizeof (VersionedHeader));
+	if (file->size () < std::max (sizeof (VersionedHeader), headerSize) || std::memcmp (header.magic, magic, sizeof (header.magic)) != 0
+		|| header.version != version || header.headerSize != headerSize || header.fileSize != file->size ()) {
+		std::cout << " > [Cache] Ignoring incompatible cache <" << filename << ">" << std::endl;
+		return nullptr;
+	}
+	return file;
+}
+
+void MeshCache::writeFile (const std::string & filename, const char magic[8], uint32_t version, VersionedHeader & header, size_t headerSize,
+						   const std::vector<Block> & blocks) {
+	std::memcpy (header.magic, magic, sizeof (header.magic));
+	header.version = version;
+	header.headerSize = static_cast<uint32_t> (headerSize);
+	header.fileSize = headerSize;
+	for (const Block & block : blocks)
+		header.fileSize = std::max<uint64_t> (header.fileSize, block.offset + block.size);
+	std::string tmpFilename = filename + ".tmp";
+	{
+		std::ofstream out (tmpFilename.c_str (), std::ios::binary | std::ios::trunc);
+		if (!out)
+			throw std::ios_base::failure ("[Mesh Cache][writeFile] Cannot create " + tmpFilename);
+		out.write (reinterpret_cast<const char *> (&header), static_cast<std::streamsize> (headerSize));
+		for (const Block & block : blocks) {
+			uint64_t position = static_cast<uint64_t> (out.tellp ());
+			if (block.offset < position)
+				throw std::ios_base::failure ("[Mesh Cache][writeFile] Misplaced block in " + filename);
+			std::fill_n (std::ostreambuf_iterator<char> (out), block.offset - position, '\0');
+			out.write (static_cast<const char *> (block.data), static_cast<std::streamsize> (block.size));
+		}
+		if (!out)
+			throw std::ios_base::failure ("[Mesh Cache][writeFile] Cannot write " + tmpFilename);
+	}
+	std::error_code error;
+	std::filesystem::rename (tmpFilename, filename, error);
+	if (error) {
+		std::filesystem::remove (tmpFilename, error);
+		throw std::ios_base::failure ("[Mesh Cache][writeFile] Cannot write " + filename);
+	}
+	std::cout << " > [Cache] Wrote <" << filename << ">" << std::endl;
+}
+
+MeshCache::SourceSignature MeshCache::computeSignature (const std::string & filename) {
+	MappedFile file (filename);
+	SourceSignature signature;
+	signature.size = file.size ();
+	signature.modificationTime = modificationTime (filename);
+	signature.contentHash = hashBytes (file.data (), file.size ());
+	return signature;
+}
+
+bool MeshCache::load (const std::string & sourceFilename, std::shared_ptr<Mesh> meshPtr, uint64_t processingKey) {
+	std::string filename = cacheFilename (sourceFilename);
+	auto start = std::chrono::steady_clock::now ();
+	std::shared_ptr<MappedFile> file = mapFile (filename, MAGIC, VERSION, sizeof (FileHeader));
+	if (!file)
+		return false;
+	FileHeader header;
+	std::memcpy (&header, file->data (), sizeof (FileHeader));
+	if (!isValidArray (header, header.positionsOffset, sizeof (glm::vec3), header.numVertices)
+		|| !isValidArray (header, header.normalsOffset, sizeof (glm::vec3), header.numVertices)
+		|| (header.numTexCoords != 0 && header.numTexCoords != header.numVertices)
+		|| !isValidArray (header, header.texCoordsOffset, sizeof (glm::vec2), header.numTexCoords)
+		|| !isValidArray (header, header.trianglesOffset, sizeof (glm::uvec3), header.numTriangles)
+		|| !isValidArray (header, header.meshletsOffset, sizeof (Meshlet), header.numMeshlets)
+		|| !isValidArray (header, header.lodTrianglesOffset, sizeof (glm::uvec3), header.numLodTriangles)
+		|| !isValidArray (header, header.levelsOfDetailOffset, sizeof (LevelOfDetail), header.numLevelsOfDetail)
+		|| !isValidArray (header, header.clusterTrianglesOffset, sizeof (glm::uvec3), header.numClusterTriangles)
+		|| !isValidArray (header, header.clustersOffset, sizeof (ClusterNode), header.numClusters)
+		|| header.packedVertexSize != (header.numTexCoords ? sizeof (VertexPacking::PackedVertex) : offsetof (VertexPacking::PackedVertex, texCoord))
+		|| !isValidArray (header, header.packedVerticesOffset, header.packedVertexSize, header.numVertices)
+		|| (header.numTangentFrames != 0 && header.numTangentFrames != header.numVertices)
+		|| !isValidArray (header, header.tangentFramesOffset, sizeof (VertexPacking::QTangent), header.numTangentFrames)
+		|| (header.numShortIndices != 0 && header.numShortIndices != 3 * (header.numTriangles + header.numLodTriangles + header.numClusterTriangles))
+		|| !isValidArray (header, header.shortIndicesOffset, sizeof (uint16_t), header.numShortIndices)) {
+		std::cout << " > [Cache] Ignoring incompatible cache <" << filename << ">" << std::endl;
+		return false;
+	}
+	// Size and date are trusted, the content is only hashed when the date alone changed, e.g., on a copy
+	std::error_code error;
+	if (header.processingKey != processingKey
+		|| std::filesystem::file_size (sourceFilename, error) != header.sourceSize || error
+		|| (modificationTime (sourceFilename) != header.sourceModificationTime
+			&& computeSignature (sourceFilename).contentHash != header.sourceContentHash)) {
+		std::cout << " > [Cache] Outdated cache <" << filename << ">" << std::endl;
+		return false;
+	}
+	if (!isValidContent (header, file->data ())) {
+		std::cout << " > [Cache] Ignoring corrupted cache <" << filename << ">" << std::endl;
+		return false;
+	}
+
+	// Nothing is copied: init uploads the packed buffers from the mapping, and the CPU kernels copy the float arrays on first use
+	const char * data = file->data ();
+	Mesh::ExternalGeometry geometry;
+	geometry.owner = file;
+	geometry.numVertices = header.numVertices;
+	geometry.numTriangles = header.numTriangles;
+	geometry.numLodTriangles = header.numLodTriangles;
+	geometry.numClusterTriangles = header.numClusterTriangles;
+	geometry.positions = reinterpret_cast<const glm::vec3 *> (data + header.positionsOffset);
+	geometry.normals = reinterpret_cast<const glm::vec3 *> (data + header.normalsOffset);
+	geometry.texCoords = header.numTexCoords ? reinterpret_cast<const glm::vec2 *> (data + header.texCoordsOffset) : nullptr;
+	geometry.triangles = reinterpret_cast<const glm::uvec3 *> (data + header.trianglesOffset);
+	geometry.lodTriangles = reinterpret_cast<const glm::uvec3 *> (data + header.lodTrianglesOffset);
+	geometry.clusterTriangles = reinterpret_cast<const glm::uvec3 *> (data + header.clusterTrianglesOffset);
+	geometry.bounds = header.bounds;
+	geometry.packedVertices = data + header.packedVerticesOffset;
+	geometry.packingError = header.packingError;
+	geometry.tangentFrames = header.numTangentFrames ? reinterpret_cast<const VertexPacking::QTangent *> (data + header.tangentFramesOffset) : nullptr;
+	geometry.shortIndices = header.numShortIndices ? reinterpret_cast<const uint16_t *> (data + header.shortIndicesOffset) : nullptr;
+	meshPtr->clear ();
+	meshPtr->setUploadSource (geometry);
+	// Last, the source clears them
+	const Meshlet * meshlets = reinterpret_cast<const Meshlet *> (data + header.meshletsOffset);
+	const LevelOfDetail * levels = reinterpret_cast<const LevelOfDetail *> (data + header.levelsOfDetailOffset);
+	const ClusterNode * clusters = reinterpret_cast<const ClusterNode *> (data + header.clustersOffset);
+	meshPtr->meshlets ().assign (meshlets, meshlets + header.numMeshlets);
+	meshPtr->levelsOfDetail ().assign (levels, levels + header.numLevelsOfDetail);
+	meshPtr->clusterHierarchy ().assign (clusters, clusters + header.numClusters);
+
+	double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	std::cout << " > [Cache] " << std::fixed << std::setprecision (2) << file->size () / (1024.0 * 1024.0)
+			  << " MB mapped from <" << filename << "> in " << seconds * 1000.0 << " ms" << std::defaultfloat << std::endl;
+	return true;
+}
+
+bool MeshCache::readBounds (const std::string & sourceFilename, GeometryKernels::Bounds & bounds) {
+	std::shared_ptr<MappedFile> file = mapFile (cacheFilename (sourceFilename), MAGIC, VERSION, sizeof (FileHeader));
+	if (!file)
+		return false;
+	FileHeader header;
+	std::memcpy (static_cast<void *> (&header), file->data (), sizeof (FileHeader));
+	std::error_code error;
+	if (std::filesystem::file_size (sourceFilename, error) != header.sourceSize || error
+		|| modificationTime (sourceFilename) != header.sourceModificationTime)
+		return false;
+	bounds = header.bounds;
+	return true;
+}
+
+void MeshCache::save (const std::string & sourceFilename, const Mesh & mesh, uint64_t processingKey) {
+	SourceSignature signature = computeSignature (sourceFilename);
+	const auto & P = mesh.vertexPositions ();
+	const auto & N = mesh.vertexNormals ();
+	const auto & UV = mesh.vertexTexCoords ();
+	const auto & T = mesh.triangleIndices ();
+	const auto & M = mesh.meshlets ();
+	const auto & lodT = mesh.lodTriangleIndices ();
+	const auto & L = mesh.levelsOfDetail ();
+	const auto & clusterT = mesh.clusterTriangleIndices ();
+	const auto & C = mesh.clusterHierarchy ();
+	if (N.size () != P.size () || (UV.size () != P.size () && !UV.empty ())) // Texture coordinates may be left to the vertex shader
+		throw std::ios_base::failure ("[Mesh Cache][save] Incomplete mesh for " + sourceFilename);
+	// The packed buffers of the default upload, without ambient occlusion, which has a cache of its own
+	std::vector<unsigned char> packedVertices;
+	VertexPacking::PackingError packingError;
+	size_t packedVertexSize = mesh.packVertices (!UV.empty (), nullptr, packedVertices, packingError);
+	std::vector<VertexPacking::QTangent> tangentFrames;
+	if (!P.empty ())
+		packingError.tangentDegrees = mesh.packTangentFrames (!UV.empty (), tangentFrames);
+	std::vector<uint16_t> shortIndices;
+	if (P.size () <= 65536)
+		mesh.packShortIndices (shortIndices);
+
+	FileHeader header;
+	std::memset (static_cast<void *> (&header), 0, sizeof (FileHeader)); // Padding included, for reproducible files
+	header.sourceSize = signature.size;
+	header.sourceModificationTime = signature.modificationTime;
+	header.sourceContentHash = signature.contentHash;
+	header.processingKey = processingKey;
+	header.numVertices = P.size ();
+	header.numTriangles = T.size ();
+	header.positionsOffset = alignUp (sizeof (FileHeader));
+	header.normalsOffset = alignUp (header.positionsOffset + sizeof (glm::vec3) * P.size ());
+	header.numTexCoords = UV.size ();
+	header.texCoordsOffset = alignUp (header.normalsOffset + sizeof (glm::vec3) * N.size ());
+	header.trianglesOffset = alignUp (header.texCoordsOffset + sizeof (glm::vec2) * UV.size ());
+	header.numMeshlets = M.size ();
+	header.meshletsOffset = alignUp (header.trianglesOffset + sizeof (glm::uvec3) * T.size ());
+	header.numLodTriangles = lodT.size ();
+	header.lodTrianglesOffset = alignUp (header.meshletsOffset + sizeof (Meshlet) * M.size ());
+	header.numLevelsOfDetail = L.size ();
+	header.levelsOfDetailOffset = alignUp (header.lodTrianglesOffset + sizeof (glm::uvec3) * lodT.size ());
+	header.numClusterTriangles = clusterT.size ();
+	header.clusterTrianglesOffset = alignUp (header.levelsOfDetailOffset + sizeof (LevelOfDetail) * L.size ());
+	header.numClusters = C.size ();
+	header.clustersOffset = alignUp (header.clusterTrianglesOffset + sizeof (glm::uvec3) * clusterT.size ());
+	header.bounds = mesh.bounds ();
+	header.packingError = packingError;
+	header.packedVertexSize = packedVertexSize;
+	header.packedVerticesOffset = alignUp (header.clustersOffset + sizeof (ClusterNode) * C.size ());
+	header.numTangentFrames = tangentFrames.size ();
+	header.tangentFramesOffset = alignUp (header.packedVerticesOffset + packedVertices.size ());
+	header.numShortIndices = shortIndices.size ();
+	header.shortIndicesOffset = alignUp (header.tangentFramesOffset + sizeof (VertexPacking::QTangent) * tangentFrames.size ());
+	MeshCache::writeFile (cacheFilename (sourceFilename), MAGIC, VERSION, header.versioned, sizeof (FileHeader),
+						  { { header.positionsOffset, P.data (), sizeof (glm::vec3) * P.size () },
+							{ header.normalsOffset, N.data (), sizeof (glm::vec3) * N.size () },
+							{ header.texCoordsOffset, UV.data (), sizeof (glm::vec2) * UV.size () },
+							{ header.trianglesOffset, T.data (), sizeof (glm::uvec3) * T.size () },
+							{ header.meshletsOffset, M.data (), sizeof (Meshlet) * M.size () },
+							{ header.lodTrianglesOffset, lodT.data (), sizeof (glm::uvec3) * lodT.size () },
+							{ header.levelsOfDetailOffset, L.data (), sizeof (LevelOfDetail) * L.size () },
+							{ header.clusterTrianglesOffset, clusterT.data (), sizeof (glm::uvec3) * clusterT.size () },
+							{ header.clustersOffset, C.data (), sizeof (ClusterNode) * C.size () },
+							{ header.packedVerticesOffset, packedVertices.data (), packedVertices.size () },
+							{ header.tangentFramesOffset, tangentFrames.data (), sizeof (VertexPacking::QTangent) * tangentFrames.size () },
+							{ header.shortIndicesOffset, shortIndices.data (), sizeof (uint16_t) * shortIndices.size () } });
+}
@@ -0,0 +1,77 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "Mesh.h"
+
+class MappedFile;
+
+/// Versioned binary sidecar storing a fully processed mesh (positions, normals, texture coordinates, indices, meshlets, levels of detail and cluster hierarchy)
+/// next to its source model, both as floats for the CPU kernels and in the layout uploaded by default (packed vertices, tangent frames and 16-bit indices),
+/// so that later launches skip parsing, post-processing and packing.
+namespace MeshCache {
+
+/// Identifies the content of a source file. A different size invalidates the cache, and so does a different date
+/// unless the content hash still matches.
+struct SourceSignature {
+	uint64_t size = 0;
+	int64_t modificationTime = 0;
+	uint64_t contentHash = 0;
+};
+
+/// Location of the cache associated to a source model.
+std::string cacheFilename (const std::string & sourceFilename);
+
+/// Fast 64-bit hash of a block of memory, as used for the content of the source files
+uint64_t hashBytes (const void * data, size_t size);
+
+/// Leading fields of every cache file, this one and the sidecars of other modules (e.g., AmbientOcclusion), as the
+/// first member of their header
+struct VersionedHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize; ///< Of the whole header
+	uint64_t fileSize;
+};
+
+/// Part of a cache file, written after the header
+struct Block {
+	uint64_t offset; ///< Zero-padded up to it from the end of the previous block
+	const void * data;
+	size_t size;
+};
+
+/// Maps a cache file whose header starts with the given magic, version and header size, and whose size matches the
+/// one it declares. Returns null if there is no such file, or, reporting it, if it is incompatible.
+std::shared_ptr<MappedFile> mapFile (const std::string & filename, const char magic[8], uint32_t version, size_t headerSize);
+
+/// Writes a cache file, its versioned header completed with the given magic, version, header size and the size of the
+/// file, then the blocks in order. Written aside then renamed, so that a concurrent or interrupted run never sees a
+/// partial file. Throws std::ios_base::failure on I/O errors.
+void writeFile (const std::string & filename, const char magic[8], uint32_t version, VersionedHeader & header, size_t headerSize,
+				const std::vector<Block> & blocks);
+
+/// Computes the signature of a file. Throws std::ios_base::failure if it cannot be read.
+SourceSignature computeSignature (const std::string & filename);
+
+/// Maps the cache of sourceFilename in memory and attaches its arrays to the mesh as its upload source, without copying
+/// them: Mesh::init feeds the packed buffers straight to the GPU, and the vectors of the mesh are only filled, from the
+/// float arrays, when first accessed, e.g., by a CPU kernel.
+/// processingKey identifies the optional load-time processing applied to the cached mesh (e.g., vertex welding).
+/// Returns false, leaving the mesh empty, if there is no cache or if it does not match the current source file and key.
+bool load (const std::string & sourceFilename, std::shared_ptr<Mesh> meshPtr, uint64_t processingKey = 0);
+
+/// Reads the bounds of the cached mesh of sourceFilename, without mapping its arrays. Returns false if there is no cache
+/// or if it does not match the size and date of the source file.
+bool readBounds (const std::string & sourceFilename, GeometryKernels::Bounds & bounds);
+
+/// Writes the cache of sourceFilename from a processed mesh. Throws std::ios_base::failure on I/O errors.
+void save (const std::string & sourceFilename, const Mesh & mesh, uint64_t processingKey = 0);
+
+}
+
+#endif // MESH_CACHE_H
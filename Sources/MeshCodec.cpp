@@ -0,0 +1,428 @@
+#include "MeshCodec.h"
+#include "MeshOptimizer.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <fstream>
+#include <exception>
+#include <ios>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <atomic>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = { 'Q', 'M', 'E', 'S', 'H', '\0', '\0', '\0' };
+
+const uint32_t VERSION = 2;
+
+/// Triangles per independently decodable index block
+const uint32_t TRIANGLES_PER_BLOCK = 16384;
+
+/// Distances below it take a single byte in an index block, larger ones escape to the end of the block
+const uint32_t ESCAPE = 255;
+/// Escaped distances from it on take a full uint32 after the uint16 one
+const uint32_t LONG_ESCAPE = 0xFFFF;
+
+/// Fixed-size header, followed by the quantized positions (3 x positionBits per vertex, as a little endian bit stream),
+/// the byte offset of every index block relative to the start of the index data (uint64 per block, plus the end
+/// offset), and the index blocks.
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t numVertices;
+	uint64_t numTriangles;
+	float positionOffset[3]; // Decoded position: offset + scale * quantized
+	float positionScale[3];
+	uint32_t positionBits;
+	uint32_t trianglesPerBlock;
+	uint64_t numBlocks;
+	uint64_t positionsOffset;
+	uint64_t blockOffsetsOffset;
+	uint64_t indicesOffset;
+	uint64_t fileSize;
+};
+
+inline bool isLittleEndianHost () {
+	const uint16_t probe = 1;
+	return *reinterpret_cast<const unsigned char *> (&probe) == 1;
+}
+
+/// LEB128: 7 bits per byte, high bit set on every byte but the last
+inline void writeVarint (std::vector<uint8_t> & out, uint32_t value) {
+	while (value >= 0x80) {
+		out.push_back (static_cast<uint8_t> (value | 0x80));
+		value >>= 7;
+	}
+	out.push_back (static_cast<uint8_t> (value));
+}
+
+/// Returns nullptr when the code overruns end or exceeds 32 bits
+inline const uint8_t * readVarint (const uint8_t * cur, const uint8_t * end, uint32_t & value) {
+	if (cur < end && *cur < 0x80) { // Most codes fit in a single byte
+		value = *cur;
+		return cur + 1;
+	}
+	value = 0;
+	for (int shift = 0; shift < 35 && cur < end; shift += 7) {
+		uint8_t byte = *cur++;
+		value |= static_cast<uint32_t> (byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return cur;
+	}
+	return nullptr;
+}
+
+/// Index of the lowest bit set in a non-zero mask
+inline unsigned int lowestBit (unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward (&index, mask);
+	return static_cast<unsigned int> (index);
+#else
+	return static_cast<unsigned int> (__builtin_ctz (mask));
+#endif
+}
+
+/// Number of bytes of numValues values packed on the given number of bits
+inline uint64_t packedSize (uint64_t numValues, unsigned int bits) {
+	return (numValues * bits + 7) / 8;
+}
+
+/// Writes the values on their low bits, as a little endian bit stream
+void packBits (const std::vector<uint16_t> & values, unsigned int bits, std::vector<uint8_t> & out) {
+	out.assign (packedSize (values.size (), bits), 0);
+	uint64_t buffer = 0;
+	unsigned int numBuffered = 0;
+	size_t byte = 0;
+	for (uint16_t value : values) {
+		buffer |= static_cast<uint64_t> (value) << numBuffered;
+		for (numBuffered += bits; numBuffered >= 8; numBuffered -= 8, buffer >>= 8)
+			out[byte++] = static_cast<uint8_t> (buffer);
+	}
+	if (numBuffered > 0)
+		out[byte] = static_cast<uint8_t> (buffer);
+}
+
+/// Reads numValues values of the given number of bits from a stream starting on a byte boundary. Reads up to 3 bytes
+/// past the last value.
+void unpackBits (const uint8_t * stream, size_t numValues, unsigned int bits, uint16_t * values) {
+	uint32_t mask = (1u << bits) - 1;
+	for (size_t i = 0; i < numValues; i++) {
+		uint64_t position = i * bits;
+		uint32_t word;
+		std::memcpy (&word, stream + (position >> 3), 4); // bits + 7 <= 23 bits
+		values[i] = static_cast<uint16_t> ((word >> (position & 7)) & mask);
+	}
+}
+
+/// After the vertex fetch reordering, an index either introduces the next unseen vertex or refers to a vertex seen
+/// shortly before, which the cache-ordered triangles keep close to it: every index is coded as its distance back from
+/// the next unseen vertex, 0 for a new vertex. A block holds its next unseen vertex (varint), to be decoded on its own,
+/// then a byte per index, the distance or ESCAPE, then the escaped distances minus ESCAPE, in order, as uint16 (or
+/// LONG_ESCAPE followed by a uint32), fixed sizes sparing the decoder the branches of varints.
+void encodeIndexBlock (const glm::uvec3 * T, size_t numTriangles, uint32_t next, std::vector<uint8_t> & out) {
+	writeVarint (out, next);
+	const unsigned int * indices = glm::value_ptr (T[0]);
+	size_t first = out.size ();
+	out.resize (first + 3 * numTriangles);
+	std::vector<uint8_t> escapes;
+	for (size_t k = 0; k < 3 * numTriangles; k++) {
+		uint32_t v = indices[k];
+		uint32_t distance = next - v; // v <= next holds in vertex fetch order
+		out[first + k] = static_cast<uint8_t> (std::min (distance, ESCAPE));
+		if (distance >= ESCAPE) {
+			uint32_t extra = distance - ESCAPE;
+			uint16_t value = static_cast<uint16_t> (std::min (extra, LONG_ESCAPE));
+			escapes.insert (escapes.end (), reinterpret_cast<const uint8_t *> (&value), reinterpret_cast<const uint8_t *> (&value + 1));
+			if (extra >= LONG_ESCAPE)
+				escapes.insert (escapes.end (), reinterpret_cast<const uint8_t *> (&extra), reinterpret_cast<const uint8_t *> (&extra + 1));
+		}
+		if (v == next)
+			next++;
+	}
+	out.insert (out.end (), escapes.begin (), escapes.end ());
+}
+
+/// The distances are decoded 16 at a time with SSE2, each index being derived from the count of new vertices before it
+/// by a prefix sum across the lanes, then the escaped ones are corrected.
+bool decodeIndexBlock (const uint8_t * cur, const uint8_t * end, glm::uvec3 * T, size_t numTriangles, uint64_t numVertices) {
+	uint32_t next;
+	cur = readVarint (cur, end, next);
+	size_t numIndices = 3 * numTriangles;
+	if (!cur || static_cast<size_t> (end - cur) < numIndices)
+		return false;
+	const uint8_t * distances = cur;
+	const uint8_t * escapes = cur + numIndices;
+	unsigned int * indices = glm::value_ptr (T[0]);
+	auto readEscape = [&] (uint32_t & extra) { // Distance minus ESCAPE
+		uint16_t value;
+		if (end - escapes < 2)
+			return false;
+		std::memcpy (&value, escapes, 2);
+		escapes += 2;
+		extra = value;
+		if (extra < LONG_ESCAPE)
+			return true;
+		if (end - escapes < 4)
+			return false;
+		std::memcpy (&extra, escapes, 4);
+		escapes += 4;
+		return extra <= std::numeric_limits<uint32_t>::max () - ESCAPE;
+	};
+	size_t k = 0;
+#ifdef MESH_CODEC_SSE2
+	const __m128i zero = _mm_setzero_si128 ();
+	const __m128i escape = _mm_set1_epi8 (static_cast<char> (ESCAPE));
+	const __m128i sign = _mm_set1_epi32 (std::numeric_limits<int32_t>::min ()); // Unsigned comparisons as signed ones
+	__m128i nextLanes = _mm_set1_epi32 (static_cast<int> (next));
+	__m128i invalid = zero;
+	for (; k + 16 <= numIndices; k += 16) {
+		__m128i bytes = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (distances + k));
+		__m128i lo = _mm_unpacklo_epi8 (bytes, zero);
+		__m128i hi = _mm_unpackhi_epi8 (bytes, zero);
+		__m128i d[4] = { _mm_unpacklo_epi16 (lo, zero), _mm_unpackhi_epi16 (lo, zero), _mm_unpacklo_epi16 (hi, zero), _mm_unpackhi_epi16 (hi, zero) };
+		for (int j = 0; j < 4; j++) {
+			// Inclusive count of the new vertices up to each lane, negated as the comparison masks are -1. New vertices
+			// are never escaped, so the count does not wait for the escaped distances.
+			__m128i isNew = _mm_cmpeq_epi32 (d[j], zero);
+			__m128i count = _mm_add_epi32 (isNew, _mm_slli_si128 (isNew, 4));
+			count = _mm_add_epi32 (count, _mm_slli_si128 (count, 8));
+			__m128i laneNext = _mm_sub_epi32 (nextLanes, _mm_sub_epi32 (count, isNew));
+			invalid = _mm_or_si128 (invalid, _mm_cmpgt_epi32 (_mm_xor_si128 (d[j], sign), _mm_xor_si128 (laneNext, sign)));
+			_mm_storeu_si128 (reinterpret_cast<__m128i *> (indices + k + 4 * j), _mm_sub_epi32 (laneNext, d[j]));
+			nextLanes = _mm_sub_epi32 (nextLanes, _mm_shuffle_epi32 (count, 0xFF));
+		}
+		// The escaped indices were decoded with a distance of ESCAPE, the rest of the distance is subtracted from them
+		for (unsigned int escaped = _mm_movemask_epi8 (_mm_cmpeq_epi8 (bytes, escape)); escaped != 0; escaped &= escaped - 1) {
+			uint32_t extra;
+			size_t l = k + lowestBit (escaped);
+			if (!readEscape (extra) || extra > indices[l])
+				return false;
+			indices[l] -= extra;
+		}
+	}
+	if (_mm_movemask_epi8 (invalid))
+		return false;
+	next = static_cast<uint32_t> (_mm_cvtsi128_si32 (nextLanes));
+#endif
+	for (; k < numIndices; k++) {
+		uint32_t distance = distances[k], extra = 0;
+		if ((distance == ESCAPE && !readEscape (extra)) || (distance += extra) > next)
+			return false;
+		indices[k] = next - distance;
+		next += (distance == 0); // Branchless: new vertices are interleaved unpredictably with reused ones
+	}
+	return escapes == end && next <= numVertices; // Every index is below next
+}
+
+/// Converts numComponents interleaved xyz coordinates. Every lane of the SIMD path handles a single coordinate, the
+/// per-axis factors repeating every 3 vectors of 4 lanes.
+void dequantizePositions (const uint16_t * Q, float * P, size_t numComponents, const float offset[3], const float scale[3]) {
+	size_t i = 0;
+#ifdef MESH_CODEC_SSE2
+	const __m128 offsets[3] = { _mm_setr_ps (offset[0], offset[1], offset[2], offset[0]),
+								_mm_setr_ps (offset[1], offset[2], offset[0], offset[1]),
+								_mm_setr_ps (offset[2], offset[0], offset[1], offset[2]) };
+	const __m128 scales[3] = { _mm_setr_ps (scale[0], scale[1], scale[2], scale[0]),
+							   _mm_setr_ps (scale[1], scale[2], scale[0], scale[1]),
+							   _mm_setr_ps (scale[2], scale[0], scale[1], scale[2]) };
+	const __m128i zero = _mm_setzero_si128 ();
+	for (; i + 24 <= numComponents; i += 24) { // 8 vertices: 3 loads of 8 coordinates, 6 stores of 4
+		for (int k = 0; k < 3; k++) {
+			__m128i q = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (Q + i + 8 * k));
+			__m128 lo = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (q, zero));
+			__m128 hi = _mm_cvtepi32_ps (_mm_unpackhi_epi16 (q, zero));
+			int a = (2 * k) % 3;
+			int b = (2 * k + 1) % 3;
+			_mm_storeu_ps (P + i + 8 * k, _mm_add_ps (offsets[a], _mm_mul_ps (lo, scales[a])));
+			_mm_storeu_ps (P + i + 8 * k + 4, _mm_add_ps (offsets[b], _mm_mul_ps (hi, scales[b])));
+		}
+	}
+#endif
+	for (; i < numComponents; i++)
+		P[i] = offset[i % 3] + static_cast<float> (Q[i]) * scale[i % 3];
+}
+
+}
+
+void MeshCodec::encode (const std::string & filename, Mesh & mesh, const EncodeOptions & options) {
+	if (!isLittleEndianHost ())
+		throw std::ios_base::failure ("[Mesh Codec][encode] Big endian hosts are not supported");
+	if (options.positionBits < 8 || options.positionBits > 16)
+		throw std::ios_base::failure ("[Mesh Codec][encode] Position precision must range from 8 to 16 bits");
+	MeshOptimizer::optimizeVertexCache (mesh, options.cacheSize);
+	MeshOptimizer::optimizeVertexFetch (mesh);
+	const Mesh & constMesh = mesh;
+	const auto & P = constMesh.vertexPositions ();
+	const auto & T = constMesh.triangleIndices ();
+
+	FileHeader header;
+	std::memset (&header, 0, sizeof (FileHeader)); // Padding included, for reproducible files
+	std::memcpy (header.magic, MAGIC, sizeof (MAGIC));
+	header.version = VERSION;
+	header.headerSize = sizeof (FileHeader);
+	header.numVertices = P.size ();
+	header.numTriangles = T.size ();
+	header.positionBits = options.positionBits;
+	header.trianglesPerBlock = TRIANGLES_PER_BLOCK;
+	header.numBlocks = (T.size () + TRIANGLES_PER_BLOCK - 1) / TRIANGLES_PER_BLOCK;
+
+	// Quantization grid spanning the bounding box
+	glm::vec3 boxMin (std::numeric_limits<float>::max ());
+	glm::vec3 boxMax (-std::numeric_limits<float>::max ());
+	for (const auto & p : P) {
+		boxMin = glm::min (boxMin, p);
+		boxMax = glm::max (boxMax, p);
+	}
+	float maxQuantized = static_cast<float> ((1u << options.positionBits) - 1);
+	std::vector<uint16_t> Q (3 * P.size ());
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = P.empty () ? 0.f : boxMax[axis] - boxMin[axis];
+		header.positionOffset[axis] = P.empty () ? 0.f : boxMin[axis];
+		header.positionScale[axis] = extent > 0.f ? extent / maxQuantized : 0.f;
+		float toGrid = extent > 0.f ? maxQuantized / extent : 0.f;
+		for (size_t i = 0; i < P.size (); i++)
+			Q[3 * i + axis] = static_cast<uint16_t> (std::min (maxQuantized, std::round ((P[i][axis] - boxMin[axis]) * toGrid)));
+	}
+
+	// Next unseen vertex at the start of every block
+	std::vector<uint32_t> blockNextVertex (header.numBlocks, 0);
+	uint32_t next = 0;
+	for (size_t i = 0; i < T.size (); i++) {
+		if (i % TRIANGLES_PER_BLOCK == 0)
+			blockNextVertex[i / TRIANGLES_PER_BLOCK] = next;
+		for (int j = 0; j < 3; j++)
+			next = std::max (next, T[i][j] + 1);
+	}
+	std::vector<std::vector<uint8_t>> blocks (header.numBlocks);
+	Parallel::forEachTask (blocks.size (), [&] (size_t b) {
+		size_t first = b * TRIANGLES_PER_BLOCK;
+		size_t count = std::min<size_t> (TRIANGLES_PER_BLOCK, T.size () - first);
+		blocks[b].reserve (3 * count + 5);
+		encodeIndexBlock (T.data () + first, count, blockNextVertex[b], blocks[b]);
+	});
+	std::vector<uint64_t> blockOffsets (header.numBlocks + 1, 0);
+	for (size_t b = 0; b < blocks.size (); b++)
+		blockOffsets[b + 1] = blockOffsets[b] + blocks[b].size ();
+
+	std::vector<uint8_t> packedPositions;
+	packBits (Q, options.positionBits, packedPositions);
+	header.positionsOffset = sizeof (FileHeader);
+	header.blockOffsetsOffset = header.positionsOffset + packedPositions.size ();
+	header.indicesOffset = header.blockOffsetsOffset + sizeof (uint64_t) * blockOffsets.size ();
+	header.fileSize = header.indicesOffset + blockOffsets.back ();
+
+	std::ofstream out (filename.c_str (), std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::ios_base::failure ("[Mesh Codec][encode] Cannot create " + filename);
+	out.write (reinterpret_cast<const char *> (&header), sizeof (FileHeader));
+	out.write (reinterpret_cast<const char *> (packedPositions.data ()), static_cast<std::streamsize> (packedPositions.size ()));
+	out.write (reinterpret_cast<const char *> (blockOffsets.data ()), static_cast<std::streamsize> (sizeof (uint64_t) * blockOffsets.size ()));
+	for (const auto & block : blocks)
+		out.write (reinterpret_cast<const char *> (block.data ()), static_cast<std::streamsize> (block.size ()));
+	if (!out)
+		throw std::ios_base::failure ("[Mesh Codec][encode] Cannot write " + filename);
+}
+
+void MeshCodec::decode (const std::string & filename, std::shared_ptr<Mesh> meshPtr) {
+	if (!isLittleEndianHost ())
+		throw std::ios_base::failure ("[Mesh Codec][decode] Big endian hosts are not supported");
+	MappedFile file (filename);
+	FileHeader header;
+	if (file.size () < sizeof (FileHeader))
+		throw std::ios_base::failure ("[Mesh Codec][decode] Not a compressed mesh: " + filename);
+	std::memcpy (&header, file.data (), sizeof (FileHeader));
+	if (std::memcmp (header.magic, MAGIC, sizeof (MAGIC)) != 0 || header.headerSize != sizeof (FileHeader))
+		throw std::ios_base::failure ("[Mesh Codec][decode] Not a compressed mesh: " + filename);
+	if (header.version != VERSION)
+		throw std::ios_base::failure ("[Mesh Codec][decode] Unsupported version " + std::to_string (header.version) + " in " + filename);
+	uint64_t expectedBlocks = header.trianglesPerBlock ? (header.numTriangles + header.trianglesPerBlock - 1) / header.trianglesPerBlock : 0;
+	if (header.numVertices > std::numeric_limits<unsigned int>::max () || header.numTriangles > header.fileSize // At least a byte per triangle index
+		|| header.fileSize != file.size () || header.numBlocks != expectedBlocks || header.positionBits < 8 || header.positionBits > 16
+		|| header.positionsOffset < header.headerSize || header.positionsOffset % alignof (uint16_t) != 0 // 16-bit ones are read in place
+		|| header.positionsOffset > header.fileSize || header.blockOffsetsOffset > header.fileSize // The sums below cannot wrap
+		|| header.positionsOffset + packedSize (3 * header.numVertices, header.positionBits) > header.blockOffsetsOffset
+		|| header.blockOffsetsOffset + sizeof (uint64_t) * (header.numBlocks + 1) > header.indicesOffset
+		|| header.indicesOffset > header.fileSize)
+		throw std::ios_base::failure ("[Mesh Codec][decode] Corrupted header in " + filename);
+
+	std::vector<uint64_t> blockOffsets (header.numBlocks + 1);
+	std::memcpy (blockOffsets.data (), file.data () + header.blockOffsetsOffset, sizeof (uint64_t) * blockOffsets.size ());
+	for (size_t b = 0; b < header.numBlocks; b++)
+		if (blockOffsets[b] > blockOffsets[b + 1])
+			throw std::ios_base::failure ("[Mesh Codec][decode] Corrupted block table in " + filename);
+	if (blockOffsets.front () != 0 || header.indicesOffset + blockOffsets.back () != header.fileSize)
+		throw std::ios_base::failure ("[Mesh Codec][decode] Corrupted block table in " + filename);
+
+	meshPtr->clear ();
+	auto & P = meshPtr->vertexPositions ();
+	auto & T = meshPtr->triangleIndices ();
+	P.resize (header.numVertices);
+	T.resize (header.numTriangles);
+	// Positions and index blocks are independent: all of them are spread over the workers
+	const size_t verticesPerTask = 65536; // Multiple of 8, so that only the last task runs the scalar tail
+	size_t numPositionTasks = (header.numVertices + verticesPerTask - 1) / verticesPerTask;
+	const uint8_t * positions = reinterpret_cast<const uint8_t *> (file.data () + header.positionsOffset);
+	unsigned int bits = header.positionBits;
+	const uint8_t * indices = reinterpret_cast<const uint8_t *> (file.data () + header.indicesOffset);
+	std::atomic<bool> valid (true);
+	Parallel::forEachTask (numPositionTasks + header.numBlocks, [&] (size_t task) {
+		if (task < numPositionTasks) {
+			size_t first = task * verticesPerTask;
+			size_t count = std::min<size_t> (verticesPerTask, header.numVertices - first);
+			const uint8_t * stream = positions + packedSize (3 * first, bits); // Byte aligned, first being a multiple of 8
+			if (bits == 16) {
+				dequantizePositions (reinterpret_cast<const uint16_t *> (stream), &P[first][0], 3 * count, header.positionOffset, header.positionScale);
+				return;
+			}
+			// Unpacked by batches small enough to stay in the L1 cache, bits * 3 * 512 being a multiple of 8
+			uint16_t Q[3 * 512];
+			for (size_t i = 0; i < count; i += 512) {
+				size_t batch = std::min<size_t> (512, count - i);
+				unpackBits (stream + packedSize (3 * i, bits), 3 * batch, bits, Q);
+				dequantizePositions (Q, &P[first + i][0], 3 * batch, header.positionOffset, header.positionScale);
+			}
+		} else {
+			size_t b = task - numPositionTasks;
+			size_t first = b * header.trianglesPerBlock;
+			size_t count = std::min<size_t> (header.trianglesPerBlock, header.numTriangles - first);
+			if (!decodeIndexBlock (indices + blockOffsets[b], indices + blockOffsets[b + 1], T.data () + first, count, header.numVertices))
+				valid = false;
+		}
+	});
+	if (!valid) {
+		meshPtr->clear ();
+		throw std::ios_base::failure ("[Mesh Codec][decode] Corrupted index data in " + filename);
+	}
+}
+
+bool MeshCodec::readBounds (const std::string & filename, glm::vec3 & boxMin, glm::vec3 & boxMax) {
+	FileHeader header;
+	std::ifstream in (filename.c_str (), std::ios::binary);
+	if (!in.read (reinterpret_cast<char *> (&header), sizeof (FileHeader))
+		|| std::memcmp (header.magic, MAGIC, sizeof (MAGIC)) != 0 || header.version != VERSION || header.headerSize != sizeof (FileHeader)
+		|| header.positionBits < 1 || header.positionBits > 16)
+		return false;
+	float maxQuantized = static_cast<float> ((1u << header.positionBits) - 1);
+	for (int axis = 0; axis < 3; axis++) {
+		boxMin[axis] = header.positionOffset[axis];
+		boxMax[axis] = header.positionOffset[axis] + header.positionScale[axis] * maxQuantized;
+	}
+	return true;
+}
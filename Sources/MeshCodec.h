@@ -0,0 +1,39 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "Mesh.h"
+
+/// Compact on-disk mesh format (.qmesh), meant for distribution rather than as a cache:
+/// - positions quantized on a regular grid spanning the bounding box of the mesh, bit-packed at positionBits per
+///   coordinate;
+/// - triangles reordered for the vertex cache (see MeshOptimizer), vertices renumbered in order of first use, then
+///   each index coded as its distance back from the next unseen vertex, a byte per index with fixed-size escapes
+///   for the distances above 254, in independent blocks decoded in parallel (with SSE2 where available).
+/// Normals and texture coordinates are not stored, the loader computes them as for OFF files.
+/// Values are little endian.
+namespace MeshCodec {
+
+struct EncodeOptions {
+	unsigned int positionBits = 16; ///< Quantization precision of the positions, from 8 to 16 bits per coordinate
+	unsigned int cacheSize = 16; ///< Vertex cache size targeted by the triangle reordering
+};
+
+/// Writes the positions and triangles of a mesh. The mesh is reordered in place, so that it matches the decoded one
+/// up to the quantization error. Throws std::ios_base::failure on I/O errors.
+void encode (const std::string & filename, Mesh & mesh, const EncodeOptions & options = EncodeOptions ());
+
+/// Decodes a file written by encode into the positions and triangles of the mesh. Normals and texture coordinates are
+/// left empty. Throws std::ios_base::failure if the file cannot be read or is invalid.
+void decode (const std::string & filename, std::shared_ptr<Mesh> meshPtr);
+
+/// Reads the bounding box of the quantization grid from the header of a file written by encode. Returns false if the
+/// file cannot be read or is not a compressed mesh.
+bool readBounds (const std::string & filename, glm::vec3 & boxMin, glm::vec3 & boxMax);
+
+}
+
+#endif // MESH_CODEC_H
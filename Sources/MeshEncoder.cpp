@@ -0,0 +1,142 @@
+// ----------------------------------------------
+// Command line tool converting mesh files to the compressed .qmesh format (see MeshCodec.h),
+// reporting the compression ratio and decoding speed of every converted model.
+// ----------------------------------------------
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "MeshCodec.h"
+#include "Parallel.h"
+
+using namespace std;
+
+static const int NUM_TIMING_RUNS = 5;
+
+void usage (const char * command) {
+	std::cerr << "Usage : " << command << " [--bits <8-16>] [--threads <n>] <model>..." << std::endl
+			  << "        Writes <model>.qmesh next to every model (.off, .ply, .glb)" << std::endl;
+	std::exit (EXIT_FAILURE);
+}
+
+/// Best of several runs, in seconds
+template<typename Func>
+double bestTime (Func func) {
+	double best = 0.0;
+	for (int i = 0; i < NUM_TIMING_RUNS; i++) {
+		auto start = std::chrono::steady_clock::now ();
+		func ();
+		double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+		best = (i == 0) ? seconds : std::min (best, seconds);
+	}
+	return best;
+}
+
+/// Time to read the uncompressed arrays back from a raw binary file, as a reference for the decoder
+double rawReadTime (const std::string & filename, const Mesh & mesh) {
+	const auto & P = mesh.vertexPositions ();
+	const auto & T = mesh.triangleIndices ();
+	{
+		std::ofstream out (filename.c_str (), std::ios::binary | std::ios::trunc);
+		out.write (reinterpret_cast<const char *> (P.data ()), sizeof (glm::vec3) * P.size ());
+		out.write (reinterpret_cast<const char *> (T.data ()), sizeof (glm::uvec3) * T.size ());
+		if (!out)
+			throw std::ios_base::failure ("Cannot write " + filename);
+	}
+	std::vector<glm::vec3> readP (P.size ());
+	std::vector<glm::uvec3> readT (T.size ());
+	double seconds = bestTime ([&] () {
+		std::ifstream in (filename.c_str (), std::ios::binary);
+		in.read (reinterpret_cast<char *> (readP.data ()), sizeof (glm::vec3) * readP.size ());
+		in.read (reinterpret_cast<char *> (readT.data ()), sizeof (glm::uvec3) * readT.size ());
+	});
+	std::error_code error;
+	std::filesystem::remove (filename, error);
+	return seconds;
+}
+
+void encodeModel (const std::string & filename, const MeshCodec::EncodeOptions & options) {
+	MeshLoader::LoadOptions loadOptions;
+	loadOptions.useCache = false;
+	auto sourcePtr = std::make_shared<Mesh> ();
+	MeshLoader::load (filename, sourcePtr, loadOptions);
+	std::string outFilename = std::filesystem::path (filename).replace_extension (".qmesh").string ();
+	auto start = std::chrono::steady_clock::now ();
+	MeshCodec::encode (outFilename, *sourcePtr, options);
+	double encodeSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+	auto decodedPtr = std::make_shared<Mesh> ();
+	double decodeSeconds = bestTime ([&] () { MeshCodec::decode (outFilename, decodedPtr); });
+	double rawSeconds = rawReadTime (outFilename + ".raw", *sourcePtr);
+
+	const Mesh & source = *sourcePtr;
+	const Mesh & decoded = *decodedPtr;
+	if (decoded.triangleIndices () != source.triangleIndices ())
+		throw std::runtime_error ("Decoded triangles differ from the source");
+	glm::vec3 boxMin (std::numeric_limits<float>::max ());
+	glm::vec3 boxMax (-std::numeric_limits<float>::max ());
+	float maxError = 0.f;
+	for (size_t i = 0; i < source.vertexPositions ().size (); i++) {
+		const glm::vec3 & p = source.vertexPositions ()[i];
+		boxMin = glm::min (boxMin, p);
+		boxMax = glm::max (boxMax, p);
+		maxError = std::max (maxError, glm::length (p - decoded.vertexPositions ()[i]));
+	}
+	float diagonal = source.vertexPositions ().empty () ? 0.f : glm::length (boxMax - boxMin);
+
+	double megaByte = 1024.0 * 1024.0;
+	size_t sourceSize = std::filesystem::file_size (filename);
+	size_t encodedSize = std::filesystem::file_size (outFilename);
+	size_t rawSize = sizeof (glm::vec3) * source.vertexPositions ().size () + sizeof (glm::uvec3) * source.triangleIndices ().size ();
+	std::cout << std::fixed << std::setprecision (2)
+			  << " > [Encoder] <" << filename << "> -> <" << outFilename << ">" << std::endl
+			  << "     " << source.vertexPositions ().size () << " vertices, " << source.triangleIndices ().size () << " triangles, encoded in " << encodeSeconds * 1000.0 << " ms" << std::endl
+			  << "     Size: " << sourceSize / megaByte << " MB source, " << rawSize / megaByte << " MB raw arrays, " << encodedSize / megaByte << " MB compressed" << std::endl
+			  << "     Ratio: " << static_cast<double> (sourceSize) / encodedSize << "x source, " << static_cast<double> (rawSize) / encodedSize << "x raw arrays ("
+			  << 8.0 * encodedSize / std::max<size_t> (source.triangleIndices ().size (), 1) << " bits per triangle)" << std::endl
+			  << "     Decode: " << decodeSeconds * 1000.0 << " ms (" << rawSize / megaByte / decodeSeconds << " MB/s of raw arrays), raw array read: " << rawSeconds * 1000.0 << " ms" << std::endl
+			  << std::scientific << std::setprecision (3)
+			  << "     Max position error: " << (diagonal > 0.f ? maxError / diagonal : 0.f) << " of the bounding box diagonal" << std::endl
+			  << std::defaultfloat;
+}
+
+int main (int argc, char ** argv) {
+	MeshCodec::EncodeOptions options;
+	std::vector<std::string> filenames;
+	for (int i = 1; i < argc; i++) {
+		std::string arg (argv[i]);
+		if (arg == "--bits" && i + 1 < argc) {
+			options.positionBits = static_cast<unsigned int> (std::atoi (argv[++i]));
+		} else if (arg == "--threads" && i + 1 < argc) {
+			Parallel::setNumThreads (static_cast<unsigned int> (std::atoi (argv[++i])));
+		} else if (arg.compare (0, 2, "--") != 0) {
+			filenames.push_back (arg);
+		} else
+			usage (argv[0]);
+	}
+	if (filenames.empty ())
+		usage (argv[0]);
+	int status = EXIT_SUCCESS;
+	for (const auto & filename : filenames) {
+		try {
+			encodeModel (filename, options);
+		} catch (std::exception & e) {
+			std::cerr << " > [Encoder] Failed on <" << filename << ">: " << e.what () << std::endl;
+			status = EXIT_FAILURE;
+		}
+	}
+	return status;
+}
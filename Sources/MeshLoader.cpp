@@ -1,18 +1,112 @@
 #include "MeshLoader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "MeshCache.h"
+#include "MeshCodec.h"
+#include "MeshOptimizer.h"
+#include "AmbientOcclusion.h"
 
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <exception>
 #include <ios>
+#include <charconv>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <sstream>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
 
 using namespace std;
 
-void MeshLoader::loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr) {
-	std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
-    meshPtr->clear ();
+namespace {
+
+/// In-place tokenizer over the bytes of an OFF file. Comments start with '#' and run to the end of the line.
+class OFFScanner {
+public:
+	OFFScanner (const char * begin, const char * end) : m_cur (begin), m_end (end) {}
+
+	inline const char * position () const { return m_cur; }
+
+	inline void skipBlanks () {
+		while (m_cur < m_end) {
+			char c = *m_cur;
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+				m_cur++;
+			else if (c == '#')
+				skipLine ();
+			else
+				break;
+		}
+	}
+
+	/// True when only blanks or a comment remain on the current line
+	inline bool atLineEnd () {
+		while (m_cur < m_end && (*m_cur == ' ' || *m_cur == '\t' || *m_cur == '\r'))
+			m_cur++;
+		return m_cur == m_end || *m_cur == '\n' || *m_cur == '#';
+	}
+
+	/// Moves right after the next end of line
+	inline void skipLine () {
+		while (m_cur < m_end && *m_cur != '\n')
+			m_cur++;
+		if (m_cur < m_end)
+			m_cur++;
+	}
+
+	inline std::string readWord () {
+		skipBlanks ();
+		const char * start = m_cur;
+		while (m_cur < m_end && *m_cur != ' ' && *m_cur != '\t' && *m_cur != '\r' && *m_cur != '\n')
+			m_cur++;
+		return std::string (start, m_cur);
+	}
+
+	inline bool readUInt (unsigned int & value) {
+		skipBlanks ();
+		auto result = std::from_chars (m_cur, m_end, value);
+		m_cur = result.ptr;
+		return result.ec == std::errc ();
+	}
+
+	inline bool readFloat (float & value) {
+		skipBlanks ();
+		if (m_cur < m_end && *m_cur == '+') // Not accepted by from_chars, but valid for istream
+			m_cur++;
+		auto result = std::from_chars (m_cur, m_end, value);
+		m_cur = result.ptr;
+		return result.ec == std::errc ();
+	}
+
+private:
+	const char * m_cur;
+	const char * m_end;
+};
+
+void reportThroughput (const std::string & parserName, size_t numBytes, std::chrono::steady_clock::duration duration) {
+	double seconds = std::chrono::duration<double> (duration).count ();
+	double megaBytes = numBytes / (1024.0 * 1024.0);
+	std::cout << " > [" << parserName << " parser] " << std::fixed << std::setprecision (2)
+			  << megaBytes << " MB in " << seconds * 1000.0 << " ms ("
+			  << (seconds > 0.0 ? megaBytes / seconds : 0.0) << " MB/s)" << std::defaultfloat << std::endl;
+}
+
+void parseOFFStream (const std::string & filename, std::shared_ptr<Mesh> meshPtr) {
 	ifstream in (filename.c_str ());
     if (!in)
         throw std::ios_base::failure ("[Mesh Loader][loadOFF] Cannot open " + filename);
+    in.seekg (0, std::ios::end);
+    size_t numBytes = static_cast<size_t> (in.tellg ());
+    in.seekg (0, std::ios::beg);
+    auto start = std::chrono::steady_clock::now ();
 	string offString;
     unsigned int sizeV, sizeT, tmp;
     in >> offString >> sizeV >> sizeT >> tmp;
@@ -20,7 +114,7 @@ void MeshLoader::loadOFF (const std::string & filename, std::shared_ptr<Mesh> me
     auto & T = meshPtr->triangleIndices ();
     P.resize (sizeV);
     T.resize (sizeT);
-    size_t tracker = (sizeV + sizeT)/20;
+    size_t tracker = std::max<size_t> ((sizeV + sizeT)/20, 1);
     std::cout << " > [" << std::flush;
     for (unsigned int i = 0; i < sizeV; i++) {
     	if (i % tracker == 0)
@@ -37,9 +131,1297 @@ void MeshLoader::loadOFF (const std::string & filename, std::shared_ptr<Mesh> me
     }
     std::cout << "]" << std::endl;
     in.close ();
-    meshPtr->vertexNormals ().resize (P.size (), glm::vec3 (0.f, 0.f, 1.f));
-    meshPtr->vertexTexCoords ().resize (P.size (), glm::vec2 (0.f, 0.f));
-    meshPtr->recomputePerVertexNormals ();
-		meshPtr->computePlanarParameterization();
-    std::cout << " > Mesh <" << filename << "> loaded" <<  std::endl;
+    reportThroughput ("Stream", numBytes, std::chrono::steady_clock::now () - start);
+}
+
+/// Values of a vertex in the [ST][C][N][4]OFF variants: x y z [w] [nx ny nz] [r g b a] [s t], of which only the position is read
+struct OFFVertexLayout {
+	bool homogeneous = false;
+	unsigned int numIgnoredValues = 0;
+};
+
+/// Reads the OFF keyword and the element counts, leaving the scanner at the beginning of the vertex block.
+void parseOFFHeader (OFFScanner & scanner, const std::string & filename, unsigned int & sizeV, unsigned int & sizeT, OFFVertexLayout & layout) {
+	std::string keyword = scanner.readWord ();
+	size_t prefixSize = keyword.rfind ("OFF");
+	if (prefixSize == std::string::npos || prefixSize + 3 != keyword.size ())
+		throw std::ios_base::failure ("[Mesh Loader][loadOFF] Missing OFF header in " + filename);
+	std::string prefix = keyword.substr (0, prefixSize);
+	if (prefix.compare (0, 2, "ST") == 0) {
+		layout.numIgnoredValues += 2;
+		prefix.erase (0, 2);
+	}
+	if (!prefix.empty () && prefix[0] == 'C') {
+		layout.numIgnoredValues += 4;
+		prefix.erase (0, 1);
+	}
+	if (!prefix.empty () && prefix[0] == 'N') {
+		layout.numIgnoredValues += 3;
+		prefix.erase (0, 1);
+	}
+	if (!prefix.empty () && prefix[0] == '4') {
+		layout.homogeneous = true;
+		prefix.erase (0, 1);
+	}
+	if (!prefix.empty ())
+		throw std::ios_base::failure ("[Mesh Loader][loadOFF] Unsupported " + keyword + " variant in " + filename);
+	unsigned int sizeE;
+	if (!scanner.readUInt (sizeV) || !scanner.readUInt (sizeT) || !scanner.readUInt (sizeE))
+		throw std::ios_base::failure ("[Mesh Loader][loadOFF] Invalid element counts in " + filename);
+}
+
+/// Reads the values of a vertex, which may span several lines or share one with other vertices
+inline bool readOFFVertex (OFFScanner & scanner, const OFFVertexLayout & layout, glm::vec3 & p) {
+	if (!scanner.readFloat (p[0]) || !scanner.readFloat (p[1]) || !scanner.readFloat (p[2]))
+		return false;
+	float value;
+	if (layout.homogeneous) {
+		if (!scanner.readFloat (value) || value == 0.f)
+			return false;
+		p /= value;
+	}
+	for (unsigned int i = 0; i < layout.numIgnoredValues; i++)
+		if (!scanner.readFloat (value))
+			return false;
+	return true;
+}
+
+/// Reads the vertex count and indices of a face, keeping the first triangle of polygons. The optional color of the
+/// face runs to the end of the line of its last index, and is skipped.
+inline bool readOFFFace (OFFScanner & scanner, size_t sizeV, glm::uvec3 & t) {
+	unsigned int s, index;
+	if (!scanner.readUInt (s) || s < 3 || !scanner.readUInt (t[0]) || !scanner.readUInt (t[1]) || !scanner.readUInt (t[2]))
+		return false;
+	for (unsigned int i = 3; i < s; i++)
+		if (!scanner.readUInt (index))
+			return false;
+	scanner.skipLine ();
+	return t[0] < sizeV && t[1] < sizeV && t[2] < sizeV;
+}
+
+/// Output of the mapped parsers: raw destination arrays, and a notification of the elements written so far.
+/// Elements are numbered as in the file, vertices first and faces next.
+struct OFFTarget {
+	OFFVertexLayout layout;
+	glm::vec3 * positions = nullptr;
+	size_t numVertices = 0;
+	glm::uvec3 * triangles = nullptr;
+	size_t numTriangles = 0;
+	std::function<void (size_t firstElement, size_t numElements)> onWritten;
+};
+
+void parseOFFBodySerial (OFFScanner & scanner, const std::string & filename, const OFFTarget & target) {
+	const size_t notificationPeriod = 64 * 1024;
+	glm::vec3 * P = target.positions;
+	glm::uvec3 * T = target.triangles;
+	size_t sizeV = target.numVertices;
+	for (size_t i = 0; i < sizeV; i++) {
+		if (!readOFFVertex (scanner, target.layout, P[i]))
+			throw std::ios_base::failure ("[Mesh Loader][loadOFF] Invalid vertex " + std::to_string (i) + " in " + filename);
+		if (target.onWritten && (i + 1) % notificationPeriod == 0)
+			target.onWritten (i + 1 - notificationPeriod, notificationPeriod);
+	}
+	if (target.onWritten)
+		target.onWritten (sizeV - sizeV % notificationPeriod, sizeV % notificationPeriod);
+	for (size_t i = 0; i < target.numTriangles; i++) {
+		if (!readOFFFace (scanner, sizeV, T[i]))
+			throw std::ios_base::failure ("[Mesh Loader][loadOFF] Invalid face " + std::to_string (i) + " in " + filename);
+		if (target.onWritten && (i + 1) % notificationPeriod == 0)
+			target.onWritten (sizeV + i + 1 - notificationPeriod, notificationPeriod);
+	}
+	if (target.onWritten)
+		target.onWritten (sizeV + target.numTriangles - target.numTriangles % notificationPeriod, target.numTriangles % notificationPeriod);
+}
+
+/// A line holds an element unless it is blank or a comment
+inline bool isRecordLine (const char * line, const char * lineEnd) {
+	while (line < lineEnd && (*line == ' ' || *line == '\t' || *line == '\r'))
+		line++;
+	return line < lineEnd && *line != '#';
+}
+
+inline const char * findLineEnd (const char * p, const char * end) {
+	const char * eol = static_cast<const char *> (std::memchr (p, '\n', end - p));
+	return eol ? eol : end;
+}
+
+/// Parses the vertex and face blocks laid out with one element per line, split in newline-aligned chunks processed concurrently.
+/// A first pass counts the element lines of every chunk; their prefix sum gives each chunk its first output slot.
+/// Returns false on malformed input, leaving the serial parser to report the precise error. Every chunk is notified as
+/// soon as it and the ones before it are parsed, so that the notified elements always form a prefix, numNotified long.
+bool parseOFFBodyParallel (const char * bodyBegin, const char * bodyEnd, const OFFTarget & target, size_t & numNotified) {
+	glm::vec3 * P = target.positions;
+	glm::uvec3 * T = target.triangles;
+	size_t sizeV = target.numVertices;
+	size_t numElements = sizeV + target.numTriangles;
+	size_t numBytes = bodyEnd - bodyBegin;
+	size_t numChunks = std::max<size_t> (1, std::min<size_t> (4 * Parallel::numThreads (), numBytes / (64 * 1024)));
+	std::vector<const char *> chunkBegins (numChunks + 1, bodyEnd);
+	chunkBegins[0] = bodyBegin;
+	for (size_t i = 1; i < numChunks; i++) {
+		const char * p = std::max (bodyBegin + i * numBytes / numChunks, chunkBegins[i-1]);
+		chunkBegins[i] = p < bodyEnd ? std::min (findLineEnd (p, bodyEnd) + 1, bodyEnd) : bodyEnd;
+	}
+
+	std::vector<size_t> chunkFirstElement (numChunks + 1, 0);
+	Parallel::forEachTask (numChunks, [&] (size_t c) {
+		size_t count = 0;
+		for (const char * line = chunkBegins[c]; line < chunkBegins[c+1]; ) {
+			const char * lineEnd = findLineEnd (line, chunkBegins[c+1]);
+			if (isRecordLine (line, lineEnd))
+				count++;
+			line = lineEnd + 1;
+		}
+		chunkFirstElement[c+1] = count;
+	});
+	for (size_t c = 0; c < numChunks; c++)
+		chunkFirstElement[c+1] += chunkFirstElement[c];
+	if (chunkFirstElement[numChunks] < numElements)
+		return false;
+
+	std::atomic<bool> valid (true);
+	std::vector<size_t> chunkEndElement (numChunks, 0);
+	std::vector<bool> chunkParsed (numChunks, false);
+	size_t numNotifiedChunks = 0;
+	std::mutex notificationMutex;
+	Parallel::forEachTask (numChunks, [&] (size_t c) {
+		size_t element = chunkFirstElement[c];
+		for (const char * line = chunkBegins[c]; line < chunkBegins[c+1] && element < numElements && valid; ) {
+			const char * lineEnd = findLineEnd (line, chunkBegins[c+1]);
+			if (isRecordLine (line, lineEnd)) {
+				OFFScanner scanner (line, lineEnd);
+				if (element < sizeV) {
+					if (!readOFFVertex (scanner, target.layout, P[element]) || !scanner.atLineEnd ())
+						valid = false; // Vertices spanning or sharing lines, left to the serial parser
+				} else if (!readOFFFace (scanner, sizeV, T[element - sizeV]))
+					valid = false;
+				element++;
+			}
+			line = lineEnd + 1;
+		}
+		if (!valid || !target.onWritten)
+			return;
+		std::lock_guard<std::mutex> lock (notificationMutex);
+		chunkEndElement[c] = std::min (element, numElements);
+		chunkParsed[c] = true;
+		for (; numNotifiedChunks < numChunks && chunkParsed[numNotifiedChunks] && valid; numNotifiedChunks++) {
+			size_t first = std::min (chunkFirstElement[numNotifiedChunks], numElements);
+			target.onWritten (first, chunkEndElement[numNotifiedChunks] - first);
+			numNotified = chunkEndElement[numNotifiedChunks];
+		}
+	});
+	return valid;
+}
+
+/// Decodes a mapped OFF file into the target returned by allocate, called with the element counts read in the header.
+void parseOFFMapped (const std::string & filename, std::function<OFFTarget (size_t sizeV, size_t sizeT)> allocate, bool parallel) {
+	MappedFile file (filename);
+	auto start = std::chrono::steady_clock::now ();
+	OFFScanner scanner (file.begin (), file.end ());
+	unsigned int sizeV, sizeT;
+	OFFVertexLayout layout;
+	parseOFFHeader (scanner, filename, sizeV, sizeT, layout);
+	OFFTarget target = allocate (sizeV, sizeT);
+	target.layout = layout;
+	size_t numNotified = 0;
+	if (parallel && parseOFFBodyParallel (scanner.position (), file.end (), target, numNotified)) {
+		reportThroughput ("Parallel x" + std::to_string (Parallel::numThreads ()), file.size (), std::chrono::steady_clock::now () - start);
+		return;
+	}
+	if (numNotified > 0) {
+		// The prefix notified before the parallel parser gave up is identical in the serial output, and not notified again
+		auto onWritten = target.onWritten;
+		target.onWritten = [onWritten, numNotified] (size_t firstElement, size_t numElements) {
+			size_t first = std::max (firstElement, numNotified);
+			if (first < firstElement + numElements)
+				onWritten (first, firstElement + numElements - first);
+		};
+	}
+	parseOFFBodySerial (scanner, filename, target);
+	reportThroughput ("Mapped", file.size (), std::chrono::steady_clock::now () - start);
+}
+
+
+/// Merges the duplicated vertices of a freshly parsed mesh, see LoadOptions::weldEpsilon
+void weld (std::shared_ptr<Mesh> meshPtr, float relativeEpsilon) {
+	auto start = std::chrono::steady_clock::now ();
+	const Mesh & mesh = *meshPtr;
+	glm::vec3 boxMin (std::numeric_limits<float>::max ());
+	glm::vec3 boxMax (-std::numeric_limits<float>::max ());
+	for (const auto & p : mesh.vertexPositions ()) {
+		boxMin = glm::min (boxMin, p);
+		boxMax = glm::max (boxMax, p);
+	}
+	size_t numVertices = mesh.vertexPositions ().size ();
+	float epsilon = numVertices > 0 ? relativeEpsilon * glm::length (boxMax - boxMin) : 0.f;
+	MeshOptimizer::WeldReport report = MeshOptimizer::weldVertices (*meshPtr, epsilon);
+	double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	std::cout << " > [Weld] " << report.removedVertices << " of " << numVertices << " vertices merged, "
+			  << report.removedTriangles << " degenerate triangles removed, " << std::fixed << std::setprecision (2)
+			  << report.savedBytes / (1024.0 * 1024.0) << " MB saved, in " << seconds * 1000.0 << " ms" << std::defaultfloat << std::endl;
+}
+
+/// The cluster hierarchy replaces the discrete levels of detail when rendering, which are then not built at all
+inline bool buildsLevelsOfDetail (const MeshLoader::LoadOptions & options) {
+	return options.buildLevelsOfDetail && !(options.buildMeshlets && options.buildClusterHierarchy);
+}
+
+/// Reorders the triangles then the vertices of a freshly parsed mesh for the GPU, see LoadOptions::optimizeIndices,
+/// LoadOptions::buildMeshlets, LoadOptions::buildLevelsOfDetail and LoadOptions::buildClusterHierarchy
+void optimizeIndices (std::shared_ptr<Mesh> meshPtr, const MeshLoader::LoadOptions & options) {
+	auto start = std::chrono::steady_clock::now ();
+	MeshOptimizer::VertexCacheStatistics before = MeshOptimizer::analyzeVertexCache (*meshPtr);
+	if (options.optimizeIndices) {
+		MeshOptimizer::optimizeVertexCache (*meshPtr);
+		MeshOptimizer::optimizeOverdraw (*meshPtr);
+	}
+	if (options.buildMeshlets) {
+		MeshOptimizer::MeshletReport report = MeshOptimizer::buildMeshlets (*meshPtr);
+		std::cout << " > [Meshlets] " << report.numMeshlets << " meshlets of " << std::fixed << std::setprecision (1)
+				  << report.averageNumVertices << " vertices and " << report.averageNumTriangles << " triangles on average, "
+				  << report.numConeCullable << " back-face cullable" << std::defaultfloat << std::endl;
+	}
+	if (buildsLevelsOfDetail (options)) {
+		auto lodStart = std::chrono::steady_clock::now ();
+		MeshOptimizer::LevelOfDetailReport report = MeshOptimizer::buildLevelsOfDetail (*meshPtr);
+		double lodSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - lodStart).count ();
+		std::cout << " > [LOD] " << report.numLevels << " levels of";
+		for (const LevelOfDetail & level : static_cast<const Mesh &> (*meshPtr).levelsOfDetail ())
+			std::cout << " " << level.numTriangles;
+		float radius = meshPtr->bounds ().sphereRadius;
+		std::cout << " triangles, max error " << std::fixed << std::setprecision (2) << (radius > 0.f ? 100.f * report.maxError / radius : 0.f)
+				  << "% of the radius, in " << lodSeconds * 1000.0 << " ms" << std::defaultfloat << std::endl;
+	}
+	if (options.buildMeshlets && options.buildClusterHierarchy) {
+		auto hierarchyStart = std::chrono::steady_clock::now ();
+		MeshOptimizer::ClusterHierarchyReport report = MeshOptimizer::buildClusterHierarchy (*meshPtr);
+		double hierarchySeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - hierarchyStart).count ();
+		std::cout << " > [Hierarchy] " << report.numClusters << " clusters in " << report.numLevels << " levels, "
+				  << report.numRoots << " roots, " << report.numTriangles << " simplified triangles, in " << std::fixed
+				  << std::setprecision (2) << hierarchySeconds * 1000.0 << " ms" << std::defaultfloat << std::endl;
+	}
+	MeshOptimizer::optimizeVertexFetch (*meshPtr);
+	double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	MeshOptimizer::VertexCacheStatistics after = MeshOptimizer::analyzeVertexCache (*meshPtr);
+	std::cout << " > [Optimizer] ACMR " << std::fixed << std::setprecision (3) << before.acmr << " -> " << after.acmr
+			  << ", ATVR " << before.atvr << " -> " << after.atvr << ", in " << std::setprecision (2) << seconds * 1000.0 << " ms"
+			  << std::defaultfloat << std::endl;
+}
+
+/// Identifies the load-time processing in the binary cache, so that changing it invalidates the cache
+uint64_t processingKey (const MeshLoader::LoadOptions & options) {
+	uint64_t key = (options.optimizeIndices ? 1ull << 33 : 0) | (options.buildMeshlets ? 1ull << 34 : 0)
+				 | (buildsLevelsOfDetail (options) ? 1ull << 35 : 0) | (options.buildMeshlets && options.buildClusterHierarchy ? 1ull << 36 : 0)
+				 | (options.generateTexCoords ? 1ull << 37 : 0);
+	if (options.weldEpsilon < 0.f)
+		return key;
+	uint32_t bits;
+	std::memcpy (&bits, &options.weldEpsilon, sizeof (bits));
+	return key | (1ull << 32) | bits;
+}
+
+/// Lets a mesh whose CPU-side copy is released after upload read it back from its binary cache
+void setCacheReloadSource (const std::string & filename, std::shared_ptr<Mesh> meshPtr, uint64_t key) {
+	meshPtr->setReloadSource ([filename, key] () {
+		auto cachedPtr = std::make_shared<Mesh> ();
+		return MeshCache::load (filename, cachedPtr, key) ? cachedPtr : std::shared_ptr<Mesh> ();
+	});
+}
+
+/// Reads the per-vertex ambient occlusion of a complete mesh from its cache when up to date, bakes it otherwise, see
+/// LoadOptions::ambientOcclusionRays
+void computeAmbientOcclusion (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const MeshLoader::LoadOptions & options) {
+	const Mesh & mesh = *meshPtr;
+	size_t numVertices = mesh.numVertices (); // Read from the cache, the vectors are only filled if the bake needs them
+	bool hasNormals = mesh.uploadSource ().normals || mesh.vertexNormals ().size () == numVertices;
+	if (options.ambientOcclusionRays == 0 || !options.computeMissingAttributes || numVertices == 0 || !hasNormals)
+		return;
+	AmbientOcclusion::BakeOptions bakeOptions;
+	bakeOptions.numRays = options.ambientOcclusionRays;
+	std::vector<float> ambientOcclusion;
+	if (options.useCache && AmbientOcclusion::loadCache (filename, mesh, bakeOptions, ambientOcclusion)) {
+		meshPtr->vertexAmbientOcclusion ().swap (ambientOcclusion);
+		return;
+	}
+	std::shared_ptr<const MeshBVH> bvhPtr = mesh.bvh ();
+	if (!bvhPtr)
+		return;
+	auto start = std::chrono::steady_clock::now ();
+	ambientOcclusion.resize (numVertices);
+	AmbientOcclusion::bake (*bvhPtr, mesh.vertexPositions ().data (), mesh.vertexNormals ().data (), numVertices, mesh.bounds ().sphereRadius,
+							ambientOcclusion.data (), bakeOptions);
+	double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	std::cout << " > [AO] " << numVertices << " vertices, " << bakeOptions.numRays << " rays each, baked in " << std::fixed
+			  << std::setprecision (2) << seconds * 1000.0 << " ms (" << std::setprecision (1)
+			  << numVertices * bakeOptions.numRays / std::max (seconds, 1e-9) * 1e-6 << " Mrays/s)" << std::defaultfloat << std::endl;
+	if (options.useCache) {
+		try {
+			AmbientOcclusion::saveCache (filename, mesh, bakeOptions, ambientOcclusion);
+		} catch (std::exception & e) {
+			std::cerr << " > [AO] " << e.what () << std::endl; // Not critical, the next launch bakes again
+		}
+	}
+	meshPtr->vertexAmbientOcclusion ().swap (ambientOcclusion);
+}
+
+/// Shared by every file format: reads the binary cache of the file when it is up to date. Otherwise parses the source,
+/// computes the attributes the file does not provide (normals, texture coordinates) and refreshes the cache. Either way,
+/// the ambient occlusion comes last, from a cache of its own.
+void loadWithCache (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const MeshLoader::LoadOptions & options, std::function<void ()> parse) {
+	std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
+	meshPtr->clear ();
+	if (options.useCache && MeshCache::load (filename, meshPtr, processingKey (options))) {
+		setCacheReloadSource (filename, meshPtr, processingKey (options));
+		computeAmbientOcclusion (filename, meshPtr, options);
+		std::cout << " > Mesh <" << filename << "> loaded" << std::endl;
+		return;
+	}
+	parse ();
+	if (options.weldEpsilon >= 0.f)
+		weld (meshPtr, options.weldEpsilon);
+	if (options.optimizeIndices || options.buildMeshlets || options.buildLevelsOfDetail)
+		optimizeIndices (meshPtr, options);
+	if (!options.computeMissingAttributes) {
+		std::cout << " > Mesh <" << filename << "> loaded" << std::endl;
+		return; // Incomplete mesh, not cached
+	}
+	// Checked on the upload source first, if any, which is only copied into the vectors when they are written
+	const Mesh & mesh = *meshPtr;
+	size_t numVertices = mesh.numVertices ();
+	bool hasNormals = mesh.uploadSource ().normals || mesh.vertexNormals ().size () == numVertices;
+	bool hasTexCoords = mesh.uploadSource ().texCoords || mesh.vertexTexCoords ().size () == numVertices;
+	if (!hasNormals) {
+		meshPtr->vertexNormals ().resize (numVertices, glm::vec3 (0.f, 0.f, 1.f));
+		meshPtr->recomputePerVertexNormals ();
+	}
+	if (!hasTexCoords && options.generateTexCoords)
+		meshPtr->vertexTexCoords ().clear (); // Generated by the vertex shader
+	else if (!hasTexCoords) {
+		meshPtr->vertexTexCoords ().resize (numVertices, glm::vec2 (0.f, 0.f));
+		meshPtr->computePlanarParameterization ();
+	}
+	if (options.useCache) {
+		try {
+			MeshCache::save (filename, *meshPtr, processingKey (options));
+			setCacheReloadSource (filename, meshPtr, processingKey (options));
+		} catch (std::exception & e) {
+			std::cerr << " > [Cache] " << e.what () << std::endl; // Not critical, the next launch parses the source again
+		}
+	}
+	computeAmbientOcclusion (filename, meshPtr, options);
+	std::cout << " > Mesh <" << filename << "> loaded" << std::endl;
+}
+
+// ---------------------------------------------------------------------------
+// PLY. See http://paulbourke.net/dataformats/ply/
+// ---------------------------------------------------------------------------
+
+enum class PLYType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+PLYType parsePLYType (const std::string & name) {
+	if (name == "char" || name == "int8") return PLYType::Int8;
+	if (name == "uchar" || name == "uint8") return PLYType::UInt8;
+	if (name == "short" || name == "int16") return PLYType::Int16;
+	if (name == "ushort" || name == "uint16") return PLYType::UInt16;
+	if (name == "int" || name == "int32") return PLYType::Int32;
+	if (name == "uint" || name == "uint32") return PLYType::UInt32;
+	if (name == "float" || name == "float32") return PLYType::Float32;
+	if (name == "double" || name == "float64") return PLYType::Float64;
+	return PLYType::Invalid;
+}
+
+inline size_t plyTypeSize (PLYType type) {
+	static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+	return sizes[static_cast<int> (type)];
+}
+
+inline bool isLittleEndianHost () {
+	const uint16_t one = 1;
+	return *reinterpret_cast<const uint8_t *> (&one) == 1;
+}
+
+/// Decodes a scalar of the given type, reversing its bytes when the file and host byte orders differ
+inline double readPLYValue (const char * data, PLYType type, bool swap) {
+	char bytes[8];
+	size_t size = plyTypeSize (type);
+	if (swap)
+		std::reverse_copy (data, data + size, bytes);
+	else
+		std::memcpy (bytes, data, size);
+	switch (type) {
+		case PLYType::Int8: { int8_t v; std::memcpy (&v, bytes, 1); return v; }
+		case PLYType::UInt8: { uint8_t v; std::memcpy (&v, bytes, 1); return v; }
+		case PLYType::Int16: { int16_t v; std::memcpy (&v, bytes, 2); return v; }
+		case PLYType::UInt16: { uint16_t v; std::memcpy (&v, bytes, 2); return v; }
+		case PLYType::Int32: { int32_t v; std::memcpy (&v, bytes, 4); return v; }
+		case PLYType::UInt32: { uint32_t v; std::memcpy (&v, bytes, 4); return v; }
+		case PLYType::Float32: { float v; std::memcpy (&v, bytes, 4); return v; }
+		case PLYType::Float64: { double v; std::memcpy (&v, bytes, 8); return v; }
+		default: return 0.0;
+	}
+}
+
+struct PLYProperty {
+	std::string name;
+	PLYType type = PLYType::Invalid;
+	bool isList = false;
+	PLYType countType = PLYType::Invalid;
+	size_t offset = 0; ///< Within the record, for fixed-size elements only
+};
+
+struct PLYElement {
+	std::string name;
+	size_t count = 0;
+	std::vector<PLYProperty> properties;
+	bool fixedSize = true; ///< No list property, hence records of stride bytes
+	size_t stride = 0;
+
+	int findProperty (std::initializer_list<const char *> names) const {
+		for (const char * name : names)
+			for (size_t i = 0; i < properties.size (); i++)
+				if (properties[i].name == name && !properties[i].isList)
+					return static_cast<int> (i);
+		return -1;
+	}
+};
+
+/// Size of the record starting at data for an element with list properties, or 0 if it overflows end
+size_t plyRecordSize (const PLYElement & element, const char * data, const char * end, bool swap) {
+	size_t size = 0;
+	for (const auto & property : element.properties) {
+		if (property.isList) {
+			size_t countSize = plyTypeSize (property.countType);
+			if (data + size + countSize > end)
+				return 0;
+			size_t count = static_cast<size_t> (readPLYValue (data + size, property.countType, swap));
+			size += countSize + count * plyTypeSize (property.type);
+		} else
+			size += plyTypeSize (property.type);
+		if (data + size > end)
+			return 0;
+	}
+	return size;
+}
+
+/// Gathers numComponents scalar properties per vertex into a float array (glm::vec2/vec3 storage).
+/// Contiguous float32 components are copied in bulk, with a 4-byte swap if the byte orders differ.
+void readPLYVertexAttribute (const PLYElement & vertices, const char * data, bool swap, const int * propertyIndices, int numComponents, float * out) {
+	const PLYProperty & first = vertices.properties[propertyIndices[0]];
+	bool packedFloats = true;
+	for (int c = 0; c < numComponents; c++) {
+		const PLYProperty & property = vertices.properties[propertyIndices[c]];
+		packedFloats = packedFloats && property.type == PLYType::Float32 && property.offset == first.offset + 4 * c;
+	}
+	size_t count = vertices.count;
+	size_t stride = vertices.stride;
+	size_t componentBytes = 4 * numComponents;
+	if (packedFloats && !swap && stride == componentBytes) {
+		std::memcpy (out, data + first.offset, count * componentBytes); // The file layout already is the glm layout
+		return;
+	}
+	Parallel::forRange (count, [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const char * record = data + i * stride;
+			float * value = out + i * numComponents;
+			if (packedFloats) {
+				std::memcpy (value, record + first.offset, componentBytes);
+				if (swap)
+					for (int c = 0; c < numComponents; c++) {
+						uint32_t bits;
+						std::memcpy (&bits, value + c, 4);
+						bits = (bits >> 24) | ((bits >> 8) & 0xff00u) | ((bits << 8) & 0xff0000u) | (bits << 24);
+						std::memcpy (value + c, &bits, 4);
+					}
+			} else
+				for (int c = 0; c < numComponents; c++) {
+					const PLYProperty & property = vertices.properties[propertyIndices[c]];
+					value[c] = static_cast<float> (readPLYValue (record + property.offset, property.type, swap));
+				}
+		}
+	});
+}
+
+/// Parses the elements declared in the header of a binary PLY file. Returns the start of their data.
+const char * parsePLYHeader (const MappedFile & file, const std::string & filename, std::vector<PLYElement> & elements, bool & swap) {
+	const char * headerEnd = nullptr;
+	static const char endHeader[] = "end_header";
+	for (const char * p = file.begin (); p + sizeof (endHeader) - 1 <= file.end (); p = findLineEnd (p, file.end ()) + 1)
+		if (std::strncmp (p, endHeader, sizeof (endHeader) - 1) == 0) {
+			headerEnd = std::min (findLineEnd (p, file.end ()) + 1, file.end ());
+			break;
+		}
+	if (file.size () < 3 || std::strncmp (file.data (), "ply", 3) != 0 || headerEnd == nullptr)
+		throw std::ios_base::failure ("[Mesh Loader][loadPLY] Missing PLY header in " + filename);
+
+	std::istringstream header (std::string (file.begin (), headerEnd));
+	std::string format;
+	for (std::string line; std::getline (header, line); ) {
+		std::istringstream tokens (line);
+		std::string keyword;
+		tokens >> keyword;
+		if (keyword == "format")
+			tokens >> format;
+		else if (keyword == "element") {
+			PLYElement element;
+			tokens >> element.name >> element.count;
+			elements.push_back (element);
+		} else if (keyword == "property" && !elements.empty ()) {
+			PLYProperty property;
+			std::string typeName;
+			tokens >> typeName;
+			if (typeName == "list") {
+				std::string countTypeName;
+				tokens >> countTypeName >> typeName;
+				property.isList = true;
+				property.countType = parsePLYType (countTypeName);
+			}
+			property.type = parsePLYType (typeName);
+			tokens >> property.name;
+			if (property.type == PLYType::Invalid || (property.isList && property.countType == PLYType::Invalid))
+				throw std::ios_base::failure ("[Mesh Loader][loadPLY] Invalid property type in " + filename + ": " + line);
+			PLYElement & element = elements.back ();
+			property.offset = element.stride;
+			if (property.isList)
+				element.fixedSize = false;
+			else
+				element.stride += plyTypeSize (property.type);
+			element.properties.push_back (property);
+		}
+	}
+	bool littleEndian;
+	if (format == "binary_little_endian")
+		littleEndian = true;
+	else if (format == "binary_big_endian")
+		littleEndian = false;
+	else
+		throw std::ios_base::failure ("[Mesh Loader][loadPLY] Unsupported PLY format <" + format + "> in " + filename + " (binary only)");
+	swap = littleEndian != isLittleEndianHost ();
+	return headerEnd;
+}
+
+void parsePLY (const std::string & filename, std::shared_ptr<Mesh> meshPtr) {
+	MappedFile file (filename);
+	auto start = std::chrono::steady_clock::now ();
+	std::vector<PLYElement> elements;
+	bool swap;
+	const char * headerEnd = parsePLYHeader (file, filename, elements, swap);
+
+	auto & P = meshPtr->vertexPositions ();
+	auto & N = meshPtr->vertexNormals ();
+	auto & UV = meshPtr->vertexTexCoords ();
+	auto & T = meshPtr->triangleIndices ();
+	bool hasVertices = false;
+	const char * data = headerEnd;
+	for (const auto & element : elements) {
+		if (element.name == "vertex") {
+			if (!element.fixedSize)
+				throw std::ios_base::failure ("[Mesh Loader][loadPLY] List properties on vertices are not supported in " + filename);
+			if (static_cast<size_t> (file.end () - data) / std::max<size_t> (element.stride, 1) < element.count)
+				throw std::ios_base::failure ("[Mesh Loader][loadPLY] Truncated vertex data in " + filename);
+			int position[3] = { element.findProperty ({ "x" }), element.findProperty ({ "y" }), element.findProperty ({ "z" }) };
+			int normal[3] = { element.findProperty ({ "nx" }), element.findProperty ({ "ny" }), element.findProperty ({ "nz" }) };
+			int texCoord[2] = { element.findProperty ({ "u", "s", "texture_u", "texture_s" }), element.findProperty ({ "v", "t", "texture_v", "texture_t" }) };
+			if (position[0] < 0 || position[1] < 0 || position[2] < 0)
+				throw std::ios_base::failure ("[Mesh Loader][loadPLY] Missing vertex coordinates in " + filename);
+			P.resize (element.count);
+			readPLYVertexAttribute (element, data, swap, position, 3, glm::value_ptr (P[0]));
+			if (normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0) {
+				N.resize (element.count);
+				readPLYVertexAttribute (element, data, swap, normal, 3, glm::value_ptr (N[0]));
+			}
+			if (texCoord[0] >= 0 && texCoord[1] >= 0) {
+				UV.resize (element.count);
+				readPLYVertexAttribute (element, data, swap, texCoord, 2, glm::value_ptr (UV[0]));
+			}
+			data += element.count * element.stride;
+			hasVertices = true;
+		} else if (element.name == "face") {
+			int indices = -1;
+			for (size_t i = 0; i < element.properties.size (); i++)
+				if (element.properties[i].isList && (element.properties[i].name == "vertex_indices" || element.properties[i].name == "vertex_index"))
+					indices = static_cast<int> (i);
+			if (indices < 0)
+				throw std::ios_base::failure ("[Mesh Loader][loadPLY] Missing face indices in " + filename);
+			T.reserve (element.count);
+			for (size_t f = 0; f < element.count; f++) {
+				const char * record = data;
+				for (size_t i = 0; i < element.properties.size (); i++) {
+					const PLYProperty & property = element.properties[i];
+					size_t countSize = property.isList ? plyTypeSize (property.countType) : 0;
+					size_t count = 1;
+					if (property.isList) {
+						if (record + countSize > file.end ())
+							throw std::ios_base::failure ("[Mesh Loader][loadPLY] Truncated face data in " + filename);
+						count = static_cast<size_t> (readPLYValue (record, property.countType, swap));
+					}
+					size_t valueSize = plyTypeSize (property.type);
+					if (record + countSize + count * valueSize > file.end ())
+						throw std::ios_base::failure ("[Mesh Loader][loadPLY] Truncated face data in " + filename);
+					if (static_cast<int> (i) == indices) {
+						// Polygons are triangulated as fans
+						const char * values = record + countSize;
+						unsigned int first = static_cast<unsigned int> (readPLYValue (values, property.type, swap));
+						for (size_t k = 1; k + 1 < count; k++)
+							T.push_back (glm::uvec3 (first,
+													 static_cast<unsigned int> (readPLYValue (values + k * valueSize, property.type, swap)),
+													 static_cast<unsigned int> (readPLYValue (values + (k + 1) * valueSize, property.type, swap))));
+					}
+					record += countSize + count * valueSize;
+				}
+				data = record;
+			}
+		} else {
+			// Other elements (edges, materials...) are skipped
+			for (size_t i = 0; i < element.count; i++) {
+				size_t size = element.fixedSize ? element.stride : plyRecordSize (element, data, file.end (), swap);
+				if ((size == 0 && !element.properties.empty ()) || data + size > file.end ())
+					throw std::ios_base::failure ("[Mesh Loader][loadPLY] Truncated <" + element.name + "> data in " + filename);
+				data += size;
+			}
+		}
+	}
+	if (!hasVertices)
+		throw std::ios_base::failure ("[Mesh Loader][loadPLY] No vertex element in " + filename);
+	for (size_t i = 0; i < T.size (); i++)
+		if (T[i][0] >= P.size () || T[i][1] >= P.size () || T[i][2] >= P.size ())
+			throw std::ios_base::failure ("[Mesh Loader][loadPLY] Out of range index in face " + std::to_string (i) + " of " + filename);
+	reportThroughput ("PLY", file.size (), std::chrono::steady_clock::now () - start);
+}
+
+
+// ---------------------------------------------------------------------------
+// glTF 2.0 binary container (GLB). See https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html
+// ---------------------------------------------------------------------------
+
+/// Minimal JSON document model, enough for the glTF scene description
+struct JsonValue {
+	enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	const JsonValue * find (const std::string & key) const {
+		for (const auto & member : object)
+			if (member.first == key)
+				return &member.second;
+		return nullptr;
+	}
+	int intMember (const std::string & key, int defaultValue) const {
+		const JsonValue * value = find (key);
+		return value && value->type == Number ? static_cast<int> (value->number) : defaultValue;
+	}
+};
+
+class JsonParser {
+public:
+	JsonParser (const char * begin, const char * end) : m_cur (begin), m_end (end) {}
+
+	JsonValue parse () {
+		JsonValue value = parseValue (0);
+		skipBlanks ();
+		if (m_cur != m_end && *m_cur != '\0' && *m_cur != ' ') // The JSON chunk is padded with spaces
+			fail ();
+		return value;
+	}
+
+private:
+	[[noreturn]] void fail () { throw std::ios_base::failure ("[Mesh Loader][loadGLB] Invalid JSON chunk"); }
+
+	void skipBlanks () {
+		while (m_cur < m_end && (*m_cur == ' ' || *m_cur == '\t' || *m_cur == '\r' || *m_cur == '\n'))
+			m_cur++;
+	}
+
+	bool consume (const char * word) {
+		size_t length = std::strlen (word);
+		if (static_cast<size_t> (m_end - m_cur) < length || std::strncmp (m_cur, word, length) != 0)
+			return false;
+		m_cur += length;
+		return true;
+	}
+
+	std::string parseString () {
+		if (m_cur >= m_end || *m_cur != '"')
+			fail ();
+		std::string result;
+		for (m_cur++; m_cur < m_end && *m_cur != '"'; m_cur++) {
+			if (*m_cur == '\\') {
+				if (++m_cur >= m_end)
+					fail ();
+				switch (*m_cur) {
+					case 'n': result += '\n'; break;
+					case 't': result += '\t'; break;
+					case 'r': result += '\r'; break;
+					case 'b': result += '\b'; break;
+					case 'f': result += '\f'; break;
+					case 'u': m_cur = std::min (m_cur + 4, m_end - 1); result += '?'; break; // Non-ASCII names are not needed
+					default: result += *m_cur; break;
+				}
+			} else
+				result += *m_cur;
+		}
+		if (m_cur >= m_end)
+			fail ();
+		m_cur++;
+		return result;
+	}
+
+	JsonValue parseValue (int depth) {
+		if (depth > 64)
+			fail ();
+		skipBlanks ();
+		if (m_cur >= m_end)
+			fail ();
+		JsonValue value;
+		if (*m_cur == '{') {
+			value.type = JsonValue::Object;
+			m_cur++;
+			skipBlanks ();
+			if (m_cur < m_end && *m_cur == '}') {
+				m_cur++;
+				return value;
+			}
+			while (true) {
+				skipBlanks ();
+				std::string key = parseString ();
+				skipBlanks ();
+				if (!consume (":"))
+					fail ();
+				value.object.emplace_back (key, parseValue (depth + 1));
+				skipBlanks ();
+				if (consume ("}"))
+					break;
+				if (!consume (","))
+					fail ();
+			}
+		} else if (*m_cur == '[') {
+			value.type = JsonValue::Array;
+			m_cur++;
+			skipBlanks ();
+			if (m_cur < m_end && *m_cur == ']') {
+				m_cur++;
+				return value;
+			}
+			while (true) {
+				value.array.push_back (parseValue (depth + 1));
+				skipBlanks ();
+				if (consume ("]"))
+					break;
+				if (!consume (","))
+					fail ();
+			}
+		} else if (*m_cur == '"') {
+			value.type = JsonValue::String;
+			value.string = parseString ();
+		} else if (consume ("true")) {
+			value.type = JsonValue::Bool;
+			value.number = 1.0;
+		} else if (consume ("false")) {
+			value.type = JsonValue::Bool;
+		} else if (consume ("null")) {
+			value.type = JsonValue::Null;
+		} else {
+			value.type = JsonValue::Number;
+			auto result = std::from_chars (m_cur, m_end, value.number);
+			if (result.ec != std::errc ())
+				fail ();
+			m_cur = result.ptr;
+		}
+		return value;
+	}
+
+	const char * m_cur;
+	const char * m_end;
+};
+
+/// Typed view over the BIN chunk, resolved from a glTF accessor and its buffer view
+struct GLTFAccessor {
+	const char * data = nullptr;
+	size_t count = 0;
+	size_t stride = 0;
+	int componentType = 0;
+	int numComponents = 0;
+	bool normalized = false;
+
+	inline size_t componentSize () const {
+		return componentType == 5120 || componentType == 5121 ? 1 : (componentType == 5122 || componentType == 5123 ? 2 : 4);
+	}
+
+	/// True when the elements are tightly packed floats, i.e., laid out exactly as the matching glm vector array
+	inline bool isPackedFloat (int components) const {
+		return componentType == 5126 && numComponents == components && stride == 4u * components;
+	}
+
+	/// Reads a component as a float, applying the glTF normalization rules to integer types
+	inline float readFloat (size_t element, int component) const {
+		const char * p = data + element * stride + component * componentSize ();
+		switch (componentType) {
+			case 5120: { int8_t v; std::memcpy (&v, p, 1); return normalized ? std::max (v / 127.f, -1.f) : v; }
+			case 5121: { uint8_t v; std::memcpy (&v, p, 1); return normalized ? v / 255.f : v; }
+			case 5122: { int16_t v; std::memcpy (&v, p, 2); return normalized ? std::max (v / 32767.f, -1.f) : v; }
+			case 5123: { uint16_t v; std::memcpy (&v, p, 2); return normalized ? v / 65535.f : v; }
+			case 5125: { uint32_t v; std::memcpy (&v, p, 4); return static_cast<float> (v); }
+			default: { float v; std::memcpy (&v, p, 4); return v; }
+		}
+	}
+
+	inline unsigned int readIndex (size_t element) const {
+		const char * p = data + element * stride;
+		if (componentType == 5121) { uint8_t v; std::memcpy (&v, p, 1); return v; }
+		if (componentType == 5123) { uint16_t v; std::memcpy (&v, p, 2); return v; }
+		uint32_t v;
+		std::memcpy (&v, p, 4);
+		return v;
+	}
+};
+
+GLTFAccessor resolveGLTFAccessor (const JsonValue & document, int index, const char * bin, size_t binSize, const std::string & filename) {
+	auto fail = [&] (const std::string & reason) {
+		throw std::ios_base::failure ("[Mesh Loader][loadGLB] " + reason + " (accessor " + std::to_string (index) + ") in " + filename);
+	};
+	const JsonValue * accessors = document.find ("accessors");
+	const JsonValue * bufferViews = document.find ("bufferViews");
+	if (!accessors || index < 0 || static_cast<size_t> (index) >= accessors->array.size ())
+		fail ("Missing accessor");
+	const JsonValue & accessor = accessors->array[index];
+	if (accessor.find ("sparse"))
+		fail ("Sparse accessors are not supported");
+	static const std::pair<const char *, int> types[] = { { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 } };
+	GLTFAccessor result;
+	const JsonValue * type = accessor.find ("type");
+	for (const auto & t : types)
+		if (type && type->string == t.first)
+			result.numComponents = t.second;
+	result.componentType = accessor.intMember ("componentType", 0);
+	result.count = static_cast<size_t> (accessor.intMember ("count", 0));
+	const JsonValue * normalized = accessor.find ("normalized");
+	result.normalized = normalized && normalized->number != 0.0;
+	if (result.numComponents == 0 || result.componentType < 5120 || result.componentType > 5126 || result.componentType == 5124)
+		fail ("Unsupported accessor type");
+	int viewIndex = accessor.intMember ("bufferView", -1);
+	if (!bufferViews || viewIndex < 0 || static_cast<size_t> (viewIndex) >= bufferViews->array.size ())
+		fail ("Missing buffer view");
+	const JsonValue & view = bufferViews->array[viewIndex];
+	if (view.intMember ("buffer", 0) != 0)
+		fail ("External buffers are not supported");
+	size_t elementSize = result.componentSize () * result.numComponents;
+	size_t offset = static_cast<size_t> (view.intMember ("byteOffset", 0)) + static_cast<size_t> (accessor.intMember ("byteOffset", 0));
+	result.stride = static_cast<size_t> (view.intMember ("byteStride", 0));
+	if (result.stride == 0)
+		result.stride = elementSize;
+	if (result.count > 0 && offset + (result.count - 1) * result.stride + elementSize > binSize)
+		fail ("Out of bounds accessor");
+	result.data = bin + offset;
+	return result;
+}
+
+/// JSON and BIN chunks of a GLB file, the latter being optional
+struct GLBChunks {
+	const char * json = nullptr;
+	size_t jsonSize = 0;
+	const char * bin = nullptr;
+	size_t binSize = 0;
+};
+
+GLBChunks readGLBChunks (const MappedFile & file, const std::string & filename) {
+	auto readU32 = [&] (size_t offset) {
+		uint32_t value;
+		std::memcpy (&value, file.data () + offset, 4);
+		return isLittleEndianHost () ? value : (value >> 24) | ((value >> 8) & 0xff00u) | ((value << 8) & 0xff0000u) | (value << 24);
+	};
+	if (file.size () < 20 || std::strncmp (file.data (), "glTF", 4) != 0 || readU32 (4) != 2)
+		throw std::ios_base::failure ("[Mesh Loader][loadGLB] Not a glTF 2.0 binary file: " + filename);
+	if (!isLittleEndianHost ())
+		throw std::ios_base::failure ("[Mesh Loader][loadGLB] Big endian hosts are not supported");
+	// Chunks: JSON first, then the optional BIN chunk
+	GLBChunks chunks;
+	for (size_t offset = 12; offset + 8 <= file.size (); ) {
+		size_t chunkSize = readU32 (offset);
+		uint32_t chunkType = readU32 (offset + 4);
+		if (offset + 8 + chunkSize > file.size ())
+			throw std::ios_base::failure ("[Mesh Loader][loadGLB] Truncated chunk in " + filename);
+		if (chunkType == 0x4E4F534Au && !chunks.json) {
+			chunks.json = file.data () + offset + 8;
+			chunks.jsonSize = chunkSize;
+		} else if (chunkType == 0x004E4942u && !chunks.bin) {
+			chunks.bin = file.data () + offset + 8;
+			chunks.binSize = chunkSize;
+		}
+		offset += 8 + ((chunkSize + 3) & ~size_t (3));
+	}
+	if (!chunks.json)
+		throw std::ios_base::failure ("[Mesh Loader][loadGLB] Missing JSON chunk in " + filename);
+	return chunks;
+}
+
+/// Attaches a primitive whose accessors are laid out as the arrays of the mesh (packed floats, 32-bit indices) as its
+/// upload source, pointing into the mapped file, as MeshCache::load does. Nothing is copied: init uploads the accessors
+/// as they are, and the vectors are only filled when first accessed, e.g., to reorder the triangles. Returns false,
+/// leaving the mesh untouched, for other layouts.
+bool attachGLBPrimitive (const JsonValue & document, const JsonValue & primitive, std::shared_ptr<MappedFile> file,
+						 const char * bin, size_t binSize, const std::string & filename, std::shared_ptr<Mesh> meshPtr) {
+	const JsonValue * attributes = primitive.find ("attributes");
+	if (!attributes || !attributes->find ("POSITION") || !primitive.find ("indices"))
+		return false;
+	auto isAligned = [] (const GLTFAccessor & accessor) { return reinterpret_cast<uintptr_t> (accessor.data) % 4 == 0; };
+	GLTFAccessor position = resolveGLTFAccessor (document, attributes->intMember ("POSITION", -1), bin, binSize, filename);
+	GLTFAccessor indices = resolveGLTFAccessor (document, primitive.intMember ("indices", -1), bin, binSize, filename);
+	if (!position.isPackedFloat (3) || !isAligned (position) || indices.numComponents != 1 || indices.componentType != 5125
+		|| indices.stride != 4 || indices.count % 3 != 0 || !isAligned (indices))
+		return false;
+	Mesh::ExternalGeometry geometry;
+	if (attributes->find ("NORMAL")) {
+		GLTFAccessor normal = resolveGLTFAccessor (document, attributes->intMember ("NORMAL", -1), bin, binSize, filename);
+		if (normal.count != position.count || !normal.isPackedFloat (3) || !isAligned (normal))
+			return false;
+		geometry.normals = reinterpret_cast<const glm::vec3 *> (normal.data);
+	}
+	if (attributes->find ("TEXCOORD_0")) {
+		GLTFAccessor texCoord = resolveGLTFAccessor (document, attributes->intMember ("TEXCOORD_0", -1), bin, binSize, filename);
+		if (texCoord.count != position.count || !texCoord.isPackedFloat (2) || !isAligned (texCoord))
+			return false;
+		geometry.texCoords = reinterpret_cast<const glm::vec2 *> (texCoord.data);
+	}
+	geometry.owner = file;
+	geometry.numVertices = position.count;
+	geometry.numTriangles = indices.count / 3;
+	geometry.positions = reinterpret_cast<const glm::vec3 *> (position.data);
+	geometry.triangles = reinterpret_cast<const glm::uvec3 *> (indices.data);
+	const uint32_t * I = reinterpret_cast<const uint32_t *> (indices.data);
+	if (std::any_of (I, I + indices.count, [&] (uint32_t index) { return index >= position.count; }))
+		throw std::ios_base::failure ("[Mesh Loader][loadGLB] Out of range index in " + filename);
+	geometry.bounds = GeometryKernels::computeBounds (geometry.positions, geometry.numVertices);
+	meshPtr->setUploadSource (geometry);
+	return true;
+}
+
+void parseGLB (const std::string & filename, std::shared_ptr<Mesh> meshPtr) {
+	auto file = std::make_shared<MappedFile> (filename);
+	auto start = std::chrono::steady_clock::now ();
+	GLBChunks chunks = readGLBChunks (*file, filename);
+	const char * bin = chunks.bin;
+	size_t binSize = chunks.binSize;
+	JsonValue document = JsonParser (chunks.json, chunks.json + chunks.jsonSize).parse ();
+
+	const JsonValue * meshes = document.find ("meshes");
+	if (!meshes || meshes->array.empty ())
+		throw std::ios_base::failure ("[Mesh Loader][loadGLB] No mesh in " + filename);
+	// All the triangle primitives of the first mesh are merged. Node transforms are not applied.
+	std::vector<const JsonValue *> primitives;
+	if (const JsonValue * list = meshes->array[0].find ("primitives"))
+		for (const auto & primitive : list->array)
+			if (primitive.intMember ("mode", 4) == 4)
+				primitives.push_back (&primitive);
+	if (primitives.empty ())
+		throw std::ios_base::failure ("[Mesh Loader][loadGLB] No triangle primitive in " + filename);
+
+	if (primitives.size () == 1 && attachGLBPrimitive (document, *primitives[0], file, bin, binSize, filename, meshPtr)) {
+		reportThroughput ("GLB", file->size (), std::chrono::steady_clock::now () - start);
+		return;
+	}
+	auto & P = meshPtr->vertexPositions ();
+	auto & N = meshPtr->vertexNormals ();
+	auto & UV = meshPtr->vertexTexCoords ();
+	auto & T = meshPtr->triangleIndices ();
+	bool allNormals = true;
+	bool allTexCoords = true;
+	for (const JsonValue * primitive : primitives) {
+		const JsonValue * attributes = primitive->find ("attributes");
+		if (!attributes || !attributes->find ("POSITION"))
+			throw std::ios_base::failure ("[Mesh Loader][loadGLB] Primitive without positions in " + filename);
+		GLTFAccessor position = resolveGLTFAccessor (document, attributes->intMember ("POSITION", -1), bin, binSize, filename);
+		if (position.numComponents != 3)
+			throw std::ios_base::failure ("[Mesh Loader][loadGLB] Invalid positions in " + filename);
+		size_t base = P.size ();
+		size_t count = position.count;
+		auto readVec3 = [&] (const GLTFAccessor & accessor, std::vector<glm::vec3> & out) {
+			out.resize (base + count);
+			if (accessor.isPackedFloat (3))
+				std::memcpy (&out[base], accessor.data, count * sizeof (glm::vec3));
+			else
+				for (size_t i = 0; i < count; i++)
+					out[base + i] = glm::vec3 (accessor.readFloat (i, 0), accessor.readFloat (i, 1), accessor.readFloat (i, 2));
+		};
+		readVec3 (position, P);
+
+		if (attributes->find ("NORMAL")) {
+			GLTFAccessor normal = resolveGLTFAccessor (document, attributes->intMember ("NORMAL", -1), bin, binSize, filename);
+			if (normal.count != count || normal.numComponents != 3)
+				throw std::ios_base::failure ("[Mesh Loader][loadGLB] Invalid normals in " + filename);
+			readVec3 (normal, N);
+		} else
+			allNormals = false;
+
+		if (attributes->find ("TEXCOORD_0")) {
+			GLTFAccessor texCoord = resolveGLTFAccessor (document, attributes->intMember ("TEXCOORD_0", -1), bin, binSize, filename);
+			if (texCoord.count != count || texCoord.numComponents != 2)
+				throw std::ios_base::failure ("[Mesh Loader][loadGLB] Invalid texture coordinates in " + filename);
+			UV.resize (base + count);
+			if (texCoord.isPackedFloat (2))
+				std::memcpy (&UV[base], texCoord.data, count * sizeof (glm::vec2));
+			else
+				for (size_t i = 0; i < count; i++)
+					UV[base + i] = glm::vec2 (texCoord.readFloat (i, 0), texCoord.readFloat (i, 1));
+		} else
+			allTexCoords = false;
+
+		size_t firstTriangle = T.size ();
+		if (primitive->find ("indices")) {
+			GLTFAccessor indices = resolveGLTFAccessor (document, primitive->intMember ("indices", -1), bin, binSize, filename);
+			if (indices.numComponents != 1 || (indices.componentType != 5121 && indices.componentType != 5123 && indices.componentType != 5125))
+				throw std::ios_base::failure ("[Mesh Loader][loadGLB] Invalid indices in " + filename);
+			T.resize (firstTriangle + indices.count / 3);
+			if (base == 0 && indices.componentType == 5125 && indices.stride == 4)
+				std::memcpy (&T[firstTriangle], indices.data, (indices.count / 3) * sizeof (glm::uvec3));
+			else
+				for (size_t i = 0; i < indices.count / 3; i++)
+					T[firstTriangle + i] = glm::uvec3 (base + indices.readIndex (3 * i),
+													   base + indices.readIndex (3 * i + 1),
+													   base + indices.readIndex (3 * i + 2));
+		} else {
+			T.resize (firstTriangle + count / 3); // Non-indexed primitive
+			for (size_t i = 0; i < count / 3; i++)
+				T[firstTriangle + i] = glm::uvec3 (base + 3 * i, base + 3 * i + 1, base + 3 * i + 2);
+		}
+		for (size_t i = firstTriangle; i < T.size (); i++)
+			if (T[i][0] >= P.size () || T[i][1] >= P.size () || T[i][2] >= P.size ())
+				throw std::ios_base::failure ("[Mesh Loader][loadGLB] Out of range index in " + filename);
+	}
+	// Attributes missing on some primitives are computed for the whole mesh
+	if (!allNormals)
+		N.clear ();
+	if (!allTexCoords)
+		UV.clear ();
+	reportThroughput ("GLB", file->size (), std::chrono::steady_clock::now () - start);
+}
+
+// ---------------------------------------------------------------------------
+// Bounds estimated without loading the model
+// ---------------------------------------------------------------------------
+
+/// Vertices read to estimate the bounds of a model, evenly spread over the vertex block
+const size_t NUM_BOUNDS_SAMPLES = 4096;
+
+/// Samples the vertices of an OFF file laid out with one vertex per line, the lines in between being skipped with
+/// memchr only. Returns false for other layouts.
+bool sampleOFFVertices (const std::string & filename, std::vector<glm::vec3> & samples) {
+	MappedFile file (filename);
+	OFFScanner scanner (file.begin (), file.end ());
+	unsigned int sizeV, sizeT;
+	OFFVertexLayout layout;
+	parseOFFHeader (scanner, filename, sizeV, sizeT, layout);
+	size_t stride = std::max<size_t> (1, sizeV / NUM_BOUNDS_SAMPLES);
+	size_t v = 0;
+	for (const char * p = scanner.position (); v < sizeV && p < file.end (); ) {
+		const char * lineEnd = findLineEnd (p, file.end ());
+		if (isRecordLine (p, lineEnd)) {
+			if (v % stride == 0) {
+				OFFScanner line (p, lineEnd);
+				glm::vec3 position;
+				if (!readOFFVertex (line, layout, position) || !line.atLineEnd ())
+					return false;
+				samples.push_back (position);
+			}
+			v++;
+		}
+		p = lineEnd + 1;
+	}
+	return v == sizeV;
+}
+
+/// Samples the vertex records of a binary PLY file. Returns false if they cannot be located without parsing the
+/// elements before them, i.e., if one of those has list properties.
+bool samplePLYVertices (const std::string & filename, std::vector<glm::vec3> & samples) {
+	MappedFile file (filename);
+	std::vector<PLYElement> elements;
+	bool swap;
+	const char * data = parsePLYHeader (file, filename, elements, swap);
+	for (const auto & element : elements) {
+		if (!element.fixedSize || static_cast<size_t> (file.end () - data) / std::max<size_t> (element.stride, 1) < element.count)
+			return false;
+		if (element.name == "vertex") {
+			int position[3] = { element.findProperty ({ "x" }), element.findProperty ({ "y" }), element.findProperty ({ "z" }) };
+			if (position[0] < 0 || position[1] < 0 || position[2] < 0)
+				return false;
+			size_t stride = std::max<size_t> (1, element.count / NUM_BOUNDS_SAMPLES);
+			for (size_t i = 0; i < element.count; i += stride) {
+				glm::vec3 p;
+				for (int c = 0; c < 3; c++) {
+					const PLYProperty & property = element.properties[position[c]];
+					p[c] = static_cast<float> (readPLYValue (data + i * element.stride + property.offset, property.type, swap));
+				}
+				samples.push_back (p);
+			}
+			return true;
+		}
+		data += element.count * element.stride;
+	}
+	return false;
+}
+
+/// Box of the positions of the first mesh of a GLB file, from the min and max of their accessors, which glTF requires.
+bool readGLBBounds (const std::string & filename, glm::vec3 & boxMin, glm::vec3 & boxMax) {
+	MappedFile file (filename);
+	GLBChunks chunks = readGLBChunks (file, filename);
+	JsonValue document = JsonParser (chunks.json, chunks.json + chunks.jsonSize).parse ();
+	const JsonValue * meshes = document.find ("meshes");
+	const JsonValue * accessors = document.find ("accessors");
+	const JsonValue * primitives = meshes && !meshes->array.empty () ? meshes->array[0].find ("primitives") : nullptr;
+	if (!accessors || !primitives)
+		return false;
+	boxMin = glm::vec3 (std::numeric_limits<float>::max ());
+	boxMax = glm::vec3 (-std::numeric_limits<float>::max ());
+	bool found = false;
+	for (const auto & primitive : primitives->array) {
+		const JsonValue * attributes = primitive.find ("attributes");
+		int index = attributes ? attributes->intMember ("POSITION", -1) : -1;
+		if (primitive.intMember ("mode", 4) != 4 || index < 0)
+			continue;
+		if (static_cast<size_t> (index) >= accessors->array.size ())
+			return false;
+		const JsonValue * min = accessors->array[index].find ("min");
+		const JsonValue * max = accessors->array[index].find ("max");
+		if (!min || !max || min->array.size () != 3 || max->array.size () != 3)
+			return false;
+		for (int c = 0; c < 3; c++) {
+			boxMin[c] = std::min (boxMin[c], static_cast<float> (min->array[c].number));
+			boxMax[c] = std::max (boxMax[c], static_cast<float> (max->array[c].number));
+		}
+		found = true;
+	}
+	return found;
+}
+
+}
+
+std::string MeshLoader::fileExtension (const std::string & filename) {
+	size_t dot = filename.find_last_of ('.');
+	size_t slash = filename.find_last_of ("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return std::string ();
+	std::string extension = filename.substr (dot + 1);
+	std::transform (extension.begin (), extension.end (), extension.begin (), [] (unsigned char c) { return static_cast<char> (std::tolower (c)); });
+	return extension;
+}
+
+void MeshLoader::loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options) {
+	loadWithCache (filename, meshPtr, options, [&] () {
+		if (options.parser == OFFParser::Stream)
+			parseOFFStream (filename, meshPtr);
+		else
+			parseOFFMapped (filename, [&] (size_t sizeV, size_t sizeT) {
+				OFFTarget target;
+				meshPtr->vertexPositions ().resize (sizeV);
+				meshPtr->triangleIndices ().resize (sizeT);
+				target.positions = meshPtr->vertexPositions ().data ();
+				target.numVertices = sizeV;
+				target.triangles = meshPtr->triangleIndices ().data ();
+				target.numTriangles = sizeT;
+				return target;
+			}, options.parser == OFFParser::Parallel);
+	});
+}
+
+void MeshLoader::loadPLY (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options) {
+	loadWithCache (filename, meshPtr, options, [&] () {
+		parsePLY (filename, meshPtr);
+	});
+}
+
+void MeshLoader::loadGLB (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options) {
+	loadWithCache (filename, meshPtr, options, [&] () {
+		parseGLB (filename, meshPtr);
+	});
+}
+
+void MeshLoader::loadQMesh (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options) {
+	// Decoding is cheaper than reading the uncompressed cache, which would also defeat the purpose of the format
+	LoadOptions uncachedOptions = options;
+	uncachedOptions.useCache = false;
+	uncachedOptions.optimizeIndices = false; // Already done by the encoder
+	loadWithCache (filename, meshPtr, uncachedOptions, [&] () {
+		auto start = std::chrono::steady_clock::now ();
+		MeshCodec::decode (filename, meshPtr);
+		reportThroughput ("QMesh", std::filesystem::file_size (filename), std::chrono::steady_clock::now () - start);
+	});
+}
+
+void MeshLoader::load (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options) {
+	std::string extension = MeshLoader::fileExtension (filename);
+	if (extension == "off")
+		loadOFF (filename, meshPtr, options);
+	else if (extension == "ply")
+		loadPLY (filename, meshPtr, options);
+	else if (extension == "glb")
+		loadGLB (filename, meshPtr, options);
+	else if (extension == "qmesh")
+		loadQMesh (filename, meshPtr, options);
+	else
+		throw std::ios_base::failure ("[Mesh Loader][load] Unsupported file format <" + extension + "> for " + filename);
+}
+
+void MeshLoader::readOFFHeader (const std::string & filename, size_t & numVertices, size_t & numTriangles) {
+	MappedFile file (filename);
+	OFFScanner scanner (file.begin (), file.end ());
+	unsigned int sizeV, sizeT;
+	OFFVertexLayout layout;
+	parseOFFHeader (scanner, filename, sizeV, sizeT, layout);
+	numVertices = sizeV;
+	numTriangles = sizeT;
+}
+
+void MeshLoader::streamOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options) {
+	std::cout << " > Start streaming mesh <" << filename << ">" << std::endl;
+	parseOFFMapped (filename, [&] (size_t sizeV, size_t sizeT) {
+		const MeshStreaming::Target & streamingTarget = meshPtr->streamingTarget ();
+		if (sizeV != streamingTarget.numVertices || sizeT != streamingTarget.numTriangles)
+			throw std::ios_base::failure ("[Mesh Loader][streamOFF] Streaming buffers do not match the content of " + filename);
+		OFFTarget target;
+		target.positions = streamingTarget.positions;
+		target.numVertices = sizeV;
+		target.triangles = streamingTarget.triangles;
+		target.numTriangles = sizeT;
+		// Hand every decoded chunk over to the OpenGL thread, so that its transfer overlaps with the parsing of the next ones
+		target.onWritten = [meshPtr, sizeV] (size_t firstElement, size_t numElements) {
+			size_t lastElement = firstElement + numElements;
+			if (firstElement < sizeV)
+				meshPtr->commitStreamedRange (MeshStreaming::Positions, firstElement, std::min (lastElement, sizeV) - firstElement);
+			if (lastElement > sizeV) {
+				size_t firstTriangle = std::max (firstElement, sizeV) - sizeV;
+				meshPtr->commitStreamedRange (MeshStreaming::Triangles, firstTriangle, lastElement - sizeV - firstTriangle);
+			}
+		};
+		return target;
+	}, options.parser != OFFParser::Mapped);
+	meshPtr->endStreaming ();
+	std::cout << " > Mesh <" << filename << "> streamed" << std::endl;
+}
+
+bool MeshLoader::estimateBounds (const std::string & filename, GeometryKernels::Bounds & bounds) {
+	try {
+		if (MeshCache::readBounds (filename, bounds))
+			return true;
+		std::string extension = fileExtension (filename);
+		std::vector<glm::vec3> samples;
+		if ((extension == "off" && sampleOFFVertices (filename, samples)) || (extension == "ply" && samplePLYVertices (filename, samples))) {
+			if (samples.empty ())
+				return false;
+			bounds = GeometryKernels::computeBounds (samples.data (), samples.size ());
+			return true;
+		}
+		glm::vec3 boxMin, boxMax;
+		if ((extension == "glb" && readGLBBounds (filename, boxMin, boxMax)) || (extension == "qmesh" && MeshCodec::readBounds (filename, boxMin, boxMax))) {
+			bounds = GeometryKernels::Bounds ();
+			bounds.boxMin = boxMin;
+			bounds.boxMax = boxMax;
+			bounds.sphereCenter = bounds.orientedBoxCenter = 0.5f * (boxMin + boxMax);
+			bounds.orientedBoxHalfExtents = 0.5f * (boxMax - boxMin);
+			bounds.sphereRadius = glm::length (bounds.orientedBoxHalfExtents);
+			return true;
+		}
+	} catch (std::exception &) {
+		// Reported by the actual load
+	}
+	return false;
 }
@@ -8,9 +8,58 @@
 
 namespace MeshLoader {
 
+/// Text decoding backends available to loadOFF.
+enum class OFFParser {
+	Stream, ///< Reference implementation, reading every token through std::ifstream
+	Mapped, ///< Memory-mapped file decoded in place with std::from_chars, writing straight into the mesh arrays
+	Parallel ///< Mapped file split in newline-aligned chunks decoded concurrently, falling back to Mapped unless each element has a line of its own. Bit-identical to Mapped
+};
+
+struct LoadOptions {
+	OFFParser parser = OFFParser::Parallel;
+	bool useCache = true; ///< Read the processed mesh from its binary cache when up to date, (re)write it otherwise. See MeshCache.
+	float weldEpsilon = -1.f; ///< When non-negative, merges the vertices closer than this fraction of the diagonal. See MeshOptimizer::weldVertices.
+	bool optimizeIndices = true; ///< Reorders the triangles and vertices for the GPU caches. See MeshOptimizer.
+	bool buildMeshlets = true; ///< See MeshOptimizer::buildMeshlets.
+	bool buildLevelsOfDetail = true; ///< Unless the cluster hierarchy is built. See MeshOptimizer::buildLevelsOfDetail.
+	bool buildClusterHierarchy = true; ///< Needs buildMeshlets. See MeshOptimizer::buildClusterHierarchy.
+	bool computeMissingAttributes = true; ///< Compute the normals and texture coordinates the file lacks, and update the cache.
+	bool generateTexCoords = false; ///< Leaves the missing texture coordinates to the vertex shader. See Mesh::TexCoordMode.
+	unsigned int ambientOcclusionRays = 0; ///< Rays per vertex of the ambient occlusion bake, 0 skipping it. See AmbientOcclusion.
+};
+
 /// Loads an OFF mesh file. See https://en.wikipedia.org/wiki/OFF_(file_format)
-void loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr);
+/// The parsing throughput (MB/s) of the selected backend is reported on the standard output.
+void loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options = LoadOptions ());
+
+/// Loads a binary PLY mesh file, little or big endian. See http://paulbourke.net/dataformats/ply/
+/// Per-vertex normals (nx, ny, nz) and texture coordinates (u, v or s, t) are used when present, computed otherwise.
+/// Polygons are triangulated as fans.
+void loadPLY (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options = LoadOptions ());
+
+/// Loads the triangles of the first mesh of a binary glTF 2.0 file (.glb), with its normals and texture coordinates when present.
+/// A single primitive of packed floats and 32-bit indices is uploaded straight from the mapped file.
+/// Node transforms, sparse accessors and external buffers are not supported.
+void loadGLB (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options = LoadOptions ());
+
+/// Loads a compressed mesh written by MeshCodec::encode (see the MeshEncoder tool). The binary cache is never used.
+void loadQMesh (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options = LoadOptions ());
+
+/// Lower case extension of a file name, without the dot.
+std::string fileExtension (const std::string & filename);
+
+/// Loads a mesh file, choosing the format from the file extension (.off, .ply, .glb, .qmesh).
+void load (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options = LoadOptions ());
+
+/// Bounds of a model before loading it, from its cache or a cheap estimate. False if unavailable.
+bool estimateBounds (const std::string & filename, GeometryKernels::Bounds & bounds);
+
+/// Reads the element counts of an OFF file, e.g., to allocate the buffers of a streaming upload.
+void readOFFHeader (const std::string & filename, size_t & numVertices, size_t & numTriangles);
+
+/// Decodes an OFF file into a mesh prepared with Mesh::beginStreaming, chunk by chunk, without cache. Loader thread.
+void streamOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr, const LoadOptions & options = LoadOptions ());
 
 }
 
-#endif // MESH_LOADER_H
\ No newline at end of file
+#endif // MESH_LOADER_H
@@ -0,0 +1,916 @@
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+/// FIFO post-transform vertex cache, simulated with time stamps: a vertex is cached if less than cacheSize vertices
+/// were transformed since its own transformation
+class VertexCacheSimulator {
+public:
+	VertexCacheSimulator (size_t numVertices, unsigned int cacheSize) : m_timeStamps (numVertices, 0), m_time (cacheSize + 1), m_cacheSize (cacheSize) {}
+
+	/// Number of vertices of the triangle transformed, i.e., missing the cache
+	inline unsigned int draw (const glm::uvec3 & t) {
+		unsigned int misses = 0;
+		for (int j = 0; j < 3; j++)
+			if (m_time - m_timeStamps[t[j]] > m_cacheSize) {
+				m_timeStamps[t[j]] = m_time++;
+				misses++;
+			}
+		return misses;
+	}
+
+	inline void flush () { m_time += m_cacheSize + 1; }
+
+private:
+	std::vector<size_t> m_timeStamps;
+	size_t m_time;
+	size_t m_cacheSize;
+};
+
+/// Bounding sphere centered on the bounding box, and normal cone (see Meshlet::isBackFacing) of the triangles of a
+/// meshlet, starting at triangles
+void computeMeshletBounds (const glm::vec3 * P, const glm::uvec3 * triangles, Meshlet & meshlet) {
+	glm::vec3 boxMin (std::numeric_limits<float>::max ());
+	glm::vec3 boxMax (-std::numeric_limits<float>::max ());
+	glm::vec3 axis (0.f);
+	for (uint32_t i = 0; i < meshlet.numTriangles; i++) {
+		for (int j = 0; j < 3; j++) {
+			boxMin = glm::min (boxMin, P[triangles[i][j]]);
+			boxMax = glm::max (boxMax, P[triangles[i][j]]);
+		}
+		axis += glm::cross (P[triangles[i][1]] - P[triangles[i][0]], P[triangles[i][2]] - P[triangles[i][0]]);
+	}
+	meshlet.center = 0.5f * (boxMin + boxMax);
+	float squaredRadius = 0.f;
+	for (uint32_t i = 0; i < meshlet.numTriangles; i++)
+		for (int j = 0; j < 3; j++) {
+			glm::vec3 d = P[triangles[i][j]] - meshlet.center;
+			squaredRadius = std::max (squaredRadius, glm::dot (d, d));
+		}
+	meshlet.radius = std::sqrt (squaredRadius);
+	float axisLength = glm::length (axis);
+	if (axisLength == 0.f)
+		return; // Degenerate, never culled
+	meshlet.coneAxis = axis / axisLength;
+	float minAlignment = 1.f;
+	for (uint32_t i = 0; i < meshlet.numTriangles; i++) {
+		glm::vec3 n = glm::cross (P[triangles[i][1]] - P[triangles[i][0]], P[triangles[i][2]] - P[triangles[i][0]]);
+		float length = glm::length (n);
+		if (length > 0.f)
+			minAlignment = std::min (minAlignment, glm::dot (n / length, meshlet.coneAxis));
+	}
+	// Beyond ~84 degrees, the cluster is back-facing from too few view points to be worth testing
+	meshlet.coneCutoff = minAlignment > 0.1f ? std::sqrt (1.f - minAlignment * minAlignment) : 1.f;
+}
+
+/// Occlusion potential of each cluster of triangles [boundaries[c], boundaries[c+1]), see optimizeOverdraw: how far
+/// its area weighted centroid lies in front of the mesh centroid, along its average normal
+std::vector<double> occlusionPotentials (const glm::vec3 * P, const glm::uvec3 * T, const std::vector<size_t> & boundaries) {
+	size_t numClusters = boundaries.size () - 1;
+	std::vector<glm::dvec3> clusterCentroids (numClusters);
+	std::vector<glm::dvec3> clusterNormals (numClusters);
+	std::vector<double> clusterAreas (numClusters);
+	glm::dvec3 meshCentroid (0.0);
+	double meshArea = 0.0;
+	Parallel::forRange (numClusters, [&] (size_t begin, size_t end) {
+		for (size_t c = begin; c < end; c++) {
+			glm::dvec3 centroid (0.0);
+			glm::dvec3 normal (0.0);
+			double clusterArea = 0.0;
+			for (size_t t = boundaries[c]; t < boundaries[c + 1]; t++) {
+				glm::dvec3 p0 (P[T[t][0]]);
+				glm::dvec3 p1 (P[T[t][1]]);
+				glm::dvec3 p2 (P[T[t][2]]);
+				glm::dvec3 n = glm::cross (p1 - p0, p2 - p0); // Twice the area
+				double area = glm::length (n);
+				centroid += area * (p0 + p1 + p2) / 3.0;
+				normal += n;
+				clusterArea += area;
+			}
+			clusterCentroids[c] = centroid; // Divided by the area below
+			clusterNormals[c] = normal;
+			clusterAreas[c] = clusterArea;
+		}
+	}, 64);
+	for (size_t c = 0; c < numClusters; c++) {
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterAreas[c];
+	}
+	if (meshArea > 0.0)
+		meshCentroid /= meshArea;
+	std::vector<double> keys (numClusters, 0.0);
+	for (size_t c = 0; c < numClusters; c++) {
+		double normalLength = glm::length (clusterNormals[c]);
+		if (clusterAreas[c] > 0.0 && normalLength > 0.0)
+			keys[c] = glm::dot (clusterCentroids[c] / clusterAreas[c] - meshCentroid, clusterNormals[c] / normalLength);
+	}
+	return keys;
+}
+
+inline uint64_t hashCell (int64_t x, int64_t y, int64_t z) {
+	uint64_t h = static_cast<uint64_t> (x) * 0x9E3779B97F4A7C15ull;
+	h ^= static_cast<uint64_t> (y) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+	h ^= static_cast<uint64_t> (z) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+	return h ^ (h >> 31);
+}
+
+/// Uniform grid hashed into a fixed number of buckets, stored as compressed rows. Vertices of distinct cells may share
+/// a bucket, the queries filter them by distance anyway.
+class SpatialHashGrid {
+public:
+	/// cellSize 0 hashes exact positions
+	SpatialHashGrid (const std::vector<glm::vec3> & P, float cellSize) : m_cellSize (cellSize) {
+		size_t numBuckets = 1;
+		while (numBuckets < P.size ())
+			numBuckets <<= 1;
+		m_mask = numBuckets - 1;
+		std::vector<uint32_t> vertexBucket (P.size ());
+		std::vector<std::atomic<uint32_t>> counts (numBuckets);
+		Parallel::forRange (numBuckets, [&] (size_t begin, size_t end) {
+			for (size_t b = begin; b < end; b++)
+				counts[b].store (0, std::memory_order_relaxed);
+		});
+		Parallel::forRange (P.size (), [&] (size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				int64_t c[3];
+				cell (P[i], c);
+				vertexBucket[i] = static_cast<uint32_t> (hashCell (c[0], c[1], c[2]) & m_mask);
+				counts[vertexBucket[i]].fetch_add (1, std::memory_order_relaxed);
+			}
+		});
+		m_offsets.resize (numBuckets + 1);
+		m_offsets[0] = 0;
+		for (size_t b = 0; b < numBuckets; b++)
+			m_offsets[b + 1] = m_offsets[b] + counts[b].load (std::memory_order_relaxed);
+		Parallel::forRange (numBuckets, [&] (size_t begin, size_t end) {
+			for (size_t b = begin; b < end; b++)
+				counts[b].store (m_offsets[b], std::memory_order_relaxed); // Now the insertion cursors
+		});
+		m_vertices.resize (P.size ());
+		Parallel::forRange (P.size (), [&] (size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				m_vertices[counts[vertexBucket[i]].fetch_add (1, std::memory_order_relaxed)] = static_cast<uint32_t> (i);
+		});
+	}
+
+	/// Calls func (vertex) for every vertex of the cells within reach of p, i.e., the 27 neighbor cells, or the cell of
+	/// p itself for exact positions
+	template<typename Func>
+	void forEachCandidate (const glm::vec3 & p, Func func) const {
+		int64_t c[3];
+		cell (p, c);
+		int reach = m_cellSize > 0.f ? 1 : 0;
+		for (int64_t x = c[0] - reach; x <= c[0] + reach; x++)
+			for (int64_t y = c[1] - reach; y <= c[1] + reach; y++)
+				for (int64_t z = c[2] - reach; z <= c[2] + reach; z++) {
+					uint64_t b = hashCell (x, y, z) & m_mask;
+					for (uint32_t k = m_offsets[b]; k < m_offsets[b + 1]; k++)
+						func (m_vertices[k]);
+				}
+	}
+
+private:
+	inline void cell (const glm::vec3 & p, int64_t c[3]) const {
+		for (int axis = 0; axis < 3; axis++) {
+			if (m_cellSize > 0.f)
+				c[axis] = static_cast<int64_t> (std::floor (static_cast<double> (p[axis]) / m_cellSize));
+			else {
+				float value = p[axis] + 0.f; // -0 and +0 share a cell
+				uint32_t bits;
+				std::memcpy (&bits, &value, sizeof (bits));
+				c[axis] = bits;
+			}
+		}
+	}
+
+	float m_cellSize;
+	uint64_t m_mask;
+	std::vector<uint32_t> m_offsets;
+	std::vector<uint32_t> m_vertices;
+};
+
+}
+
+namespace {
+
+/// Tipsify, see MeshOptimizer::optimizeVertexCache
+std::vector<glm::uvec3> tipsify (const std::vector<glm::uvec3> & T, size_t numVertices, const MeshAdjacency * adjacency, unsigned int cacheSize) {
+	std::vector<unsigned int> live (numVertices); // Triangles of each vertex not emitted yet
+	for (size_t v = 0; v < numVertices; v++)
+		live[v] = adjacency->valence (static_cast<unsigned int> (v));
+	std::vector<size_t> cacheTime (numVertices, 0);
+	std::vector<bool> emitted (T.size (), false);
+	std::vector<unsigned int> deadEnd; // Recently used vertices, to restart from when the fan runs dry
+	std::vector<unsigned int> candidates;
+	std::vector<glm::uvec3> reordered;
+	reordered.reserve (T.size ());
+	size_t timeStamp = cacheSize + 1;
+	size_t cursor = 0; // Next vertex to try when the dead-end stack is empty
+	long long fanning = 0;
+	while (fanning >= 0) {
+		candidates.clear ();
+		for (unsigned int corner : adjacency->corners (static_cast<unsigned int> (fanning))) {
+			unsigned int t = MeshAdjacency::triangle (corner);
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+			reordered.push_back (T[t]);
+			for (int j = 0; j < 3; j++) {
+				unsigned int v = T[t][j];
+				deadEnd.push_back (v);
+				candidates.push_back (v);
+				live[v]--;
+				if (timeStamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timeStamp++;
+			}
+		}
+		// Next fanning vertex: the one of the 1-ring staying in cache the longest while its remaining triangles are emitted
+		fanning = -1;
+		long long bestPriority = -1;
+		for (unsigned int v : candidates) {
+			if (live[v] == 0)
+				continue;
+			long long priority = 0;
+			if (timeStamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = static_cast<long long> (timeStamp - cacheTime[v]);
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+		if (fanning >= 0)
+			continue;
+		while (!deadEnd.empty () && fanning < 0) {
+			unsigned int v = deadEnd.back ();
+			deadEnd.pop_back ();
+			if (live[v] > 0)
+				fanning = v;
+		}
+		for (; cursor < numVertices && fanning < 0; cursor++)
+			if (live[cursor] > 0)
+				fanning = static_cast<long long> (cursor);
+	}
+	return reordered;
+}
+
+}
+
+void MeshOptimizer::optimizeVertexCache (Mesh & mesh, unsigned int cacheSize) {
+	const Mesh & constMesh = mesh;
+	const std::vector<glm::uvec3> & T = constMesh.triangleIndices ();
+	size_t numVertices = constMesh.vertexPositions ().size ();
+	if (T.empty () || numVertices == 0)
+		return;
+	std::vector<glm::uvec3> reordered = tipsify (T, numVertices, constMesh.adjacency ().get (), cacheSize);
+	mesh.triangleIndices ().swap (reordered);
+}
+
+void MeshOptimizer::optimizeOverdraw (Mesh & mesh, float threshold, unsigned int cacheSize) {
+	const Mesh & constMesh = mesh;
+	const std::vector<glm::vec3> & P = constMesh.vertexPositions ();
+	const std::vector<glm::uvec3> & T = constMesh.triangleIndices ();
+	if (T.empty ())
+		return;
+
+	// Hard boundaries: triangles missing the cache on all of their vertices start a disjoint patch
+	std::vector<size_t> hardBoundaries;
+	VertexCacheSimulator cache (P.size (), cacheSize);
+	for (size_t t = 0; t < T.size (); t++)
+		if (cache.draw (T[t]) == 3 || t == 0)
+			hardBoundaries.push_back (t);
+	hardBoundaries.push_back (T.size ());
+
+	// Soft boundaries: a cluster is closed as soon as its ACMR drops to the threshold, relative to its hard cluster.
+	// A trailing cluster which does not get there is merged into the previous one.
+	std::vector<size_t> boundaries;
+	for (size_t h = 0; h + 1 < hardBoundaries.size (); h++) {
+		size_t begin = hardBoundaries[h];
+		size_t end = hardBoundaries[h + 1];
+		cache.flush ();
+		size_t misses = 0;
+		for (size_t t = begin; t < end; t++)
+			misses += cache.draw (T[t]);
+		float clusterThreshold = threshold * static_cast<float> (misses) / static_cast<float> (end - begin);
+		boundaries.push_back (begin);
+		cache.flush ();
+		size_t runningMisses = 0;
+		size_t runningTriangles = 0;
+		for (size_t t = begin; t < end; t++) {
+			runningMisses += cache.draw (T[t]);
+			runningTriangles++;
+			if (static_cast<float> (runningMisses) <= clusterThreshold * static_cast<float> (runningTriangles) && t + 1 < end) {
+				boundaries.push_back (t + 1);
+				cache.flush ();
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+		if (runningTriangles > 0 && boundaries.back () != begin && runningMisses > clusterThreshold * runningTriangles)
+			boundaries.pop_back ();
+	}
+	boundaries.push_back (T.size ());
+
+	// Outward facing clusters far from the mesh center first
+	size_t numClusters = boundaries.size () - 1;
+	std::vector<double> keys = occlusionPotentials (P.data (), T.data (), boundaries);
+	std::vector<size_t> order (numClusters);
+	for (size_t c = 0; c < numClusters; c++)
+		order[c] = c;
+	std::stable_sort (order.begin (), order.end (), [&] (size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<glm::uvec3> reordered;
+	reordered.reserve (T.size ());
+	for (size_t c : order)
+		reordered.insert (reordered.end (), T.begin () + boundaries[c], T.begin () + boundaries[c + 1]);
+	mesh.triangleIndices ().swap (reordered);
+}
+
+MeshOptimizer::VertexCacheStatistics MeshOptimizer::analyzeVertexCache (const Mesh & mesh, unsigned int cacheSize) {
+	VertexCacheStatistics statistics;
+	const std::vector<glm::uvec3> & T = mesh.triangleIndices ();
+	size_t numVertices = mesh.vertexPositions ().size ();
+	if (T.empty ())
+		return statistics;
+	VertexCacheSimulator cache (numVertices, cacheSize);
+	std::vector<bool> referenced (numVertices, false);
+	size_t numReferenced = 0;
+	for (const auto & t : T) {
+		statistics.numTransformedVertices += cache.draw (t);
+		for (int j = 0; j < 3; j++)
+			if (!referenced[t[j]]) {
+				referenced[t[j]] = true;
+				numReferenced++;
+			}
+	}
+	statistics.acmr = static_cast<float> (statistics.numTransformedVertices) / static_cast<float> (T.size ());
+	statistics.atvr = static_cast<float> (statistics.numTransformedVertices) / static_cast<float> (numReferenced);
+	return statistics;
+}
+
+MeshOptimizer::MeshletReport MeshOptimizer::buildMeshlets (Mesh & mesh, unsigned int maxVertices, unsigned int maxTriangles) {
+	MeshletReport report;
+	const Mesh & constMesh = mesh;
+	const std::vector<glm::vec3> & P = constMesh.vertexPositions ();
+	const std::vector<glm::uvec3> & T = constMesh.triangleIndices ();
+	if (T.empty ())
+		return report;
+	std::shared_ptr<const MeshAdjacency> adjacency = constMesh.adjacency ();
+	const unsigned int none = static_cast<unsigned int> (-1);
+	const float coneWeight = 16.f; // Trades meshlet size for narrower cones, i.e., more back-face culling
+
+	std::vector<glm::vec3> normals (T.size ());
+	std::vector<glm::vec3> centroids (T.size ());
+	Parallel::forRange (T.size (), [&] (size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++) {
+			glm::vec3 n = glm::cross (P[T[t][1]] - P[T[t][0]], P[T[t][2]] - P[T[t][0]]);
+			float length = glm::length (n);
+			normals[t] = length > 0.f ? n / length : glm::vec3 (0.f);
+			centroids[t] = (P[T[t][0]] + P[T[t][1]] + P[T[t][2]]) / 3.f;
+		}
+	});
+
+	// Greedy growth. Membership of the vertices and candidate triangles is tagged with the meshlet index, which saves
+	// clearing any table between meshlets.
+	std::vector<bool> emitted (T.size (), false);
+	std::vector<unsigned int> vertexMeshlet (P.size (), none);
+	std::vector<unsigned int> candidateMeshlet (T.size (), none);
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> order; // Source index of the reordered triangles
+	order.reserve (T.size ());
+	std::vector<Meshlet> meshlets;
+	size_t totalNumVertices = 0;
+	size_t nextInOrder = 0;
+	while (true) {
+		// Continue from the front of the previous meshlet, in its most enclosed triangle, which avoids leaving isolated
+		// pockets behind
+		unsigned int t = none;
+		int bestEnclosure = -1;
+		for (unsigned int c : candidates) {
+			if (emitted[c])
+				continue;
+			int enclosure = 0;
+			for (unsigned int h = 3 * c; h < 3 * c + 3; h++)
+				enclosure += adjacency->twin (h) == MeshAdjacency::NoTwin || emitted[MeshAdjacency::triangle (adjacency->twin (h))];
+			if (enclosure > bestEnclosure || (enclosure == bestEnclosure && c < t)) {
+				t = c;
+				bestEnclosure = enclosure;
+			}
+		}
+		if (t == none) {
+			while (nextInOrder < T.size () && emitted[nextInOrder])
+				nextInOrder++;
+			if (nextInOrder == T.size ())
+				break;
+			t = static_cast<unsigned int> (nextInOrder);
+		}
+		unsigned int id = static_cast<unsigned int> (meshlets.size ());
+		Meshlet meshlet;
+		meshlet.firstTriangle = static_cast<uint32_t> (order.size ());
+		unsigned int numVertices = 0;
+		glm::vec3 normalSum (0.f);
+		glm::vec3 centroidSum (0.f);
+		candidates.clear ();
+		while (t != none) {
+			emitted[t] = true;
+			order.push_back (t);
+			normalSum += normals[t];
+			centroidSum += centroids[t];
+			for (int j = 0; j < 3; j++) {
+				unsigned int v = T[t][j];
+				if (vertexMeshlet[v] == id)
+					continue;
+				vertexMeshlet[v] = id;
+				numVertices++;
+				for (unsigned int corner : adjacency->corners (v)) {
+					unsigned int neighbour = MeshAdjacency::triangle (corner);
+					if (!emitted[neighbour] && candidateMeshlet[neighbour] != id) {
+						candidateMeshlet[neighbour] = id;
+						candidates.push_back (neighbour);
+					}
+				}
+			}
+			if (order.size () - meshlet.firstTriangle == maxTriangles)
+				break;
+			// Fewest new vertices first, then closest to the center of the meshlet, which keeps it round, with a
+			// penalty for the normals deviating from the average one, which keeps its cone narrow
+			glm::vec3 center = centroidSum / static_cast<float> (order.size () - meshlet.firstTriangle);
+			glm::vec3 axis = glm::length (normalSum) > 0.f ? glm::normalize (normalSum) : glm::vec3 (0.f);
+			t = none;
+			unsigned int bestNewVertices = 4;
+			float bestCost = std::numeric_limits<float>::max ();
+			for (size_t i = 0; i < candidates.size ();) {
+				unsigned int c = candidates[i];
+				if (emitted[c]) {
+					candidates[i] = candidates.back ();
+					candidates.pop_back ();
+					continue;
+				}
+				unsigned int newVertices = (vertexMeshlet[T[c][0]] != id) + (vertexMeshlet[T[c][1]] != id) + (vertexMeshlet[T[c][2]] != id);
+				float cost = glm::distance (centroids[c], center) * (1.f + coneWeight * (1.f - glm::dot (normals[c], axis)));
+				if (numVertices + newVertices <= maxVertices
+					&& (newVertices < bestNewVertices || (newVertices == bestNewVertices && cost < bestCost))) {
+					t = c;
+					bestNewVertices = newVertices;
+					bestCost = cost;
+				}
+				i++;
+			}
+		}
+		meshlet.numTriangles = static_cast<uint32_t> (order.size () - meshlet.firstTriangle);
+		// The growth order jumps around the front of the meshlet, the source one is cache friendly
+		std::sort (order.begin () + meshlet.firstTriangle, order.end ());
+		totalNumVertices += numVertices;
+		meshlets.push_back (meshlet);
+	}
+
+	// Growing meshlets breaks the clusters of optimizeOverdraw, whose order is restored at meshlet granularity
+	std::vector<size_t> boundaries (meshlets.size () + 1, T.size ());
+	for (size_t m = 0; m < meshlets.size (); m++)
+		boundaries[m] = meshlets[m].firstTriangle;
+	std::vector<glm::uvec3> grown (T.size ());
+	for (size_t i = 0; i < T.size (); i++)
+		grown[i] = T[order[i]];
+	std::vector<double> keys = occlusionPotentials (P.data (), grown.data (), boundaries);
+	std::vector<size_t> meshletOrder (meshlets.size ());
+	for (size_t m = 0; m < meshlets.size (); m++)
+		meshletOrder[m] = m;
+	std::stable_sort (meshletOrder.begin (), meshletOrder.end (), [&] (size_t a, size_t b) { return keys[a] > keys[b]; });
+	std::vector<glm::uvec3> reordered;
+	reordered.reserve (T.size ());
+	std::vector<Meshlet> sortedMeshlets;
+	sortedMeshlets.reserve (meshlets.size ());
+	for (size_t m : meshletOrder) {
+		Meshlet meshlet = meshlets[m];
+		meshlet.firstTriangle = static_cast<uint32_t> (reordered.size ());
+		reordered.insert (reordered.end (), grown.begin () + boundaries[m], grown.begin () + boundaries[m + 1]);
+		sortedMeshlets.push_back (meshlet);
+	}
+	meshlets.swap (sortedMeshlets);
+
+	Parallel::forRange (meshlets.size (), [&] (size_t begin, size_t end) {
+		for (size_t m = begin; m < end; m++) {
+			Meshlet & meshlet = meshlets[m];
+			computeMeshletBounds (P.data (), reordered.data () + meshlet.firstTriangle, meshlet);
+		}
+	}, 64);
+
+	report.numMeshlets = meshlets.size ();
+	report.averageNumVertices = static_cast<float> (totalNumVertices) / static_cast<float> (meshlets.size ());
+	report.averageNumTriangles = static_cast<float> (T.size ()) / static_cast<float> (meshlets.size ());
+	for (const auto & meshlet : meshlets)
+		report.numConeCullable += meshlet.coneCutoff < 1.f;
+	mesh.triangleIndices ().swap (reordered);
+	mesh.meshlets ().swap (meshlets); // After the triangles, whose mutable access clears the meshlets
+	return report;
+}
+
+MeshOptimizer::LevelOfDetailReport MeshOptimizer::buildLevelsOfDetail (Mesh & mesh, const std::vector<float> & ratios, unsigned int cacheSize) {
+	LevelOfDetailReport report;
+	const Mesh & constMesh = mesh;
+	const std::vector<glm::vec3> & P = constMesh.vertexPositions ();
+	const std::vector<glm::uvec3> & T = constMesh.triangleIndices ();
+	if (T.empty ())
+		return report;
+	std::vector<LevelOfDetail> levels;
+	std::vector<glm::uvec3> lodTriangles;
+	MeshSimplifier simplifier (P.data (), P.size (), T.data (), T.size ());
+	size_t previousNumTriangles = T.size ();
+	for (float ratio : ratios) {
+		simplifier.simplify (static_cast<size_t> (ratio * static_cast<float> (T.size ())));
+		const std::vector<glm::uvec3> & simplified = simplifier.triangles ();
+		if (simplified.empty ())
+			break;
+		if (10 * simplified.size () >= 9 * previousNumTriangles)
+			continue; // Not worth a level, the next ratio may still get further
+		previousNumTriangles = simplified.size ();
+		MeshAdjacency adjacency (simplified.data (), simplified.size (), P.size ());
+		std::vector<glm::uvec3> reordered = tipsify (simplified, P.size (), &adjacency, cacheSize);
+		LevelOfDetail level;
+		level.firstTriangle = static_cast<uint32_t> (lodTriangles.size ());
+		level.numTriangles = static_cast<uint32_t> (reordered.size ());
+		level.error = simplifier.error ();
+		levels.push_back (level);
+		lodTriangles.insert (lodTriangles.end (), reordered.begin (), reordered.end ());
+	}
+	report.numLevels = levels.size ();
+	report.numTriangles = lodTriangles.size ();
+	report.maxError = levels.empty () ? 0.f : levels.back ().error;
+	mesh.levelsOfDetail ().swap (levels);
+	mesh.lodTriangleIndices ().swap (lodTriangles);
+	return report;
+}
+
+namespace {
+
+/// Gathers the clusters, given by their sorted vertices, in groups of up to groupSize clusters sharing the most
+/// vertices. Each group is seeded with the first cluster left, in the current (spatially coherent) order, and grows
+/// with the neighbour sharing the most vertices with the group so far.
+std::vector<std::vector<uint32_t>> groupClusters (const std::vector<std::vector<uint32_t>> & clusterVertices, unsigned int groupSize) {
+	size_t numClusters = clusterVertices.size ();
+	// Pairs of clusters sharing a vertex, from the (vertex, cluster) incidences
+	std::vector<std::pair<uint32_t, uint32_t>> incidences;
+	for (size_t c = 0; c < numClusters; c++)
+		for (uint32_t v : clusterVertices[c])
+			incidences.emplace_back (v, static_cast<uint32_t> (c));
+	std::sort (incidences.begin (), incidences.end ());
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+	for (size_t i = 0, j = 0; i < incidences.size (); i = j) {
+		while (j < incidences.size () && incidences[j].first == incidences[i].first)
+			j++;
+		for (size_t a = i; a < j; a++)
+			for (size_t b = i; b < j; b++)
+				if (a != b)
+					pairs.emplace_back (incidences[a].second, incidences[b].second);
+	}
+	std::sort (pairs.begin (), pairs.end ());
+
+	// Neighbours of each cluster, with the number of vertices they share, in compressed rows
+	std::vector<size_t> offsets (numClusters + 1, 0);
+	std::vector<std::pair<uint32_t, uint32_t>> neighbours;
+	for (size_t i = 0, j = 0; i < pairs.size (); i = j) {
+		while (j < pairs.size () && pairs[j] == pairs[i])
+			j++;
+		neighbours.emplace_back (pairs[i].second, static_cast<uint32_t> (j - i));
+		offsets[pairs[i].first + 1]++;
+	}
+	for (size_t c = 0; c < numClusters; c++)
+		offsets[c + 1] += offsets[c];
+
+	std::vector<std::vector<uint32_t>> groups;
+	std::vector<bool> grouped (numClusters, false);
+	std::vector<std::pair<uint32_t, uint32_t>> candidates; // Neighbours of the group, with the number of vertices they share with it
+	for (size_t seed = 0; seed < numClusters; seed++) {
+		if (grouped[seed])
+			continue;
+		std::vector<uint32_t> group (1, static_cast<uint32_t> (seed));
+		grouped[seed] = true;
+		candidates.clear ();
+		for (uint32_t c = group.back (); group.size () < groupSize; c = group.back ()) {
+			for (size_t n = offsets[c]; n < offsets[c + 1]; n++) {
+				if (grouped[neighbours[n].first])
+					continue;
+				auto it = std::find_if (candidates.begin (), candidates.end (), [&] (const std::pair<uint32_t, uint32_t> & candidate) {
+					return candidate.first == neighbours[n].first;
+				});
+				if (it == candidates.end ())
+					candidates.push_back (neighbours[n]);
+				else
+					it->second += neighbours[n].second;
+			}
+			auto best = std::max_element (candidates.begin (), candidates.end (), [] (const std::pair<uint32_t, uint32_t> & a, const std::pair<uint32_t, uint32_t> & b) {
+				return a.second < b.second;
+			});
+			if (best == candidates.end ())
+				break;
+			grouped[best->first] = true;
+			group.push_back (best->first);
+			candidates.erase (best);
+		}
+		groups.push_back (std::move (group));
+	}
+	return groups;
+}
+
+/// Splits the triangles in [begin, end) in numClusters clusters of about the same size, by recursive median splits
+/// along the longest axis of their centroids. The triangles are reordered so that each cluster is a contiguous range.
+void splitInClusters (const glm::vec3 * P, std::vector<glm::uvec3> & T, size_t begin, size_t end, size_t numClusters, std::vector<Meshlet> & clusters) {
+	if (numClusters <= 1) {
+		Meshlet cluster;
+		cluster.firstTriangle = static_cast<uint32_t> (begin);
+		cluster.numTriangles = static_cast<uint32_t> (end - begin);
+		computeMeshletBounds (P, T.data () + begin, cluster);
+		clusters.push_back (cluster);
+		return;
+	}
+	auto centroid = [&] (const glm::uvec3 & t) { return P[t[0]] + P[t[1]] + P[t[2]]; }; // Times 3, only compared
+	glm::vec3 boxMin (std::numeric_limits<float>::max ());
+	glm::vec3 boxMax (-std::numeric_limits<float>::max ());
+	for (size_t i = begin; i < end; i++) {
+		boxMin = glm::min (boxMin, centroid (T[i]));
+		boxMax = glm::max (boxMax, centroid (T[i]));
+	}
+	glm::vec3 extent = boxMax - boxMin;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	size_t numFirst = numClusters / 2;
+	size_t middle = begin + (end - begin) * numFirst / numClusters;
+	std::nth_element (T.begin () + begin, T.begin () + middle, T.begin () + end, [&] (const glm::uvec3 & a, const glm::uvec3 & b) {
+		return centroid (a)[axis] < centroid (b)[axis];
+	});
+	splitInClusters (P, T, begin, middle, numFirst, clusters);
+	splitInClusters (P, T, middle, end, numClusters - numFirst, clusters);
+}
+
+/// Group of clusters once simplified
+struct SimplifiedGroup {
+	std::vector<glm::uvec3> triangles;
+	std::vector<Meshlet> clusters; ///< Ranges of triangles. Empty when the group could not be simplified
+	float error = 0.f;
+	glm::vec4 errorBounds = glm::vec4 (0.f);
+};
+
+}
+
+MeshOptimizer::ClusterHierarchyReport MeshOptimizer::buildClusterHierarchy (Mesh & mesh, unsigned int groupSize, unsigned int maxTriangles) {
+	ClusterHierarchyReport report;
+	const Mesh & constMesh = mesh;
+	const std::vector<glm::vec3> & P = constMesh.vertexPositions ();
+	const std::vector<glm::uvec3> & T = constMesh.triangleIndices ();
+	if (constMesh.meshlets ().empty ())
+		return report;
+	std::vector<ClusterNode> nodes;
+	std::vector<glm::uvec3> clusterTriangles;
+	for (const Meshlet & meshlet : constMesh.meshlets ()) {
+		ClusterNode node;
+		node.cluster = meshlet;
+		node.errorBounds = glm::vec4 (meshlet.center, meshlet.radius);
+		nodes.push_back (node);
+	}
+	auto trianglesOf = [&] (const ClusterNode & node) {
+		return (node.level == 0 ? T.data () : clusterTriangles.data ()) + node.cluster.firstTriangle;
+	};
+
+	const uint32_t maxLevels = 32;
+	const uint32_t none = std::numeric_limits<uint32_t>::max ();
+	std::vector<uint32_t> vertexGroup (P.size ());
+	std::vector<unsigned char> lockedVertex (P.size ()); // Read in parallel, not packed
+	std::vector<unsigned char> rootVertex (P.size (), 0); // On roots, which stay drawn next to coarser and coarser neighbours
+	size_t levelBegin = 0;
+	for (uint32_t level = 0; level + 1 < maxLevels && nodes.size () - levelBegin > 1; level++) {
+		size_t levelEnd = nodes.size ();
+		size_t numClusters = levelEnd - levelBegin;
+		std::vector<std::vector<uint32_t>> clusterVertices (numClusters);
+		Parallel::forRange (numClusters, [&] (size_t begin, size_t end) {
+			for (size_t c = begin; c < end; c++) {
+				const ClusterNode & node = nodes[levelBegin + c];
+				const glm::uvec3 * triangles = trianglesOf (node);
+				std::vector<uint32_t> & vertices = clusterVertices[c];
+				for (uint32_t i = 0; i < node.cluster.numTriangles; i++)
+					vertices.insert (vertices.end (), { triangles[i][0], triangles[i][1], triangles[i][2] });
+				std::sort (vertices.begin (), vertices.end ());
+				vertices.erase (std::unique (vertices.begin (), vertices.end ()), vertices.end ());
+			}
+		}, 64);
+		std::vector<std::vector<uint32_t>> groups = groupClusters (clusterVertices, groupSize);
+
+		// The vertices shared by several groups (or with a root) stay in place, so that each group is simplified on its own
+		std::fill (vertexGroup.begin (), vertexGroup.end (), none);
+		std::copy (rootVertex.begin (), rootVertex.end (), lockedVertex.begin ());
+		for (size_t g = 0; g < groups.size (); g++)
+			for (uint32_t c : groups[g])
+				for (uint32_t v : clusterVertices[c]) {
+					if (vertexGroup[v] == none)
+						vertexGroup[v] = static_cast<uint32_t> (g);
+					else if (vertexGroup[v] != g)
+						lockedVertex[v] = 1;
+				}
+
+		std::vector<SimplifiedGroup> simplifiedGroups (groups.size ());
+		Parallel::forRange (groups.size (), [&] (size_t begin, size_t end) {
+			for (size_t g = begin; g < end; g++) {
+				SimplifiedGroup & simplified = simplifiedGroups[g];
+				// Local copy of the group, with compact vertex indices
+				std::vector<uint32_t> vertices;
+				std::vector<glm::uvec3> triangles;
+				float childError = 0.f;
+				glm::vec3 boundsMin (std::numeric_limits<float>::max ());
+				glm::vec3 boundsMax (-std::numeric_limits<float>::max ());
+				for (uint32_t c : groups[g]) {
+					const ClusterNode & node = nodes[levelBegin + c];
+					triangles.insert (triangles.end (), trianglesOf (node), trianglesOf (node) + node.cluster.numTriangles);
+					vertices.insert (vertices.end (), clusterVertices[c].begin (), clusterVertices[c].end ());
+					childError = std::max (childError, node.error);
+					boundsMin = glm::min (boundsMin, glm::vec3 (node.errorBounds) - node.errorBounds.w);
+					boundsMax = glm::max (boundsMax, glm::vec3 (node.errorBounds) + node.errorBounds.w);
+				}
+				std::sort (vertices.begin (), vertices.end ());
+				vertices.erase (std::unique (vertices.begin (), vertices.end ()), vertices.end ());
+				std::vector<glm::vec3> localPositions (vertices.size ());
+				for (size_t i = 0; i < vertices.size (); i++)
+					localPositions[i] = P[vertices[i]];
+				for (glm::uvec3 & t : triangles)
+					for (int j = 0; j < 3; j++)
+						t[j] = static_cast<unsigned int> (std::lower_bound (vertices.begin (), vertices.end (), t[j]) - vertices.begin ());
+
+				MeshSimplifier simplifier (localPositions.data (), localPositions.size (), triangles.data (), triangles.size ());
+				for (size_t i = 0; i < vertices.size (); i++)
+					if (lockedVertex[vertices[i]])
+						simplifier.lockVertex (static_cast<unsigned int> (i));
+				simplifier.simplify (triangles.size () / 2);
+				const std::vector<glm::uvec3> & S = simplifier.triangles ();
+				if (S.empty () || 20 * S.size () > 17 * triangles.size ())
+					continue; // Root
+				simplified.triangles.resize (S.size ());
+				for (size_t i = 0; i < S.size (); i++)
+					simplified.triangles[i] = glm::uvec3 (vertices[S[i][0]], vertices[S[i][1]], vertices[S[i][2]]);
+				simplified.error = childError + simplifier.error ();
+				// Sphere enclosing the ones of the children
+				glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+				float radius = 0.f;
+				for (uint32_t c : groups[g]) {
+					const glm::vec4 & bounds = nodes[levelBegin + c].errorBounds;
+					radius = std::max (radius, glm::length (glm::vec3 (bounds) - center) + bounds.w);
+				}
+				simplified.errorBounds = glm::vec4 (center, radius);
+				size_t numSplits = (simplified.triangles.size () + maxTriangles - 1) / maxTriangles;
+				splitInClusters (P.data (), simplified.triangles, 0, simplified.triangles.size (), numSplits, simplified.clusters);
+			}
+		}, 1);
+
+		for (size_t g = 0; g < groups.size (); g++) {
+			const SimplifiedGroup & simplified = simplifiedGroups[g];
+			if (simplified.clusters.empty ()) {
+				for (uint32_t c : groups[g])
+					for (uint32_t v : clusterVertices[c])
+						rootVertex[v] = 1;
+				continue;
+			}
+			for (uint32_t c : groups[g]) {
+				nodes[levelBegin + c].parentError = simplified.error;
+				nodes[levelBegin + c].parentErrorBounds = simplified.errorBounds;
+			}
+			for (const Meshlet & cluster : simplified.clusters) {
+				ClusterNode node;
+				node.cluster = cluster;
+				node.cluster.firstTriangle += static_cast<uint32_t> (clusterTriangles.size ());
+				node.level = level + 1;
+				node.error = simplified.error;
+				node.errorBounds = simplified.errorBounds;
+				nodes.push_back (node);
+			}
+			clusterTriangles.insert (clusterTriangles.end (), simplified.triangles.begin (), simplified.triangles.end ());
+		}
+		levelBegin = levelEnd;
+	}
+
+	report.numClusters = nodes.size ();
+	for (const ClusterNode & node : nodes) {
+		report.numLevels = std::max<size_t> (report.numLevels, node.level + 1);
+		if (node.parentError == std::numeric_limits<float>::max ()) {
+			report.numRoots++;
+			report.maxError = std::max (report.maxError, node.error);
+		}
+	}
+	report.numTriangles = clusterTriangles.size ();
+	mesh.clusterHierarchy ().swap (nodes);
+	mesh.clusterTriangleIndices ().swap (clusterTriangles);
+	return report;
+}
+
+void MeshOptimizer::optimizeVertexFetch (Mesh & mesh) {
+	// Same triangle order and positions, the meshlets and coarser triangles are still valid once the vertices are renumbered
+	std::vector<Meshlet> meshlets;
+	std::vector<LevelOfDetail> levels;
+	std::vector<glm::uvec3> lodTriangles;
+	meshlets.swap (mesh.meshlets ());
+	levels.swap (mesh.levelsOfDetail ());
+	lodTriangles.swap (mesh.lodTriangleIndices ());
+	std::vector<ClusterNode> clusters;
+	std::vector<glm::uvec3> clusterTriangles;
+	clusters.swap (mesh.clusterHierarchy ());
+	clusterTriangles.swap (mesh.clusterTriangleIndices ());
+	size_t numVertices = static_cast<const Mesh &> (mesh).vertexPositions ().size ();
+	const unsigned int unused = static_cast<unsigned int> (-1);
+	std::vector<unsigned int> remap (numVertices, unused);
+	unsigned int next = 0;
+	for (auto & t : mesh.triangleIndices ())
+		for (int j = 0; j < 3; j++) {
+			if (remap[t[j]] == unused)
+				remap[t[j]] = next++;
+			t[j] = remap[t[j]];
+		}
+	for (auto & r : remap)
+		if (r == unused)
+			r = next++;
+	remapVertexAttribute (mesh.vertexPositions (), remap);
+	remapVertexAttribute (mesh.vertexNormals (), remap);
+	remapVertexAttribute (mesh.vertexTexCoords (), remap);
+	for (auto & t : lodTriangles) // The coarser levels only use vertices of the full detail
+		t = glm::uvec3 (remap[t[0]], remap[t[1]], remap[t[2]]);
+	for (auto & t : clusterTriangles)
+		t = glm::uvec3 (remap[t[0]], remap[t[1]], remap[t[2]]);
+	mesh.meshlets ().swap (meshlets);
+	mesh.levelsOfDetail ().swap (levels);
+	mesh.lodTriangleIndices ().swap (lodTriangles);
+	mesh.clusterHierarchy ().swap (clusters);
+	mesh.clusterTriangleIndices ().swap (clusterTriangles);
+}
+
+MeshOptimizer::WeldReport MeshOptimizer::weldVertices (Mesh & mesh, float epsilon) {
+	WeldReport report;
+	const Mesh & constMesh = mesh;
+	const auto & P = constMesh.vertexPositions ();
+	const auto & N = constMesh.vertexNormals ();
+	const auto & UV = constMesh.vertexTexCoords ();
+	size_t numVertices = P.size ();
+	if (numVertices == 0)
+		return report;
+	bool hasNormals = N.size () == numVertices;
+	bool hasTexCoords = UV.size () == numVertices;
+	epsilon = std::max (epsilon, 0.f);
+	float squaredEpsilon = epsilon * epsilon;
+	SpatialHashGrid grid (P, epsilon);
+
+	// Every vertex points to the lowest index vertex it can merge with, possibly itself
+	std::vector<uint32_t> representative (numVertices);
+	Parallel::forRange (numVertices, [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			uint32_t best = static_cast<uint32_t> (i);
+			grid.forEachCandidate (P[i], [&] (uint32_t j) {
+				if (j >= best)
+					return;
+				glm::vec3 d = P[j] - P[i];
+				if (glm::dot (d, d) > squaredEpsilon)
+					return;
+				if ((hasNormals && N[j] != N[i]) || (hasTexCoords && UV[j] != UV[i]))
+					return;
+				best = j;
+			});
+			representative[i] = best;
+		}
+	});
+	// Representatives have lower indices, so one forward pass resolves the chains and numbers the kept vertices
+	std::vector<uint32_t> remap (numVertices);
+	uint32_t numKept = 0;
+	for (size_t i = 0; i < numVertices; i++)
+		remap[i] = representative[i] == i ? numKept++ : remap[representative[i]];
+	report.removedVertices = numVertices - numKept;
+	if (report.removedVertices == 0)
+		return report;
+
+	auto compact = [&] (auto & attribute) {
+		for (size_t i = 0; i < numVertices; i++)
+			if (representative[i] == i)
+				attribute[remap[i]] = attribute[i]; // remap[i] <= i: in place
+		attribute.resize (numKept);
+		attribute.shrink_to_fit ();
+	};
+	compact (mesh.vertexPositions ());
+	if (hasNormals)
+		compact (mesh.vertexNormals ());
+	if (hasTexCoords)
+		compact (mesh.vertexTexCoords ());
+
+	auto & T = mesh.triangleIndices ();
+	Parallel::forRange (T.size (), [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			T[i] = glm::uvec3 (remap[T[i][0]], remap[T[i][1]], remap[T[i][2]]);
+	});
+	size_t numTriangles = T.size ();
+	T.erase (std::remove_if (T.begin (), T.end (), [] (const glm::uvec3 & t) {
+		return t[0] == t[1] || t[1] == t[2] || t[2] == t[0];
+	}), T.end ());
+	T.shrink_to_fit ();
+	report.removedTriangles = numTriangles - T.size ();
+	report.savedBytes = report.removedVertices * (sizeof (glm::vec3) + sizeof (glm::vec3) + sizeof (glm::vec2))
+						+ report.removedTriangles * sizeof (glm::uvec3);
+	return report;
+}
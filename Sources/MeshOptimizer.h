@@ -0,0 +1,116 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+
+#include "Mesh.h"
+
+/// Passes rewriting the mesh arrays to make the mesh cheaper to draw or to store.
+namespace MeshOptimizer {
+
+/// Outcome of weldVertices
+struct WeldReport {
+	size_t removedVertices = 0;
+	size_t removedTriangles = 0; ///< Triangles degenerated by the merge
+	size_t savedBytes = 0; ///< Per copy of the mesh (CPU-side vectors or GPU buffers)
+};
+
+/// Merges the vertices lying within epsilon of each other (0: identical positions only) and rewrites the triangles
+/// accordingly, dropping the ones which degenerate. Vertices with different normals or texture coordinates, when the
+/// mesh has them, are kept apart so that hard edges and seams survive. Clusters are built from the lowest index vertex
+/// within reach, which makes the result independent of the number of threads.
+/// Runs in parallel over a spatial hash grid of cell size epsilon.
+WeldReport weldVertices (Mesh & mesh, float epsilon);
+
+/// Reorders the triangles for the post-transform vertex cache with Tipsify (Sander et al., "Fast Triangle Reordering
+/// for Vertex Locality and Reduced Overdraw", 2007), which runs in linear time. cacheSize is the targeted FIFO size.
+void optimizeVertexCache (Mesh & mesh, unsigned int cacheSize = 16);
+
+/// Reorders clusters of triangles to reduce overdraw, keeping most of the vertex cache locality (Sander et al. 2007).
+/// The current order, e.g., from optimizeVertexCache, is split where all the vertices of a triangle miss the cache,
+/// then further wherever the ACMR of the cluster so far drops to threshold times the one of the whole cluster. Clusters
+/// are then drawn by decreasing occlusion potential, i.e., outward facing clusters far from the mesh center first.
+/// threshold >= 1 trades cache efficiency (ACMR up to threshold times higher) for smaller, better sorted clusters.
+void optimizeOverdraw (Mesh & mesh, float threshold = 1.05f, unsigned int cacheSize = 16);
+
+/// Outcome of buildMeshlets
+struct MeshletReport {
+	size_t numMeshlets = 0;
+	float averageNumVertices = 0.f;
+	float averageNumTriangles = 0.f;
+	size_t numConeCullable = 0; ///< Meshlets whose normals are gathered enough for back-face culling
+};
+
+/// Partitions the triangles in meshlets of at most maxVertices distinct vertices and maxTriangles triangles, reorders
+/// the triangles so that each meshlet is a contiguous range, and stores the meshlets with their bounding sphere and
+/// normal cone in the mesh (see Mesh::meshlets). Each meshlet is seeded next to the previous one, or with the first
+/// triangle left in the current order, then grows greedily over the adjacent triangles adding the fewest vertices,
+/// preferring the ones close to its center and aligned with its normals, so that it stays round with a narrow cone.
+/// Triangles keep their relative order within a meshlet, which preserves most of the vertex cache locality, and the
+/// meshlets are then drawn by decreasing occlusion potential like the clusters of optimizeOverdraw.
+MeshletReport buildMeshlets (Mesh & mesh, unsigned int maxVertices = 64, unsigned int maxTriangles = 124);
+
+/// Outcome of buildLevelsOfDetail
+struct LevelOfDetailReport {
+	size_t numLevels = 0; ///< Besides the full detail
+	size_t numTriangles = 0; ///< Of all the levels together
+	float maxError = 0.f; ///< Of the coarsest level, in model units
+};
+
+/// Builds a chain of simplified versions of the triangles sharing the vertices of the mesh (see MeshSimplifier), with
+/// the given ratios of the original number of triangles, by decreasing ratio. Each level continues the simplification
+/// of the previous one, and is reordered for the vertex cache. Levels which cannot be simplified much further than the
+/// previous one (less than 10% fewer triangles) or which vanish are dropped. Stored in the mesh (see
+/// Mesh::levelsOfDetail), with the error of each level.
+LevelOfDetailReport buildLevelsOfDetail (Mesh & mesh, const std::vector<float> & ratios = { 0.5f, 0.25f, 0.1f, 0.02f }, unsigned int cacheSize = 16);
+
+/// Outcome of buildClusterHierarchy
+struct ClusterHierarchyReport {
+	size_t numClusters = 0; ///< Including the meshlets
+	size_t numLevels = 0; ///< Including the meshlets
+	size_t numRoots = 0; ///< Clusters which could not be simplified any further
+	size_t numTriangles = 0; ///< Of the clusters above the meshlets
+	float maxError = 0.f; ///< Of the roots, in model units
+};
+
+/// Builds a hierarchy of clusters of increasing simplification on top of the meshlets (see buildMeshlets), in the
+/// spirit of Nanite (Karis et al., "Nanite: A Deep Dive", 2021). Level by level, the clusters are gathered in groups of
+/// groupSize clusters sharing the most vertices, and the triangles of each group are simplified to half of them while
+/// the vertices shared with the other groups stay in place, so that groups are simplified independently (and in
+/// parallel) without cracks. The simplified triangles are split along their longest axis in clusters of at most
+/// maxTriangles triangles, which form the next level. Groups which cannot be simplified enough (by 15%) are the roots
+/// of the hierarchy. The error of a group adds its simplification error to the one of its clusters, and its bounds
+/// enclose theirs, so that errors only grow towards the roots. Stored in the mesh (see Mesh::clusterHierarchy).
+ClusterHierarchyReport buildClusterHierarchy (Mesh & mesh, unsigned int groupSize = 4, unsigned int maxTriangles = 124);
+
+/// Renumbers the vertices in their order of first use by the triangles, so that vertex fetches walk the buffers
+/// forward and consecutive indices stay close. Unreferenced vertices are moved last, in their original order.
+/// The triangle order, hence the meshlets, are preserved, and so are the levels of detail and cluster hierarchy, whose
+/// indices are remapped.
+void optimizeVertexFetch (Mesh & mesh);
+
+/// Efficiency of the triangle order for a FIFO post-transform vertex cache
+struct VertexCacheStatistics {
+	size_t numTransformedVertices = 0; ///< Cache misses
+	float acmr = 0.f; ///< Average cache miss ratio: transformed vertices per triangle, 3 at worst, 0.5 for an ideal regular grid
+	float atvr = 0.f; ///< Average transformed vertex ratio: transformed vertices per referenced vertex, 1 at best
+};
+
+/// Simulates a FIFO vertex cache of cacheSize entries over the triangles of the mesh.
+VertexCacheStatistics analyzeVertexCache (const Mesh & mesh, unsigned int cacheSize = 16);
+
+/// Applies a remapping table (old index -> new index) to a per-vertex array.
+template<typename T>
+void remapVertexAttribute (std::vector<T> & attribute, const std::vector<unsigned int> & remap) {
+	if (attribute.size () != remap.size ())
+		return;
+	std::vector<T> remapped (attribute.size ());
+	for (size_t i = 0; i < attribute.size (); i++)
+		remapped[remap[i]] = attribute[i];
+	attribute.swap (remapped);
+}
+
+}
+
+#endif // MESH_OPTIMIZER_H
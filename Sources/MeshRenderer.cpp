@@ -0,0 +1,200 @@
+#include "MeshRenderer.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+/// Planes of the view frustum of a model-view-projection matrix, in model space, as (normal, offset) with the normals
+/// pointing inward (Gribb and Hartmann). Normalized, so that they give signed distances.
+void extractFrustumPlanes (const glm::mat4 & modelViewProjection, glm::vec4 planes[6]) {
+	glm::mat4 m = glm::transpose (modelViewProjection); // Rows of the matrix as columns
+	for (int i = 0; i < 3; i++) {
+		planes[2 * i] = m[3] + m[i];
+		planes[2 * i + 1] = m[3] - m[i];
+	}
+	for (int i = 0; i < 6; i++)
+		planes[i] /= glm::length (glm::vec3 (planes[i]));
+}
+
+inline bool isOutsideFrustum (const glm::vec4 planes[6], const glm::vec3 & center, float radius) {
+	for (int i = 0; i < 6; i++)
+		if (glm::dot (glm::vec3 (planes[i]), center) + planes[i][3] < -radius)
+			return true;
+	return false;
+}
+
+}
+
+void MeshRenderer::init (GLuint vao, GLenum indexType, size_t numTriangles, size_t numLodTriangles, size_t numMeshlets, size_t numLevelsOfDetail, size_t numClusters) {
+	release ();
+	m_vao = vao;
+	m_indexType = indexType;
+	m_numTriangles = numTriangles;
+	m_numLodTriangles = numLodTriangles;
+	m_numMeshlets = numMeshlets;
+	m_numLevelsOfDetail = numLevelsOfDetail;
+	m_numClusters = numClusters;
+	if (m_numMeshlets > 0 || m_numClusters > 0) {
+		glCreateBuffers (1, &m_indirectBuffer); // Draw commands of the visible meshlets or clusters, rewritten every frame
+		size_t maxNumCommands = std::max (m_numMeshlets, m_numClusters);
+		glNamedBufferStorage (m_indirectBuffer, sizeof (DrawElementsIndirectCommand) * maxNumCommands, NULL, GL_DYNAMIC_STORAGE_BIT);
+	}
+}
+
+void MeshRenderer::release () {
+	if (m_indirectBuffer) {
+		glDeleteBuffers (1, &m_indirectBuffer);
+		m_indirectBuffer = 0;
+	}
+	m_vao = 0;
+	m_numTriangles = 0;
+	m_numLodTriangles = 0;
+	m_numMeshlets = 0;
+	m_numLevelsOfDetail = 0;
+	m_numClusters = 0;
+	m_levelOfDetail = 0;
+	m_renderStats = RenderStats ();
+}
+
+size_t MeshRenderer::cpuBytes () const {
+	return sizeof (DrawElementsIndirectCommand) * m_drawCommands.capacity ();
+}
+
+size_t MeshRenderer::gpuBytes () const {
+	return m_indirectBuffer ? sizeof (DrawElementsIndirectCommand) * std::max (m_numMeshlets, m_numClusters) : 0;
+}
+
+void MeshRenderer::render () {
+	glBindVertexArray (m_vao); // Activate the VAO storing geometry data
+	glDrawElements (GL_TRIANGLES, static_cast<GLsizei> (m_numTriangles * 3), m_indexType, 0); // Call for rendering: stream the current GPU geometry through the current GPU program
+}
+
+void MeshRenderer::render (const std::vector<Meshlet> & meshlets, const std::vector<LevelOfDetail> & levelsOfDetail,
+						   const std::vector<ClusterNode> & clusterHierarchy, const GeometryKernels::Bounds & bounds,
+						   const glm::mat4 & modelViewMatrix, const glm::mat4 & projectionMatrix, float viewportHeight,
+						   bool selectLevelOfDetail, bool cullClusters) {
+	// Projected size of the mesh: pixels per model unit at the point of the bounding sphere closest to the viewer
+	glm::vec3 center (modelViewMatrix * glm::vec4 (bounds.sphereCenter, 1.f));
+	float scale = glm::length (glm::vec3 (modelViewMatrix[0])); // Uniform scaling of the model transform
+	float radius = bounds.sphereRadius * scale;
+	float distance = std::max (glm::length (center) - radius, 1e-3f * std::max (radius, 1e-6f));
+	float pixelsPerUnit = 0.5f * viewportHeight * projectionMatrix[1][1] * scale / distance;
+	m_renderStats = RenderStats ();
+	m_renderStats.projectedRadius = bounds.sphereRadius * pixelsPerUnit;
+
+	// The cluster hierarchy must still describe the uploaded index buffer
+	if (selectLevelOfDetail && m_numClusters > 0 && clusterHierarchy.size () == m_numClusters) {
+		m_levelOfDetail = 0;
+		drawClusterHierarchy (clusterHierarchy, modelViewMatrix, projectionMatrix, 0.5f * viewportHeight * projectionMatrix[1][1], cullClusters);
+		return;
+	}
+
+	// The levels of detail must still describe the uploaded index buffer
+	if (!selectLevelOfDetail || m_numLevelsOfDetail == 0 || levelsOfDetail.size () != m_numLevelsOfDetail)
+		m_levelOfDetail = 0;
+	else {
+		// Hysteresis: refine as soon as the current error exceeds a pixel, coarsen only once the next one is well below
+		const float maxError = 1.f;
+		const float coarsenFactor = 0.75f;
+		auto projectedError = [&] (unsigned int level) {
+			return level == 0 ? 0.f : levelsOfDetail[level - 1].error * pixelsPerUnit;
+		};
+		m_levelOfDetail = std::min<unsigned int> (m_levelOfDetail, static_cast<unsigned int> (m_numLevelsOfDetail));
+		while (m_levelOfDetail > 0 && projectedError (m_levelOfDetail) > maxError)
+			m_levelOfDetail--;
+		while (m_levelOfDetail < m_numLevelsOfDetail && projectedError (m_levelOfDetail + 1) <= coarsenFactor * maxError)
+			m_levelOfDetail++;
+	}
+	m_renderStats.levelOfDetail = m_levelOfDetail;
+	if (m_levelOfDetail > 0)
+		drawLevelOfDetail (levelsOfDetail[m_levelOfDetail - 1]);
+	else if (cullClusters && m_numMeshlets > 0 && meshlets.size () == m_numMeshlets) // The meshlets must still describe the uploaded index buffer
+		drawMeshlets (meshlets, modelViewMatrix, projectionMatrix);
+	else {
+		m_renderStats.numDrawnTriangles = m_numTriangles;
+		m_renderStats.numDrawCommands = 1;
+		render ();
+	}
+}
+
+void MeshRenderer::drawLevelOfDetail (const LevelOfDetail & lod) {
+	m_renderStats.numDrawnTriangles = lod.numTriangles;
+	m_renderStats.numDrawCommands = 1;
+	size_t indexSize = m_indexType == GL_UNSIGNED_SHORT ? sizeof (GLushort) : sizeof (GLuint);
+	size_t offset = 3 * indexSize * (m_numTriangles + lod.firstTriangle);
+	glBindVertexArray (m_vao);
+	glDrawElements (GL_TRIANGLES, static_cast<GLsizei> (lod.numTriangles * 3), m_indexType, reinterpret_cast<const void *> (offset));
+}
+
+void MeshRenderer::drawMeshlets (const std::vector<Meshlet> & meshlets, const glm::mat4 & modelViewMatrix, const glm::mat4 & projectionMatrix) {
+	glm::vec4 planes[6];
+	extractFrustumPlanes (projectionMatrix * modelViewMatrix, planes);
+	glm::vec3 eye (glm::inverse (modelViewMatrix)[3]); // Viewer in model space
+	RenderStats & stats = m_renderStats;
+	stats.numMeshlets = meshlets.size ();
+	m_drawCommands.clear ();
+	for (const Meshlet & meshlet : meshlets) {
+		if (isOutsideFrustum (planes, meshlet.center, meshlet.radius)) {
+			stats.numFrustumCulled++;
+			continue;
+		}
+		if (meshlet.isBackFacing (eye)) {
+			stats.numBackFaceCulled++;
+			continue;
+		}
+		stats.numDrawnTriangles += meshlet.numTriangles;
+		// Meshlets are stored in order, a visible meshlet following a visible one extends its command
+		if (!m_drawCommands.empty () && m_drawCommands.back ().firstIndex + m_drawCommands.back ().count == 3 * meshlet.firstTriangle)
+			m_drawCommands.back ().count += 3 * meshlet.numTriangles;
+		else
+			m_drawCommands.push_back ({ 3 * meshlet.numTriangles, 1, 3 * meshlet.firstTriangle, 0, 0 });
+	}
+	submitDrawCommands ();
+}
+
+void MeshRenderer::drawClusterHierarchy (const std::vector<ClusterNode> & clusterHierarchy, const glm::mat4 & modelViewMatrix,
+										 const glm::mat4 & projectionMatrix, float pixelsPerUnit, bool cullClusters) {
+	const float maxError = 1.f; // Pixels
+	glm::vec4 planes[6];
+	extractFrustumPlanes (projectionMatrix * modelViewMatrix, planes);
+	glm::vec3 eye (glm::inverse (modelViewMatrix)[3]); // Viewer in model space, where the errors are measured
+	RenderStats & stats = m_renderStats;
+	size_t clusterTrianglesBase = m_numTriangles + m_numLodTriangles;
+	m_drawCommands.clear ();
+	// Each cluster decides on its own whether it belongs to the cut, which amounts to the traversal of the hierarchy
+	for (const ClusterNode & node : clusterHierarchy) {
+		if (!node.isSelected (eye, pixelsPerUnit, maxError))
+			continue;
+		const Meshlet & cluster = node.cluster;
+		stats.numMeshlets++;
+		stats.levelOfDetail = std::max (stats.levelOfDetail, node.level);
+		if (cullClusters && isOutsideFrustum (planes, cluster.center, cluster.radius)) {
+			stats.numFrustumCulled++;
+			continue;
+		}
+		if (cullClusters && cluster.isBackFacing (eye)) {
+			stats.numBackFaceCulled++;
+			continue;
+		}
+		stats.numDrawnTriangles += cluster.numTriangles;
+		GLuint firstIndex = static_cast<GLuint> (3 * (node.level == 0 ? cluster.firstTriangle : clusterTrianglesBase + cluster.firstTriangle));
+		if (!m_drawCommands.empty () && m_drawCommands.back ().firstIndex + m_drawCommands.back ().count == firstIndex)
+			m_drawCommands.back ().count += 3 * cluster.numTriangles;
+		else
+			m_drawCommands.push_back ({ 3 * cluster.numTriangles, 1, firstIndex, 0, 0 });
+	}
+	submitDrawCommands ();
+}
+
+void MeshRenderer::submitDrawCommands () {
+	m_renderStats.numDrawCommands = m_drawCommands.size ();
+	if (m_drawCommands.empty ())
+		return;
+	glNamedBufferSubData (m_indirectBuffer, 0, sizeof (DrawElementsIndirectCommand) * m_drawCommands.size (), m_drawCommands.data ());
+	glBindVertexArray (m_vao);
+	glBindBuffer (GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glMultiDrawElementsIndirect (GL_TRIANGLES, m_indexType, 0, static_cast<GLsizei> (m_drawCommands.size ()), 0);
+	glBindBuffer (GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,77 @@
+#ifndef MESH_RENDERER_H
+#define MESH_RENDERER_H
+
+#include <glad/glad.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Meshlet.h"
+#include "GeometryKernels.h"
+
+/// Draws every triangle of an uploaded mesh, a level of detail, or the culled meshlets or clusters by indirect multi-draw
+class MeshRenderer {
+public:
+	/// Outcome of the level of detail selection and cluster culling of the last render call
+	struct RenderStats {
+		unsigned int levelOfDetail = 0; ///< Coarsest level of the cut through the cluster hierarchy, when used
+		float projectedRadius = 0.f; ///< Of the bounding sphere, in pixels
+		size_t numMeshlets = 0; ///< Meshlets at full detail, clusters of the cut through the hierarchy, culled individually
+		size_t numFrustumCulled = 0;
+		size_t numBackFaceCulled = 0;
+		size_t numDrawnTriangles = 0;
+		size_t numDrawCommands = 0; ///< Consecutive visible meshlets share a command
+	};
+
+	/// Index buffer layout: full detail, levels of detail, then clusters above the meshlets
+	void init (GLuint vao, GLenum indexType, size_t numTriangles, size_t numLodTriangles, size_t numMeshlets, size_t numLevelsOfDetail, size_t numClusters);
+
+	/// Deletes the indirect buffer
+	void release ();
+
+	/// Draws every triangle
+	void render ();
+
+	/// Selects the level of detail, or cut of the hierarchy, projecting to under a pixel, and culls the clusters
+	void render (const std::vector<Meshlet> & meshlets, const std::vector<LevelOfDetail> & levelsOfDetail,
+				 const std::vector<ClusterNode> & clusterHierarchy, const GeometryKernels::Bounds & bounds,
+				 const glm::mat4 & modelViewMatrix, const glm::mat4 & projectionMatrix, float viewportHeight,
+				 bool selectLevelOfDetail, bool cullClusters);
+
+	inline const RenderStats & renderStats () const { return m_renderStats; }
+
+	/// Staging of the draw commands
+	size_t cpuBytes () const;
+	/// Indirect buffer
+	size_t gpuBytes () const;
+
+private:
+	/// Layout expected by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	void drawLevelOfDetail (const LevelOfDetail & lod);
+	void drawMeshlets (const std::vector<Meshlet> & meshlets, const glm::mat4 & modelViewMatrix, const glm::mat4 & projectionMatrix);
+	void drawClusterHierarchy (const std::vector<ClusterNode> & clusterHierarchy, const glm::mat4 & modelViewMatrix,
+							   const glm::mat4 & projectionMatrix, float pixelsPerUnit, bool cullClusters);
+	void submitDrawCommands ();
+
+	GLuint m_vao = 0;
+	GLenum m_indexType = GL_UNSIGNED_INT;
+	size_t m_numTriangles = 0;
+	size_t m_numLodTriangles = 0;
+	size_t m_numMeshlets = 0;
+	size_t m_numLevelsOfDetail = 0;
+	size_t m_numClusters = 0;
+	GLuint m_indirectBuffer = 0; // One draw command per meshlet, or cluster of the hierarchy, at most
+	std::vector<DrawElementsIndirectCommand> m_drawCommands; // Staging of the indirect buffer, kept across frames
+	unsigned int m_levelOfDetail = 0; // Selected at the last render call
+	RenderStats m_renderStats;
+};
+
+#endif // MESH_RENDERER_H
@@ -0,0 +1,188 @@
+#include "MeshSimplifier.h"
+#include "MeshAdjacency.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+/// Weight of the planes keeping the boundaries in place, relative to the ones of the triangles
+const double BOUNDARY_WEIGHT = 10.0;
+
+struct Collapse {
+	float cost;
+	unsigned int from;
+	unsigned int to;
+};
+
+}
+
+void MeshSimplifier::Quadric::addPlane (const glm::dvec3 & n, double d, double w) {
+	a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+	b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+	c2 += w * n.z * n.z; cd += w * n.z * d;
+	d2 += w * d * d;
+	weight += w;
+}
+
+void MeshSimplifier::Quadric::operator+= (const Quadric & q) {
+	a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+	b2 += q.b2; bc += q.bc; bd += q.bd;
+	c2 += q.c2; cd += q.cd;
+	d2 += q.d2;
+	weight += q.weight;
+}
+
+double MeshSimplifier::Quadric::evaluate (const glm::dvec3 & p) const {
+	double e = a2 * p.x * p.x + 2.0 * ab * p.x * p.y + 2.0 * ac * p.x * p.z + 2.0 * ad * p.x
+			 + b2 * p.y * p.y + 2.0 * bc * p.y * p.z + 2.0 * bd * p.y
+			 + c2 * p.z * p.z + 2.0 * cd * p.z
+			 + d2;
+	return std::max (e, 0.0); // Rounding
+}
+
+MeshSimplifier::MeshSimplifier (const glm::vec3 * P, size_t numVertices, const glm::uvec3 * T, size_t numTriangles)
+	: m_positions (P), m_numVertices (numVertices), m_triangles (T, T + numTriangles), m_quadrics (numVertices), m_locked (numVertices, false) {
+	// Plane of each triangle, weighted by its area, plus a plane orthogonal to it along each of its boundary edges
+	MeshAdjacency adjacency (T, numTriangles, numVertices);
+	for (size_t t = 0; t < numTriangles; t++) {
+		glm::dvec3 p[3] = { glm::dvec3 (P[T[t][0]]), glm::dvec3 (P[T[t][1]]), glm::dvec3 (P[T[t][2]]) };
+		glm::dvec3 n = glm::cross (p[1] - p[0], p[2] - p[0]);
+		double length = glm::length (n);
+		if (length == 0.0)
+			continue;
+		n /= length;
+		Quadric q;
+		q.addPlane (n, -glm::dot (n, p[0]), 0.5 * length);
+		for (int j = 0; j < 3; j++)
+			m_quadrics[T[t][j]] += q;
+		for (int j = 0; j < 3; j++) {
+			if (adjacency.twin (static_cast<unsigned int> (3 * t + j)) != MeshAdjacency::NoTwin)
+				continue;
+			glm::dvec3 edge = p[(j + 1) % 3] - p[j];
+			glm::dvec3 m = glm::cross (edge, n);
+			double edgeLength = glm::length (m);
+			if (edgeLength == 0.0)
+				continue;
+			m /= edgeLength;
+			Quadric b;
+			b.addPlane (m, -glm::dot (m, p[j]), BOUNDARY_WEIGHT * edgeLength * edgeLength);
+			m_quadrics[T[t][j]] += b;
+			m_quadrics[T[t][(j + 1) % 3]] += b;
+		}
+	}
+
+	// Seams: vertices sharing their position with another one
+	std::vector<unsigned int> sorted (numVertices);
+	for (size_t v = 0; v < numVertices; v++)
+		sorted[v] = static_cast<unsigned int> (v);
+	auto less = [&] (unsigned int a, unsigned int b) {
+		return P[a].x != P[b].x ? P[a].x < P[b].x : (P[a].y != P[b].y ? P[a].y < P[b].y : P[a].z < P[b].z);
+	};
+	std::sort (sorted.begin (), sorted.end (), less);
+	for (size_t i = 1; i < numVertices; i++)
+		if (P[sorted[i]] == P[sorted[i - 1]])
+			m_locked[sorted[i]] = m_locked[sorted[i - 1]] = true;
+}
+
+void MeshSimplifier::simplify (size_t targetNumTriangles) {
+	const glm::vec3 * P = m_positions;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap (m_numVertices);
+	std::vector<bool> touched (m_numVertices);
+	std::vector<unsigned char> boundary (m_numVertices); // Written in parallel, not packed
+	while (m_triangles.size () > targetNumTriangles) {
+		const std::vector<glm::uvec3> & T = m_triangles;
+		MeshAdjacency adjacency (T.data (), T.size (), m_numVertices);
+		Parallel::forRange (m_numVertices, [&] (size_t begin, size_t end) {
+			for (size_t v = begin; v < end; v++)
+				boundary[v] = adjacency.isBoundary (static_cast<unsigned int> (v));
+		});
+
+		// Cheapest valid direction of every edge
+		collapses.resize (3 * T.size ());
+		Parallel::forRange (T.size (), [&] (size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++)
+				for (int j = 0; j < 3; j++) {
+					unsigned int h = static_cast<unsigned int> (3 * t + j);
+					unsigned int a = T[t][j];
+					unsigned int b = T[t][(j + 1) % 3];
+					bool boundaryEdge = adjacency.twin (h) == MeshAdjacency::NoTwin;
+					Collapse & collapse = collapses[h];
+					collapse.cost = -1.f;
+					if (a == b || (!boundaryEdge && a > b)) // Interior edges are seen from both sides
+						continue;
+					Quadric q = m_quadrics[a];
+					q += m_quadrics[b];
+					for (int direction = 0; direction < 2; direction++) {
+						unsigned int from = direction ? b : a;
+						unsigned int to = direction ? a : b;
+						if (m_locked[from] || (boundary[from] && !boundaryEdge))
+							continue;
+						float cost = static_cast<float> (q.evaluate (glm::dvec3 (P[to])));
+						if (collapse.cost < 0.f || cost < collapse.cost)
+							collapse = { cost, from, to };
+					}
+				}
+		});
+		collapses.erase (std::remove_if (collapses.begin (), collapses.end (), [] (const Collapse & c) { return c.cost < 0.f; }), collapses.end ());
+		std::sort (collapses.begin (), collapses.end (), [] (const Collapse & a, const Collapse & b) {
+			return a.cost < b.cost || (a.cost == b.cost && (a.from < b.from || (a.from == b.from && a.to < b.to)));
+		});
+
+		for (size_t v = 0; v < m_numVertices; v++)
+			remap[v] = static_cast<unsigned int> (v);
+		std::fill (touched.begin (), touched.end (), false);
+		size_t numRemoved = 0;
+		size_t numToRemove = T.size () - targetNumTriangles;
+		for (const Collapse & collapse : collapses) {
+			if (numRemoved >= numToRemove)
+				break;
+			unsigned int u = collapse.from;
+			unsigned int v = collapse.to;
+			if (touched[u] || touched[v])
+				continue;
+			// The triangles around u, with the collapses of this pass applied, must keep their orientation
+			bool flips = false;
+			size_t numDegenerate = 0;
+			for (unsigned int corner : adjacency.corners (u)) {
+				glm::uvec3 t = T[MeshAdjacency::triangle (corner)];
+				t = glm::uvec3 (remap[t[0]], remap[t[1]], remap[t[2]]);
+				if (t[0] == v || t[1] == v || t[2] == v) {
+					numDegenerate++;
+					continue;
+				}
+				glm::vec3 before = glm::cross (P[t[1]] - P[t[0]], P[t[2]] - P[t[0]]);
+				for (int j = 0; j < 3; j++)
+					if (t[j] == u)
+						t[j] = v;
+				glm::vec3 after = glm::cross (P[t[1]] - P[t[0]], P[t[2]] - P[t[0]]);
+				if (glm::dot (before, after) <= 0.f) {
+					flips = true;
+					break;
+				}
+			}
+			if (flips)
+				continue;
+			remap[u] = v;
+			touched[u] = touched[v] = true;
+			m_quadrics[v] += m_quadrics[u];
+			if (m_quadrics[v].weight > 0.0)
+				m_error = std::max (m_error, static_cast<float> (std::sqrt (collapse.cost / m_quadrics[v].weight)));
+			numRemoved += numDegenerate;
+		}
+		if (numRemoved == 0)
+			break; // Stuck
+		std::vector<glm::uvec3> simplified;
+		simplified.reserve (T.size () - numRemoved);
+		for (const glm::uvec3 & t : T) {
+			glm::uvec3 r (remap[t[0]], remap[t[1]], remap[t[2]]);
+			if (r[0] != r[1] && r[1] != r[2] && r[2] != r[0])
+				simplified.push_back (r);
+		}
+		m_triangles.swap (simplified);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+/// Quadric error metric simplification (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics",
+/// 1997) by half-edge collapses: a vertex is merged into one of its neighbours, which keeps its position, so that every
+/// simplified version indexes the vertices of the original mesh and can share its vertex buffers.
+/// Collapses run in passes over the edges sorted by increasing error, each vertex taking part in one collapse per pass.
+/// Collapses flipping a triangle are rejected, boundary vertices only slide along the boundary, and vertices sharing
+/// their position with another one (texture or normal seams) never move.
+/// Successive calls to simplify continue from the previous result, which builds a chain of levels of detail.
+class MeshSimplifier {
+public:
+	MeshSimplifier (const glm::vec3 * P, size_t numVertices, const glm::uvec3 * T, size_t numTriangles);
+
+	/// Keeps a vertex in place, e.g., on the border of a part simplified separately from the rest of the mesh
+	inline void lockVertex (unsigned int v) { m_locked[v] = true; }
+
+	/// Collapses edges until at most targetNumTriangles triangles remain, or no collapse is possible anymore.
+	void simplify (size_t targetNumTriangles);
+
+	/// Current triangles
+	inline const std::vector<glm::uvec3> & triangles () const { return m_triangles; }
+
+	/// Largest error of the collapses so far, as a distance to the original surface: the root mean square distance of
+	/// the collapsed vertex to the planes of the triangles it stands for.
+	inline float error () const { return m_error; }
+
+private:
+	/// Sum of squared distances to a set of weighted planes, as a symmetric 4x4 matrix
+	struct Quadric {
+		double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0, b2 = 0.0, bc = 0.0, bd = 0.0, c2 = 0.0, cd = 0.0, d2 = 0.0;
+		double weight = 0.0;
+
+		void addPlane (const glm::dvec3 & n, double d, double w);
+		void operator+= (const Quadric & q);
+		double evaluate (const glm::dvec3 & p) const;
+	};
+
+	const glm::vec3 * m_positions;
+	size_t m_numVertices;
+	std::vector<glm::uvec3> m_triangles;
+	std::vector<Quadric> m_quadrics;
+	std::vector<bool> m_locked;
+	float m_error = 0.f;
+};
+
+#endif // MESH_SIMPLIFIER_H
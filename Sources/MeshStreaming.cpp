@@ -0,0 +1,110 @@
+#include "MeshStreaming.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+void MeshStreaming::begin (const GLuint buffers[NumStreams], size_t numVertices, size_t numTriangles, bool texCoords) {
+	close ();
+	size_t sizes[NumStreams] = { sizeof (glm::vec3) * numVertices, sizeof (glm::vec3) * numVertices,
+								 texCoords ? sizeof (glm::vec2) * numVertices : 0, sizeof (glm::uvec3) * numTriangles };
+	for (int i = 0; i < NumStreams; i++) {
+		GLsizeiptr size = static_cast<GLsizeiptr> (std::max<size_t> (sizes[i], 1)); // Empty stores are not allowed
+		// Mapped for the whole streaming and only ever written, sequentially, as the mapping may be uncached
+		GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT;
+		m_buffers[i] = buffers[i];
+		glNamedBufferStorage (m_buffers[i], size, NULL, mapFlags);
+		m_mapped[i] = glMapNamedBufferRange (m_buffers[i], 0, size, mapFlags | GL_MAP_FLUSH_EXPLICIT_BIT);
+	}
+	m_isMapped = true;
+	m_positions.resize (numVertices);
+	m_triangles.resize (numTriangles);
+	m_target.positions = m_positions.data ();
+	m_target.triangles = m_triangles.data ();
+	m_target.numVertices = numVertices;
+	m_target.numTriangles = numTriangles;
+	m_ended = false;
+}
+
+void MeshStreaming::commit (Stream stream, size_t firstElement, size_t numElements) {
+	if (stream == Positions)
+		write (Positions, sizeof (glm::vec3) * firstElement, m_target.positions + firstElement, sizeof (glm::vec3) * numElements);
+	else if (stream == Triangles)
+		write (Triangles, sizeof (glm::uvec3) * firstElement, m_target.triangles + firstElement, sizeof (glm::uvec3) * numElements);
+}
+
+void MeshStreaming::write (Stream stream, size_t offset, const void * data, size_t size) {
+	if (size == 0)
+		return;
+	std::memcpy (static_cast<char *> (m_mapped[stream]) + offset, data, size);
+	std::lock_guard<std::mutex> lock (m_mutex);
+	m_committedRanges.push_back ({ stream, offset, size });
+}
+
+GeometryKernels::Bounds MeshStreaming::end (bool texCoords, bool angleBasedNormals) {
+	const glm::vec3 * P = m_positions.data ();
+	size_t numVertices = m_positions.size ();
+	std::vector<glm::vec3> N (numVertices);
+	GeometryKernels::computePerVertexNormals (P, numVertices, m_triangles.data (), m_triangles.size (), N.data (), angleBasedNormals);
+	write (Normals, 0, N.data (), sizeof (glm::vec3) * numVertices);
+	if (texCoords) {
+		std::vector<glm::vec2> UV (numVertices);
+		GeometryKernels::computePlanarParameterization (P, numVertices, UV.data (), numVertices);
+		write (TexCoords, 0, UV.data (), sizeof (glm::vec2) * numVertices);
+	}
+	GeometryKernels::Bounds bounds = GeometryKernels::computeBounds (P, numVertices);
+	// No CPU-side copy remains once the stream is over
+	m_target = Target ();
+	std::vector<glm::vec3> ().swap (m_positions);
+	std::vector<glm::uvec3> ().swap (m_triangles);
+	std::lock_guard<std::mutex> lock (m_mutex);
+	m_ended = true;
+	return bounds;
+}
+
+bool MeshStreaming::update () {
+	if (!m_isMapped)
+		return true; // Not streaming, or already complete
+	std::vector<StreamedRange> ranges;
+	bool ended;
+	{
+		std::lock_guard<std::mutex> lock (m_mutex);
+		ranges.swap (m_committedRanges);
+		ended = m_ended;
+	}
+	for (const auto & range : ranges)
+		glFlushMappedNamedBufferRange (m_buffers[range.stream], range.offset, range.size);
+	if (!ended)
+		return false;
+	// The mesh is only drawn, and its buffers unmapped, once the GL consumed the last flush
+	if (!m_fence)
+		m_fence = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (glClientWaitSync (m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+		return false;
+	close ();
+	return true;
+}
+
+void MeshStreaming::close () {
+	if (m_isMapped) {
+		if (!m_fence)
+			m_fence = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		while (glClientWaitSync (m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+			continue; // The GL may still be reading the flushed ranges
+		for (int i = 0; i < NumStreams; i++) {
+			glUnmapNamedBuffer (m_buffers[i]);
+			m_mapped[i] = nullptr;
+			m_buffers[i] = 0;
+		}
+		m_isMapped = false;
+	}
+	if (m_fence) {
+		glDeleteSync (m_fence);
+		m_fence = 0;
+	}
+	m_target = Target ();
+	m_positions.clear ();
+	m_triangles.clear ();
+	m_committedRanges.clear ();
+}
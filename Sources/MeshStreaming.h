@@ -0,0 +1,66 @@
+#ifndef MESH_STREAMING_H
+#define MESH_STREAMING_H
+
+#include <glad/glad.h>
+#include <vector>
+#include <mutex>
+
+#include <glm/glm.hpp>
+
+#include "GeometryKernels.h"
+
+/// Streaming upload of a mesh: staging arrays copied into persistently mapped buffers, flushed by the OpenGL thread
+class MeshStreaming {
+public:
+	/// Arrays of a streaming upload
+	enum Stream { Positions = 0, Normals, TexCoords, Triangles, NumStreams };
+
+	/// Writable destination of a streaming upload: CPU-side staging arrays, copied into the mapped GPU buffers as committed
+	struct Target {
+		glm::vec3 * positions = nullptr;
+		glm::uvec3 * triangles = nullptr;
+		size_t numVertices = 0;
+		size_t numTriangles = 0;
+	};
+
+	/// Allocates and maps the stores of the given buffers, and the staging arrays. OpenGL thread only.
+	void begin (const GLuint buffers[NumStreams], size_t numVertices, size_t numTriangles, bool texCoords);
+
+	/// Any thread
+	inline const Target & target () const { return m_target; }
+
+	/// Copies a range of positions or triangles into its mapped buffer, to be flushed at the next update. Any thread.
+	void commit (Stream stream, size_t firstElement, size_t numElements);
+
+	/// Commits the normals and texture coordinates, drops the staging arrays and returns the bounds. Any thread.
+	GeometryKernels::Bounds end (bool texCoords, bool angleBasedNormals);
+
+	/// Flushes the committed ranges, true once the stream is complete and unmapped. OpenGL thread only.
+	bool update ();
+
+	/// Waits for the GL to be done with the flushes, unmaps the buffers and drops the staging arrays. OpenGL thread only.
+	void close ();
+
+private:
+	struct StreamedRange {
+		Stream stream;
+		size_t offset;
+		size_t size;
+	};
+
+	/// Copies bytes into a mapped buffer and queues their flush. Any thread.
+	void write (Stream stream, size_t offset, const void * data, size_t size);
+
+	Target m_target;
+	std::vector<glm::vec3> m_positions; // Staging arrays of the target
+	std::vector<glm::uvec3> m_triangles;
+	GLuint m_buffers[NumStreams] = {};
+	void * m_mapped[NumStreams] = {}; // Write-only
+	bool m_isMapped = false;
+	GLsync m_fence = 0; // Signaled once the GL consumed the last flush
+	std::mutex m_mutex; // Guards the committed ranges and the end flag, shared with the loader thread
+	std::vector<StreamedRange> m_committedRanges;
+	bool m_ended = false;
+};
+
+#endif // MESH_STREAMING_H
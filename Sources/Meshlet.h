@@ -0,0 +1,63 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <cstdint>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+/// Cluster of a few dozen neighbouring triangles, stored contiguously in the index buffer of its mesh, with the bounds
+/// used to cull it as a whole. See MeshOptimizer::buildMeshlets.
+/// Plain data of fixed layout, stored as is in the binary cache.
+struct Meshlet {
+	uint32_t firstTriangle = 0;
+	uint32_t numTriangles = 0;
+	glm::vec3 center = glm::vec3 (0.f); ///< Bounding sphere
+	float radius = 0.f;
+	glm::vec3 coneAxis = glm::vec3 (0.f, 0.f, 1.f); ///< Normal cone: average direction of the triangle normals
+	float coneCutoff = 1.f; ///< Sine of the cone half-angle. 1 when the normals spread too much for the cluster to ever be entirely back-facing
+
+	/// True if every triangle faces away from a viewer at eye, conservatively over the bounding sphere
+	inline bool isBackFacing (const glm::vec3 & eye) const {
+		glm::vec3 d = center - eye;
+		return glm::dot (d, coneAxis) > coneCutoff * glm::length (d) + radius;
+	}
+};
+
+/// Simplified version of the triangles of a mesh, indexing the same vertices (see MeshOptimizer::buildLevelsOfDetail).
+/// Plain data of fixed layout, stored as is in the binary cache.
+struct LevelOfDetail {
+	uint32_t firstTriangle = 0; ///< In the triangles of the levels of detail
+	uint32_t numTriangles = 0;
+	float error = 0.f; ///< Distance to the full detail surface, in model units
+};
+
+/// Node of the cluster hierarchy of a mesh (see MeshOptimizer::buildClusterHierarchy): a cluster of triangles, either a
+/// meshlet of the full detail mesh (level 0) or part of a simplified group of clusters of the level below. Each group
+/// shares its error bounds between the clusters it is made of and the ones simplified from it, so that a cluster is
+/// drawn exactly when its own error is small enough on screen and the one of its parents is not. Plain data of fixed
+/// layout, stored as is in the binary cache.
+struct ClusterNode {
+	Meshlet cluster; ///< Triangles, indexing the mesh triangles at level 0 and the hierarchy triangles above, and culling bounds
+	uint32_t level = 0;
+	float error = 0.f; ///< Simplification error of the triangles of the cluster, in model units, at least the one of its children
+	glm::vec4 errorBounds = glm::vec4 (0.f); ///< Sphere (center, radius) the error is measured from, enclosing the ones of the children
+	float parentError = std::numeric_limits<float>::max (); ///< Same for the parents, infinite for the roots of the hierarchy
+	glm::vec4 parentErrorBounds = glm::vec4 (0.f);
+
+	/// Error of the triangles as seen from eye, in pixels of pixelsPerUnit at unit distance, bounded over the sphere
+	static inline float projectedError (float error, const glm::vec4 & bounds, const glm::vec3 & eye, float pixelsPerUnit) {
+		if (error == 0.f)
+			return 0.f;
+		float distance = glm::length (glm::vec3 (bounds) - eye) - bounds.w;
+		return distance > 0.f ? error * pixelsPerUnit / distance : std::numeric_limits<float>::max ();
+	}
+
+	/// True if the cluster belongs to the cut of the hierarchy whose projected error stays within threshold pixels
+	inline bool isSelected (const glm::vec3 & eye, float pixelsPerUnit, float threshold) const {
+		return projectedError (error, errorBounds, eye, pixelsPerUnit) <= threshold
+			&& (parentError == std::numeric_limits<float>::max () || projectedError (parentError, parentErrorBounds, eye, pixelsPerUnit) > threshold);
+	}
+};
+
+#endif // MESHLET_H
@@ -0,0 +1,164 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+/// Minimal fork-join helpers used by the CPU geometry kernels. Workers are spawned per call and joined before returning.
+namespace Parallel {
+
+namespace detail {
+inline unsigned int & requestedNumThreads () {
+	static unsigned int n = 0;
+	return n;
+}
+}
+
+/// Overrides the number of worker threads. 0 restores the default, i.e., one per hardware thread.
+inline void setNumThreads (unsigned int n) { detail::requestedNumThreads () = n; }
+
+inline unsigned int numThreads () {
+	unsigned int n = detail::requestedNumThreads ();
+	if (n == 0)
+		n = std::thread::hardware_concurrency ();
+	return std::max (n, 1u);
+}
+
+/// Calls func (taskIndex) for every task in [0, numTasks). Tasks are handed out dynamically to the worker threads.
+/// The first exception thrown by a task is rethrown on the calling thread once all workers are done.
+template<typename Func>
+void forEachTask (size_t numTasks, Func func) {
+	size_t numWorkers = std::min<size_t> (numThreads (), numTasks);
+	if (numWorkers <= 1) {
+		for (size_t i = 0; i < numTasks; i++)
+			func (i);
+		return;
+	}
+	std::atomic<size_t> nextTask (0);
+	std::exception_ptr error;
+	std::atomic<bool> failed (false);
+	auto worker = [&] () {
+		try {
+			for (size_t i = nextTask++; i < numTasks && !failed; i = nextTask++)
+				func (i);
+		} catch (...) {
+			if (!failed.exchange (true))
+				error = std::current_exception ();
+		}
+	};
+	std::vector<std::thread> threads;
+	threads.reserve (numWorkers - 1);
+	for (size_t i = 1; i < numWorkers; i++)
+		threads.emplace_back (worker);
+	worker (); // The calling thread takes part in the work
+	for (auto & t : threads)
+		t.join ();
+	if (error)
+		std::rethrow_exception (error);
+}
+
+/// Calls func (begin, end) on contiguous blocks of at least grainSize elements covering [0, count).
+template<typename Func>
+void forRange (size_t count, Func func, size_t grainSize = 4096) {
+	if (count == 0)
+		return;
+	size_t numBlocks = std::min<size_t> ((count + grainSize - 1) / grainSize, 4 * numThreads ());
+	size_t blockSize = (count + numBlocks - 1) / numBlocks;
+	forEachTask (numBlocks, [&] (size_t b) {
+		size_t begin = b * blockSize;
+		size_t end = std::min (count, begin + blockSize);
+		if (begin < end)
+			func (begin, end);
+	});
+}
+
+/// Calls func (begin, end) on blocks of at most grainSize elements covering [0, count), for elements of uneven cost.
+/// Each worker walks a contiguous share of the range, then steals the second half of the largest share left to
+/// another one, and so on until none is left: the blocks of a worker stay close together, unlike with forRange.
+/// Exceptions behave as in forEachTask.
+template<typename Func>
+void forRangeStealing (size_t count, Func func, size_t grainSize = 64) {
+	grainSize = std::max<size_t> (grainSize, 1);
+	size_t numWorkers = std::min<size_t> (numThreads (), (count + grainSize - 1) / grainSize);
+	if (numWorkers <= 1) {
+		for (size_t begin = 0; begin < count; begin += grainSize)
+			func (begin, std::min (count, begin + grainSize));
+		return;
+	}
+	struct Share {
+		std::mutex mutex;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+	std::unique_ptr<Share[]> shares (new Share[numWorkers]);
+	for (size_t w = 0; w < numWorkers; w++) {
+		shares[w].begin = count * w / numWorkers;
+		shares[w].end = count * (w + 1) / numWorkers;
+	}
+	std::exception_ptr error;
+	std::atomic<bool> failed (false);
+	auto worker = [&] (size_t w) {
+		Share & own = shares[w];
+		try {
+			while (!failed) {
+				// Next block of the own share, from its front
+				size_t begin, end;
+				{
+					std::lock_guard<std::mutex> lock (own.mutex);
+					begin = own.begin;
+					end = std::min (own.end, begin + grainSize);
+					own.begin = end;
+				}
+				if (begin < end) {
+					func (begin, end);
+					continue;
+				}
+				// Otherwise half of the largest share left, from its back
+				size_t victim = numWorkers, largest = 0;
+				for (size_t v = 0; v < numWorkers; v++) {
+					if (v == w)
+						continue;
+					std::lock_guard<std::mutex> lock (shares[v].mutex);
+					if (shares[v].end - shares[v].begin > largest) {
+						largest = shares[v].end - shares[v].begin;
+						victim = v;
+					}
+				}
+				if (victim == numWorkers)
+					break; // Only blocks already taken remain
+				{
+					std::lock_guard<std::mutex> lock (shares[victim].mutex);
+					size_t remaining = shares[victim].end - shares[victim].begin;
+					end = shares[victim].end;
+					begin = end - (remaining + 1) / 2;
+					shares[victim].end = begin;
+				}
+				std::lock_guard<std::mutex> lock (own.mutex);
+				own.begin = begin;
+				own.end = end;
+			}
+		} catch (...) {
+			if (!failed.exchange (true))
+				error = std::current_exception ();
+		}
+	};
+	std::vector<std::thread> threads;
+	threads.reserve (numWorkers - 1);
+	for (size_t w = 1; w < numWorkers; w++)
+		threads.emplace_back (worker, w);
+	worker (0); // The calling thread takes part in the work
+	for (auto & t : threads)
+		t.join ();
+	if (error)
+		std::rethrow_exception (error);
+}
+
+}
+
+#endif // PARALLEL_H
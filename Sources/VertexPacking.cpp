@@ -0,0 +1,199 @@
+#define _USE_MATH_DEFINES
+
+#include "VertexPacking.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace {
+
+inline float signNotZero (float x) { return x >= 0.f ? 1.f : -1.f; }
+
+/// As read by the GPU from a normalized short
+inline float decodeSnorm16 (int16_t x) { return std::max (static_cast<float> (x) / 32767.f, -1.f); }
+
+inline int16_t encodeSnorm16 (float x) { return static_cast<int16_t> (std::round (glm::clamp (x, -1.f, 1.f) * 32767.f)); }
+
+inline uint16_t encodeUnorm16 (float x) { return static_cast<uint16_t> (std::round (glm::clamp (x, 0.f, 1.f) * 65535.f)); }
+
+inline float decodeSnorm8 (int8_t x) { return std::max (static_cast<float> (x) / 127.f, -1.f); }
+
+inline int8_t encodeSnorm8 (float x) { return static_cast<int8_t> (std::round (glm::clamp (x, -1.f, 1.f) * 127.f)); }
+
+/// First and third columns of the rotation matrix of a quaternion (x, y, z, w), as the vertex shader computes them,
+/// dividing by the squared norm rather than normalizing
+inline void rotationColumns (const glm::vec4 & q, glm::vec3 & tangent, glm::vec3 & normal) {
+	float s = 2.f / glm::dot (q, q);
+	tangent = glm::vec3 (1.f - s * (q.y * q.y + q.z * q.z), s * (q.x * q.y + q.w * q.z), s * (q.x * q.z - q.w * q.y));
+	normal = glm::vec3 (s * (q.x * q.z + q.w * q.y), s * (q.y * q.z - q.w * q.x), 1.f - s * (q.x * q.x + q.y * q.y));
+}
+
+}
+
+glm::mat4 VertexPacking::dequantizationMatrix (const glm::vec3 & boxMin, const glm::vec3 & boxMax) {
+	return glm::scale (glm::translate (glm::mat4 (1.f), boxMin), boxMax - boxMin);
+}
+
+glm::vec2 VertexPacking::encodeOctahedral (const glm::vec3 & n) {
+	float l1 = std::abs (n.x) + std::abs (n.y) + std::abs (n.z);
+	if (l1 == 0.f)
+		return glm::vec2 (0.f);
+	glm::vec3 p = n / l1;
+	if (p.z >= 0.f)
+		return glm::vec2 (p.x, p.y);
+	return glm::vec2 ((1.f - std::abs (p.y)) * signNotZero (p.x), (1.f - std::abs (p.x)) * signNotZero (p.y));
+}
+
+glm::vec3 VertexPacking::decodeOctahedral (const glm::vec2 & e) {
+	glm::vec3 n (e.x, e.y, 1.f - std::abs (e.x) - std::abs (e.y));
+	if (n.z < 0.f) {
+		float x = n.x;
+		n.x = (1.f - std::abs (n.y)) * signNotZero (x);
+		n.y = (1.f - std::abs (x)) * signNotZero (n.y);
+	}
+	return glm::normalize (n);
+}
+
+VertexPacking::QTangent VertexPacking::encodeQTangent (const glm::vec3 & normal, const glm::vec4 & tangent) {
+	glm::vec3 t (tangent);
+	glm::quat q = glm::normalize (glm::quat_cast (glm::mat3 (t, glm::cross (normal, t), normal)));
+	if (q.w < 0.f)
+		q = -q; // Same rotation
+	// w must not round to zero, its sign carries the handedness
+	const float bias = 1.f / 127.f;
+	glm::vec3 v (q.x, q.y, q.z);
+	if (q.w < bias && glm::length (v) > 0.f) {
+		v *= std::sqrt (1.f - bias * bias) / glm::length (v);
+		q = glm::quat (bias, v.x, v.y, v.z);
+	}
+	// Rounding each component independently is not the closest frame: keep the best of the 16 neighbours
+	glm::vec4 e = glm::vec4 (q.x, q.y, q.z, q.w) * 127.f;
+	QTangent best = {{ 0, 0, 0, 127 }};
+	float bestAlignment = -3.f;
+	for (int corner = 0; corner < 16; corner++) {
+		QTangent candidate;
+		glm::vec4 c;
+		for (int k = 0; k < 4; k++) {
+			candidate.q[k] = encodeSnorm8 (((corner >> k) & 1 ? std::ceil (e[k]) : std::floor (e[k])) / 127.f);
+			c[k] = candidate.q[k]; // The scale does not change the rotation
+		}
+		if (candidate.q[3] == 0)
+			continue;
+		glm::vec3 n, d;
+		rotationColumns (c, d, n);
+		float alignment = glm::dot (normal, n) + glm::dot (t, d);
+		if (alignment > bestAlignment) {
+			bestAlignment = alignment;
+			best = candidate;
+		}
+	}
+	if (tangent.w < 0.f) // Same rotation again, the sign of w now tells the bitangent is flipped
+		for (int k = 0; k < 4; k++)
+			best.q[k] = static_cast<int8_t> (-best.q[k]);
+	return best;
+}
+
+void VertexPacking::decodeQTangent (const QTangent & encoded, glm::vec3 & normal, glm::vec4 & tangent) {
+	glm::vec4 q (decodeSnorm8 (encoded.q[0]), decodeSnorm8 (encoded.q[1]), decodeSnorm8 (encoded.q[2]), decodeSnorm8 (encoded.q[3]));
+	glm::vec3 t;
+	rotationColumns (q, t, normal);
+	tangent = glm::vec4 (t, q.w < 0.f ? -1.f : 1.f);
+}
+
+void VertexPacking::interleaveVertices (const glm::vec3 * P, const glm::vec3 * N, const glm::vec2 * UV, size_t numVertices, InterleavedVertex * interleaved) {
+	Parallel::forRange (numVertices, [&] (size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			InterleavedVertex & vertex = interleaved[v];
+			vertex.position = P[v];
+			vertex.normal = N ? N[v] : glm::vec3 (0.f);
+			vertex.texCoord = UV ? UV[v] : glm::vec2 (0.f);
+		}
+	}, 4096);
+}
+
+VertexPacking::PackingError VertexPacking::packVertices (const glm::vec3 * P, const glm::vec3 * N, const glm::vec2 * UV, const float * AO, size_t numVertices,
+														 const glm::vec3 & boxMin, const glm::vec3 & boxMax, PackedVertex * packed) {
+	glm::vec3 extent = boxMax - boxMin;
+	glm::vec3 scale;
+	for (int k = 0; k < 3; k++)
+		scale[k] = extent[k] > 0.f ? 65535.f / extent[k] : 0.f;
+	PackingError error;
+	std::mutex errorMutex;
+	Parallel::forRange (numVertices, [&] (size_t begin, size_t end) {
+		PackingError local;
+		for (size_t v = begin; v < end; v++) {
+			PackedVertex & vertex = packed[v];
+			glm::vec3 q = glm::clamp (glm::round ((P[v] - boxMin) * scale), glm::vec3 (0.f), glm::vec3 (65535.f));
+			for (int k = 0; k < 3; k++)
+				vertex.position[k] = static_cast<uint16_t> (q[k]);
+			vertex.ambientOcclusion = AO ? encodeUnorm16 (AO[v]) : 0;
+			local.position = std::max (local.position, glm::length (boxMin + q / 65535.f * extent - P[v]));
+
+			vertex.normal[0] = vertex.normal[1] = 0;
+			float length = N ? glm::length (N[v]) : 0.f;
+			if (length > 0.f) {
+				// Rounding each coordinate independently is not the closest direction: keep the best of the 4 neighbours
+				glm::vec3 n = N[v] / length;
+				glm::vec2 e = encodeOctahedral (n) * 32767.f;
+				float bestAlignment = -2.f;
+				for (int corner = 0; corner < 4; corner++) {
+					int16_t x = encodeSnorm16 ((corner & 1 ? std::ceil (e.x) : std::floor (e.x)) / 32767.f);
+					int16_t y = encodeSnorm16 ((corner & 2 ? std::ceil (e.y) : std::floor (e.y)) / 32767.f);
+					float alignment = glm::dot (n, decodeOctahedral (glm::vec2 (decodeSnorm16 (x), decodeSnorm16 (y))));
+					if (alignment > bestAlignment) {
+						bestAlignment = alignment;
+						vertex.normal[0] = x;
+						vertex.normal[1] = y;
+					}
+				}
+				float degrees = static_cast<float> (std::acos (glm::clamp (bestAlignment, -1.f, 1.f)) * 180.0 / M_PI);
+				local.normalDegrees = std::max (local.normalDegrees, degrees);
+			}
+
+			glm::vec2 uv = UV ? UV[v] : glm::vec2 (0.f);
+			for (int k = 0; k < 2; k++) {
+				vertex.texCoord[k] = glm::packHalf1x16 (uv[k]);
+				local.texCoord = std::max (local.texCoord, std::abs (glm::unpackHalf1x16 (vertex.texCoord[k]) - uv[k]));
+			}
+		}
+		std::lock_guard<std::mutex> lock (errorMutex);
+		error.position = std::max (error.position, local.position);
+		error.normalDegrees = std::max (error.normalDegrees, local.normalDegrees);
+		error.texCoord = std::max (error.texCoord, local.texCoord);
+	}, 4096);
+	return error;
+}
+
+void VertexPacking::packAmbientOcclusion (const float * AO, size_t numVertices, uint16_t * packed) {
+	Parallel::forRange (numVertices, [&] (size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++)
+			packed[v] = encodeUnorm16 (AO[v]);
+	}, 4096);
+}
+
+float VertexPacking::packTangentFrames (const glm::vec3 * N, const glm::vec4 * tangents, size_t numVertices, QTangent * packed) {
+	float maxDegrees = 0.f;
+	std::mutex errorMutex;
+	Parallel::forRange (numVertices, [&] (size_t begin, size_t end) {
+		float local = 0.f;
+		for (size_t v = begin; v < end; v++) {
+			packed[v] = encodeQTangent (N[v], tangents[v]);
+			glm::vec3 n;
+			glm::vec4 t;
+			decodeQTangent (packed[v], n, t);
+			glm::vec3 decoded = glm::vec3 (t) - glm::dot (N[v], glm::vec3 (t)) * N[v];
+			float length = glm::length (decoded);
+			float alignment = length > 0.f ? glm::dot (glm::vec3 (tangents[v]), decoded / length) : -1.f;
+			local = std::max (local, static_cast<float> (std::acos (glm::clamp (alignment, -1.f, 1.f)) * 180.0 / M_PI));
+		}
+		std::lock_guard<std::mutex> lock (errorMutex);
+		maxDegrees = std::max (maxDegrees, local);
+	}, 4096);
+	return maxDegrees;
+}
@@ -0,0 +1,83 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/// Interleaved GPU vertex formats, so that fetching a vertex reads a single stream: plain floats in 32 bytes, or the
+/// compact format, with positions quantized to 16 bits over the bounding box of the mesh, octahedral normals
+/// (Cigolle et al., "A Survey of Efficient Representations for Independent Unit Vectors", 2014) on 2x16 bits and half
+/// float texture coordinates, in 16 bytes, the ambient occlusion filling the remaining 2 bytes. Tangent frames for normal
+/// mapping come in a buffer of their own, as QTangents, as does the ambient occlusion of float vertices.
+namespace VertexPacking {
+
+/// Float attributes of a vertex, side by side
+struct InterleavedVertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+};
+
+static_assert (sizeof (InterleavedVertex) == 32, "Interleaved vertices are uploaded as is");
+
+/// Compact vertex, read by the vertex shader as normalized unsigned shorts (position), normalized shorts (normal)
+/// and half floats (texture coordinates). Attributes stay on 4-byte boundaries, which leaves 2 bytes after the position
+/// for the ambient occlusion, read as a normalized unsigned short.
+struct PackedVertex {
+	uint16_t position[3]; ///< In [0, 65535] over the bounding box, see dequantizationMatrix
+	uint16_t ambientOcclusion; ///< In [0, 65535], see packAmbientOcclusion
+	int16_t normal[2]; ///< Octahedral projection, in [-32767, 32767]
+	uint16_t texCoord[2]; ///< Half floats
+};
+
+static_assert (sizeof (PackedVertex) == 16, "Packed vertices are uploaded as is");
+
+/// Tangent frame (tangent, bitangent, normal) as a unit quaternion (Frey and Herzeg, "Spherical Skinning with
+/// Dual-Quaternions and QTangents", 2011), read by the vertex shader as 4 normalized bytes, x, y, z, w. The frame is
+/// right-handed, the sign of w giving the handedness of the actual bitangent: w is kept away from zero so that it has one.
+struct QTangent {
+	int8_t q[4]; ///< In [-127, 127]
+};
+
+static_assert (sizeof (QTangent) == 4, "Tangent frames are uploaded as is");
+
+/// Largest difference between the packed attributes, once decoded, and the float ones
+struct PackingError {
+	float position = 0.f; ///< Model units
+	float normalDegrees = 0.f;
+	float texCoord = 0.f;
+	float tangentDegrees = 0.f; ///< Of the tangent frames, once orthonormalized against the normal, see packTangentFrames
+};
+
+/// Maps the quantized positions, read as [0, 1]^3, back to the bounding box. Folded into the model-view matrix.
+glm::mat4 dequantizationMatrix (const glm::vec3 & boxMin, const glm::vec3 & boxMax);
+
+/// Octahedral projection of a unit vector in [-1, 1]^2, and back
+glm::vec2 encodeOctahedral (const glm::vec3 & n);
+glm::vec3 decodeOctahedral (const glm::vec2 & e);
+
+/// Tangent frame of a unit normal and a unit tangent orthogonal to it, with the handedness in w, and back
+QTangent encodeQTangent (const glm::vec3 & normal, const glm::vec4 & tangent);
+void decodeQTangent (const QTangent & q, glm::vec3 & normal, glm::vec4 & tangent);
+
+/// Interleaves the float attributes in parallel. Any of N and UV may be null, their attribute is then zero.
+void interleaveVertices (const glm::vec3 * P, const glm::vec3 * N, const glm::vec2 * UV, size_t numVertices, InterleavedVertex * interleaved);
+
+/// Packs the vertices in parallel, with the positions quantized over the given box. Any of N, UV and AO (ambient
+/// occlusion) may be null, their attribute is then zero. Returns the largest errors, measured by decoding every packed
+/// vertex as the GPU does.
+PackingError packVertices (const glm::vec3 * P, const glm::vec3 * N, const glm::vec2 * UV, const float * AO, size_t numVertices,
+						   const glm::vec3 & boxMin, const glm::vec3 & boxMax, PackedVertex * packed);
+
+/// Ambient occlusion in [0, 1] as normalized unsigned shorts, for the vertex buffer of float vertices, in parallel
+void packAmbientOcclusion (const float * AO, size_t numVertices, uint16_t * packed);
+
+/// Encodes the tangent frames of the vertices in parallel (see GeometryKernels::computePerVertexTangents). Returns the
+/// largest angle, in degrees, between a tangent and the decoded one, orthonormalized against the normal as the shaders do.
+float packTangentFrames (const glm::vec3 * N, const glm::vec4 * tangents, size_t numVertices, QTangent * packed);
+
+}
+
+#endif // VERTEX_PACKING_H
@@ -0,0 +1,65 @@
+#ifndef VERTEX_SOA_H
+#define VERTEX_SOA_H
+
+#include <vector>
+#include <new>
+#include <algorithm>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Parallel.h"
+
+/// Minimal allocator returning memory aligned on Alignment bytes, e.g., for aligned SIMD loads from a std::vector.
+template<typename T, size_t Alignment>
+struct AlignedAllocator {
+	typedef T value_type;
+	template<typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+	AlignedAllocator () = default;
+	template<typename U> AlignedAllocator (const AlignedAllocator<U, Alignment> &) {}
+
+	T * allocate (size_t n) { return static_cast<T *> (::operator new (n * sizeof (T), std::align_val_t (Alignment))); }
+	void deallocate (T * p, size_t) { ::operator delete (p, std::align_val_t (Alignment)); }
+
+	template<typename U> bool operator== (const AlignedAllocator<U, Alignment> &) const { return true; }
+	template<typename U> bool operator!= (const AlignedAllocator<U, Alignment> &) const { return false; }
+};
+
+/// Vertex positions as separate x, y and z arrays (structure of arrays), for the SIMD geometry kernels.
+/// The arrays start on a cache line and are padded to a multiple of WIDTH floats by replicating the last vertex, which
+/// lets the kernels run whole registers of any width up to AVX-512 without a scalar tail, and leaves min, max and
+/// distance reductions unchanged.
+struct VertexSoA {
+	static const size_t WIDTH = 16;
+	typedef std::vector<float, AlignedAllocator<float, 64>> Array;
+
+	Array x;
+	Array y;
+	Array z;
+	size_t numVertices = 0;
+
+	VertexSoA () = default;
+
+	VertexSoA (const glm::vec3 * P, size_t n) : numVertices (n) {
+		size_t paddedSize = (n + WIDTH - 1) / WIDTH * WIDTH;
+		x.resize (paddedSize);
+		y.resize (paddedSize);
+		z.resize (paddedSize);
+		Parallel::forRange (paddedSize, [&] (size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				const glm::vec3 & p = P[std::min (i, n - 1)];
+				x[i] = p[0];
+				y[i] = p[1];
+				z[i] = p[2];
+			}
+		}, 1 << 16);
+	}
+
+	/// Number of floats per array, padding included
+	inline size_t paddedSize () const { return x.size (); }
+
+	inline glm::vec3 operator[] (size_t i) const { return glm::vec3 (x[i], y[i], z[i]); }
+};
+
+#endif // VERTEX_SOA_H